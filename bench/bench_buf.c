@@ -0,0 +1,261 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  bench_buf.c --  Copying receive pipeline against pooled views       */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Runs the same receive pipeline two ways over an in-memory stream    */
+/*  of newline framed messages, so only the user space cost is timed:   */
+/*                                                                      */
+/*    copy      read() sized block -> framer -> copy into a queue       */
+/*              entry -> copy into each of C_CONSUMERS consumers        */
+/*    view      pool chunk -> framer -> slice -> one reference per      */
+/*              consumer, copying only frames split across chunks       */
+/*                                                                      */
+/*  The memcpy() standing in for read() is counted in both.  Also       */
+/*  times a bare alloc/release pair.  Prints one JSON object per run.   */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ec_frame.h"
+#include "ec_buf.h"
+#include "bench_util.h"
+
+#define CB_CHUNK        4096
+#define CB_MAX_FRAME    1024
+#define C_CONSUMERS     2
+#define C_QUEUE         64          // frames in flight per chunk, at most
+#define C_POOL          (2 * C_QUEUE)
+
+static size_t   cbStream = 32 * 1024 * 1024;
+
+typedef struct {
+    uint8_t     *pbStream;
+    size_t      cbStream;
+    uint64_t    cbCopied;           // memcpy() bytes, read included
+    uint64_t    cFrames;
+    uint64_t    ulSink;             // keeps the consumers from being optimised out
+} RUN;
+
+static uint64_t Consume(const uint8_t *pb, size_t cb) {
+
+    return pb[0] + pb[cb - 1] + cb;
+}
+
+static void RunCopy(RUN *prun, SERIAL_FRAMER *pfr) {
+
+    static uint8_t  rgbRead[CB_CHUNK];
+    static uint8_t  rgrgbQueue[C_QUEUE][CB_MAX_FRAME];
+    static uint8_t  rgrgbConsumer[C_CONSUMERS][CB_MAX_FRAME];
+    size_t          rgcbQueue[C_QUEUE];
+    const uint8_t   *pbFrame;
+    size_t          cbFrame;
+    size_t          ib;
+    size_t          cb;
+    int             cQueued;
+    int             iq;
+    int             icons;
+
+    for ( ib = 0; ib < prun->cbStream; ib += cb ) {
+        cb = ( prun->cbStream - ib < CB_CHUNK ) ? prun->cbStream - ib : CB_CHUNK;
+        memcpy(rgbRead, prun->pbStream + ib, cb);
+        prun->cbCopied += cb;
+
+        SerialFramerPush(pfr, rgbRead, cb);
+        for ( cQueued = 0; (cQueued < C_QUEUE) && SerialFramerNext(pfr, &pbFrame, &cbFrame); cQueued++ ) {
+            memcpy(rgrgbQueue[cQueued], pbFrame, cbFrame);
+            rgcbQueue[cQueued] = cbFrame;
+            prun->cbCopied += cbFrame;
+        }
+        for ( iq = 0; iq < cQueued; iq++ ) {
+            for ( icons = 0; icons < C_CONSUMERS; icons++ ) {
+                memcpy(rgrgbConsumer[icons], rgrgbQueue[iq], rgcbQueue[iq]);
+                prun->cbCopied += rgcbQueue[iq];
+                prun->ulSink += Consume(rgrgbConsumer[icons], rgcbQueue[iq]);
+            }
+        }
+        prun->cFrames += cQueued;
+    }
+}
+
+static void RunView(RUN *prun, SERIAL_FRAMER *pfr, SERIAL_BUF_POOL *ppool) {
+
+    SERIAL_BUF      bufChunk;
+    SERIAL_BUF      rgbufQueue[C_QUEUE];
+    SERIAL_BUF      bufConsumer;
+    const uint8_t   *pbFrame;
+    uint8_t         *pbWrite;
+    size_t          cbFrame;
+    size_t          ib;
+    size_t          cb;
+    int             cQueued;
+    int             iq;
+    int             icons;
+
+    for ( ib = 0; ib < prun->cbStream; ib += cb ) {
+        cb = ( prun->cbStream - ib < CB_CHUNK ) ? prun->cbStream - ib : CB_CHUNK;
+        if ( !SerialBufAlloc(ppool, &bufChunk, &pbWrite) ) {
+            exit(1);
+        }
+        memcpy(pbWrite, prun->pbStream + ib, cb);
+        bufChunk.cb = cb;
+        prun->cbCopied += cb;
+
+        SerialFramerPush(pfr, bufChunk.pb, bufChunk.cb);
+        for ( cQueued = 0; (cQueued < C_QUEUE) && SerialFramerNext(pfr, &pbFrame, &cbFrame); cQueued++ ) {
+            if ( !SerialBufSlice(&bufChunk, pbFrame, cbFrame, &rgbufQueue[cQueued]) ) {
+                // reassembled across chunks, give it a chunk of its own
+                if ( !SerialBufAlloc(ppool, &rgbufQueue[cQueued], &pbWrite) ) {
+                    exit(1);
+                }
+                memcpy(pbWrite, pbFrame, cbFrame);
+                rgbufQueue[cQueued].cb = cbFrame;
+                prun->cbCopied += cbFrame;
+            }
+        }
+        SerialBufRelease(&bufChunk);
+
+        for ( iq = 0; iq < cQueued; iq++ ) {
+            for ( icons = 0; icons < C_CONSUMERS; icons++ ) {
+                // the last consumer takes over the queue's reference
+                bufConsumer = rgbufQueue[iq];
+                if ( icons < C_CONSUMERS - 1 ) {
+                    SerialBufRef(&bufConsumer);
+                }
+                prun->ulSink += Consume(bufConsumer.pb, bufConsumer.cb);
+                SerialBufRelease(&bufConsumer);
+            }
+        }
+        prun->cFrames += cQueued;
+    }
+}
+
+static void Bench(uint8_t *pbStream, size_t cbStreamIn, const char *szFrames, bool fView) {
+
+    SERIAL_FRAME_CFG        cfg;
+    SERIAL_FRAMER           *pfr;
+    SERIAL_BUF_POOL         *ppool;
+    SERIAL_BUF_POOL_STATS   stats;
+    RUN                     run;
+    uint64_t                nsStart;
+    double                  sec;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.type = SERIAL_FRAME_DELIMITER;
+    cfg.bDelimiter = '\n';
+    cfg.cbMaxFrame = CB_MAX_FRAME;
+    pfr = SerialFramerCreate(&cfg);
+    ppool = SerialBufPoolCreate(CB_CHUNK, C_POOL);
+    if ( (pfr == NULL) || (ppool == NULL) ) {
+        exit(1);
+    }
+
+    memset(&run, 0, sizeof(run));
+    run.pbStream = pbStream;
+    run.cbStream = cbStreamIn;
+    nsStart = NowNs();
+    if ( fView ) {
+        RunView(&run, pfr, ppool);
+    } else {
+        RunCopy(&run, pfr);
+    }
+    sec = (NowNs() - nsStart) / 1e9;
+
+    SerialBufPoolGetStats(ppool, &stats);
+    printf("{\"bench\":\"buf\",\"mode\":\"%s\",\"frame_sizes\":\"%s\",\"bytes\":%zu,\"frames\":%llu,"
+           "\"copied_per_byte\":%.2f,\"ns_per_byte\":%.3f,\"mb_per_s\":%.0f,"
+           "\"pool_fails\":%llu,\"sink\":%llu}\n",
+           fView ? "view" : "copy", szFrames, cbStreamIn, (unsigned long long)run.cFrames,
+           (double)run.cbCopied / cbStreamIn, sec * 1e9 / cbStreamIn, cbStreamIn / sec / 1e6,
+           (unsigned long long)stats.cAllocFails, (unsigned long long)(run.ulSink & 0xFF));
+    fflush(stdout);
+
+    SerialBufPoolDestroy(ppool);
+    SerialFramerDestroy(pfr);
+}
+
+static void BenchAlloc(void) {
+
+    SERIAL_BUF_POOL *ppool;
+    SERIAL_BUF      buf;
+    uint8_t         *pbWrite;
+    uint64_t        nsStart;
+    long            cPairs = 10000000;
+    long            i;
+
+    ppool = SerialBufPoolCreate(CB_CHUNK, C_POOL);
+    if ( ppool == NULL ) {
+        exit(1);
+    }
+    nsStart = NowNs();
+    for ( i = 0; i < cPairs; i++ ) {
+        SerialBufAlloc(ppool, &buf, &pbWrite);
+        SerialBufRelease(&buf);
+    }
+    printf("{\"bench\":\"buf\",\"mode\":\"alloc_release\",\"pairs\":%ld,\"ns_per_pair\":%.1f}\n",
+           cPairs, (double)(NowNs() - nsStart) / cPairs);
+    fflush(stdout);
+    SerialBufPoolDestroy(ppool);
+}
+
+static void Fill(uint8_t *pbStream, size_t cbMin, size_t cbMax) {
+
+    size_t      cbFrame;
+    size_t      ib;
+    size_t      i;
+
+    srand(1);
+    for ( ib = 0; ib < cbStream; ib += cbFrame ) {
+        cbFrame = cbMin + rand() % (cbMax - cbMin);
+        for ( i = 0; i < cbFrame - 1; i++ ) {
+            pbStream[ib + i] = 'A' + rand() % 26;
+        }
+        pbStream[ib + cbFrame - 1] = '\n';
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    uint8_t     *pbStream;
+
+    if ( (argc > 1) && (strcmp(argv[1], "--quick") == 0) ) {
+        cbStream = 4 * 1024 * 1024;
+    }
+
+    pbStream = malloc(cbStream + CB_MAX_FRAME);
+
+    Fill(pbStream, 16, 256);
+    Bench(pbStream, cbStream, "16-255", false);
+    Bench(pbStream, cbStream, "16-255", true);
+
+    Fill(pbStream, 256, CB_MAX_FRAME);
+    Bench(pbStream, cbStream, "256-1023", false);
+    Bench(pbStream, cbStream, "256-1023", true);
+
+    BenchAlloc();
+
+    free(pbStream);
+    return 0;
+}
@@ -0,0 +1,213 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  bench_capture.c --  capture cost and replay speed                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  A helper thread streams data into the master side of an openpty()   */
+/*  pair and the benchmark reads it with SerialPortReadEx().  Reports   */
+/*                                                                      */
+/*    capture       MB/s and reader CPU per MB with capture off and on  */
+/*    replay_fast   MB/s of that capture replayed at unlimited speed    */
+/*                  into SerialPortReadEx()                             */
+/*    replay_timed  a paced capture, one chunk per ms, replayed at 1x,  */
+/*                  10x and 100x: elapsed time against the scaled       */
+/*                  original and the worst lateness                     */
+/*                                                                      */
+/*  Prints one JSON object per run.                                     */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "ec_serial.h"
+#include "ec_capture.h"
+#include "bench_util.h"
+
+#define CB_CHUNK        4096
+#define CB_PACED        64
+
+static size_t   cbStream = 64 * 1024 * 1024;
+static size_t   cPaced = 1000;
+static char     szCapture[] = "/tmp/bench_capture.XXXXXX";
+
+typedef struct {
+    int         fdMaster;
+    size_t      cb;
+    uint32_t    usGap;          // between chunks, 0 for back to back
+    size_t      cbChunk;
+} FEED;
+
+static void *Feeder(void *pv) {
+
+    FEED        *pfeed = pv;
+    uint8_t     rgb[CB_CHUNK];
+    size_t      cbSent;
+    size_t      cb;
+    ssize_t     cbWritten;
+
+    memset(rgb, 0x5a, sizeof(rgb));
+    for ( cbSent = 0; cbSent < pfeed->cb; cbSent += cb ) {
+        cb = ( pfeed->cb - cbSent < pfeed->cbChunk ) ? pfeed->cb - cbSent : pfeed->cbChunk;
+        cbWritten = write(pfeed->fdMaster, rgb, cb);
+        if ( cbWritten <= 0 ) {
+            return NULL;
+        }
+        cb = cbWritten;
+        if ( pfeed->usGap != 0 ) {
+            usleep(pfeed->usGap);
+        }
+    }
+    return NULL;
+}
+
+/* Reads cb bytes from the port, returns the reader's CPU time in ns or 0
+   if the stream stopped short. */
+static uint64_t Drain(SERIAL_PORT *port, size_t cb) {
+
+    uint8_t     rgb[CB_CHUNK];
+    uint64_t    nsCpu = ClockNs(CLOCK_THREAD_CPUTIME_ID);
+    int         cbRead;
+
+    while ( cb > 0 ) {
+        cbRead = SerialPortReadEx(port, rgb, sizeof(rgb), 1, 2000, 0);
+        if ( cbRead <= 0 ) {
+            return 0;
+        }
+        cb -= cbRead;
+    }
+    return ClockNs(CLOCK_THREAD_CPUTIME_ID) - nsCpu;
+}
+
+/* Streams through a fresh pty, recording into szCapture if fCapture. */
+static void BenchCapture(bool fCapture, size_t cb, uint32_t usGap, size_t cbChunk, bool fPrint) {
+
+    SERIAL_PORT *port;
+    pthread_t   thread;
+    FEED        feed;
+    uint64_t    nsStart;
+    uint64_t    nsCpu;
+    double      sec;
+    int         fdSlave;
+
+    port = BenchOpenPort(115200, &feed.fdMaster, &fdSlave);
+    if ( fCapture && !SerialPortCaptureStart(port, szCapture) ) {
+        exit(1);
+    }
+    feed.cb = cb;
+    feed.usGap = usGap;
+    feed.cbChunk = cbChunk;
+
+    nsStart = NowNs();
+    pthread_create(&thread, NULL, Feeder, &feed);
+    nsCpu = Drain(port, cb);
+    sec = (NowNs() - nsStart) / 1e9;
+    pthread_join(thread, NULL);
+
+    if ( fPrint ) {
+        printf("{\"bench\":\"capture\",\"capture\":%s,\"mb\":%.0f,\"mb_per_s\":%.1f,"
+               "\"cpu_ms_per_mb\":%.3f}\n",
+               fCapture ? "true" : "false", cb / 1e6, cb / sec / 1e6, nsCpu / 1e6 / (cb / 1e6));
+        fflush(stdout);
+    }
+    SerialPortClose(port);      // stops the capture
+    close(fdSlave);
+    close(feed.fdMaster);
+}
+
+static void BenchReplay(double speed, size_t cbExpected, const char *szRun) {
+
+    SERIAL_CAPTURE      *pcap;
+    SERIAL_REPLAY       *prp;
+    SERIAL_REPLAY_CFG   cfg;
+    SERIAL_REPLAY_STATS stats;
+    SERIAL_CAPTURE_REC  rec;
+    SERIAL_PORT         *port;
+    uint64_t            nsCapture = 0;
+
+    pcap = SerialCaptureOpen(szCapture);
+    if ( pcap == NULL ) {
+        exit(1);
+    }
+    while ( SerialCaptureNext(pcap, &rec) ) {
+        nsCapture = rec.ns;
+    }
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.speed = speed;
+    prp = SerialReplayCreate(pcap, &cfg);
+    port = ( prp != NULL ) ? SerialPortOpen(SerialReplayPtyName(prp), 115200) : NULL;
+    if ( (port == NULL) || !SerialReplayStart(prp) || (Drain(port, cbExpected) == 0) ||
+         !SerialReplayWait(prp, 10000) ) {
+        exit(1);
+    }
+    SerialReplayGetStats(prp, &stats);
+
+    if ( speed == 0 ) {
+        printf("{\"bench\":\"capture\",\"run\":\"%s\",\"mb\":%.0f,\"mb_per_s\":%.1f}\n",
+               szRun, stats.cbRx / 1e6, stats.cbRx / (stats.nsElapsed / 1e9) / 1e6);
+    } else {
+        printf("{\"bench\":\"capture\",\"run\":\"%s\",\"speed\":%.0f,\"records\":%zu,"
+               "\"original_ms\":%.1f,\"scaled_ms\":%.2f,\"elapsed_ms\":%.2f,\"late_max_us\":%.1f}\n",
+               szRun, speed, cPaced, nsCapture / 1e6, nsCapture / speed / 1e6,
+               stats.nsElapsed / 1e6, stats.nsLateMax / 1e3);
+    }
+    fflush(stdout);
+
+    SerialPortClose(port);
+    SerialReplayDestroy(prp);
+    SerialCaptureClose(pcap);
+}
+
+int main(int argc, char *argv[]) {
+
+    static const double rgspeed[] = { 1, 10, 100 };
+    size_t  ispeed;
+    int     fd;
+
+    if ( (argc > 1) && (strcmp(argv[1], "--quick") == 0) ) {
+        cbStream = 8 * 1024 * 1024;
+        cPaced = 200;
+    }
+    fd = mkstemp(szCapture);
+    if ( fd < 0 ) {
+        return 1;
+    }
+    close(fd);
+
+    BenchCapture(false, cbStream / 8, 0, CB_CHUNK, false);     // warm up
+    BenchCapture(false, cbStream, 0, CB_CHUNK, true);
+    BenchCapture(true, cbStream, 0, CB_CHUNK, true);
+    BenchReplay(0, cbStream, "replay_fast");
+
+    BenchCapture(true, cPaced * CB_PACED, 1000, CB_PACED, false);
+    for ( ispeed = 0; ispeed < sizeof(rgspeed) / sizeof(rgspeed[0]); ispeed++ ) {
+        BenchReplay(rgspeed[ispeed], cPaced * CB_PACED, "replay_timed");
+    }
+
+    unlink(szCapture);
+    return 0;
+}
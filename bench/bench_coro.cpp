@@ -0,0 +1,210 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  bench_coro.cpp --  Coroutine conversations against thread per port  */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Every port holds a request/response conversation with an echoing    */
+/*  device on the far side of a pty.  The host side runs either as      */
+/*  coroutines on one ec::EventLoop or as one thread per port calling   */
+/*  the blocking C API.  The devices are coroutines on an event loop    */
+/*  of their own thread in both cases.  Reports round trips per second  */
+/*  and process CPU for a growing number of ports, one JSON object      */
+/*  each.                                                               */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include <thread>
+#include <vector>
+
+#include "ec_serial.hpp"
+#include "bench_util.h"
+
+#define CB_MSG          32
+#define C_PORTS_MAX     1024
+
+static const int rgcPorts[] = { 16, 64, 256, C_PORTS_MAX };
+
+static int  cRounds = 200;
+
+// the device: echo every byte back, cbTotal of them
+static ec::Task<> Device(ec::EventLoop &loop, int fdMaster, size_t cbTotal) {
+
+    uint8_t     rgb[256];
+    size_t      cbDone;
+    ssize_t     cb;
+    ssize_t     ib;
+    ssize_t     cbWritten;
+
+    for ( cbDone = 0; cbDone < cbTotal; cbDone += cb ) {
+        cb = read(fdMaster, rgb, sizeof(rgb));
+        if ( cb <= 0 ) {
+            cb = 0;
+            co_await loop.wait_readable(fdMaster);
+            continue;
+        }
+        for ( ib = 0; ib < cb; ib += cbWritten ) {
+            cbWritten = write(fdMaster, rgb + ib, cb - ib);
+            if ( cbWritten < 0 ) {
+                cbWritten = 0;
+                co_await loop.wait_writable(fdMaster);
+            }
+        }
+    }
+}
+
+static ec::Task<> Host(ec::Port &port) {
+
+    uint8_t     rgbReq[CB_MSG];
+    uint8_t     rgbRsp[CB_MSG];
+    int         iround;
+
+    memset(rgbReq, 0x5A, sizeof(rgbReq) - 1);
+    rgbReq[sizeof(rgbReq) - 1] = '\n';
+    for ( iround = 0; iround < cRounds; iround++ ) {
+        co_await port.write(rgbReq, ec::after(std::chrono::seconds(5)));
+        co_await port.read_until(rgbRsp, '\n', ec::after(std::chrono::seconds(5)));
+    }
+}
+
+static void HostThread(SERIAL_PORT *port) {
+
+    uint8_t     rgbReq[CB_MSG];
+    uint8_t     rgbRsp[CB_MSG];
+    int         iround;
+
+    memset(rgbReq, 0x5A, sizeof(rgbReq) - 1);
+    rgbReq[sizeof(rgbReq) - 1] = '\n';
+    for ( iround = 0; iround < cRounds; iround++ ) {
+        if ( (SerialPortWrite(port, rgbReq, sizeof(rgbReq), 0) != sizeof(rgbReq)) ||
+             (SerialPortReadEx(port, rgbRsp, sizeof(rgbRsp), sizeof(rgbRsp), 5000, 0) != sizeof(rgbRsp)) ) {
+            fprintf(stderr, "HostThread: round %d failed\n", iround);
+            exit(1);
+        }
+    }
+}
+
+static void Bench(int cPorts, bool fCoro) {
+
+    std::vector<int>        vecfdMaster(cPorts);
+    std::vector<int>        vecfdSlave(cPorts);
+    std::vector<ec::Port>   vecport;
+    std::vector<SERIAL_PORT *> vecportC;
+    std::vector<std::thread> vecthread;
+    ec::EventLoop           loopDevice;
+    ec::EventLoop           loopHost;
+    struct termios          tio;
+    char                    szName[128];
+    uint64_t                nsStart;
+    double                  secCpu;
+    double                  sec;
+    int                     iport;
+
+    vecport.reserve(cPorts);
+    for ( iport = 0; iport < cPorts; iport++ ) {
+        BenchOpenPty(&vecfdMaster[iport], &vecfdSlave[iport], szName);
+        tcgetattr(vecfdMaster[iport], &tio);
+        cfmakeraw(&tio);
+        tcsetattr(vecfdMaster[iport], TCSANOW, &tio);
+        fcntl(vecfdMaster[iport], F_SETFL, O_NONBLOCK);
+        loopDevice.attach(vecfdMaster[iport]);
+        loopDevice.spawn(Device(loopDevice, vecfdMaster[iport], (size_t)cRounds * CB_MSG));
+        if ( fCoro ) {
+            vecport.emplace_back(loopHost, szName, 115200);
+            loopHost.spawn(Host(vecport.back()));
+        } else {
+            vecportC.push_back(SerialPortOpen(szName, 115200));
+            if ( vecportC.back() == NULL ) {
+                exit(1);
+            }
+        }
+    }
+
+    std::thread threadDevice([&loopDevice] { loopDevice.run(); });
+
+    // CPU covers the device thread too, it does the same work either way
+    nsStart = NowNs();
+    secCpu = CpuSec(RUSAGE_SELF);
+    if ( fCoro ) {
+        loopHost.run();
+    } else {
+        for ( iport = 0; iport < cPorts; iport++ ) {
+            vecthread.emplace_back(HostThread, vecportC[iport]);
+        }
+        for ( std::thread &thread : vecthread ) {
+            thread.join();
+        }
+    }
+    sec = (NowNs() - nsStart) / 1e9;
+    threadDevice.join();
+    secCpu = CpuSec(RUSAGE_SELF) - secCpu;
+
+    printf("{\"bench\":\"coro\",\"mode\":\"%s\",\"ports\":%d,\"host_threads\":%d,"
+           "\"round_trips\":%ld,\"round_trips_per_s\":%.0f,\"cpu_pct\":%.1f}\n",
+           fCoro ? "coroutines" : "thread_per_port", cPorts, fCoro ? 1 : cPorts,
+           (long)cPorts * cRounds, cPorts * cRounds / sec, secCpu * 100 / sec);
+    fflush(stdout);
+
+    for ( SERIAL_PORT *port : vecportC ) {
+        SerialPortClose(port);
+    }
+    vecport.clear();
+    for ( iport = 0; iport < cPorts; iport++ ) {
+        loopDevice.detach(vecfdMaster[iport]);
+        close(vecfdSlave[iport]);
+        close(vecfdMaster[iport]);
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    struct rlimit   rl;
+    size_t          i;
+
+    if ( (argc > 1) && (strcmp(argv[1], "--quick") == 0) ) {
+        cRounds = 20;
+    }
+
+    // three descriptors per port
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+
+    SerialSetLogger(NULL, NULL, SERIAL_LOG_ERROR);
+
+    for ( i = 0; i < sizeof(rgcPorts) / sizeof(rgcPorts[0]); i++ ) {
+        if ( (rlim_t)rgcPorts[i] * 3 + 16 > rl.rlim_cur ) {
+            break;
+        }
+        Bench(rgcPorts[i], true);
+        Bench(rgcPorts[i], false);
+    }
+    return 0;
+}
@@ -0,0 +1,187 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  bench_crc.c --  CRC kernels against the byte at a time baseline     */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Times every CRC on every kernel this CPU can run, over buffers      */
+/*  from a short frame up to 64 KB, and reports the speedup over the    */
+/*  byte at a time kernel.  Then decodes the same COBS stream with and  */
+/*  without a CRC-32 trailer to show what checking costs the framer.    */
+/*  Prints one JSON object per run.                                     */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ec_crc.h"
+#include "ec_frame.h"
+#include "bench_util.h"
+
+static size_t   cbPerRun = 256 * 1024 * 1024;
+static volatile uint32_t crcSink;   // keeps the CRCs from being optimised out
+
+static const char *TypeName(SERIAL_CRC_TYPE type) {
+
+    switch ( type ) {
+        case SERIAL_CRC16_CCITT:    return "crc16_ccitt";
+        case SERIAL_CRC16_MODBUS:   return "crc16_modbus";
+        case SERIAL_CRC32:          return "crc32";
+        default:                    return "none";
+    }
+}
+
+/* MB/s of SerialCrc() over cb byte buffers */
+static double Rate(SERIAL_CRC_TYPE type, const uint8_t *pb, size_t cb) {
+
+    uint64_t    nsStart;
+    size_t      cIter = cbPerRun / cb;
+    size_t      i;
+    uint32_t    crc = 0;
+
+    nsStart = NowNs();
+    for ( i = 0; i < cIter; i++ ) {
+        // vary the start so the calls cannot be folded together
+        crc += SerialCrc(type, pb + (i & 7), cb);
+    }
+    crcSink = crc;
+    return (double)cIter * cb / ((NowNs() - nsStart) / 1e9) / 1e6;
+}
+
+static void BenchKernels(const uint8_t *pb) {
+
+    static const size_t     rgcb[] = { 16, 64, 256, 1024, 4096, 65536 };
+    static const SERIAL_CRC_IMPL rgimpl[] = {
+        SERIAL_CRC_IMPL_BYTE, SERIAL_CRC_IMPL_SLICE8, SERIAL_CRC_IMPL_CLMUL, SERIAL_CRC_IMPL_ARMV8
+    };
+    double      rgmbpsByte[sizeof(rgcb) / sizeof(rgcb[0])];
+    double      mbps;
+    int         type;
+    size_t      iimpl;
+    size_t      icb;
+
+    for ( type = SERIAL_CRC16_CCITT; type <= SERIAL_CRC32; type++ ) {
+        for ( iimpl = 0; iimpl < sizeof(rgimpl) / sizeof(rgimpl[0]); iimpl++ ) {
+            if ( !SerialCrcSetImpl(rgimpl[iimpl]) ||
+                 (SerialCrcGetImpl(type) != rgimpl[iimpl]) ) {
+                continue;   // not on this CPU, or not for this CRC
+            }
+            for ( icb = 0; icb < sizeof(rgcb) / sizeof(rgcb[0]); icb++ ) {
+                mbps = Rate(type, pb, rgcb[icb]);
+                if ( rgimpl[iimpl] == SERIAL_CRC_IMPL_BYTE ) {
+                    rgmbpsByte[icb] = mbps;
+                }
+                printf("{\"bench\":\"crc\",\"crc\":\"%s\",\"impl\":\"%s\",\"bytes\":%zu,"
+                       "\"mb_per_s\":%.0f,\"speedup\":%.2f}\n",
+                       TypeName(type), SerialCrcImplName(rgimpl[iimpl]), rgcb[icb],
+                       mbps, mbps / rgmbpsByte[icb]);
+                fflush(stdout);
+            }
+        }
+    }
+    SerialCrcSetImpl(SERIAL_CRC_IMPL_AUTO);
+}
+
+static void BenchFramer(SERIAL_CRC_TYPE crc) {
+
+    SERIAL_FRAME_CFG    cfg;
+    SERIAL_FRAMER       *pfr;
+    const uint8_t       *pbFrame;
+    uint8_t             *pbWire;
+    uint8_t             rgbPayload[1024];
+    uint64_t            nsStart;
+    uint64_t            cFrames;
+    size_t              cbFrame;
+    size_t              cbWire;
+    size_t              cbPayload;
+    size_t              cbStream = cbPerRun / 8;
+    size_t              ib;
+    double              sec;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.type = SERIAL_FRAME_COBS;
+    cfg.cbMaxFrame = sizeof(rgbPayload) + 4;
+    cfg.crc = crc;
+
+    // the same payloads both times, only the trailer differs
+    pbWire = malloc(cbStream + 2 * SerialFrameEncodedMax(&cfg, sizeof(rgbPayload)));
+    srand(1);
+    for ( cbWire = 0; cbWire < cbStream; ) {
+        cbPayload = 64 + rand() % (sizeof(rgbPayload) - 64);
+        for ( ib = 0; ib < cbPayload; ib++ ) {
+            rgbPayload[ib] = rand();
+        }
+        cbWire += SerialFrameEncode(&cfg, rgbPayload, cbPayload, pbWire + cbWire,
+                                    SerialFrameEncodedMax(&cfg, cbPayload));
+    }
+
+    pfr = SerialFramerCreate(&cfg);
+    if ( (pbWire == NULL) || (pfr == NULL) ) {
+        exit(1);
+    }
+    cFrames = 0;
+    nsStart = NowNs();
+    for ( ib = 0; ib < cbWire; ib += 4096 ) {
+        SerialFramerPush(pfr, pbWire + ib, ( cbWire - ib < 4096 ) ? cbWire - ib : 4096);
+        while ( SerialFramerNext(pfr, &pbFrame, &cbFrame) ) {
+            cFrames++;
+        }
+    }
+    sec = (NowNs() - nsStart) / 1e9;
+
+    printf("{\"bench\":\"crc\",\"framer\":\"cobs\",\"crc\":\"%s\",\"impl\":\"%s\",\"frames\":%llu,"
+           "\"crc_errors\":%llu,\"mb_per_s\":%.0f}\n",
+           TypeName(crc), SerialCrcImplName(SerialCrcGetImpl(crc)), (unsigned long long)cFrames,
+           (unsigned long long)SerialFramerCrcErrors(pfr), cbWire / sec / 1e6);
+    fflush(stdout);
+
+    SerialFramerDestroy(pfr);
+    free(pbWire);
+}
+
+int main(int argc, char *argv[]) {
+
+    uint8_t     *pb;
+    size_t      ib;
+
+    if ( (argc > 1) && (strcmp(argv[1], "--quick") == 0) ) {
+        cbPerRun = 16 * 1024 * 1024;
+    }
+
+    pb = malloc(65536 + 8);
+    if ( pb == NULL ) {
+        return 1;
+    }
+    srand(1);
+    for ( ib = 0; ib < 65536 + 8; ib++ ) {
+        pb[ib] = rand();
+    }
+
+    BenchKernels(pb);
+    BenchFramer(SERIAL_CRC_NONE);
+    BenchFramer(SERIAL_CRC32);
+    BenchFramer(SERIAL_CRC16_CCITT);
+
+    free(pb);
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  bench_frame.c --  Frame decoder throughput benchmark                */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Encodes a stream of random frames with each framing, then times     */
+/*  how fast the framer splits it again when fed in read() sized        */
+/*  chunks.  Prints one JSON object per framing.  "x_line_rate" is the  */
+/*  decode rate divided by the byte rate of a 3 Mbaud 8N1 link.         */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ec_frame.h"
+#include "bench_util.h"
+
+#define CB_STREAM       (32 * 1024 * 1024)
+#define CB_CHUNK        4096
+#define CB_MAX_FRAME    1024
+#define LINE_RATE_BPS   (3000000 / 10)
+
+static void CountFrame(void *pvCtx, const uint8_t *pbFrame, size_t cbFrame) {
+
+    *(uint64_t *)pvCtx += cbFrame;
+}
+
+static void Bench(const char *szName, const SERIAL_FRAME_CFG *pcfg) {
+
+    SERIAL_FRAMER   *pfr;
+    uint8_t         *pbStream;
+    uint8_t         rgbFrame[CB_MAX_FRAME];
+    size_t          cbStream;
+    size_t          cbFrame;
+    size_t          ib;
+    uint64_t        cFrames;
+    uint64_t        cbPayload;
+    uint64_t        cbDecoded;
+    uint64_t        nsStart;
+    double          sec;
+    int             i;
+
+    pbStream = malloc(CB_STREAM + 2 * CB_MAX_FRAME + 8);
+    cbStream = 0;
+    cFrames = 0;
+    cbPayload = 0;
+    srand(1);
+    while ( cbStream < CB_STREAM ) {
+        cbFrame = 16 + rand() % 240;
+        for ( i = 0; i < (int)cbFrame; i++ ) {
+            rgbFrame[i] = rand();
+        }
+        if ( pcfg->type == SERIAL_FRAME_DELIMITER ) {
+            for ( i = 0; i < (int)cbFrame; i++ ) {
+                if ( rgbFrame[i] == pcfg->bDelimiter ) {
+                    rgbFrame[i]++;
+                }
+            }
+        }
+        cbStream += SerialFrameEncode(pcfg, rgbFrame, cbFrame,
+                                      pbStream + cbStream, 2 * CB_MAX_FRAME + 8);
+        cbPayload += cbFrame;
+        cFrames++;
+    }
+
+    pfr = SerialFramerCreate(pcfg);
+    cbDecoded = 0;
+    nsStart = NowNs();
+    for ( ib = 0; ib < cbStream; ib += CB_CHUNK ) {
+        SerialFramerFeed(pfr, pbStream + ib,
+                         ( cbStream - ib < CB_CHUNK ) ? cbStream - ib : CB_CHUNK,
+                         CountFrame, &cbDecoded);
+    }
+    sec = (NowNs() - nsStart) / 1e9;
+
+    printf("{\"bench\":\"frame\",\"framing\":\"%s\",\"chunk\":%d,\"frames\":%llu,"
+           "\"wire_bytes\":%zu,\"payload_ok\":%s,\"dropped\":%llu,\"mb_per_s\":%.1f,"
+           "\"frames_per_s\":%.0f,\"x_line_rate\":%.0f}\n",
+           szName, CB_CHUNK, (unsigned long long)cFrames, cbStream,
+           ( cbDecoded == cbPayload ) ? "true" : "false",
+           (unsigned long long)SerialFramerDropped(pfr),
+           cbStream / sec / 1e6, cFrames / sec, cbStream / sec / LINE_RATE_BPS);
+
+    SerialFramerDestroy(pfr);
+    free(pbStream);
+}
+
+int main(void) {
+
+    SERIAL_FRAME_CFG cfg;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.cbMaxFrame = CB_MAX_FRAME;
+
+    cfg.type = SERIAL_FRAME_DELIMITER;
+    cfg.bDelimiter = '\n';
+    Bench("delimiter", &cfg);
+
+    cfg.type = SERIAL_FRAME_LENGTH;
+    cfg.ibLength = 1;
+    cfg.cbLength = 2;
+    cfg.fBigEndian = true;
+    cfg.cbAdjust = 0;
+    Bench("length", &cfg);
+
+    cfg.type = SERIAL_FRAME_SLIP;
+    Bench("slip", &cfg);
+
+    cfg.type = SERIAL_FRAME_COBS;
+    Bench("cobs", &cfg);
+
+    return 0;
+}
@@ -0,0 +1,323 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  bench_hotplug.c --  outage length with and without reconnecting     */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Simulates an adapter being pulled and plugged back in with an       */
+/*  openpty() pair behind a symlink, the way udev names adapters in     */
+/*  /dev/serial/by-id.  Pulling closes the master and removes the       */
+/*  link; plugging in opens a new pair and renames a fresh link into    */
+/*  place.  A reader thread blocks in SerialPortReadEx() throughout,    */
+/*  and the benchmark writes one byte to the new master as soon as it   */
+/*  is plugged in.  Reports, per mode, the time from the plug to that   */
+/*  byte reaching the reader:                                           */
+/*                                                                      */
+/*    reconnect     SerialPortSetReconnect(), the watcher thread        */
+/*                  reopens the link on the inotify event               */
+/*    poll_Nms      the usual application loop, close on EIO and try    */
+/*                  SerialPortOpen() again every N ms                   */
+/*                                                                      */
+/*  A last run pulls the adapter while a writer thread loops on         */
+/*  SerialPortWrite() with SERIAL_WRITE_DRAIN, and compares the bytes   */
+/*  the writes reported against the bytes handed to the devices.  Any   */
+/*  surplus went out twice, once to the old device and again from the   */
+/*  reconnect queue.                                                    */
+/*                                                                      */
+/*  Prints one JSON object per run.                                     */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <poll.h>
+
+#include "ec_serial.h"
+#include "bench_util.h"
+
+#define MS_GONE         5       // the adapter stays out this long
+#define MS_PLUGGED      5       // and in this long between pulls in the drain run
+#define MS_RECOVER_MAX  2000
+#define CB_BLOCK        64
+
+static int      cCycles = 200;
+static char     szDir[] = "/tmp/bench_hotplug.XXXXXX";
+static char     szLink[64];
+static char     szLinkNew[64];
+
+typedef struct {
+    SERIAL_PORT         *port;
+    uint32_t            msPoll;         // 0 with reconnecting on
+    _Atomic uint64_t    nsRx;           // when the last byte arrived
+    _Atomic bool        fStop;
+} READER;
+
+/* Opens a new pair and points the link at its slave, returns the master. */
+static int PlugIn(void) {
+
+    char    szSlave[64];
+    int     fdMaster;
+    int     fdSlave;
+
+    BenchOpenPty(&fdMaster, &fdSlave, szSlave);
+    close(fdSlave);
+    unlink(szLinkNew);
+    if ( (symlink(szSlave, szLinkNew) != 0) || (rename(szLinkNew, szLink) != 0) ) {
+        perror("symlink");
+        exit(1);
+    }
+    return fdMaster;
+}
+
+static void Unplug(int fdMaster) {
+
+    unlink(szLink);
+    close(fdMaster);
+}
+
+typedef struct {
+    SERIAL_PORT         *port;
+    uint64_t            cbAcked;        // sum of what SerialPortWrite() reported
+    _Atomic bool        fStop;
+    _Atomic bool        fDone;
+} WRITER;
+
+static void *Reader(void *pv) {
+
+    READER      *prd = pv;
+    uint8_t     b;
+    int         rc;
+
+    while ( !atomic_load(&prd->fStop) ) {
+        rc = SerialPortReadEx(prd->port, &b, 1, 1, 100, 0);
+        if ( rc > 0 ) {
+            atomic_store(&prd->nsRx, NowNs());
+        } else if ( (rc == SERIAL_ERROR_CODE) && (prd->msPoll > 0) ) {
+            // what an application does without help
+            SerialPortClose(prd->port);
+            do {
+                usleep(prd->msPoll * 1000);
+                prd->port = SerialPortOpen(szLink, 115200);
+            } while ( (prd->port == NULL) && !atomic_load(&prd->fStop) );
+        }
+    }
+    return NULL;
+}
+
+static void *Writer(void *pv) {
+
+    WRITER      *pwr = pv;
+    uint8_t     rgb[CB_BLOCK];
+    int         rc;
+
+    memset(rgb, 0x5a, sizeof(rgb));
+    while ( !atomic_load(&pwr->fStop) ) {
+        rc = SerialPortWrite(pwr->port, rgb, sizeof(rgb), SERIAL_WRITE_DRAIN);
+        if ( rc == SERIAL_DRAIN_ERROR_CODE ) {
+            rc = sizeof(rgb);       // every byte was written, only the drain failed
+        }
+        if ( rc > 0 ) {
+            pwr->cbAcked += rc;
+        } else {
+            usleep(100);            // the queue is full
+        }
+    }
+    atomic_store(&pwr->fDone, true);
+    return NULL;
+}
+
+/* Reads and discards what reaches the master for ms, or until the port
+   is connected again with ms 0. */
+static void Pump(SERIAL_PORT *port, int fdMaster, uint32_t ms) {
+
+    struct pollfd   pfd;
+    uint8_t         rgb[4096];
+    uint64_t        nsEnd;
+
+    nsEnd = NowNs() + (uint64_t)(( ms != 0 ) ? ms : MS_RECOVER_MAX) * 1000000;
+    pfd.fd = fdMaster;
+    pfd.events = POLLIN;
+    while ( (ms != 0) || !SerialPortIsConnected(port) ) {
+        if ( NowNs() >= nsEnd ) {
+            if ( ms != 0 ) {
+                return;
+            }
+            fprintf(stderr, "no reconnect within %d ms\n", MS_RECOVER_MAX);
+            exit(1);
+        }
+        if ( (poll(&pfd, 1, 1) > 0) && (read(fdMaster, rgb, sizeof(rgb)) < 0) ) {
+            if ( errno != EIO ) {
+                perror("read");
+                exit(1);
+            }
+            usleep(100);        // nothing has the slave open yet
+        }
+    }
+}
+
+static void RunDrain(void) {
+
+    SERIAL_RECONNECT_CFG    cfg;
+    SERIAL_RECONNECT_STATS  stats;
+    SERIAL_STATS            st;
+    WRITER                  wr;
+    pthread_t               thread;
+    int                     fdMaster;
+    int                     iCycle;
+
+    fdMaster = PlugIn();
+    memset(&wr, 0, sizeof(wr));
+    wr.port = SerialPortOpen(szLink, 115200);
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.szPath = szLink;
+    if ( (wr.port == NULL) || !SerialPortSetReconnect(wr.port, &cfg) ) {
+        perror("SerialPortOpen");
+        exit(1);
+    }
+    pthread_create(&thread, NULL, Writer, &wr);
+
+    for ( iCycle = 0; iCycle < cCycles; iCycle++ ) {
+        Pump(wr.port, fdMaster, MS_PLUGGED);
+        Unplug(fdMaster);
+        usleep(MS_GONE * 1000);
+        fdMaster = PlugIn();
+        Pump(wr.port, fdMaster, 0);
+    }
+
+    atomic_store(&wr.fStop, true);
+    while ( !atomic_load(&wr.fDone) ) {
+        Pump(wr.port, fdMaster, 1);
+    }
+    pthread_join(thread, NULL);
+    SerialPortGetStats(wr.port, &st);
+    SerialPortGetReconnectStats(wr.port, &stats);
+    SerialPortClose(wr.port);
+    Unplug(fdMaster);
+
+    printf("{\"bench\":\"hotplug\",\"mode\":\"drain_write\",\"cycles\":%d,\"acked_bytes\":%llu,"
+           "\"written_bytes\":%llu,\"duplicated_bytes\":%lld,\"queued_bytes\":%llu,"
+           "\"dropped_bytes\":%llu,\"reconnects\":%llu}\n",
+           cCycles, (unsigned long long)wr.cbAcked, (unsigned long long)st.cbWritten,
+           (long long)(st.cbWritten - wr.cbAcked), (unsigned long long)stats.cbTxQueued,
+           (unsigned long long)stats.cbTxDropped, (unsigned long long)stats.cReconnects);
+    fflush(stdout);
+}
+
+static void Run(uint32_t msPoll) {
+
+    SERIAL_RECONNECT_CFG    cfg;
+    SERIAL_RECONNECT_STATS  stats;
+    READER                  rd;
+    pthread_t               thread;
+    uint64_t                *rgns;
+    uint64_t                nsPlug;
+    uint64_t                nsSum;
+    uint8_t                 b = 0x5a;
+    int                     fdMaster;
+    int                     iCycle;
+    char                    szMode[32];
+
+    rgns = calloc(cCycles, sizeof(*rgns));
+    fdMaster = PlugIn();
+    memset(&rd, 0, sizeof(rd));
+    rd.msPoll = msPoll;
+    rd.port = SerialPortOpen(szLink, 115200);
+    if ( (rgns == NULL) || (rd.port == NULL) ) {
+        perror("SerialPortOpen");
+        exit(1);
+    }
+    if ( msPoll == 0 ) {
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.szPath = szLink;
+        if ( !SerialPortSetReconnect(rd.port, &cfg) ) {
+            perror("SerialPortSetReconnect");
+            exit(1);
+        }
+    }
+    pthread_create(&thread, NULL, Reader, &rd);
+
+    nsSum = 0;
+    for ( iCycle = 0; iCycle < cCycles; iCycle++ ) {
+        Unplug(fdMaster);
+        usleep(MS_GONE * 1000);
+        fdMaster = PlugIn();
+        nsPlug = NowNs();
+        atomic_store(&rd.nsRx, 0);
+        if ( write(fdMaster, &b, 1) != 1 ) {
+            perror("write");
+            exit(1);
+        }
+        while ( atomic_load(&rd.nsRx) == 0 ) {
+            usleep(100);
+        }
+        rgns[iCycle] = atomic_load(&rd.nsRx) - nsPlug;
+        nsSum += rgns[iCycle];
+    }
+
+    atomic_store(&rd.fStop, true);
+    pthread_join(thread, NULL);
+    SerialPortGetReconnectStats(rd.port, &stats);
+    SerialPortClose(rd.port);
+    Unplug(fdMaster);
+
+    qsort(rgns, cCycles, sizeof(*rgns), CompareU64);
+    if ( msPoll == 0 ) {
+        strcpy(szMode, "reconnect");
+    } else {
+        snprintf(szMode, sizeof(szMode), "poll_%ums", msPoll);
+    }
+    printf("{\"bench\":\"hotplug\",\"mode\":\"%s\",\"cycles\":%d,\"recover_us_mean\":%.1f,"
+           "\"recover_us_p50\":%.1f,\"recover_us_p99\":%.1f,\"reconnects\":%llu}\n",
+           szMode, cCycles, nsSum / 1e3 / cCycles, rgns[cCycles / 2] / 1e3,
+           rgns[cCycles * 99 / 100] / 1e3, (unsigned long long)stats.cReconnects);
+    fflush(stdout);
+    free(rgns);
+}
+
+int main(int argc, char *argv[]) {
+
+    if ( (argc > 1) && (strcmp(argv[1], "--quick") == 0) ) {
+        cCycles = 20;
+    }
+    if ( mkdtemp(szDir) == NULL ) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(szLink, sizeof(szLink), "%s/ttyUSB", szDir);
+    snprintf(szLinkNew, sizeof(szLinkNew), "%s/ttyUSB.new", szDir);
+
+    // keep the lost/reconnected notices out of the JSON
+    SerialSetLogger(NULL, NULL, SERIAL_LOG_ERROR);
+
+    Run(0);
+    Run(10);
+    Run(100);
+    RunDrain();
+
+    unlink(szLinkNew);
+    rmdir(szDir);
+    return 0;
+}
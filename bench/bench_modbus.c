@@ -0,0 +1,226 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  bench_modbus.c --  Modbus RTU poll cycles against fixed delays      */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  A helper thread plays a bus of slaves on the master side of an      */
+/*  openpty() pair and answers every read holding registers request.    */
+/*  Each run polls every slave in turn and reports polls per second     */
+/*  and the p50/p99 request spacing for                                 */
+/*                                                                      */
+/*    engine        SerialModbusPoll(), responses complete by length    */
+/*    engine_gap    SerialModbusPoll() with a user defined function,    */
+/*                  so every response has to end in a t3.5 silence      */
+/*    fixed_delay   write, then read for a fixed window long enough     */
+/*                  for any response, the way a master without gap      */
+/*                  detection has to                                    */
+/*                                                                      */
+/*  A pty moves bytes without wire time, so the numbers show the time   */
+/*  the master adds on top of the line, not the line itself.  Prints    */
+/*  one JSON object per run.                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ec_serial.h"
+#include "ec_crc.h"
+#include "ec_modbus.h"
+#include "bench_util.h"
+
+#define C_SLAVES        32
+#define C_REGS          8
+#define FC_USER         100     // user defined, length unknown to the master
+#define MS_FIXED_WINDOW 10
+
+typedef enum {
+    MODE_ENGINE,
+    MODE_ENGINE_GAP,
+    MODE_FIXED_DELAY
+} MODE;
+
+static const char *rgszMode[] = { "engine", "engine_gap", "fixed_delay" };
+
+static size_t   cCycles = 20;
+
+static bool ReadAll(int fd, uint8_t *pb, size_t cb) {
+
+    ssize_t cbRead;
+
+    for ( ; cb > 0; pb += cbRead, cb -= cbRead ) {
+        cbRead = read(fd, pb, cb);
+        if ( cbRead <= 0 ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Slave side: requests are 8 bytes for function 3, 4 for FC_USER. */
+static void *Slaves(void *pv) {
+
+    int         fdMaster = *(int *)pv;
+    uint8_t     rgbReq[8];
+    uint8_t     rgbRsp[5 + 2 * C_REGS];
+    size_t      cbReq;
+    size_t      cbRsp;
+    size_t      iReg;
+
+    for ( ;; ) {
+        if ( !ReadAll(fdMaster, rgbReq, 2) ) {
+            return NULL;
+        }
+        cbReq = ( rgbReq[1] == 3 ) ? 8 : 4;
+        if ( !ReadAll(fdMaster, rgbReq + 2, cbReq - 2) ) {
+            return NULL;
+        }
+        if ( !SerialCrcCheck(SERIAL_CRC16_MODBUS, rgbReq, cbReq) ) {
+            continue;
+        }
+
+        cbRsp = 0;
+        rgbRsp[cbRsp++] = rgbReq[0];
+        rgbRsp[cbRsp++] = rgbReq[1];
+        rgbRsp[cbRsp++] = 2 * C_REGS;
+        for ( iReg = 0; iReg < C_REGS; iReg++ ) {
+            rgbRsp[cbRsp++] = rgbReq[0];
+            rgbRsp[cbRsp++] = iReg;
+        }
+        cbRsp += SerialCrcPut(SERIAL_CRC16_MODBUS, SerialCrc(SERIAL_CRC16_MODBUS, rgbRsp, cbRsp),
+                              rgbRsp + cbRsp);
+        if ( write(fdMaster, rgbRsp, cbRsp) != (ssize_t)cbRsp ) {
+            return NULL;
+        }
+    }
+}
+
+static void Bench(MODE mode, int baudRate) {
+
+    SERIAL_PORT         *port;
+    SERIAL_MODBUS       *pmb;
+    SERIAL_MODBUS_CFG   cfg;
+    SERIAL_MODBUS_STATS stats;
+    SERIAL_MODBUS_REQ   rgreq[C_SLAVES];
+    pthread_t           thread;
+    uint8_t             rgbPdu[C_SLAVES][5];
+    uint8_t             rgbAdu[8];
+    uint8_t             rgbRsp[SERIAL_MODBUS_MAX_ADU];
+    uint64_t            *rgns;
+    uint64_t            nsStart;
+    uint64_t            nsPrev;
+    size_t              cPolls = cCycles * C_SLAVES;
+    size_t              iCycle;
+    size_t              islave;
+    size_t              cOk = 0;
+    double              sec;
+    int                 fdMaster;
+    int                 fdSlave;
+
+    port = BenchOpenPort(baudRate, &fdMaster, &fdSlave);
+    memset(&cfg, 0, sizeof(cfg));
+    pmb = SerialModbusCreate(port, &cfg);
+    rgns = malloc(cPolls * sizeof(rgns[0]));
+    if ( (pmb == NULL) || (rgns == NULL) ) {
+        exit(1);
+    }
+    pthread_create(&thread, NULL, Slaves, &fdMaster);
+
+    memset(rgreq, 0, sizeof(rgreq));
+    for ( islave = 0; islave < C_SLAVES; islave++ ) {
+        rgbPdu[islave][0] = ( mode == MODE_ENGINE_GAP ) ? FC_USER : 3;
+        rgbPdu[islave][1] = 0;
+        rgbPdu[islave][2] = 0;
+        rgbPdu[islave][3] = 0;
+        rgbPdu[islave][4] = C_REGS;
+        rgreq[islave].unit = islave + 1;
+        rgreq[islave].pbPdu = rgbPdu[islave];
+        rgreq[islave].cbPdu = ( mode == MODE_ENGINE_GAP ) ? 1 : 5;
+    }
+
+    nsStart = NowNs();
+    nsPrev = nsStart;
+    for ( iCycle = 0; iCycle < cCycles; iCycle++ ) {
+        if ( mode != MODE_FIXED_DELAY ) {
+            cOk += SerialModbusPoll(pmb, rgreq, C_SLAVES);
+            rgns[iCycle] = NowNs() - nsPrev;
+            nsPrev += rgns[iCycle];
+            continue;
+        }
+        for ( islave = 0; islave < C_SLAVES; islave++ ) {
+            rgbAdu[0] = islave + 1;
+            memcpy(rgbAdu + 1, rgbPdu[islave], 5);
+            SerialCrcPut(SERIAL_CRC16_MODBUS, SerialCrc(SERIAL_CRC16_MODBUS, rgbAdu, 6), rgbAdu + 6);
+            SerialPortWrite(port, rgbAdu, sizeof(rgbAdu), 0);
+            // no gap detection: whatever arrived within the window is the frame
+            if ( SerialPortReadEx(port, rgbRsp, sizeof(rgbRsp), sizeof(rgbRsp), MS_FIXED_WINDOW, 0) ==
+                 5 + 2 * C_REGS ) {
+                cOk++;
+            }
+        }
+        rgns[iCycle] = NowNs() - nsPrev;
+        nsPrev += rgns[iCycle];
+    }
+    sec = (NowNs() - nsStart) / 1e9;
+
+    // per poll spacing, from the cycle times
+    for ( iCycle = 0; iCycle < cCycles; iCycle++ ) {
+        rgns[iCycle] /= C_SLAVES;
+    }
+    qsort(rgns, cCycles, sizeof(rgns[0]), CompareU64);
+    SerialModbusGetStats(pmb, &stats);
+
+    printf("{\"bench\":\"modbus\",\"mode\":\"%s\",\"baud\":%d,\"t35_us\":%u,\"slaves\":%d,"
+           "\"polls\":%zu,\"ok\":%zu,\"polls_per_s\":%.0f,\"poll_p50_us\":%.0f,\"poll_p99_us\":%.0f,"
+           "\"crc_errors\":%llu,\"timeouts\":%llu}\n",
+           rgszMode[mode], baudRate, SerialModbusGapUs(pmb), C_SLAVES, cPolls, cOk, cPolls / sec,
+           rgns[cCycles / 2] / 1e3, rgns[(cCycles * 99) / 100] / 1e3,
+           (unsigned long long)stats.cCrcErrors, (unsigned long long)stats.cTimeouts);
+    fflush(stdout);
+
+    SerialModbusDestroy(pmb);
+    SerialPortClose(port);
+    close(fdSlave);                 // the slave thread's read fails with EIO
+    pthread_join(thread, NULL);
+    close(fdMaster);
+    free(rgns);
+}
+
+int main(int argc, char *argv[]) {
+
+    static const int rgBaud[] = { 9600, 19200, 115200 };
+    size_t  ibaud;
+
+    if ( (argc > 1) && (strcmp(argv[1], "--quick") == 0) ) {
+        cCycles = 4;
+    }
+
+    for ( ibaud = 0; ibaud < sizeof(rgBaud) / sizeof(rgBaud[0]); ibaud++ ) {
+        Bench(MODE_ENGINE, rgBaud[ibaud]);
+        Bench(MODE_ENGINE_GAP, rgBaud[ibaud]);
+    }
+    Bench(MODE_FIXED_DELAY, 19200);
+    return 0;
+}
@@ -0,0 +1,298 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  bench_profile.cpp --  compile time profiles against the generic     */
+/*                        framer                                        */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Builds one stream of frames per profile with SerialFrameEncode()    */
+/*  and times, on the same bytes,                                       */
+/*                                                                      */
+/*    decode        SerialFramer against ec::Framer<P>, in 4 KB chunks  */
+/*                  as SerialPortReadFrame() reads them                 */
+/*    encode        SerialFrameEncode() against the profile's encoder   */
+/*    crc           SerialCrc() with the fastest kernel for this CPU    */
+/*                  against the profile's compile time tables           */
+/*    pty           SerialPortReadFrame() against ProfilePort::         */
+/*                  read_frame() with a thread feeding an openpty()     */
+/*                  pair as fast as it can                              */
+/*                                                                      */
+/*  for short and long frames.  Prints one JSON object per run.         */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+
+#include "ec_serial_profile.hpp"
+#include "bench_util.h"
+
+#define CB_CHUNK        4096
+
+using Cobs32 = ec::Profile<ec::Baud<921600>, ec::Line8N1, ec::Cobs, ec::Crc32, ec::TimeoutFrames<4>, 1024>;
+using CobsPlain = ec::Profile<ec::Baud<921600>, ec::Line8N1, ec::Cobs, ec::NoCrc, ec::TimeoutFrames<4>, 1024>;
+using Slip16 = ec::Profile<ec::Baud<115200>, ec::Line8N1, ec::Slip, ec::Crc16Ccitt, ec::TimeoutFrames<4>, 1024>;
+
+static size_t   cbPerRun = 64 * 1024 * 1024;
+static volatile size_t cbSink;      // keeps the results from being optimised out
+
+static const char *CrcName(SERIAL_CRC_TYPE type) {
+
+    switch ( type ) {
+        case SERIAL_CRC16_CCITT:    return "crc16_ccitt";
+        case SERIAL_CRC16_MODBUS:   return "crc16_modbus";
+        case SERIAL_CRC32:          return "crc32";
+        default:                    return "none";
+    }
+}
+
+static const char *FrameName(SERIAL_FRAME_TYPE type) {
+
+    return ( type == SERIAL_FRAME_COBS ) ? "cobs" : ( type == SERIAL_FRAME_SLIP ) ? "slip" : "delimited";
+}
+
+/* Random payloads of cbMin to cbMax bytes, some zeros and SLIP specials in them. */
+static std::vector<std::vector<uint8_t>> Payloads(size_t cbMin, size_t cbMax, size_t cbTotal) {
+
+    std::vector<std::vector<uint8_t>>   vecvec;
+    size_t                              cb;
+
+    srand(1);
+    for ( size_t cbDone = 0; cbDone < cbTotal; cbDone += cb ) {
+        cb = cbMin + rand() % (cbMax - cbMin + 1);
+        std::vector<uint8_t> vec(cb);
+        for ( uint8_t &b : vec ) {
+            b = ( rand() % 64 == 0 ) ? 0 : ( rand() % 64 == 0 ) ? SERIAL_SLIP_END : rand();
+        }
+        vecvec.push_back(std::move(vec));
+    }
+    return vecvec;
+}
+
+template <typename P>
+static void BenchCodec(size_t cbMin, size_t cbMax) {
+
+    using CrcT = typename P::CrcPolicy;
+
+    SERIAL_FRAME_CFG    cfg = P::frame_cfg();
+    SERIAL_FRAMER       *pfr = SerialFramerCreate(&cfg);
+    ec::Framer<P>       fr;
+    std::vector<uint8_t> vecbWire;
+    const uint8_t       *pbFrame;
+    size_t              cbFrame;
+    size_t              cb;
+    uint64_t            cFrames;
+    uint64_t            nsStart;
+    double              secGeneric;
+    double              secProfile;
+    uint8_t             rgbCrc[4];
+
+    auto vecvec = Payloads(cbMin, cbMax, cbPerRun / 8);
+    vecbWire.resize(cbPerRun / 8 * 2 + vecvec.size() * 8);
+    cb = 0;
+    nsStart = NowNs();
+    for ( const auto &vec : vecvec ) {
+        cb += SerialFrameEncode(&cfg, vec.data(), vec.size(), vecbWire.data() + cb, vecbWire.size() - cb);
+    }
+    secGeneric = (NowNs() - nsStart) / 1e9;
+    vecbWire.resize(cb);
+
+    std::vector<uint8_t> vecbCheck(vecbWire.size());
+    cb = 0;
+    nsStart = NowNs();
+    for ( const auto &vec : vecvec ) {
+        if constexpr ( CrcT::kSize > 0 ) {
+            CrcT::Put(CrcT::Compute(vec.data(), vec.size()), rgbCrc);
+        }
+        cb += P::FramePolicy::Encode(vec.data(), vec.size(), rgbCrc, CrcT::kSize, vecbCheck.data() + cb);
+    }
+    secProfile = (NowNs() - nsStart) / 1e9;
+
+    printf("{\"bench\":\"profile\",\"run\":\"encode\",\"framing\":\"%s\",\"crc\":\"%s\",\"payload\":\"%zu-%zu\","
+           "\"generic_mb_per_s\":%.0f,\"profile_mb_per_s\":%.0f,\"speedup\":%.2f,\"same_bytes\":%s}\n",
+           FrameName(cfg.type), CrcName(cfg.crc), cbMin, cbMax, vecbWire.size() / secGeneric / 1e6,
+           vecbWire.size() / secProfile / 1e6, secGeneric / secProfile,
+           ( (cb == vecbWire.size()) && (memcmp(vecbCheck.data(), vecbWire.data(), cb) == 0) ) ? "true" : "false");
+    fflush(stdout);
+
+    // decode the same stream several times over, in read sized chunks
+    std::vector<uint64_t> veccFrames(2);
+    std::vector<double> vecsec(2);
+    for ( int iPass = 0; iPass < 2; iPass++ ) {
+        cFrames = 0;
+        nsStart = NowNs();
+        for ( int iRep = 0; iRep < 8; iRep++ ) {
+            for ( size_t ib = 0; ib < vecbWire.size(); ib += CB_CHUNK ) {
+                cb = std::min<size_t>(CB_CHUNK, vecbWire.size() - ib);
+                if ( iPass == 0 ) {
+                    SerialFramerPush(pfr, vecbWire.data() + ib, cb);
+                    while ( SerialFramerNext(pfr, &pbFrame, &cbFrame) ) {
+                        cFrames++;
+                    }
+                } else {
+                    fr.push(vecbWire.data() + ib, cb);
+                    while ( fr.next(&pbFrame, &cbFrame) ) {
+                        cFrames++;
+                    }
+                }
+            }
+        }
+        vecsec[iPass] = (NowNs() - nsStart) / 1e9;
+        veccFrames[iPass] = cFrames;
+    }
+
+    printf("{\"bench\":\"profile\",\"run\":\"decode\",\"framing\":\"%s\",\"crc\":\"%s\",\"payload\":\"%zu-%zu\","
+           "\"frames\":%llu,\"generic_mb_per_s\":%.0f,\"profile_mb_per_s\":%.0f,\"speedup\":%.2f,"
+           "\"generic_ns_per_frame\":%.1f,\"profile_ns_per_frame\":%.1f,\"same_frames\":%s}\n",
+           FrameName(cfg.type), CrcName(cfg.crc), cbMin, cbMax, (unsigned long long)veccFrames[1],
+           8 * vecbWire.size() / vecsec[0] / 1e6, 8 * vecbWire.size() / vecsec[1] / 1e6, vecsec[0] / vecsec[1],
+           vecsec[0] * 1e9 / veccFrames[0], vecsec[1] * 1e9 / veccFrames[1],
+           ( (veccFrames[0] == veccFrames[1]) && (veccFrames[0] == 8 * vecvec.size()) ) ? "true" : "false");
+    fflush(stdout);
+    SerialFramerDestroy(pfr);
+}
+
+template <typename CrcT>
+static void BenchCrc(size_t cb) {
+
+    std::vector<uint8_t>    vecb(cb + 8);
+    size_t                  cIter = cbPerRun / 4 / cb;
+    uint64_t                nsStart;
+    uint32_t                crc = 0;
+    double                  secGeneric;
+    double                  secProfile;
+
+    for ( uint8_t &b : vecb ) {
+        b = rand();
+    }
+    nsStart = NowNs();
+    for ( size_t i = 0; i < cIter; i++ ) {
+        crc += SerialCrc(CrcT::kType, vecb.data() + (i & 7), cb);
+    }
+    secGeneric = (NowNs() - nsStart) / 1e9;
+    nsStart = NowNs();
+    for ( size_t i = 0; i < cIter; i++ ) {
+        crc += CrcT::Compute(vecb.data() + (i & 7), cb);
+    }
+    secProfile = (NowNs() - nsStart) / 1e9;
+    cbSink = crc;
+
+    printf("{\"bench\":\"profile\",\"run\":\"crc\",\"crc\":\"%s\",\"generic_impl\":\"%s\",\"bytes\":%zu,"
+           "\"generic_mb_per_s\":%.0f,\"profile_mb_per_s\":%.0f,\"speedup\":%.2f}\n",
+           CrcName(CrcT::kType), SerialCrcImplName(SerialCrcGetImpl(CrcT::kType)), cb,
+           cIter * cb / secGeneric / 1e6, cIter * cb / secProfile / 1e6, secGeneric / secProfile);
+    fflush(stdout);
+}
+
+/* Frames per second read from a pty the feeder keeps full, generic then profile. */
+template <typename P>
+static void BenchPty(size_t cbPayload) {
+
+    SERIAL_FRAME_CFG    cfg = P::frame_cfg();
+    std::vector<uint8_t> vecbFrame(cbPayload, 0x5A);
+    std::vector<uint8_t> vecbWire;
+    const uint8_t       *pbFrame;
+    size_t              cFrames = cbPerRun / 64 / cbPayload;
+    uint64_t            nsStart;
+    double              rgsec[2];
+    char                szName[64];
+    int                 fdMaster;
+    int                 fdSlave;
+
+    vecbWire.resize(SerialFrameEncodedMax(&cfg, cbPayload));
+    vecbWire.resize(SerialFrameEncode(&cfg, vecbFrame.data(), cbPayload, vecbWire.data(), vecbWire.size()));
+    std::vector<uint8_t> vecbBurst;
+    for ( size_t i = 0; i < CB_CHUNK / vecbWire.size() + 1; i++ ) {
+        vecbBurst.insert(vecbBurst.end(), vecbWire.begin(), vecbWire.end());
+    }
+    size_t cFramesPerBurst = CB_CHUNK / vecbWire.size() + 1;
+
+    for ( int iPass = 0; iPass < 2; iPass++ ) {
+        BenchOpenPty(&fdMaster, &fdSlave, szName);
+        std::thread thrFeed([&] {
+            for ( size_t cSent = 0; cSent < cFrames; cSent += cFramesPerBurst ) {
+                if ( write(fdMaster, vecbBurst.data(), vecbBurst.size()) != (ssize_t)vecbBurst.size() ) {
+                    return;
+                }
+            }
+        });
+
+        size_t cGot = 0;
+        nsStart = NowNs();
+        if ( iPass == 0 ) {
+            SERIAL_PORT *port = SerialPortOpen(szName, P::kBaud);
+            SERIAL_FRAMER *pfr = SerialFramerCreate(&cfg);
+            while ( (cGot < cFrames) && (SerialPortReadFrame(port, pfr, &pbFrame, 1000) > 0) ) {
+                cGot++;
+            }
+            SerialFramerDestroy(pfr);
+            SerialPortClose(port);
+        } else {
+            ec::ProfilePort<P> port(szName);
+            while ( (cGot < cFrames) && (port.read_frame(&pbFrame, 1000) > 0) ) {
+                cGot++;
+            }
+        }
+        rgsec[iPass] = (NowNs() - nsStart) / 1e9;
+        close(fdMaster);
+        thrFeed.join();
+        close(fdSlave);
+        if ( cGot < cFrames ) {
+            fprintf(stderr, "BenchPty: %zu of %zu frames\n", cGot, cFrames);
+            exit(1);
+        }
+    }
+
+    printf("{\"bench\":\"profile\",\"run\":\"pty\",\"framing\":\"%s\",\"crc\":\"%s\",\"payload\":%zu,"
+           "\"generic_frames_per_s\":%.0f,\"profile_frames_per_s\":%.0f,\"speedup\":%.2f}\n",
+           FrameName(cfg.type), CrcName(cfg.crc), cbPayload, cFrames / rgsec[0], cFrames / rgsec[1],
+           rgsec[0] / rgsec[1]);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+
+    if ( (argc > 1) && (strcmp(argv[1], "--quick") == 0) ) {
+        cbPerRun = 8 * 1024 * 1024;
+    }
+    SerialSetLogger(NULL, NULL, SERIAL_LOG_ERROR);  // keep open/close chatter out of the JSON
+
+    BenchCodec<Cobs32>(8, 64);
+    BenchCodec<Cobs32>(256, 1024);
+    BenchCodec<CobsPlain>(8, 64);
+    BenchCodec<CobsPlain>(256, 1024);
+    BenchCodec<Slip16>(8, 64);
+    BenchCodec<Slip16>(256, 1024);
+
+    for ( size_t cb : { 16, 64, 256, 1024 } ) {
+        BenchCrc<ec::Crc32>(cb);
+        BenchCrc<ec::Crc16Ccitt>(cb);
+    }
+
+    BenchPty<Cobs32>(32);
+    BenchPty<Cobs32>(1024);
+    return 0;
+}
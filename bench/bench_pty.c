@@ -0,0 +1,322 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  bench_pty.c --  Read/write path benchmarks over pseudo terminals    */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Uses openpty() pairs as stand-ins for devices: the library opens    */
+/*  the slave side like any tty and a helper thread plays the device on */
+/*  the master side.  Measures                                          */
+/*                                                                      */
+/*    pty_throughput  bulk receive rate, reader CPU per MB and system   */
+/*                    calls per MB across read sizes and timeouts       */
+/*    pty_rtt         request/response round trip percentiles across    */
+/*                    message sizes, also with busy polling and a       */
+/*                    pinned RX thread (SerialPortSetLowLatency())      */
+/*                                                                      */
+/*  for the direct read path, the RX thread and the legacy SerialRead() */
+/*  and SerialWriteNBytes() calls.  Prints one JSON object per          */
+/*  configuration so results can be diffed between releases.  --quick   */
+/*  shrinks every run for CI.                                           */
+/*                                                                      */
+/************************************************************************/
+
+#define _GNU_SOURCE  /* RUSAGE_THREAD */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include "ec_serial.h"
+#include "bench_util.h"
+
+#define CB_DEVICE_CHUNK     4096
+#define CB_RING             (1 << 20)
+#define SPIN_US             200
+
+typedef enum {
+    MODE_DIRECT,        // SerialPortReadEx() on the descriptor
+    MODE_RX,            // SerialPortReadEx() from the RX thread's ring
+    MODE_LEGACY         // SerialRead() on the default port
+} MODE;
+
+static const char *rgszMode[] = { "direct", "rx_thread", "legacy" };
+
+typedef struct {
+    int         fdMaster;
+    size_t      cbTotal;        // throughput: bytes to send
+    size_t      cbMsg;          // rtt: bytes per echo
+    size_t      cIter;          // rtt: echoes to serve
+    double      secCpu;         // CPU used by the device thread
+} DEVICE;
+
+static size_t cbThroughput = 64 * 1024 * 1024;
+static size_t cRttIter = 20000;
+
+/* Device side of the throughput test: stream cbTotal bytes. */
+static void *DeviceStream(void *pv) {
+
+    DEVICE  *pdev = pv;
+    uint8_t rgb[CB_DEVICE_CHUNK];
+    size_t  cbSent;
+    ssize_t cb;
+
+    memset(rgb, 0x55, sizeof(rgb));
+    for ( cbSent = 0; cbSent < pdev->cbTotal; cbSent += cb ) {
+        cb = write(pdev->fdMaster, rgb,
+                   ( pdev->cbTotal - cbSent < sizeof(rgb) ) ? pdev->cbTotal - cbSent : sizeof(rgb));
+        if ( cb <= 0 ) {
+            break;
+        }
+    }
+    pdev->secCpu = CpuSec(RUSAGE_THREAD);
+    return NULL;
+}
+
+/* Device side of the latency test: echo every request back. */
+static void *DeviceEcho(void *pv) {
+
+    DEVICE  *pdev = pv;
+    uint8_t rgb[CB_DEVICE_CHUNK];
+    size_t  iIter;
+    size_t  cbGot;
+    ssize_t cb;
+
+    for ( iIter = 0; iIter < pdev->cIter; iIter++ ) {
+        for ( cbGot = 0; cbGot < pdev->cbMsg; cbGot += cb ) {
+            cb = read(pdev->fdMaster, rgb + cbGot, pdev->cbMsg - cbGot);
+            if ( cb <= 0 ) {
+                return NULL;
+            }
+        }
+        if ( write(pdev->fdMaster, rgb, pdev->cbMsg) != (ssize_t)pdev->cbMsg ) {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+static SERIAL_PORT *OpenPort(MODE mode, int *pfdMaster, int *pfdSlave) {
+
+    SERIAL_PORT *port;
+    char        szName[64];
+
+    if ( mode == MODE_LEGACY ) {
+        BenchOpenPty(pfdMaster, pfdSlave, szName);
+        if ( !SerialInit(szName, 115200) ) {
+            exit(1);
+        }
+        return NULL;
+    }
+    port = BenchOpenPort(115200, pfdMaster, pfdSlave);
+    if ( (mode == MODE_RX) && !SerialPortRxStart(port, CB_RING) ) {
+        exit(1);
+    }
+    return port;
+}
+
+static void ClosePort(SERIAL_PORT *port, int fdMaster, int fdSlave) {
+
+    if ( port != NULL ) {
+        SerialPortClose(port);
+    } else {
+        SerialClose();
+    }
+    close(fdMaster);
+    close(fdSlave);
+}
+
+static void BenchThroughput(MODE mode, size_t cbRead, uint32_t timeOutMs) {
+
+    SERIAL_PORT     *port;
+    SERIAL_STATS    stats;
+    DEVICE          dev;
+    pthread_t       thread;
+    uint8_t         *pbBuf;
+    size_t          cbGot;
+    uint64_t        cbLost;
+    uint64_t        nsStart;
+    double          sec;
+    double          secCpu;
+    double          mb;
+    int             fdSlave;
+    int             rc;
+
+    pbBuf = malloc(cbRead);
+    memset(&dev, 0, sizeof(dev));
+    port = OpenPort(mode, &dev.fdMaster, &fdSlave);
+    // the legacy read waits for whole buffers, keep the total a multiple
+    dev.cbTotal = cbThroughput - cbThroughput % cbRead;
+
+    secCpu = CpuSec(RUSAGE_SELF);
+    nsStart = NowNs();
+    pthread_create(&thread, NULL, DeviceStream, &dev);
+
+    // a slow consumer makes the RX thread drop bytes, those count as done
+    for ( cbGot = 0, cbLost = 0; cbGot + cbLost < dev.cbTotal; ) {
+        if ( mode == MODE_LEGACY ) {
+            rc = SerialRead(pbBuf, cbRead, timeOutMs);
+        } else {
+            rc = SerialPortReadEx(port, pbBuf, cbRead, 1, timeOutMs, 0);
+        }
+        if ( rc > 0 ) {
+            cbGot += rc;
+        } else if ( (rc == SERIAL_ERROR_CODE) || (timeOutMs >= 1000) ) {
+            break;
+        }
+        if ( mode == MODE_RX ) {
+            cbLost = SerialPortRxOverflow(port);
+        }
+    }
+
+    sec = (NowNs() - nsStart) / 1e9;
+    pthread_join(thread, NULL);
+    secCpu = CpuSec(RUSAGE_SELF) - secCpu - dev.secCpu;
+    mb = cbGot / 1e6;
+
+    printf("{\"bench\":\"pty_throughput\",\"mode\":\"%s\",\"read_size\":%zu,\"timeout_ms\":%u,"
+           "\"bytes\":%zu,\"overflow_bytes\":%llu,\"mb_per_s\":%.1f,\"cpu_s_per_mb\":%.6f",
+           rgszMode[mode], cbRead, timeOutMs, cbGot, (unsigned long long)cbLost,
+           mb / sec, secCpu / mb);
+    if ( port != NULL ) {
+        SerialPortGetStats(port, &stats);
+        printf(",\"read_calls\":%llu,\"poll_calls\":%llu,\"syscalls_per_mb\":%.1f",
+               (unsigned long long)stats.cReadCalls, (unsigned long long)stats.cPollCalls,
+               (stats.cReadCalls + stats.cPollCalls) / mb);
+    }
+    printf("}\n");
+    fflush(stdout);
+
+    ClosePort(port, dev.fdMaster, fdSlave);
+    free(pbBuf);
+}
+
+static void BenchRtt(MODE mode, size_t cbMsg, bool fLowLatency) {
+
+    SERIAL_PORT     *port;
+    SERIAL_STATS    stats;
+    SERIAL_LOW_LATENCY ll;
+    DEVICE          dev;
+    pthread_t       thread;
+    uint32_t        llApplied = 0;
+    uint8_t         rgbTx[CB_DEVICE_CHUNK];
+    uint8_t         rgbRx[CB_DEVICE_CHUNK];
+    uint64_t        *rgns;
+    uint64_t        nsStart;
+    size_t          iIter;
+    size_t          cDone;
+    int             fdSlave;
+    int             rc;
+
+    rgns = malloc(cRttIter * sizeof(*rgns));
+    memset(rgbTx, 0xA5, sizeof(rgbTx));
+    memset(&dev, 0, sizeof(dev));
+    port = OpenPort(mode, &dev.fdMaster, &fdSlave);
+    if ( fLowLatency ) {
+        memset(&ll, 0, sizeof(ll));
+        ll.flags = SERIAL_LL_DRIVER | SERIAL_LL_BUSY_POLL | SERIAL_LL_RX_CPU;
+        ll.spinUs = SPIN_US;
+        ll.cpuRx = (int)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+        llApplied = SerialPortSetLowLatency(port, &ll);
+    }
+    dev.cbMsg = cbMsg;
+    dev.cIter = cRttIter;
+    pthread_create(&thread, NULL, DeviceEcho, &dev);
+
+    cDone = 0;
+    for ( iIter = 0; iIter < cRttIter; iIter++ ) {
+        nsStart = NowNs();
+        if ( mode == MODE_LEGACY ) {
+            SerialWriteNBytes(rgbTx, (int)cbMsg);
+            rc = SerialRead(rgbRx, cbMsg, 1000);
+        } else {
+            SerialPortWrite(port, rgbTx, cbMsg, 0);
+            rc = SerialPortReadEx(port, rgbRx, cbMsg, cbMsg, 1000, 0);
+        }
+        if ( rc != (int)cbMsg ) {
+            break;
+        }
+        rgns[cDone++] = NowNs() - nsStart;
+    }
+    pthread_join(thread, NULL);
+
+    qsort(rgns, cDone, sizeof(*rgns), CompareU64);
+    printf("{\"bench\":\"pty_rtt\",\"mode\":\"%s\",\"low_latency\":\"0x%x\",\"msg_size\":%zu,"
+           "\"iterations\":%zu,\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f",
+           rgszMode[mode], llApplied, cbMsg, cDone,
+           cDone ? rgns[cDone / 2] / 1e3 : 0.0,
+           cDone ? rgns[cDone * 99 / 100] / 1e3 : 0.0,
+           cDone ? rgns[cDone * 999 / 1000] / 1e3 : 0.0,
+           cDone ? rgns[cDone - 1] / 1e3 : 0.0);
+    if ( (port != NULL) && (cDone > 0) ) {
+        SerialPortGetStats(port, &stats);
+        printf(",\"syscalls_per_rtt\":%.2f",
+               (double)(stats.cReadCalls + stats.cPollCalls + stats.cWriteCalls) / cDone);
+    }
+    printf("}\n");
+    fflush(stdout);
+
+    ClosePort(port, dev.fdMaster, fdSlave);
+    free(rgns);
+}
+
+int main(int argc, char *argv[]) {
+
+    static const size_t     rgcbRead[] = { 64, 256, 1024, 4096 };
+    static const uint32_t   rgmsTimeout[] = { 0, 100 };
+    static const size_t     rgcbMsg[] = { 1, 16, 128, 1024 };
+    size_t                  icb;
+    size_t                  ims;
+    int                     mode;
+
+    if ( (argc > 1) && (strcmp(argv[1], "--quick") == 0) ) {
+        cbThroughput = 4 * 1024 * 1024;
+        cRttIter = 2000;
+    }
+
+    // keep open/close notices out of the JSON
+    SerialSetLogger(NULL, NULL, SERIAL_LOG_ERROR);
+
+    for ( mode = MODE_DIRECT; mode <= MODE_LEGACY; mode++ ) {
+        for ( icb = 0; icb < sizeof(rgcbRead) / sizeof(rgcbRead[0]); icb++ ) {
+            for ( ims = 0; ims < sizeof(rgmsTimeout) / sizeof(rgmsTimeout[0]); ims++ ) {
+                BenchThroughput(mode, rgcbRead[icb], rgmsTimeout[ims]);
+            }
+        }
+    }
+
+    for ( mode = MODE_DIRECT; mode <= MODE_LEGACY; mode++ ) {
+        for ( icb = 0; icb < sizeof(rgcbMsg) / sizeof(rgcbMsg[0]); icb++ ) {
+            BenchRtt(mode, rgcbMsg[icb], false);
+        }
+    }
+
+    for ( mode = MODE_DIRECT; mode <= MODE_RX; mode++ ) {
+        for ( icb = 0; icb < sizeof(rgcbMsg) / sizeof(rgcbMsg[0]); icb++ ) {
+            BenchRtt(mode, rgcbMsg[icb], true);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  bench_reactor.c --  Reactor scaling over many pseudo terminals      */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Registers a growing number of pty ports with one reactor and        */
+/*  measures, for each count, the CPU burnt while every port is idle    */
+/*  and the delay from a device write to the data callback when         */
+/*  messages are spread over all ports.  Both should stay flat as the   */
+/*  port count grows.  Prints one JSON object per port count.           */
+/*                                                                      */
+/************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+
+#include "ec_serial.h"
+#include "ec_reactor.h"
+#include "bench_util.h"
+
+#define C_PORTS_MAX     256
+#define MS_IDLE         200
+
+static const int rgcPorts[] = { 1, 16, 64, C_PORTS_MAX };
+
+static sem_t        semDone;
+static uint64_t     *rgnsLatency;
+static atomic_uint  cLatency;
+static size_t       cMsg = 5000;
+
+/* Each message is the CLOCK_MONOTONIC time it was written at. */
+static void OnData(void *pvUser, SERIAL_PORT *port, const uint8_t *pb, size_t cb) {
+
+    uint64_t    nsSent;
+    unsigned    i;
+
+    (void)pvUser;
+    (void)port;
+    for ( ; cb >= sizeof(nsSent); pb += sizeof(nsSent), cb -= sizeof(nsSent) ) {
+        memcpy(&nsSent, pb, sizeof(nsSent));
+        i = atomic_fetch_add(&cLatency, 1);
+        if ( i < cMsg ) {
+            rgnsLatency[i] = NowNs() - nsSent;
+        }
+        sem_post(&semDone);
+    }
+}
+
+static void BenchPorts(int cPorts) {
+
+    SERIAL_REACTOR      *prt;
+    SERIAL_REACTOR_CBS  cbs = { OnData, NULL, NULL };
+    SERIAL_PORT         *rgport[C_PORTS_MAX];
+    int                 rgfdMaster[C_PORTS_MAX];
+    int                 rgfdSlave[C_PORTS_MAX];
+    uint64_t            nsSent;
+    double              secCpu;
+    double              secIdle;
+    size_t              iMsg;
+    size_t              c;
+    int                 iport;
+    int                 ishard;
+    uint32_t            cMin;
+    uint32_t            cMax;
+
+    prt = SerialReactorCreate(0, SERIAL_REACTOR_PIN);
+    if ( prt == NULL ) {
+        perror("SerialReactorCreate");
+        exit(1);
+    }
+    for ( iport = 0; iport < cPorts; iport++ ) {
+        rgport[iport] = BenchOpenPort(115200, &rgfdMaster[iport], &rgfdSlave[iport]);
+        if ( SerialReactorAdd(prt, rgport[iport], &cbs) < 0 ) {
+            exit(1);
+        }
+    }
+
+    cMin = UINT32_MAX;
+    cMax = 0;
+    for ( ishard = 0; ishard < SerialReactorShards(prt); ishard++ ) {
+        c = SerialReactorShardPorts(prt, ishard);
+        cMin = ( c < cMin ) ? c : cMin;
+        cMax = ( c > cMax ) ? c : cMax;
+    }
+
+    secCpu = CpuSec(RUSAGE_SELF);
+    usleep(MS_IDLE * 1000);
+    secIdle = CpuSec(RUSAGE_SELF) - secCpu;
+
+    atomic_store(&cLatency, 0);
+    secCpu = CpuSec(RUSAGE_SELF);
+    for ( iMsg = 0; iMsg < cMsg; iMsg++ ) {
+        nsSent = NowNs();
+        if ( write(rgfdMaster[iMsg % cPorts], &nsSent, sizeof(nsSent)) != sizeof(nsSent) ) {
+            exit(1);
+        }
+        sem_wait(&semDone);
+    }
+    secCpu = CpuSec(RUSAGE_SELF) - secCpu;
+
+    c = atomic_load(&cLatency);
+    c = ( c < cMsg ) ? c : cMsg;
+    qsort(rgnsLatency, c, sizeof(*rgnsLatency), CompareU64);
+    printf("{\"bench\":\"reactor\",\"ports\":%d,\"shards\":%d,\"ports_per_shard_min\":%u,"
+           "\"ports_per_shard_max\":%u,\"idle_cpu_ms_per_s\":%.3f,\"messages\":%zu,"
+           "\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"cpu_us_per_msg\":%.2f}\n",
+           cPorts, SerialReactorShards(prt), cMin, cMax, secIdle * 1e3 / (MS_IDLE / 1e3), c,
+           rgnsLatency[c / 2] / 1e3, rgnsLatency[c * 99 / 100] / 1e3,
+           rgnsLatency[c * 999 / 1000] / 1e3, secCpu * 1e6 / c);
+    fflush(stdout);
+
+    SerialReactorDestroy(prt);
+    for ( iport = 0; iport < cPorts; iport++ ) {
+        SerialPortClose(rgport[iport]);
+        close(rgfdSlave[iport]);
+        close(rgfdMaster[iport]);
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    size_t  i;
+
+    if ( (argc > 1) && (strcmp(argv[1], "--quick") == 0) ) {
+        cMsg = 1000;
+    }
+
+    SerialSetLogger(NULL, NULL, SERIAL_LOG_ERROR);
+    sem_init(&semDone, 0, 0);
+    rgnsLatency = malloc(cMsg * sizeof(*rgnsLatency));
+
+    for ( i = 0; i < sizeof(rgcPorts) / sizeof(rgcPorts[0]); i++ ) {
+        BenchPorts(rgcPorts[i]);
+    }
+
+    free(rgnsLatency);
+    return 0;
+}
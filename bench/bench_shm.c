@@ -0,0 +1,272 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  bench_shm.c --  Shared memory fan-out against a socket relay        */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Streams a device's output from an openpty() pair to 1 to 8 reader   */
+/*  processes, two ways:                                                */
+/*                                                                      */
+/*    shm       a broker publishes into shared memory and the readers   */
+/*              look at the data in place                               */
+/*    socket    the owning process reads the port and writes every      */
+/*              chunk to one Unix socket per reader                     */
+/*                                                                      */
+/*  and reports MB/s delivered to every reader, and the CPU all         */
+/*  processes together spend per MB of device data.  Prints one JSON    */
+/*  object per run.                                                     */
+/*                                                                      */
+/************************************************************************/
+
+#define _GNU_SOURCE  /* RUSAGE_THREAD */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/mman.h>      /* shm_unlink */
+
+#include "ec_serial.h"
+#include "ec_shm.h"
+#include "bench_util.h"
+
+#define SZ_SHM_NAME     "/ec_bench_shm"
+#define CB_CHUNK        4096
+#define C_MAX_READERS   8
+
+typedef enum {
+    MODE_SHM,
+    MODE_SOCKET
+} MODE;
+
+static const char *rgszMode[] = { "shm", "socket" };
+
+typedef struct {
+    int         fdMaster;
+    double      secCpu;         // CPU used by the device thread
+} DEVICE;
+
+static size_t cbTotal = 64 * 1024 * 1024;
+
+/* Device side: stream cbTotal bytes. */
+static void *DeviceStream(void *pv) {
+
+    DEVICE  *pdev = pv;
+    uint8_t rgb[CB_CHUNK];
+    size_t  cbSent;
+    ssize_t cb;
+
+    memset(rgb, 0x55, sizeof(rgb));
+    for ( cbSent = 0; cbSent < cbTotal; cbSent += cb ) {
+        cb = write(pdev->fdMaster, rgb, ( cbTotal - cbSent < sizeof(rgb) ) ? cbTotal - cbSent : sizeof(rgb));
+        if ( cb <= 0 ) {
+            break;
+        }
+    }
+    pdev->secCpu = CpuSec(RUSAGE_THREAD);
+    return NULL;
+}
+
+/* Reader process of the shm run, exits once it has seen cbTotal bytes. */
+static int ShmReader(int fdReady) {
+
+    SERIAL_SHM_READER   *prd;
+    const uint8_t       *pb;
+    size_t              cbGot = 0;
+    volatile uint8_t    bSink = 0;
+    int                 cb;
+
+    prd = SerialShmOpen(SZ_SHM_NAME);
+    if ( (prd == NULL) || (write(fdReady, "r", 1) != 1) ) {
+        return 1;
+    }
+    while ( cbGot + SerialShmLost(prd) < cbTotal ) {
+        cb = SerialShmPeek(prd, &pb, 5000);
+        if ( (cb < 0) && (errno == EOVERFLOW) ) {
+            continue;
+        }
+        if ( cb < 0 ) {
+            return 1;
+        }
+        // touch the data the way a consumer would
+        bSink ^= pb[0] ^ pb[cb - 1];
+        if ( SerialShmConsume(prd, cb) ) {
+            cbGot += cb;
+        }
+    }
+    // the parent reads the loss back from the broker's stats
+    SerialShmClose(prd);
+    return 0;
+}
+
+/* Reader process of the socket run. */
+static int SocketReader(int fdReady, int fdSock) {
+
+    uint8_t     rgb[CB_CHUNK * 4];
+    size_t      cbGot = 0;
+    ssize_t     cb;
+
+    if ( write(fdReady, "r", 1) != 1 ) {
+        return 1;
+    }
+    while ( cbGot < cbTotal ) {
+        cb = read(fdSock, rgb, sizeof(rgb));
+        if ( cb <= 0 ) {
+            return 1;
+        }
+        cbGot += cb;
+    }
+    return 0;
+}
+
+static void Bench(MODE mode, int cReaders) {
+
+    SERIAL_PORT         *port;
+    SERIAL_SHM_BROKER   *pbr = NULL;
+    SERIAL_SHM_CFG      cfg;
+    SERIAL_SHM_STATS    stats;
+    DEVICE              dev;
+    pthread_t           thread;
+    pid_t               rgpid[C_MAX_READERS];
+    int                 rgfdSock[C_MAX_READERS][2];
+    int                 rgfdReady[2];
+    uint8_t             rgb[CB_CHUNK * 4];
+    char                ch;
+    uint64_t            nsStart;
+    size_t              cbRelayed = 0;
+    double              secCpuStart;
+    double              secCpuChildrenStart;
+    double              sec;
+    double              secCpu;
+    int                 fdSlave;
+    int                 ird;
+    int                 status;
+    int                 cFailed = 0;
+    int                 cb;
+
+    memset(&dev, 0, sizeof(dev));
+    port = BenchOpenPort(115200, &dev.fdMaster, &fdSlave);
+    if ( pipe(rgfdReady) != 0 ) {
+        perror("pipe");
+        exit(1);
+    }
+    if ( mode == MODE_SHM ) {
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.cbRing = 4 << 20;
+        shm_unlink(SZ_SHM_NAME);
+        pbr = SerialShmBrokerCreate(port, SZ_SHM_NAME, &cfg);
+        if ( pbr == NULL ) {
+            perror("SerialShmBrokerCreate");
+            exit(1);
+        }
+    }
+
+    fflush(stdout);
+    for ( ird = 0; ird < cReaders; ird++ ) {
+        if ( (mode == MODE_SOCKET) && (socketpair(AF_UNIX, SOCK_STREAM, 0, rgfdSock[ird]) != 0) ) {
+            exit(1);
+        }
+        rgpid[ird] = fork();
+        if ( rgpid[ird] == 0 ) {
+            _exit(( mode == MODE_SHM ) ? ShmReader(rgfdReady[1]) : SocketReader(rgfdReady[1], rgfdSock[ird][1]));
+        }
+        if ( mode == MODE_SOCKET ) {
+            close(rgfdSock[ird][1]);
+        }
+    }
+    for ( ird = 0; ird < cReaders; ird++ ) {
+        if ( read(rgfdReady[0], &ch, 1) != 1 ) {
+            exit(1);
+        }
+    }
+
+    secCpuStart = CpuSec(RUSAGE_SELF);
+    secCpuChildrenStart = CpuSec(RUSAGE_CHILDREN);
+    nsStart = NowNs();
+    pthread_create(&thread, NULL, DeviceStream, &dev);
+
+    if ( mode == MODE_SOCKET ) {
+        while ( cbRelayed < cbTotal ) {
+            cb = SerialPortReadEx(port, rgb, sizeof(rgb), 1, 5000, 0);
+            if ( cb <= 0 ) {
+                break;
+            }
+            for ( ird = 0; ird < cReaders; ird++ ) {
+                if ( write(rgfdSock[ird][0], rgb, cb) != cb ) {
+                    exit(1);
+                }
+            }
+            cbRelayed += cb;
+        }
+    }
+    for ( ird = 0; ird < cReaders; ird++ ) {
+        waitpid(rgpid[ird], &status, 0);
+        cFailed += !WIFEXITED(status) || (WEXITSTATUS(status) != 0);
+    }
+    sec = (NowNs() - nsStart) / 1e9;
+    pthread_join(thread, NULL);
+    // everything but the device thread, which is the same in both modes
+    secCpu = CpuSec(RUSAGE_SELF) - secCpuStart - dev.secCpu +
+             CpuSec(RUSAGE_CHILDREN) - secCpuChildrenStart;
+
+    memset(&stats, 0, sizeof(stats));
+    if ( pbr != NULL ) {
+        SerialShmBrokerGetStats(pbr, &stats);
+        SerialShmBrokerDestroy(pbr);
+    }
+    printf("{\"bench\":\"shm\",\"mode\":\"%s\",\"readers\":%d,\"mb\":%zu,\"mb_per_s\":%.1f,"
+           "\"cpu_ms_per_mb\":%.2f,\"lag_events\":%llu,\"mb_lost\":%.2f,\"failed\":%d}\n",
+           rgszMode[mode], cReaders, cbTotal >> 20, cbTotal / sec / 1e6,
+           secCpu * 1e3 / (cbTotal / 1e6), (unsigned long long)stats.cLagEvents, stats.cbLost / 1e6, cFailed);
+    fflush(stdout);
+
+    if ( mode == MODE_SOCKET ) {
+        for ( ird = 0; ird < cReaders; ird++ ) {
+            close(rgfdSock[ird][0]);
+        }
+    }
+    SerialPortClose(port);
+    close(dev.fdMaster);
+    close(fdSlave);
+    close(rgfdReady[0]);
+    close(rgfdReady[1]);
+}
+
+int main(int argc, char *argv[]) {
+
+    static const int rgcReaders[] = { 1, 2, 4, 8 };
+    size_t  i;
+
+    if ( (argc > 1) && (strcmp(argv[1], "--quick") == 0) ) {
+        cbTotal = 8 * 1024 * 1024;
+    }
+
+    for ( i = 0; i < sizeof(rgcReaders) / sizeof(rgcReaders[0]); i++ ) {
+        Bench(MODE_SHM, rgcReaders[i]);
+        Bench(MODE_SOCKET, rgcReaders[i]);
+    }
+    return 0;
+}
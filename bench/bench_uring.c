@@ -0,0 +1,222 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  bench_uring.c --  System calls per byte, poll against io_uring      */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Two workloads, each run on the poll/epoll path and on io_uring:     */
+/*                                                                      */
+/*    serial_read   one port read with a SerialPortRead() loop while a  */
+/*                  thread feeds the pty in small paced chunks, the     */
+/*                  way a device trickles data in                       */
+/*    reactor       one reactor serving many ports, every port getting  */
+/*                  a message per round                                 */
+/*                                                                      */
+/*  Reports the system calls made on the receive side per KB received.  */
+/*  Prints one JSON object per run.                                     */
+/*                                                                      */
+/************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "ec_serial.h"
+#include "ec_reactor.h"
+#include "bench_util.h"
+
+#define CB_CHUNK        64          // bytes per write of the feeder
+#define US_GAP          20          // feeder pause between chunks
+#define CB_READ         256         // SerialPortRead() request size
+#define C_PORTS_MAX     256
+#define CB_MSG          32          // reactor message per port per round
+
+static const int rgcPorts[] = { 16, 64, C_PORTS_MAX };
+
+static size_t       cbStream = 1 << 20;
+static int          cRounds = 200;
+static atomic_ulong cbReactor;
+
+static void *Feeder(void *pv) {
+
+    int                 fdMaster = *(int *)pv;
+    uint8_t             rgb[CB_CHUNK];
+    struct timespec     ts = { 0, US_GAP * 1000 };
+    size_t              cbSent;
+
+    memset(rgb, 0x5A, sizeof(rgb));
+    for ( cbSent = 0; cbSent < cbStream; cbSent += sizeof(rgb) ) {
+        if ( write(fdMaster, rgb, sizeof(rgb)) != sizeof(rgb) ) {
+            exit(1);
+        }
+        nanosleep(&ts, NULL);
+    }
+    return NULL;
+}
+
+static void BenchSerialRead(SERIAL_IO_BACKEND backend) {
+
+    SERIAL_PORT     *port;
+    SERIAL_STATS    stats;
+    pthread_t       thread;
+    uint8_t         rgb[CB_READ];
+    int             fdMaster;
+    int             fdSlave;
+    size_t          cbGot;
+    uint64_t        nsStart;
+    uint64_t        cCalls;
+    double          secCpu;
+    double          sec;
+    int             rc;
+
+    port = BenchOpenPort(115200, &fdMaster, &fdSlave);
+    backend = SerialPortSetIoBackend(port, backend);
+
+    secCpu = CpuSec(RUSAGE_SELF);
+    nsStart = NowNs();
+    pthread_create(&thread, NULL, Feeder, &fdMaster);
+    for ( cbGot = 0; cbGot < cbStream; cbGot += rc ) {
+        rc = SerialPortReadEx(port, rgb, sizeof(rgb), 1, 1000, 0);
+        if ( rc <= 0 ) {
+            fprintf(stderr, "SerialPortReadEx: %d\n", rc);
+            exit(1);
+        }
+    }
+    pthread_join(thread, NULL);
+    sec = (NowNs() - nsStart) / 1e9;
+    secCpu = CpuSec(RUSAGE_SELF) - secCpu;
+
+    SerialPortGetStats(port, &stats);
+    cCalls = stats.cReadCalls + stats.cPollCalls + stats.cUringCalls;
+    printf("{\"bench\":\"uring\",\"mode\":\"serial_read\",\"backend\":\"%s\",\"bytes\":%zu,"
+           "\"read_calls\":%llu,\"poll_calls\":%llu,\"uring_calls\":%llu,"
+           "\"syscalls_per_kb\":%.2f,\"mb_per_s\":%.2f,\"cpu_pct\":%.1f}\n",
+           ( backend == SERIAL_IO_URING ) ? "io_uring" : "poll", cbGot,
+           (unsigned long long)stats.cReadCalls, (unsigned long long)stats.cPollCalls,
+           (unsigned long long)stats.cUringCalls, cCalls / (cbGot / 1024.0),
+           cbGot / sec / 1e6, secCpu * 100 / sec);
+    fflush(stdout);
+
+    SerialPortClose(port);
+    close(fdSlave);
+    close(fdMaster);
+}
+
+static void OnData(void *pvUser, SERIAL_PORT *port, const uint8_t *pb, size_t cb) {
+
+    (void)pvUser;
+    (void)port;
+    (void)pb;
+    atomic_fetch_add(&cbReactor, cb);
+}
+
+static void BenchReactor(int cPorts, uint32_t flags) {
+
+    SERIAL_REACTOR          *prt;
+    SERIAL_REACTOR_CBS      cbs = { OnData, NULL, NULL };
+    SERIAL_REACTOR_STATS    stats;
+    SERIAL_PORT             *rgport[C_PORTS_MAX];
+    int                     rgfdMaster[C_PORTS_MAX];
+    int                     rgfdSlave[C_PORTS_MAX];
+    uint8_t                 rgb[CB_MSG];
+    unsigned long           cbWant;
+    uint64_t                cSyscallsStart;
+    uint64_t                nsStart;
+    double                  sec;
+    int                     iport;
+    int                     iround;
+
+    prt = SerialReactorCreate(1, flags);
+    if ( prt == NULL ) {
+        perror("SerialReactorCreate");
+        exit(1);
+    }
+    for ( iport = 0; iport < cPorts; iport++ ) {
+        rgport[iport] = BenchOpenPort(115200, &rgfdMaster[iport], &rgfdSlave[iport]);
+        if ( SerialReactorAdd(prt, rgport[iport], &cbs) < 0 ) {
+            exit(1);
+        }
+    }
+
+    // let the shard settle with every port armed
+    usleep(20000);
+    atomic_store(&cbReactor, 0);
+    SerialReactorGetStats(prt, &stats);
+    cSyscallsStart = stats.cSyscalls;
+
+    memset(rgb, 0xA5, sizeof(rgb));
+    cbWant = 0;
+    nsStart = NowNs();
+    for ( iround = 0; iround < cRounds; iround++ ) {
+        for ( iport = 0; iport < cPorts; iport++ ) {
+            if ( write(rgfdMaster[iport], rgb, sizeof(rgb)) != sizeof(rgb) ) {
+                exit(1);
+            }
+        }
+        cbWant += (unsigned long)cPorts * sizeof(rgb);
+        while ( atomic_load(&cbReactor) < cbWant ) {
+            usleep(50);
+        }
+    }
+    sec = (NowNs() - nsStart) / 1e9;
+
+    SerialReactorGetStats(prt, &stats);
+    printf("{\"bench\":\"uring\",\"mode\":\"reactor\",\"backend\":\"%s\",\"ports\":%d,"
+           "\"bytes\":%lu,\"syscalls\":%llu,\"syscalls_per_kb\":%.2f,\"mb_per_s\":%.2f}\n",
+           ( SerialReactorFlags(prt) & SERIAL_REACTOR_URING ) ? "io_uring" : "epoll",
+           cPorts, cbWant, (unsigned long long)(stats.cSyscalls - cSyscallsStart),
+           (stats.cSyscalls - cSyscallsStart) / (cbWant / 1024.0), cbWant / sec / 1e6);
+    fflush(stdout);
+
+    SerialReactorDestroy(prt);
+    for ( iport = 0; iport < cPorts; iport++ ) {
+        SerialPortClose(rgport[iport]);
+        close(rgfdSlave[iport]);
+        close(rgfdMaster[iport]);
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    size_t  i;
+
+    if ( (argc > 1) && (strcmp(argv[1], "--quick") == 0) ) {
+        cbStream = 1 << 18;
+        cRounds = 50;
+    }
+
+    SerialSetLogger(NULL, NULL, SERIAL_LOG_ERROR);
+
+    BenchSerialRead(SERIAL_IO_POLL);
+    BenchSerialRead(SERIAL_IO_URING);
+    for ( i = 0; i < sizeof(rgcPorts) / sizeof(rgcPorts[0]); i++ ) {
+        BenchReactor(rgcPorts[i], 0);
+        BenchReactor(rgcPorts[i], SERIAL_REACTOR_URING);
+    }
+    return 0;
+}
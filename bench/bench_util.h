@@ -0,0 +1,105 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  bench_util.h --  helpers shared by the benchmark programs           */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*  Clocks, CPU time, a qsort() comparison for latency samples, and     */
+/*  the openpty() pair that stands in for a device.  Everything is      */
+/*  static inline, each benchmark is a single translation unit built    */
+/*  against the library objects.  Compiles as C and as C++.             */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(_BENCH_UTIL_H)
+#define _BENCH_UTIL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <pty.h>
+#include <sys/resource.h>
+
+#include "ec_serial.h"
+
+/* ------------------------------------------------------------ */
+/*                  Procedure Definitions                       */
+/* ------------------------------------------------------------ */
+
+/* Reading of clk in ns. */
+static inline uint64_t ClockNs(clockid_t clk) {
+    struct timespec ts;
+
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Monotonic time in ns, for elapsed times and latencies. */
+static inline uint64_t NowNs(void) {
+
+    return ClockNs(CLOCK_MONOTONIC);
+}
+
+/* User plus system seconds of RUSAGE_SELF, _THREAD or _CHILDREN. */
+static inline double CpuSec(int who) {
+    struct rusage ru;
+
+    getrusage(who, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+/* qsort() order for uint64_t samples. */
+static inline int CompareU64(const void *pv1, const void *pv2) {
+    uint64_t v1 = *(const uint64_t *)pv1;
+    uint64_t v2 = *(const uint64_t *)pv2;
+
+    return ( v1 > v2 ) - ( v1 < v2 );
+}
+
+/* A pty pair, the slave's path in szName (64 bytes), exits on failure. */
+static inline void BenchOpenPty(int *pfdMaster, int *pfdSlave, char *szName) {
+
+    if ( openpty(pfdMaster, pfdSlave, szName, NULL, NULL) != 0 ) {
+        perror("openpty");
+        exit(1);
+    }
+}
+
+/* A pty pair with the library's port open on the slave, exits on failure. */
+static inline SERIAL_PORT *BenchOpenPort(int baudRate, int *pfdMaster, int *pfdSlave) {
+
+    SERIAL_PORT *port;
+    char        szName[64];
+
+    BenchOpenPty(pfdMaster, pfdSlave, szName);
+    port = SerialPortOpen(szName, baudRate);
+    if ( port == NULL ) {
+        perror("SerialPortOpen");
+        exit(1);
+    }
+    return port;
+}
+
+#endif
+
+/**********************************  EOF  **************************************/
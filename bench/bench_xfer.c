@@ -0,0 +1,330 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  bench_xfer.c --  windowed bulk transfer against stop and wait       */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Two openpty() pairs joined by a simulated link: a helper thread     */
+/*  per direction paces the bytes at the baud rate, adds the latency    */
+/*  of a USB adapter and, when asked, corrupts bytes at random.  The    */
+/*  sender and the receiver each open a slave with SerialPortOpen().    */
+/*  Each run sends one image and reports the throughput and the share   */
+/*  of the line it used for                                             */
+/*                                                                      */
+/*    window 1      stop and wait, an ack per block as in XMODEM        */
+/*    window 8/32   blocks in flight with selective retransmit          */
+/*    resume        the receiver cancels half way, a second transfer    */
+/*                  with idResume only sends the rest                   */
+/*                                                                      */
+/*  Prints one JSON object per run.                                     */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "ec_serial.h"
+#include "ec_xfer.h"
+#include "bench_util.h"
+
+#define BAUD            921600
+#define NS_LATENCY      4000000     // each way, a USB adapter's latency timer
+#define CB_CHUNK        256
+#define C_CHUNKS        16          // 4 KB in flight, the adapter's buffer
+
+typedef struct {
+    uint8_t     rgb[CB_CHUNK];
+    size_t      cb;
+    uint64_t    nsDue;
+} CHUNK;
+
+// One direction of the link
+typedef struct {
+    int             fdIn;
+    int             fdOut;
+    uint32_t        rng;
+    pthread_t       thrRead;
+    pthread_t       thrWrite;
+    pthread_mutex_t mtx;
+    pthread_cond_t  cv;
+    CHUNK           rgchunk[C_CHUNKS];
+    size_t          ichunkHead;
+    size_t          cchunk;
+    bool            fEof;
+} LINK;
+
+typedef struct {
+    SERIAL_PORT     *port;
+    SERIAL_XFER_CFG cfg;
+    uint8_t         *pbImage;
+    uint64_t        cbCancel;       // cancel once this much is written, 0 never
+    SERIAL_XFER_STATUS status;
+    SERIAL_XFER_STATS stats;
+} RECEIVER;
+
+static size_t   cbImage = 256 * 1024;
+static volatile uint32_t ppmError;  // corrupted bytes per million, both ways
+
+static void SleepUntil(uint64_t ns) {
+    struct timespec ts;
+
+    ts.tv_sec = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR ) {
+    }
+}
+
+static uint32_t XorShift(uint32_t *prng) {
+
+    *prng ^= *prng << 13;
+    *prng ^= *prng >> 17;
+    *prng ^= *prng << 5;
+    return *prng;
+}
+
+/* Takes bytes off the wire as fast as the baud rate lets them on. */
+static void *LinkRead(void *pv) {
+
+    LINK        *plink = pv;
+    CHUNK       *pchunk;
+    uint64_t    nsFree = 0;
+    uint64_t    nsNow;
+    uint8_t     rgb[CB_CHUNK];
+    ssize_t     cb;
+    ssize_t     ib;
+
+    for ( ; ; ) {
+        cb = read(plink->fdIn, rgb, sizeof(rgb));
+        if ( cb <= 0 ) {
+            break;
+        }
+        for ( ib = 0; ib < cb; ib++ ) {
+            if ( XorShift(&plink->rng) % 1000000 < ppmError ) {
+                rgb[ib] ^= 1 << (XorShift(&plink->rng) % 8);
+            }
+        }
+
+        nsNow = NowNs();
+        nsFree = (( nsFree > nsNow ) ? nsFree : nsNow) + (uint64_t)cb * 10 * 1000000000 / BAUD;
+        SleepUntil(nsFree);
+
+        pthread_mutex_lock(&plink->mtx);
+        while ( plink->cchunk == C_CHUNKS ) {
+            pthread_cond_wait(&plink->cv, &plink->mtx);
+        }
+        pchunk = &plink->rgchunk[(plink->ichunkHead + plink->cchunk) % C_CHUNKS];
+        memcpy(pchunk->rgb, rgb, cb);
+        pchunk->cb = cb;
+        pchunk->nsDue = nsFree + NS_LATENCY;
+        plink->cchunk++;
+        pthread_cond_broadcast(&plink->cv);
+        pthread_mutex_unlock(&plink->mtx);
+    }
+
+    pthread_mutex_lock(&plink->mtx);
+    plink->fEof = true;
+    pthread_cond_broadcast(&plink->cv);
+    pthread_mutex_unlock(&plink->mtx);
+    return NULL;
+}
+
+/* Hands the bytes over once the latency has passed. */
+static void *LinkWrite(void *pv) {
+
+    LINK        *plink = pv;
+    CHUNK       chunk;
+
+    for ( ; ; ) {
+        pthread_mutex_lock(&plink->mtx);
+        while ( (plink->cchunk == 0) && !plink->fEof ) {
+            pthread_cond_wait(&plink->cv, &plink->mtx);
+        }
+        if ( plink->cchunk == 0 ) {
+            pthread_mutex_unlock(&plink->mtx);
+            return NULL;
+        }
+        chunk = plink->rgchunk[plink->ichunkHead];
+        plink->ichunkHead = (plink->ichunkHead + 1) % C_CHUNKS;
+        plink->cchunk--;
+        pthread_cond_broadcast(&plink->cv);
+        pthread_mutex_unlock(&plink->mtx);
+
+        SleepUntil(chunk.nsDue);
+        if ( write(plink->fdOut, chunk.rgb, chunk.cb) != (ssize_t)chunk.cb ) {
+            return NULL;
+        }
+    }
+}
+
+static void LinkStart(LINK *plink, int fdIn, int fdOut, uint32_t seed) {
+
+    memset(plink, 0, sizeof(*plink));
+    plink->fdIn = fdIn;
+    plink->fdOut = fdOut;
+    plink->rng = seed;
+    pthread_mutex_init(&plink->mtx, NULL);
+    pthread_cond_init(&plink->cv, NULL);
+    pthread_create(&plink->thrRead, NULL, LinkRead, plink);
+    pthread_create(&plink->thrWrite, NULL, LinkWrite, plink);
+}
+
+static bool WriteImage(void *pvCtx, uint64_t ib, const uint8_t *pb, size_t cb) {
+
+    RECEIVER    *prcv = pvCtx;
+
+    memcpy(prcv->pbImage + ib, pb, cb);
+    return true;
+}
+
+static bool ReceiveProgress(void *pvCtx, uint64_t cbDone, uint64_t cbTotal) {
+
+    RECEIVER    *prcv = pvCtx;
+
+    return (prcv->cbCancel == 0) || (cbDone < prcv->cbCancel);
+}
+
+static void *Receive(void *pv) {
+
+    RECEIVER    *prcv = pv;
+
+    prcv->status = SerialXferReceive(prcv->port, &prcv->cfg, &prcv->stats);
+    return NULL;
+}
+
+/* Throws away what is left on the link, late acks and repeated ENDs. */
+static void Drain(SERIAL_PORT *port) {
+
+    uint8_t     rgb[CB_CHUNK];
+
+    while ( SerialPortRead(port, rgb, sizeof(rgb), 2 * NS_LATENCY / 1000000 + 10) > 0 ) {
+    }
+}
+
+/* One transfer of the image from portTx to portRx. */
+static void Bench(const char *szRun, SERIAL_PORT *portTx, SERIAL_PORT *portRx, const uint8_t *pbImage,
+                  uint32_t cWindow, bool fResume) {
+
+    SERIAL_XFER_CFG     cfg;
+    SERIAL_XFER_STATS   stats;
+    SERIAL_XFER_STATUS  status;
+    RECEIVER            rcv;
+    pthread_t           thr;
+    uint64_t            cbResume = 0;
+    uint64_t            cbLine = 0;
+    int                 iPass;
+    double              sec = 0;
+    double              mbps;
+
+    memset(&rcv, 0, sizeof(rcv));
+    rcv.pbImage = calloc(1, cbImage);
+    rcv.port = portRx;
+    for ( iPass = ( fResume ? 0 : 1 ); iPass < 2; iPass++ ) {
+        memset(&rcv.cfg, 0, sizeof(rcv.cfg));
+        rcv.cfg.pfnWrite = WriteImage;
+        rcv.cfg.pfnProgress = ReceiveProgress;
+        rcv.cfg.pvCtx = &rcv;
+        rcv.cfg.idResume = 1;
+        rcv.cfg.cbResume = cbResume;
+        rcv.cbCancel = ( iPass == 0 ) ? cbImage / 2 : 0;
+        pthread_create(&thr, NULL, Receive, &rcv);
+
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.cWindow = cWindow;
+        status = SerialXferSend(portTx, &cfg, 1, pbImage, cbImage, &stats);
+        pthread_join(thr, NULL);
+        cbResume = rcv.stats.cbDone;
+        Drain(portTx);
+        Drain(portRx);
+        if ( iPass == 0 ) {
+            continue;   // the cancelled half, only the resumed transfer is timed
+        }
+        sec = stats.nsElapsed / 1e9;
+        cbLine = stats.cbDone - stats.cbResumed;
+    }
+
+    mbps = cbLine / sec / 1e6;
+    printf("{\"bench\":\"xfer\",\"run\":\"%s\",\"window\":%u,\"block\":%u,\"baud\":%d,"
+           "\"latency_ms\":%.1f,\"error_ppm\":%u,\"bytes\":%zu,\"resumed\":%llu,"
+           "\"status\":\"%s\",\"match\":%s,\"sec\":%.2f,\"mb_per_s\":%.4f,\"line_use\":%.2f,"
+           "\"retransmits\":%llu,\"timeouts\":%llu,\"crc_errors\":%llu}\n",
+           szRun, ( cWindow != 0 ) ? cWindow : SERIAL_XFER_WINDOW_DEFAULT, SERIAL_XFER_BLOCK_DEFAULT,
+           BAUD, NS_LATENCY / 1e6, ppmError, cbImage, (unsigned long long)stats.cbResumed,
+           SerialXferStatusName(status), ( memcmp(rcv.pbImage, pbImage, cbImage) == 0 ) ? "true" : "false",
+           sec, mbps, mbps * 1e6 / (BAUD / 10.0), (unsigned long long)stats.cRetransmits,
+           (unsigned long long)stats.cTimeouts, (unsigned long long)rcv.stats.cCrcErrors);
+    fflush(stdout);
+    free(rcv.pbImage);
+}
+
+int main(int argc, char *argv[]) {
+
+    static const uint32_t rgcWindow[] = { 1, 8, 32 };
+    SERIAL_PORT *portTx;
+    SERIAL_PORT *portRx;
+    LINK        linkTx;
+    LINK        linkRx;
+    uint8_t     *pbImage;
+    int         fdMasterTx;
+    int         fdMasterRx;
+    int         fdSlaveTx;
+    int         fdSlaveRx;
+    size_t      ib;
+    size_t      iwin;
+
+    if ( (argc > 1) && (strcmp(argv[1], "--quick") == 0) ) {
+        cbImage = 64 * 1024;
+    }
+    SerialSetLogger(NULL, NULL, SERIAL_LOG_ERROR);  // keep the retry warnings out of the JSON
+
+    portTx = BenchOpenPort(BAUD, &fdMasterTx, &fdSlaveTx);
+    portRx = BenchOpenPort(BAUD, &fdMasterRx, &fdSlaveRx);
+    pbImage = malloc(cbImage);
+    if ( pbImage == NULL ) {
+        return 1;
+    }
+    srand(1);
+    for ( ib = 0; ib < cbImage; ib++ ) {
+        pbImage[ib] = rand();
+    }
+    LinkStart(&linkTx, fdMasterTx, fdMasterRx, 1);
+    LinkStart(&linkRx, fdMasterRx, fdMasterTx, 2);
+
+    for ( iwin = 0; iwin < sizeof(rgcWindow) / sizeof(rgcWindow[0]); iwin++ ) {
+        Bench("clean", portTx, portRx, pbImage, rgcWindow[iwin], false);
+    }
+    Bench("resume", portTx, portRx, pbImage, 32, true);
+
+    // about one block in fifty damaged, acks too
+    ppmError = 20;
+    for ( iwin = 0; iwin < sizeof(rgcWindow) / sizeof(rgcWindow[0]); iwin++ ) {
+        Bench("errors", portTx, portRx, pbImage, rgcWindow[iwin], false);
+    }
+
+    SerialPortClose(portTx);
+    SerialPortClose(portRx);
+    free(pbImage);
+    return 0;
+}
@@ -0,0 +1,119 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_baud.c --  EmbedCreativity's arbitrary baud rate support         */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  The POSIX termios interface only knows the fixed Bxxx rates.  Linux */
+/*  takes any integer rate through struct termios2 with the BOTHER      */
+/*  flag, and reports the rate the driver actually programmed back in   */
+/*  c_ispeed/c_ospeed.  <asm/termbits.h> clashes with <termios.h>, so   */
+/*  these helpers live on their own and only deal in descriptors.       */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*                                                                      */
+/************************************************************************/
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>   /* struct termios2, BOTHER */
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    BaudSetFd
+**
+**  Synopsis:
+**      bool BaudSetFd(int fd, int baudRate)
+**
+**  Parameters:
+**      fd              open serial device
+**      baudRate        any rate, in bits per second
+**
+**  Return Values:
+**      1               the driver accepted the request
+**      0               failure, see errno
+**
+**  Description:
+**      Programs the same rate for input and output.  The driver may round
+**      to the nearest rate its clock can produce, use BaudGetFd() to find
+**      out what it settled on.
+*/
+bool BaudSetFd(int fd, int baudRate) {
+
+    struct termios2 tio;
+
+    if ( baudRate <= 0 ) {
+        errno = EINVAL;
+        return false;
+    }
+    if ( 0 != ioctl(fd, TCGETS2, &tio) ) {
+        return false;
+    }
+
+    tio.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    tio.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    tio.c_ispeed = baudRate;
+    tio.c_ospeed = baudRate;
+
+    return ( 0 == ioctl(fd, TCSETS2, &tio) );
+}
+
+/* ------------------------------------------------------------ */
+/***    BaudGetFd
+**
+**  Synopsis:
+**      int BaudGetFd(int fd)
+**
+**  Parameters:
+**      fd              open serial device
+**
+**  Return Values:
+**      input rate currently programmed, in bits per second
+**      -1 if it cannot be read, see errno
+*/
+int BaudGetFd(int fd) {
+
+    struct termios2 tio;
+
+    if ( 0 != ioctl(fd, TCGETS2, &tio) ) {
+        return -1;
+    }
+    return (int)tio.c_ispeed;
+}
+
+
+/************************************ EOF ********************************/
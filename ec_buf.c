@@ -0,0 +1,438 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_buf.c --  EmbedCreativity's pooled receive buffers               */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Fixed size chunks carved out of one arena when the pool is made.    */
+/*  SerialPortReadChunk() reads straight into a chunk and hands it out  */
+/*  as a SERIAL_BUF, a counted view that consumers slice and pass on    */
+/*  (a frame, a queue entry, one copy per subscriber) without copying   */
+/*  the bytes.  The chunk goes back to the pool when the last view of   */
+/*  it is released.  Nothing is allocated after SerialBufPoolCreate().  */
+/*                                                                      */
+/*  Free chunks sit on a Treiber stack of chunk indices.  The head      */
+/*  carries a tag that changes on every push and pop, so a stale        */
+/*  compare-and-swap cannot succeed after the same chunk went out and   */
+/*  came back (ABA).  Any thread may allocate and release.              */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*                                                                      */
+/************************************************************************/
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "ec_serial.h"
+#include "ec_serial_priv.h"
+#include "ec_ring.h"
+#include "ec_buf.h"
+
+/* ------------------------------------------------------------ */
+/*              Local Type Definitions                          */
+/* ------------------------------------------------------------ */
+
+#define SERIAL_BUF_CHUNK_MAX    (16u << 20)     // reads take a uint32_t length
+
+// a free list head: tag in the high half, chunk index + 1 in the low, 0 is empty
+#define FREE_TAG(ull)       ((ull) >> 32)
+#define FREE_LINK(ull)      ((uint32_t)(ull))
+#define FREE_HEAD(tag, link) (((uint64_t)(tag) << 32) | (link))
+
+struct SERIAL_CHUNK {
+    // own cache line, views on different threads bump it
+    _Alignas(SERIAL_CACHE_LINE) _Atomic uint32_t cRefs;
+    _Atomic uint32_t                            ilinkNext;  // free list, index + 1
+    SERIAL_BUF_POOL                             *ppool;
+    uint8_t                                     *pb;
+};
+
+struct SERIAL_BUF_POOL {
+    _Alignas(SERIAL_CACHE_LINE) _Atomic uint64_t ullFree;
+    // chunks handed out, plus one until SerialBufPoolDestroy()
+    _Alignas(SERIAL_CACHE_LINE) _Atomic uint32_t cLive;
+    _Atomic uint64_t                            cAllocFails;
+    // read only after create
+    _Alignas(SERIAL_CACHE_LINE) size_t          cbChunk;
+    uint32_t                                    cChunks;
+    SERIAL_CHUNK                                *rgchunk;
+    uint8_t                                     *rgbArena;
+};
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static SERIAL_CHUNK *ChunkPop( SERIAL_BUF_POOL *ppool );
+static void     ChunkPush( SERIAL_BUF_POOL *ppool, SERIAL_CHUNK *pchunk );
+static void     PoolUnref( SERIAL_BUF_POOL *ppool );
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    SerialBufPoolCreate
+**
+**  Synopsis:
+**      SERIAL_BUF_POOL *SerialBufPoolCreate(size_t cbChunk, uint32_t cChunks)
+**
+**  Parameters:
+**      cbChunk         bytes per chunk, the most one read delivers
+**      cChunks         number of chunks, the most views can pin at once
+**
+**  Return Values:
+**      new pool, NULL on failure with errno set
+**
+**  Errors:
+**      EINVAL if either size is 0 or cbChunk is over 16 MB
+**      ENOMEM
+**
+**  Description:
+**      Allocates every chunk up front in one cache line aligned arena.
+**      Size the pool for the chunks consumers may hold on to at the
+**      same time plus the one being read into.
+*/
+SERIAL_BUF_POOL *SerialBufPoolCreate(size_t cbChunk, uint32_t cChunks) {
+
+    SERIAL_BUF_POOL *ppool;
+    size_t          cbStride;
+    uint32_t        ichunk;
+
+    if ( (cbChunk == 0) || (cbChunk > SERIAL_BUF_CHUNK_MAX) ||
+         (cChunks == 0) || (cChunks == UINT32_MAX) ) {
+        errno = EINVAL;
+        return NULL;
+    }
+    cbStride = (cbChunk + SERIAL_CACHE_LINE - 1) & ~(size_t)(SERIAL_CACHE_LINE - 1);
+
+    ppool = aligned_alloc(SERIAL_CACHE_LINE, sizeof(SERIAL_BUF_POOL));
+    if ( ppool == NULL ) {
+        return NULL;
+    }
+    memset(ppool, 0, sizeof(*ppool));
+    ppool->rgchunk = aligned_alloc(SERIAL_CACHE_LINE, cChunks * sizeof(SERIAL_CHUNK));
+    ppool->rgbArena = aligned_alloc(SERIAL_CACHE_LINE, cChunks * cbStride);
+    if ( (ppool->rgchunk == NULL) || (ppool->rgbArena == NULL) ) {
+        free(ppool->rgchunk);
+        free(ppool->rgbArena);
+        free(ppool);
+        errno = ENOMEM;
+        return NULL;
+    }
+    ppool->cbChunk = cbChunk;
+    ppool->cChunks = cChunks;
+
+    // chain every chunk in index order, chunk 0 on top
+    for ( ichunk = 0; ichunk < cChunks; ichunk++ ) {
+        atomic_init(&ppool->rgchunk[ichunk].cRefs, 0);
+        atomic_init(&ppool->rgchunk[ichunk].ilinkNext, ( ichunk + 1 < cChunks ) ? ichunk + 2 : 0);
+        ppool->rgchunk[ichunk].ppool = ppool;
+        ppool->rgchunk[ichunk].pb = ppool->rgbArena + ichunk * cbStride;
+    }
+    atomic_init(&ppool->ullFree, FREE_HEAD(0, 1));
+    atomic_init(&ppool->cLive, 1);
+    atomic_init(&ppool->cAllocFails, 0);
+    return ppool;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialBufPoolDestroy
+**
+**  Synopsis:
+**      void SerialBufPoolDestroy(SERIAL_BUF_POOL *ppool)
+**
+**  Description:
+**      Gives up the creator's hold on the pool.  Views still out keep
+**      it alive, the memory goes when the last of them is released.
+**      Nothing may be allocated from the pool after this.
+*/
+void SerialBufPoolDestroy(SERIAL_BUF_POOL *ppool) {
+
+    if ( ppool != NULL ) {
+        PoolUnref(ppool);
+    }
+}
+
+void SerialBufPoolGetStats(SERIAL_BUF_POOL *ppool, SERIAL_BUF_POOL_STATS *pstats) {
+
+    uint32_t cLive = atomic_load_explicit(&ppool->cLive, memory_order_relaxed);
+
+    pstats->cbChunk = ppool->cbChunk;
+    pstats->cChunks = ppool->cChunks;
+    pstats->cFree = ppool->cChunks - ( (cLive > 0) ? cLive - 1 : 0 );
+    pstats->cAllocFails = atomic_load_explicit(&ppool->cAllocFails, memory_order_relaxed);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialBufAlloc
+**
+**  Synopsis:
+**      bool SerialBufAlloc(SERIAL_BUF_POOL *ppool, SERIAL_BUF *pbuf,
+**                          uint8_t **ppbWrite)
+**
+**  Parameters:
+**      *ppool          pool to take a chunk from
+**      *pbuf           receives a view of the whole chunk, one reference
+**      **ppbWrite      receives a writable pointer to the chunk
+**
+**  Return Values:
+**      true on success
+**      false if every chunk is in use
+**
+**  Errors:
+**      ENOBUFS if every chunk is in use
+**
+**  Description:
+**      For producers other than SerialPortReadChunk(): fill the chunk
+**      through *ppbWrite, then trim pbuf->cb to what was written before
+**      handing the view on.
+*/
+bool SerialBufAlloc(SERIAL_BUF_POOL *ppool, SERIAL_BUF *pbuf, uint8_t **ppbWrite) {
+
+    SERIAL_CHUNK    *pchunk;
+
+    pchunk = ChunkPop(ppool);
+    if ( pchunk == NULL ) {
+        atomic_fetch_add_explicit(&ppool->cAllocFails, 1, memory_order_relaxed);
+        pbuf->pchunk = NULL;
+        pbuf->pb = NULL;
+        pbuf->cb = 0;
+        errno = ENOBUFS;
+        return false;
+    }
+    atomic_fetch_add_explicit(&ppool->cLive, 1, memory_order_relaxed);
+    atomic_store_explicit(&pchunk->cRefs, 1, memory_order_relaxed);
+
+    pbuf->pchunk = pchunk;
+    pbuf->pb = pchunk->pb;
+    pbuf->cb = ppool->cbChunk;
+    *ppbWrite = pchunk->pb;
+    return true;
+}
+
+/* Adds a reference for a copy of *pbuf, which then needs its own release. */
+void SerialBufRef(const SERIAL_BUF *pbuf) {
+
+    if ( pbuf->pchunk != NULL ) {
+        atomic_fetch_add_explicit(&pbuf->pchunk->cRefs, 1, memory_order_relaxed);
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialBufSlice
+**
+**  Synopsis:
+**      bool SerialBufSlice(const SERIAL_BUF *pbuf, const uint8_t *pb,
+**                          size_t cb, SERIAL_BUF *pbufSlice)
+**
+**  Parameters:
+**      *pbuf           view to slice
+**      *pb             first byte of the slice, inside pbuf
+**      cb              length of the slice
+**      *pbufSlice      receives the new view, one reference of its own
+**
+**  Return Values:
+**      true on success
+**      false if pb/cb is not inside pbuf, *pbufSlice is then empty
+**
+**  Errors:
+**      ERANGE if pb/cb is not inside pbuf
+**
+**  Description:
+**      Takes pointers rather than offsets so the result of a parser that
+**      works in place can be sliced directly.  A frame that
+**      SerialFramerNext() returned inside the chunk it was pushed from
+**      becomes its own view, while one it had to reassemble across
+**      chunks fails with ERANGE and has to be copied.
+*/
+bool SerialBufSlice(const SERIAL_BUF *pbuf, const uint8_t *pb, size_t cb, SERIAL_BUF *pbufSlice) {
+
+    if ( (pbuf->pchunk == NULL) || (pb < pbuf->pb) || (pb > pbuf->pb + pbuf->cb) ||
+         (cb > (size_t)(pbuf->pb + pbuf->cb - pb)) ) {
+        pbufSlice->pchunk = NULL;
+        pbufSlice->pb = NULL;
+        pbufSlice->cb = 0;
+        errno = ERANGE;
+        return false;
+    }
+    SerialBufRef(pbuf);
+    pbufSlice->pchunk = pbuf->pchunk;
+    pbufSlice->pb = pb;
+    pbufSlice->cb = cb;
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialBufRelease
+**
+**  Synopsis:
+**      void SerialBufRelease(SERIAL_BUF *pbuf)
+**
+**  Description:
+**      Drops the view's reference and empties it.  The last reference
+**      puts the chunk back on the free list.  Safe on an empty view.
+*/
+void SerialBufRelease(SERIAL_BUF *pbuf) {
+
+    SERIAL_CHUNK    *pchunk = pbuf->pchunk;
+    SERIAL_BUF_POOL *ppool;
+
+    pbuf->pchunk = NULL;
+    pbuf->pb = NULL;
+    pbuf->cb = 0;
+    if ( pchunk == NULL ) {
+        return;
+    }
+
+    // a sole holder cannot race anyone, only a view can add a reference
+    if ( (atomic_load_explicit(&pchunk->cRefs, memory_order_acquire) == 1) ||
+         (atomic_fetch_sub_explicit(&pchunk->cRefs, 1, memory_order_release) == 1) ) {
+        // every other holder's reads of the chunk happen before its reuse
+        atomic_thread_fence(memory_order_acquire);
+        ppool = pchunk->ppool;
+        ChunkPush(ppool, pchunk);
+        PoolUnref(ppool);
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortReadChunk
+**
+**  Synopsis:
+**      int SerialPortReadChunk(SERIAL_PORT *port, SERIAL_BUF_POOL *ppool,
+**                              SERIAL_BUF *pbuf, uint32_t minLen,
+**                              uint32_t timeOutMs, uint32_t interByteUs)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      *ppool          pool the chunk comes from
+**      *pbuf           receives a view of the data read, one reference
+**      minLen, timeOutMs, interByteUs
+**                      as for SerialPortReadEx(), with len the chunk size
+**
+**  Return Values:
+**      number of bytes in *pbuf
+**      -1 (SERIAL_ERROR_CODE) on error, *pbuf is empty
+**      -2 (SERIAL_TIMEOUT_CODE) if the deadline expired before any data
+**
+**  Errors:
+**      ENOBUFS if the pool has no free chunk, otherwise as for
+**      SerialPortReadEx()
+**
+**  Description:
+**      SerialPortReadEx() into a pool chunk, so the driver's read() is
+**      the only copy the data sees on the direct path.  With the RX
+**      thread running the bytes are copied once out of its ring, and
+**      on the io_uring backend once out of the registered buffer.
+*/
+int SerialPortReadChunk(SERIAL_PORT *port, SERIAL_BUF_POOL *ppool, SERIAL_BUF *pbuf,
+                        uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs) {
+
+    uint8_t     *pbWrite;
+    int         rc;
+
+    if ( !SerialBufAlloc(ppool, pbuf, &pbWrite) ) {
+        SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL buffer pool empty on %s", port->szDevice);
+        return SERIAL_ERROR_CODE;
+    }
+
+    rc = SerialPortReadEx(port, pbWrite, (uint32_t)ppool->cbChunk, minLen, timeOutMs, interByteUs);
+    if ( rc <= 0 ) {
+        SerialBufRelease(pbuf);
+        return rc;
+    }
+    pbuf->cb = rc;
+    return rc;
+}
+
+/* ------------------------------------------------------------ */
+/***    ChunkPop
+**
+**  Synopsis:
+**      SERIAL_CHUNK *ChunkPop(SERIAL_BUF_POOL *ppool)
+**
+**  Description:
+**      Takes the top chunk off the free list, NULL if it is empty.  The
+**      link read from a chunk another thread popped meanwhile may be
+**      stale, but then the tag has moved on and the swap fails.
+*/
+static SERIAL_CHUNK *ChunkPop(SERIAL_BUF_POOL *ppool) {
+
+    uint64_t    ullOld;
+    uint64_t    ullNew;
+    uint32_t    ilink;
+    uint32_t    ilinkNext;
+
+    ullOld = atomic_load_explicit(&ppool->ullFree, memory_order_acquire);
+    do {
+        ilink = FREE_LINK(ullOld);
+        if ( ilink == 0 ) {
+            return NULL;
+        }
+        ilinkNext = atomic_load_explicit(&ppool->rgchunk[ilink - 1].ilinkNext, memory_order_relaxed);
+        ullNew = FREE_HEAD(FREE_TAG(ullOld) + 1, ilinkNext);
+    } while ( !atomic_compare_exchange_weak_explicit(&ppool->ullFree, &ullOld, ullNew,
+                                                     memory_order_acquire, memory_order_acquire) );
+
+    return &ppool->rgchunk[ilink - 1];
+}
+
+static void ChunkPush(SERIAL_BUF_POOL *ppool, SERIAL_CHUNK *pchunk) {
+
+    uint64_t    ullOld;
+    uint64_t    ullNew;
+    uint32_t    ilink = (uint32_t)(pchunk - ppool->rgchunk) + 1;
+
+    ullOld = atomic_load_explicit(&ppool->ullFree, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&pchunk->ilinkNext, FREE_LINK(ullOld), memory_order_relaxed);
+        ullNew = FREE_HEAD(FREE_TAG(ullOld) + 1, ilink);
+    } while ( !atomic_compare_exchange_weak_explicit(&ppool->ullFree, &ullOld, ullNew,
+                                                     memory_order_release, memory_order_relaxed) );
+}
+
+/* Drops one hold on the pool, the last one frees it. */
+static void PoolUnref(SERIAL_BUF_POOL *ppool) {
+
+    if ( atomic_fetch_sub_explicit(&ppool->cLive, 1, memory_order_acq_rel) == 1 ) {
+        free(ppool->rgbArena);
+        free(ppool->rgchunk);
+        free(ppool);
+    }
+}
+
+
+/************************************ EOF ********************************/
@@ -0,0 +1,97 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_buf.h --  EmbedCreativity's Serial buffer pool header file       */
+/*                                                                      */
+/************************************************************************/
+/*  Author:     agent                                                   */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*  This header file contains declarations the functions contained in   */
+/*  ec_buf.c                                                            */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026(agent): created                                          */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(_SERIALBUF_H)
+#define _SERIALBUF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ec_serial.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------------ */
+/*                  Object Class Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef struct SERIAL_BUF_POOL SERIAL_BUF_POOL;
+typedef struct SERIAL_CHUNK SERIAL_CHUNK;
+
+/* ------------------------------------------------------------ */
+/*                  General Type Declarations                   */
+/* ------------------------------------------------------------ */
+
+// A counted view of part of a pool chunk.  Copy it with SerialBufRef()
+// or SerialBufSlice(), give it up with SerialBufRelease().
+typedef struct {
+    SERIAL_CHUNK        *pchunk;        // NULL for an empty view
+    const uint8_t       *pb;
+    size_t              cb;
+} SERIAL_BUF;
+
+typedef struct {
+    size_t              cbChunk;
+    uint32_t            cChunks;
+    uint32_t            cFree;          // chunks in the pool right now
+    uint64_t            cAllocFails;    // allocations that found the pool empty
+} SERIAL_BUF_POOL_STATS;
+
+/* ------------------------------------------------------------ */
+/*                  Function Prototypes                         */
+/* ------------------------------------------------------------ */
+
+SERIAL_BUF_POOL *SerialBufPoolCreate(size_t cbChunk, uint32_t cChunks);
+void    SerialBufPoolDestroy(SERIAL_BUF_POOL *ppool);
+void    SerialBufPoolGetStats(SERIAL_BUF_POOL *ppool, SERIAL_BUF_POOL_STATS *pstats);
+bool    SerialBufAlloc(SERIAL_BUF_POOL *ppool, SERIAL_BUF *pbuf, uint8_t **ppbWrite);
+void    SerialBufRef(const SERIAL_BUF *pbuf);
+bool    SerialBufSlice(const SERIAL_BUF *pbuf, const uint8_t *pb, size_t cb, SERIAL_BUF *pbufSlice);
+void    SerialBufRelease(SERIAL_BUF *pbuf);
+int     SerialPortReadChunk(SERIAL_PORT *port, SERIAL_BUF_POOL *ppool, SERIAL_BUF *pbuf,
+                            uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs);
+/* ------------------------------------------------------------ */
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+
+/**********************************  EOF  **************************************/
@@ -0,0 +1,1074 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_capture.c --  EmbedCreativity's traffic capture and replay       */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  SerialPortCaptureStart() records every chunk a port reads or        */
+/*  writes, whichever path moved it, into a file with a monotonic       */
+/*  timestamp and a direction.  The paths hand their chunks over after  */
+/*  the system call; while no capture runs that costs one relaxed load  */
+/*  per chunk.  Records are gathered into a buffer under a mutex and    */
+/*  reach the file in large write()s, so the I/O threads never wait on  */
+/*  the disk for more than one flush.                                   */
+/*                                                                      */
+/*  A replay plays the received side of a capture back through a        */
+/*  pseudo-terminal.  The application opens the pty's name instead of   */
+/*  the device and sees the same bytes, in the same chunks, at the      */
+/*  original pace or any multiple of it.  What the application sends    */
+/*  is read and counted, and can gate the next chunk the way the real   */
+/*  device waited for a request.  Load tests then run offline, without  */
+/*  the hardware, as fast as the application can take the data.         */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*                                                                      */
+/************************************************************************/
+
+#define _GNU_SOURCE  /* ppoll, posix_openpt, ptsname_r */
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+
+#include "ec_serial.h"
+#include "ec_serial_priv.h"
+#include "ec_capture.h"
+
+/* ------------------------------------------------------------ */
+/*              Local Type Definitions                          */
+/* ------------------------------------------------------------ */
+
+#define CAPTURE_BUF         (64 * 1024)     // records gathered per write()
+#define REPLAY_IOV_BATCH    64              // due records handed to one writev()
+#define REPLAY_POLL_NS      10000000        // re-check a full pty this often
+#define CB_PAD(cb)          (((cb) + SERIAL_CAPTURE_ALIGN - 1) & ~(size_t)(SERIAL_CAPTURE_ALIGN - 1))
+
+_Static_assert(sizeof(SERIAL_CAPTURE_FILE_HDR) == 64, "capture file header layout");
+_Static_assert(sizeof(SERIAL_CAPTURE_REC_HDR) == SERIAL_CAPTURE_ALIGN, "capture record layout");
+
+// A running capture, hung off port->pcapw and guarded by port->mtxCapture
+struct CAPTURE_WRITER {
+    int         fd;
+    uint64_t    nsStart;        // MonoNowNs() at the start, record times count from here
+    int         errWrite;       // first write() error, recording stopped there
+    size_t      cbBuf;
+    uint8_t     rgbBuf[CAPTURE_BUF];
+};
+
+struct SERIAL_CAPTURE {
+    const uint8_t   *pbMap;     // the whole file, read only
+    size_t          cbMap;
+    size_t          ibFirst;    // first record
+    size_t          ibNext;     // record SerialCaptureNext() returns next
+};
+
+struct SERIAL_REPLAY {
+    SERIAL_CAPTURE      *pcap;
+    SERIAL_REPLAY_CFG   cfg;
+    int                 fdMaster;       // non-blocking, the replay's side
+    int                 fdSlave;        // held open so the pty outlives the application's opens
+    int                 evtStop;        // eventfd, stops the replay thread
+    int                 evtDone;        // eventfd, readable once the thread has finished
+    pthread_t           thread;
+    bool                fStarted;
+    uint64_t            nsStart;
+    _Atomic uint64_t    nsEnd;
+    _Atomic uint64_t    cbRx;
+    _Atomic uint64_t    cbTx;
+    _Atomic uint64_t    cTxTimeouts;
+    _Atomic uint64_t    nsLateMax;
+    _Atomic bool        fDone;
+    char                szPty[64];
+    uint8_t             rgbDrain[4096];
+};
+
+/* ------------------------------------------------------------ */
+/*              Local Variables                                 */
+/* ------------------------------------------------------------ */
+
+static const uint8_t rgbZero[SERIAL_CAPTURE_ALIGN];
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static void     CaptureAppend( SERIAL_PORT *port, struct CAPTURE_WRITER *pcw, const void *pv, size_t cb );
+static bool     CaptureFlush( SERIAL_PORT *port, struct CAPTURE_WRITER *pcw );
+static bool     WriteAll( int fd, const void *pv, size_t cb );
+static void     *ReplayThread( void *pv );
+static bool     ReplayWait( SERIAL_REPLAY *prp, uint64_t nsDeadline, bool fOut );
+static bool     ReplayWrite( SERIAL_REPLAY *prp, struct iovec *rgiov, int ciov );
+static void     ReplayDrain( SERIAL_REPLAY *prp );
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    SerialPortCaptureStart
+**
+**  Synopsis:
+**      bool SerialPortCaptureStart(SERIAL_PORT *port, const char *szPath)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      szPath          file to record into, replaced if it exists
+**
+**  Return Values:
+**      1               success
+**      0               failure, nothing is being recorded
+**
+**  Errors:
+**      EBUSY if a capture is already running on the port, otherwise
+**      errno from malloc(), open() or write()
+**
+**  Description:
+**      From now on every chunk the port receives or sends is appended
+**      to szPath, on the direct read path, the RX thread, io_uring, a
+**      reactor or a shared memory broker alike.  Data lands in the file
+**      in 64 KB writes, SerialPortCaptureFlush() pushes out the rest.
+**      Record times count from this call.
+*/
+bool SerialPortCaptureStart(SERIAL_PORT *port, const char *szPath) {
+
+    struct CAPTURE_WRITER   *pcw;
+    SERIAL_CAPTURE_FILE_HDR hdr;
+    struct timespec         ts;
+    size_t                  cbDevice;
+    int                     baudRate;
+    int                     errnoSave;
+
+    pcw = malloc(sizeof(*pcw));
+    if ( pcw == NULL ) {
+        return false;
+    }
+    pcw->cbBuf = 0;
+    pcw->errWrite = 0;
+    pcw->fd = open(szPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if ( pcw->fd < 0 ) {
+        goto lErrFree;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.rgchMagic, SERIAL_CAPTURE_MAGIC, sizeof(hdr.rgchMagic));
+    hdr.version = SERIAL_CAPTURE_VERSION;
+    hdr.cbHeader = sizeof(hdr);
+    clock_gettime(CLOCK_REALTIME, &ts);
+    hdr.nsRealStart = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    baudRate = SerialPortGetBaud(port);
+    hdr.baudRate = ( baudRate > 0 ) ? baudRate : port->baudRate;
+    cbDevice = strlen(port->szDevice);
+    if ( cbDevice >= sizeof(hdr.szDevice) ) {
+        cbDevice = sizeof(hdr.szDevice) - 1;    // long by-id paths keep their start
+    }
+    memcpy(hdr.szDevice, port->szDevice, cbDevice);
+    if ( !WriteAll(pcw->fd, &hdr, sizeof(hdr)) ) {
+        goto lErrClose;
+    }
+
+    pthread_mutex_lock(&port->mtxCapture);
+    if ( port->pcapw != NULL ) {
+        pthread_mutex_unlock(&port->mtxCapture);
+        errno = EBUSY;
+        goto lErrClose;
+    }
+    pcw->nsStart = MonoNowNs();
+    port->pcapw = pcw;
+    atomic_store_explicit(&port->fCapture, true, memory_order_relaxed);
+    pthread_mutex_unlock(&port->mtxCapture);
+
+    SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL %s: capturing to %s", port->szDevice, szPath);
+    return true;
+
+lErrClose:
+    errnoSave = errno;
+    close(pcw->fd);
+    errno = errnoSave;
+lErrFree:
+    errnoSave = errno;
+    free(pcw);
+    errno = errnoSave;
+    return false;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortCaptureFlush
+**
+**  Synopsis:
+**      bool SerialPortCaptureFlush(SERIAL_PORT *port)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**
+**  Return Values:
+**      1               everything recorded so far is in the file
+**      0               failure
+**
+**  Errors:
+**      EINVAL if no capture is running, otherwise the errno of the
+**      write() that failed, which also ended the recording
+*/
+bool SerialPortCaptureFlush(SERIAL_PORT *port) {
+
+    struct CAPTURE_WRITER   *pcw;
+    bool                    fSuccess;
+
+    pthread_mutex_lock(&port->mtxCapture);
+    pcw = port->pcapw;
+    if ( pcw == NULL ) {
+        errno = EINVAL;
+        fSuccess = false;
+    } else {
+        fSuccess = CaptureFlush(port, pcw);
+    }
+    pthread_mutex_unlock(&port->mtxCapture);
+    return fSuccess;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortCaptureStop
+**
+**  Synopsis:
+**      bool SerialPortCaptureStop(SERIAL_PORT *port)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**
+**  Return Values:
+**      1               success, or no capture was running
+**      0               some of the recording was lost
+**
+**  Errors:
+**      errno from write() or close()
+**
+**  Description:
+**      Flushes and closes the file.  SerialPortClose() does this too.
+*/
+bool SerialPortCaptureStop(SERIAL_PORT *port) {
+
+    struct CAPTURE_WRITER   *pcw;
+    bool                    fSuccess;
+    int                     errnoSave;
+
+    atomic_store_explicit(&port->fCapture, false, memory_order_relaxed);
+    pthread_mutex_lock(&port->mtxCapture);
+    pcw = port->pcapw;
+    port->pcapw = NULL;
+    pthread_mutex_unlock(&port->mtxCapture);
+    if ( pcw == NULL ) {
+        return true;
+    }
+
+    fSuccess = CaptureFlush(port, pcw);
+    errnoSave = errno;
+    if ( (close(pcw->fd) != 0) && fSuccess ) {
+        fSuccess = false;
+        errnoSave = errno;
+    }
+    free(pcw);
+    errno = errnoSave;
+    return fSuccess;
+}
+
+/* ------------------------------------------------------------ */
+/***    CaptureAddV
+**
+**  Synopsis:
+**      void CaptureAddV(SERIAL_PORT *port, SERIAL_CAPTURE_DIR dir,
+**                       const struct iovec *rgiov, int ciov, size_t cb)
+**
+**  Parameters:
+**      *port           port the data crossed
+**      dir             SERIAL_CAPTURE_RX or SERIAL_CAPTURE_TX
+**      *rgiov          where the data is, may describe more than cb
+**      ciov            number of entries in rgiov
+**      cb              bytes to record
+**
+**  Description:
+**      Appends one record.  Called through CAPTURE_DATA()/CAPTURE_DATAV()
+**      from the I/O paths, which skip the call while no capture runs.
+*/
+void CaptureAddV(SERIAL_PORT *port, SERIAL_CAPTURE_DIR dir,
+                 const struct iovec *rgiov, int ciov, size_t cb) {
+
+    struct CAPTURE_WRITER   *pcw;
+    SERIAL_CAPTURE_REC_HDR  hdr;
+    size_t                  cbLeft;
+    size_t                  cbPart;
+    int                     iiov;
+
+    if ( cb == 0 ) {
+        return;
+    }
+    pthread_mutex_lock(&port->mtxCapture);
+    pcw = port->pcapw;
+    if ( (pcw != NULL) && (pcw->errWrite == 0) ) {
+        // stamped under the lock, so times never go backwards in the file
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.ns = MonoNowNs() - pcw->nsStart;
+        hdr.cb = (uint32_t)cb;
+        hdr.dir = (uint8_t)dir;
+        CaptureAppend(port, pcw, &hdr, sizeof(hdr));
+        for ( iiov = 0, cbLeft = cb; (iiov < ciov) && (cbLeft > 0); iiov++ ) {
+            cbPart = ( rgiov[iiov].iov_len < cbLeft ) ? rgiov[iiov].iov_len : cbLeft;
+            CaptureAppend(port, pcw, rgiov[iiov].iov_base, cbPart);
+            cbLeft -= cbPart;
+        }
+        CaptureAppend(port, pcw, rgbZero, CB_PAD(cb) - cb);
+    }
+    pthread_mutex_unlock(&port->mtxCapture);
+}
+
+/* ------------------------------------------------------------ */
+/***    CapturePortFree
+**
+**  Synopsis:
+**      void CapturePortFree(SERIAL_PORT *port)
+**
+**  Description:
+**      Ends a capture that is still running and releases the lock set
+**      up by SerialPortOpen().  Called by SerialPortClose() once no
+**      I/O path can record any more.
+*/
+void CapturePortFree(SERIAL_PORT *port) {
+
+    if ( !SerialPortCaptureStop(port) ) {
+        SERIAL_LOG(SERIAL_LOG_WARN, "SERIAL %s: capture incomplete, %s",
+                   port->szDevice, strerror(errno));
+    }
+    pthread_mutex_destroy(&port->mtxCapture);
+}
+
+/* Copies into the buffer, writing it out whenever it fills. */
+static void CaptureAppend(SERIAL_PORT *port, struct CAPTURE_WRITER *pcw, const void *pv, size_t cb) {
+
+    const uint8_t   *pb = pv;
+    size_t          cbPart;
+
+    while ( cb > 0 ) {
+        if ( (pcw->cbBuf == CAPTURE_BUF) && !CaptureFlush(port, pcw) ) {
+            return;
+        }
+        cbPart = CAPTURE_BUF - pcw->cbBuf;
+        if ( cbPart > cb ) {
+            cbPart = cb;
+        }
+        memcpy(pcw->rgbBuf + pcw->cbBuf, pb, cbPart);
+        pcw->cbBuf += cbPart;
+        pb += cbPart;
+        cb -= cbPart;
+    }
+}
+
+/* Writes the buffer out.  A failure ends the recording, the file then
+   holds everything up to the last whole record that made it. */
+static bool CaptureFlush(SERIAL_PORT *port, struct CAPTURE_WRITER *pcw) {
+
+    if ( pcw->errWrite != 0 ) {
+        errno = pcw->errWrite;
+        return false;
+    }
+    if ( !WriteAll(pcw->fd, pcw->rgbBuf, pcw->cbBuf) ) {
+        pcw->errWrite = errno;
+        atomic_store_explicit(&port->fCapture, false, memory_order_relaxed);
+        SERIAL_LOG(SERIAL_LOG_WARN, "SERIAL %s: capture stopped, %s",
+                   port->szDevice, strerror(errno));
+        return false;
+    }
+    pcw->cbBuf = 0;
+    return true;
+}
+
+static bool WriteAll(int fd, const void *pv, size_t cb) {
+
+    const uint8_t   *pb = pv;
+    ssize_t         cbWritten;
+
+    while ( cb > 0 ) {
+        cbWritten = write(fd, pb, cb);
+        if ( cbWritten < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            return false;
+        }
+        pb += cbWritten;
+        cb -= cbWritten;
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialCaptureOpen
+**
+**  Synopsis:
+**      SERIAL_CAPTURE *SerialCaptureOpen(const char *szPath)
+**
+**  Parameters:
+**      szPath          file written by SerialPortCaptureStart()
+**
+**  Return Values:
+**      handle positioned at the first record, NULL on failure with
+**      errno set
+**
+**  Errors:
+**      EINVAL if the file is not a capture of a version this library
+**      reads, otherwise errno from open() or mmap()
+**
+**  Description:
+**      Maps the file read only.  Records are handed out in place, a
+**      capture of any size costs no more memory than the pages read.
+*/
+SERIAL_CAPTURE *SerialCaptureOpen(const char *szPath) {
+
+    SERIAL_CAPTURE          *pcap;
+    SERIAL_CAPTURE_FILE_HDR hdr;
+    struct stat             st;
+    void                    *pv;
+    int                     fd;
+    int                     errnoSave;
+
+    fd = open(szPath, O_RDONLY | O_CLOEXEC);
+    if ( fd < 0 ) {
+        return NULL;
+    }
+    if ( fstat(fd, &st) != 0 ) {
+        goto lErrClose;
+    }
+    if ( (size_t)st.st_size < sizeof(hdr) ) {
+        errno = EINVAL;
+        goto lErrClose;
+    }
+    pv = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if ( pv == MAP_FAILED ) {
+        goto lErrClose;
+    }
+    close(fd);
+
+    memcpy(&hdr, pv, sizeof(hdr));
+    if ( (memcmp(hdr.rgchMagic, SERIAL_CAPTURE_MAGIC, sizeof(hdr.rgchMagic)) != 0) ||
+         (hdr.version != SERIAL_CAPTURE_VERSION) || (hdr.cbHeader < sizeof(hdr)) ||
+         (hdr.cbHeader > (size_t)st.st_size) ) {
+        munmap(pv, st.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    pcap = malloc(sizeof(*pcap));
+    if ( pcap == NULL ) {
+        errnoSave = errno;
+        munmap(pv, st.st_size);
+        errno = errnoSave;
+        return NULL;
+    }
+    pcap->pbMap = pv;
+    pcap->cbMap = st.st_size;
+    pcap->ibFirst = hdr.cbHeader;
+    pcap->ibNext = hdr.cbHeader;
+    return pcap;
+
+lErrClose:
+    errnoSave = errno;
+    close(fd);
+    errno = errnoSave;
+    return NULL;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialCaptureClose
+**
+**  Synopsis:
+**      void SerialCaptureClose(SERIAL_CAPTURE *pcap)
+**
+**  Description:
+**      Unmaps the file.  Records handed out earlier are gone with it.
+*/
+void SerialCaptureClose(SERIAL_CAPTURE *pcap) {
+
+    if ( pcap == NULL ) {
+        return;
+    }
+    munmap((void *)pcap->pbMap, pcap->cbMap);
+    free(pcap);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialCaptureHeader
+**
+**  Synopsis:
+**      const SERIAL_CAPTURE_FILE_HDR *SerialCaptureHeader(SERIAL_CAPTURE *pcap)
+**
+**  Return Values:
+**      the file's header, valid until SerialCaptureClose()
+*/
+const SERIAL_CAPTURE_FILE_HDR *SerialCaptureHeader(SERIAL_CAPTURE *pcap) {
+
+    return (const SERIAL_CAPTURE_FILE_HDR *)pcap->pbMap;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialCaptureNext
+**
+**  Synopsis:
+**      bool SerialCaptureNext(SERIAL_CAPTURE *pcap, SERIAL_CAPTURE_REC *prec)
+**
+**  Parameters:
+**      *pcap           capture returned by SerialCaptureOpen()
+**      *prec           receives the record, data in place in the file
+**
+**  Return Values:
+**      1               *prec holds the next record
+**      0               no more whole records
+**
+**  Description:
+**      A capture cut short while it was written, by a crash or a full
+**      disk, ends at its last whole record.
+*/
+bool SerialCaptureNext(SERIAL_CAPTURE *pcap, SERIAL_CAPTURE_REC *prec) {
+
+    SERIAL_CAPTURE_REC_HDR  hdr;
+    size_t                  ibData;
+
+    if ( pcap->cbMap - pcap->ibNext < sizeof(hdr) ) {
+        return false;
+    }
+    memcpy(&hdr, pcap->pbMap + pcap->ibNext, sizeof(hdr));
+    ibData = pcap->ibNext + sizeof(hdr);
+    if ( pcap->cbMap - ibData < hdr.cb ) {
+        return false;
+    }
+
+    prec->ns = hdr.ns;
+    prec->dir = (SERIAL_CAPTURE_DIR)hdr.dir;
+    prec->pb = pcap->pbMap + ibData;
+    prec->cb = hdr.cb;
+    // the padding after the last record may be missing
+    pcap->ibNext = ibData + CB_PAD((size_t)hdr.cb);
+    if ( pcap->ibNext > pcap->cbMap ) {
+        pcap->ibNext = pcap->cbMap;
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialCaptureRewind
+**
+**  Synopsis:
+**      void SerialCaptureRewind(SERIAL_CAPTURE *pcap)
+**
+**  Description:
+**      The next SerialCaptureNext() returns the first record again.
+*/
+void SerialCaptureRewind(SERIAL_CAPTURE *pcap) {
+
+    pcap->ibNext = pcap->ibFirst;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialReplayCreate
+**
+**  Synopsis:
+**      SERIAL_REPLAY *SerialReplayCreate(SERIAL_CAPTURE *pcap,
+**                                        const SERIAL_REPLAY_CFG *pcfg)
+**
+**  Parameters:
+**      *pcap           capture to play, used by the replay until it is
+**                      destroyed
+**      *pcfg           speed and pacing, NULL for one pass at the
+**                      original speed
+**
+**  Return Values:
+**      new replay, NULL on failure with errno set
+**
+**  Errors:
+**      EINVAL for a negative speed, otherwise errno from the pty calls
+**
+**  Description:
+**      Creates a pseudo-terminal for the application to open in place
+**      of the device, see SerialReplayPtyName().  Nothing is played
+**      until SerialReplayStart().
+*/
+SERIAL_REPLAY *SerialReplayCreate(SERIAL_CAPTURE *pcap, const SERIAL_REPLAY_CFG *pcfg) {
+
+    SERIAL_REPLAY   *prp;
+    struct termios  options;
+    int             errnoSave;
+
+    if ( (pcfg != NULL) && !(pcfg->speed >= 0) ) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    prp = calloc(1, sizeof(*prp));
+    if ( prp == NULL ) {
+        return NULL;
+    }
+    prp->pcap = pcap;
+    if ( pcfg != NULL ) {
+        prp->cfg = *pcfg;
+    } else {
+        prp->cfg.speed = 1.0;
+    }
+    if ( prp->cfg.cLoops == 0 ) {
+        prp->cfg.cLoops = 1;
+    }
+    prp->fdSlave = -1;
+    prp->evtStop = -1;
+    prp->evtDone = -1;
+
+    prp->fdMaster = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if ( prp->fdMaster < 0 ) {
+        goto lErrFree;
+    }
+    if ( (grantpt(prp->fdMaster) != 0) || (unlockpt(prp->fdMaster) != 0) ||
+         (ptsname_r(prp->fdMaster, prp->szPty, sizeof(prp->szPty)) != 0) ) {
+        goto lErrClose;
+    }
+
+    // raw from the start, so nothing is echoed or translated before the
+    // application has set the line up
+    prp->fdSlave = open(prp->szPty, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if ( (prp->fdSlave < 0) || (tcgetattr(prp->fdSlave, &options) != 0) ) {
+        goto lErrClose;
+    }
+    cfmakeraw(&options);
+    if ( (tcsetattr(prp->fdSlave, TCSANOW, &options) != 0) ||
+         (fcntl(prp->fdMaster, F_SETFL, O_NONBLOCK) != 0) ) {
+        goto lErrClose;
+    }
+
+    prp->evtStop = eventfd(0, EFD_CLOEXEC);
+    prp->evtDone = eventfd(0, EFD_CLOEXEC);
+    if ( (prp->evtStop < 0) || (prp->evtDone < 0) ) {
+        goto lErrClose;
+    }
+    return prp;
+
+lErrClose:
+    errnoSave = errno;
+    if ( prp->evtDone >= 0 ) {
+        close(prp->evtDone);
+    }
+    if ( prp->evtStop >= 0 ) {
+        close(prp->evtStop);
+    }
+    if ( prp->fdSlave >= 0 ) {
+        close(prp->fdSlave);
+    }
+    close(prp->fdMaster);
+    errno = errnoSave;
+lErrFree:
+    errnoSave = errno;
+    free(prp);
+    errno = errnoSave;
+    return NULL;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialReplayPtyName
+**
+**  Synopsis:
+**      const char *SerialReplayPtyName(SERIAL_REPLAY *prp)
+**
+**  Return Values:
+**      device path to hand to SerialPortOpen() or SerialInit()
+*/
+const char *SerialReplayPtyName(SERIAL_REPLAY *prp) {
+
+    return prp->szPty;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialReplayStart
+**
+**  Synopsis:
+**      bool SerialReplayStart(SERIAL_REPLAY *prp)
+**
+**  Parameters:
+**      *prp            replay returned by SerialReplayCreate()
+**
+**  Return Values:
+**      1               success
+**      0               failure
+**
+**  Errors:
+**      EBUSY if already started, otherwise errno from pthread_create()
+**
+**  Description:
+**      Starts the thread that plays the capture.  Received records are
+**      written to the pty at their original times divided by the speed,
+**      records that fall due together go out in one writev().  The
+**      application can open the pty before or after this call; data it
+**      has not read yet waits in the pty.
+*/
+bool SerialReplayStart(SERIAL_REPLAY *prp) {
+
+    int err;
+
+    if ( prp->fStarted ) {
+        errno = EBUSY;
+        return false;
+    }
+    prp->nsStart = MonoNowNs();
+    err = pthread_create(&prp->thread, NULL, ReplayThread, prp);
+    if ( err != 0 ) {
+        errno = err;
+        return false;
+    }
+    prp->fStarted = true;
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialReplayWait
+**
+**  Synopsis:
+**      bool SerialReplayWait(SERIAL_REPLAY *prp, uint32_t timeOutMs)
+**
+**  Parameters:
+**      *prp            replay returned by SerialReplayCreate()
+**      timeOutMs       longest wait, SERIAL_WAIT_FOREVER never expires
+**
+**  Return Values:
+**      1               every pass has been played
+**      0               not yet
+**
+**  Errors:
+**      EINVAL if the replay was never started, ETIMEDOUT
+**
+**  Description:
+**      Played means written to the pty, the application may still have
+**      some of it to read.
+*/
+bool SerialReplayWait(SERIAL_REPLAY *prp, uint32_t timeOutMs) {
+
+    struct pollfd   pfd;
+    int             rc;
+
+    if ( !prp->fStarted ) {
+        errno = EINVAL;
+        return false;
+    }
+    pfd.fd = prp->evtDone;
+    pfd.events = POLLIN;
+    do {
+        rc = poll(&pfd, 1, ( timeOutMs == SERIAL_WAIT_FOREVER ) ? -1 : (int)timeOutMs);
+    } while ( (rc < 0) && (errno == EINTR) );
+    if ( rc <= 0 ) {
+        errno = ( rc == 0 ) ? ETIMEDOUT : errno;
+        return false;
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialReplayGetStats
+**
+**  Synopsis:
+**      void SerialReplayGetStats(SERIAL_REPLAY *prp, SERIAL_REPLAY_STATS *pstats)
+**
+**  Description:
+**      May be called while the replay runs.  nsLateMax is how far the
+**      replay fell behind the scaled capture, from the scheduler or a
+**      full pty; it stays 0 at unlimited speed.
+*/
+void SerialReplayGetStats(SERIAL_REPLAY *prp, SERIAL_REPLAY_STATS *pstats) {
+
+    uint64_t nsEnd;
+
+    pstats->cbRx = atomic_load_explicit(&prp->cbRx, memory_order_relaxed);
+    pstats->cbTx = atomic_load_explicit(&prp->cbTx, memory_order_relaxed);
+    pstats->cTxTimeouts = atomic_load_explicit(&prp->cTxTimeouts, memory_order_relaxed);
+    pstats->nsLateMax = atomic_load_explicit(&prp->nsLateMax, memory_order_relaxed);
+    pstats->fDone = atomic_load_explicit(&prp->fDone, memory_order_acquire);
+    nsEnd = atomic_load_explicit(&prp->nsEnd, memory_order_relaxed);
+    if ( !prp->fStarted ) {
+        pstats->nsElapsed = 0;
+    } else {
+        pstats->nsElapsed = (( pstats->fDone ) ? nsEnd : MonoNowNs()) - prp->nsStart;
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialReplayDestroy
+**
+**  Synopsis:
+**      void SerialReplayDestroy(SERIAL_REPLAY *prp)
+**
+**  Description:
+**      Stops the replay and removes the pty.  The application sees a
+**      hangup on its descriptor, so let it read what it needs first.
+**      The capture stays open.
+*/
+void SerialReplayDestroy(SERIAL_REPLAY *prp) {
+
+    uint64_t one = 1;
+
+    if ( prp == NULL ) {
+        return;
+    }
+    if ( prp->fStarted ) {
+        while ( (write(prp->evtStop, &one, sizeof(one)) < 0) && (errno == EINTR) ) {
+        }
+        pthread_join(prp->thread, NULL);
+    }
+    close(prp->evtDone);
+    close(prp->evtStop);
+    close(prp->fdSlave);
+    close(prp->fdMaster);
+    free(prp);
+}
+
+/* ------------------------------------------------------------ */
+/***    ReplayThread
+**
+**  Synopsis:
+**      void *ReplayThread(void *pv)
+**
+**  Parameters:
+**      *pv             the SERIAL_REPLAY
+**
+**  Description:
+**      Plays each received record at nsBase + (ns - ns0) / speed, where
+**      nsBase and ns0 anchor the capture's clock to ours.  Transmitted
+**      records only add to what the application owes.  With fWaitTx a
+**      received record waits until the application has sent that much,
+**      then the clock is anchored again at that record, so the device's
+**      think time is kept but not the original round trip.
+*/
+static void *ReplayThread(void *pv) {
+
+    SERIAL_REPLAY       *prp = pv;
+    SERIAL_CAPTURE      *pcap = prp->pcap;
+    SERIAL_CAPTURE_REC  rec;
+    struct iovec        rgiov[REPLAY_IOV_BATCH];
+    uint64_t            nsBase = 0;
+    uint64_t            ns0 = 0;
+    uint64_t            nsDue;
+    uint64_t            nsNow;
+    uint64_t            nsGiveUp;
+    uint64_t            cbTxOwed = 0;   // application bytes the capture has seen so far
+    uint64_t            cbTx;
+    size_t              ibMark;
+    size_t              cbBatch;
+    uint32_t            iLoop;
+    int                 ciov;
+    bool                fAnchored;
+    double              speed = prp->cfg.speed;
+    uint64_t            one = 1;
+
+#define DUE(ns) \
+    ( (speed == 0) ? 0 : nsBase + (uint64_t)((double)(((ns) > ns0) ? (ns) - ns0 : 0) / speed) )
+
+    for ( iLoop = 0; iLoop < prp->cfg.cLoops; iLoop++ ) {
+        SerialCaptureRewind(pcap);
+        fAnchored = false;
+
+        while ( SerialCaptureNext(pcap, &rec) ) {
+            if ( rec.dir == SERIAL_CAPTURE_TX ) {
+                cbTxOwed += rec.cb;
+                continue;
+            }
+            if ( (rec.dir != SERIAL_CAPTURE_RX) || (rec.cb == 0) ) {
+                continue;
+            }
+
+            if ( prp->cfg.fWaitTx &&
+                 (atomic_load_explicit(&prp->cbTx, memory_order_relaxed) < cbTxOwed) ) {
+                nsGiveUp = ( prp->cfg.msTxTimeout != 0 ) ?
+                           MonoNowNs() + (uint64_t)prp->cfg.msTxTimeout * 1000000 : UINT64_MAX;
+                while ( (cbTx = atomic_load_explicit(&prp->cbTx, memory_order_relaxed)) < cbTxOwed ) {
+                    if ( MonoNowNs() >= nsGiveUp ) {
+                        // forgive the missing bytes, or every later record would wait too
+                        STAT_ADD(prp->cTxTimeouts, 1);
+                        cbTxOwed = cbTx;
+                        break;
+                    }
+                    if ( !ReplayWait(prp, nsGiveUp, false) ) {
+                        goto lStop;
+                    }
+                }
+                fAnchored = false;
+            }
+            if ( !fAnchored ) {
+                nsBase = MonoNowNs();
+                ns0 = rec.ns;
+                fAnchored = true;
+            }
+
+            nsDue = DUE(rec.ns);
+            while ( (nsNow = MonoNowNs()) < nsDue ) {
+                if ( !ReplayWait(prp, nsDue, false) ) {
+                    goto lStop;
+                }
+            }
+            if ( (speed != 0) && (nsNow - nsDue > atomic_load_explicit(&prp->nsLateMax, memory_order_relaxed)) ) {
+                atomic_store_explicit(&prp->nsLateMax, nsNow - nsDue, memory_order_relaxed);
+            }
+
+            // everything else that is already due goes out in the same writev()
+            rgiov[0].iov_base = (void *)rec.pb;
+            rgiov[0].iov_len = rec.cb;
+            cbBatch = rec.cb;
+            ciov = 1;
+            while ( ciov < REPLAY_IOV_BATCH ) {
+                ibMark = pcap->ibNext;
+                if ( !SerialCaptureNext(pcap, &rec) ) {
+                    break;
+                }
+                if ( (rec.dir != SERIAL_CAPTURE_RX) || (DUE(rec.ns) > nsNow) ) {
+                    pcap->ibNext = ibMark;
+                    break;
+                }
+                rgiov[ciov].iov_base = (void *)rec.pb;
+                rgiov[ciov].iov_len = rec.cb;
+                cbBatch += rec.cb;
+                ciov++;
+            }
+            if ( !ReplayWrite(prp, rgiov, ciov) ) {
+                goto lStop;
+            }
+            STAT_ADD(prp->cbRx, cbBatch);
+            ReplayDrain(prp);
+        }
+    }
+#undef DUE
+
+lStop:
+    atomic_store_explicit(&prp->nsEnd, MonoNowNs(), memory_order_relaxed);
+    atomic_store_explicit(&prp->fDone, true, memory_order_release);
+    while ( (write(prp->evtDone, &one, sizeof(one)) < 0) && (errno == EINTR) ) {
+    }
+    return NULL;
+}
+
+/* Sleeps until nsDeadline, the stop eventfd, or, with fOut, room in the
+   pty, reading whatever the application sends meanwhile.  Returns false
+   once the replay has to stop. */
+static bool ReplayWait(SERIAL_REPLAY *prp, uint64_t nsDeadline, bool fOut) {
+
+    struct pollfd   rgpfd[2];
+    struct timespec ts;
+    uint64_t        nsNow;
+    uint64_t        nsWait;
+    int             rc;
+
+    rgpfd[0].fd = prp->fdMaster;
+    rgpfd[0].events = POLLIN | ( fOut ? POLLOUT : 0 );
+    rgpfd[1].fd = prp->evtStop;
+    rgpfd[1].events = POLLIN;
+
+    nsNow = MonoNowNs();
+    nsWait = ( nsDeadline > nsNow ) ? nsDeadline - nsNow : 0;
+    ts.tv_sec = nsWait / 1000000000;
+    ts.tv_nsec = nsWait % 1000000000;
+    rc = ppoll(rgpfd, 2, ( nsDeadline == UINT64_MAX ) ? NULL : &ts, NULL);
+    if ( rc < 0 ) {
+        return ( errno == EINTR );
+    }
+    if ( rgpfd[1].revents ) {
+        return false;
+    }
+    if ( rgpfd[0].revents & POLLIN ) {
+        ReplayDrain(prp);
+    }
+    return !(rgpfd[0].revents & (POLLERR | POLLNVAL));
+}
+
+/* Writes the whole batch, waiting while the pty is full.  rgiov is used
+   up in the process. */
+static bool ReplayWrite(SERIAL_REPLAY *prp, struct iovec *rgiov, int ciov) {
+
+    ssize_t cbWritten;
+
+    while ( ciov > 0 ) {
+        cbWritten = writev(prp->fdMaster, rgiov, ciov);
+        if ( cbWritten < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            if ( errno != EAGAIN ) {
+                SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL replay %s: write error %d %s",
+                           prp->szPty, errno, strerror(errno));
+                return false;
+            }
+            // POLLOUT on a pty master is not always raised, look again soon
+            if ( !ReplayWait(prp, MonoNowNs() + REPLAY_POLL_NS, true) ) {
+                return false;
+            }
+            continue;
+        }
+        while ( (ciov > 0) && ((size_t)cbWritten >= rgiov->iov_len) ) {
+            cbWritten -= rgiov->iov_len;
+            rgiov++;
+            ciov--;
+        }
+        if ( ciov > 0 ) {
+            rgiov->iov_base = (uint8_t *)rgiov->iov_base + cbWritten;
+            rgiov->iov_len -= cbWritten;
+        }
+    }
+    return true;
+}
+
+/* Reads and counts everything the application has sent. */
+static void ReplayDrain(SERIAL_REPLAY *prp) {
+
+    ssize_t cbRead;
+
+    for (;;) {
+        cbRead = read(prp->fdMaster, prp->rgbDrain, sizeof(prp->rgbDrain));
+        if ( cbRead > 0 ) {
+            STAT_ADD(prp->cbTx, cbRead);
+            continue;
+        }
+        if ( (cbRead < 0) && (errno == EINTR) ) {
+            continue;
+        }
+        return;
+    }
+}
+
+
+/************************************ EOF ********************************/
@@ -0,0 +1,151 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_capture.h --  EmbedCreativity's Serial capture header file       */
+/*                                                                      */
+/************************************************************************/
+/*  Author:     agent                                                   */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*  This header file contains declarations the functions contained in   */
+/*  ec_capture.c, and the capture file layout for other tools.          */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026(agent): created                                          */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(_SERIALCAPTURE_H)
+#define _SERIALCAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ec_serial.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------------ */
+/*                  Definitions                                 */
+/* ------------------------------------------------------------ */
+
+#define SERIAL_CAPTURE_MAGIC    "ECSERCAP"
+#define SERIAL_CAPTURE_VERSION  1
+#define SERIAL_CAPTURE_ALIGN    16      // every record starts on this boundary
+
+/* ------------------------------------------------------------ */
+/*                  General Type Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef enum {
+    SERIAL_CAPTURE_RX = 1,      // received from the device
+    SERIAL_CAPTURE_TX = 2       // sent to the device
+} SERIAL_CAPTURE_DIR;
+
+// A capture file is this header followed by records, each a
+// SERIAL_CAPTURE_REC_HDR and cb bytes of data padded with zeros to
+// SERIAL_CAPTURE_ALIGN.  Fields are in host byte order.  A file cut
+// short by a crash ends at the last whole record.
+typedef struct {
+    char        rgchMagic[8];       // SERIAL_CAPTURE_MAGIC, no terminator
+    uint32_t    version;            // SERIAL_CAPTURE_VERSION
+    uint32_t    cbHeader;           // the first record starts here
+    uint64_t    nsRealStart;        // CLOCK_REALTIME at the start, for reference
+    uint32_t    baudRate;
+    uint32_t    reserved;
+    char        szDevice[32];
+} SERIAL_CAPTURE_FILE_HDR;
+
+typedef struct {
+    uint64_t    ns;                 // CLOCK_MONOTONIC since the capture started
+    uint32_t    cb;                 // bytes of data that follow
+    uint8_t     dir;                // SERIAL_CAPTURE_DIR
+    uint8_t     rgbReserved[3];
+} SERIAL_CAPTURE_REC_HDR;
+
+// One record as returned by SerialCaptureNext(), pb points into the file.
+typedef struct {
+    uint64_t            ns;
+    SERIAL_CAPTURE_DIR  dir;
+    const uint8_t       *pb;
+    size_t              cb;
+} SERIAL_CAPTURE_REC;
+
+typedef struct {
+    double      speed;          // 1 original timing, 10 ten times faster, 0 as fast as possible
+    uint32_t    cLoops;         // passes through the capture, 0 for one
+    bool        fWaitTx;        // hold received data back until the application has sent
+                                // what was sent before it in the capture
+    uint32_t    msTxTimeout;    // fWaitTx: stop waiting after this, 0 never
+} SERIAL_REPLAY_CFG;
+
+typedef struct {
+    uint64_t    cbRx;           // played to the application
+    uint64_t    cbTx;           // received from the application
+    uint64_t    cTxTimeouts;    // fWaitTx waits that gave up
+    uint64_t    nsLateMax;      // furthest a write fell behind its scaled time
+    uint64_t    nsElapsed;      // since SerialReplayStart()
+    bool        fDone;
+} SERIAL_REPLAY_STATS;
+
+/* ------------------------------------------------------------ */
+/*                  Object Class Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef struct SERIAL_CAPTURE SERIAL_CAPTURE;
+typedef struct SERIAL_REPLAY SERIAL_REPLAY;
+
+/* ------------------------------------------------------------ */
+/*                  Function Prototypes                         */
+/* ------------------------------------------------------------ */
+
+// recording
+bool    SerialPortCaptureStart(SERIAL_PORT *port, const char *szPath);
+bool    SerialPortCaptureFlush(SERIAL_PORT *port);
+bool    SerialPortCaptureStop(SERIAL_PORT *port);
+
+// reading a capture
+SERIAL_CAPTURE *SerialCaptureOpen(const char *szPath);
+void    SerialCaptureClose(SERIAL_CAPTURE *pcap);
+const SERIAL_CAPTURE_FILE_HDR *SerialCaptureHeader(SERIAL_CAPTURE *pcap);
+bool    SerialCaptureNext(SERIAL_CAPTURE *pcap, SERIAL_CAPTURE_REC *prec);
+void    SerialCaptureRewind(SERIAL_CAPTURE *pcap);
+
+// replaying a capture through a pty
+SERIAL_REPLAY *SerialReplayCreate(SERIAL_CAPTURE *pcap, const SERIAL_REPLAY_CFG *pcfg);
+const char *SerialReplayPtyName(SERIAL_REPLAY *prp);
+bool    SerialReplayStart(SERIAL_REPLAY *prp);
+bool    SerialReplayWait(SERIAL_REPLAY *prp, uint32_t timeOutMs);
+void    SerialReplayGetStats(SERIAL_REPLAY *prp, SERIAL_REPLAY_STATS *pstats);
+void    SerialReplayDestroy(SERIAL_REPLAY *prp);
+/* ------------------------------------------------------------ */
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+
+/**********************************  EOF  **************************************/
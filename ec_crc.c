@@ -0,0 +1,631 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_crc.c --  EmbedCreativity's frame checksums                      */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  CRC-16/CCITT-FALSE, CRC-16/MODBUS and CRC-32, one shot or a piece   */
+/*  at a time.  The running value is the raw CRC register, so it can    */
+/*  be carried across calls and only SerialCrcFinal() applies the       */
+/*  output XOR.                                                         */
+/*                                                                      */
+/*  Every CRC has a byte at a time kernel, kept as the baseline, and a  */
+/*  slice-by-8 kernel that folds eight bytes per step through eight     */
+/*  tables.  CRC-32 also has a PCLMULQDQ folding kernel on x86-64 and   */
+/*  one on the ARMv8 CRC32 instructions.  The tables are built and the  */
+/*  fastest kernel the CPU supports is chosen on first use.  Neither    */
+/*  instruction set helps the 16 bit CRCs: the ARMv8 instructions are   */
+/*  fixed to the CRC-32 polynomials, so those stay on slice-by-8.       */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*                                                                      */
+/************************************************************************/
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#define _GNU_SOURCE  /* getauxval */
+
+#include <string.h>
+#include <endian.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CRC_HAVE_CLMUL
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__GNUC__)
+#define CRC_HAVE_ARMV8
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#if defined(__clang__)
+#define ARMV8_TARGET        __attribute__((target("crc")))
+#define ARMV8_CRC32B(crc, b) __builtin_arm_crc32b(crc, b)
+#define ARMV8_CRC32X(crc, v) __builtin_arm_crc32d(crc, v)
+#else
+#define ARMV8_TARGET        __attribute__((target("+crc")))
+#define ARMV8_CRC32B(crc, b) __builtin_aarch64_crc32b(crc, b)
+#define ARMV8_CRC32X(crc, v) __builtin_aarch64_crc32x(crc, v)
+#endif
+#endif
+
+#include "ec_crc.h"
+
+/* ------------------------------------------------------------ */
+/*              Local Type Definitions                          */
+/* ------------------------------------------------------------ */
+
+#define C_CRC_TYPES     (SERIAL_CRC32 + 1)
+
+typedef uint32_t (*CRC_FN)(const uint32_t rgT[8][256], uint32_t crc, const uint8_t *pb, size_t cb);
+
+typedef struct {
+    uint32_t    poly;           // bit reversed when fReflected
+    uint32_t    crcInit;
+    uint32_t    crcXorOut;
+    uint32_t    crcResidue;     // register after data followed by its own CRC
+    uint8_t     cbCrc;
+    bool        fReflected;
+    bool        fBigEndian;     // byte order of the CRC on the wire
+} CRC_DESC;
+
+static const CRC_DESC rgdesc[C_CRC_TYPES] = {
+    [SERIAL_CRC16_CCITT]  = { 0x1021,     0xFFFF,     0,          0,          2, false, true  },
+    [SERIAL_CRC16_MODBUS] = { 0xA001,     0xFFFF,     0,          0,          2, true,  false },
+    [SERIAL_CRC32]        = { 0xEDB88320, 0xFFFFFFFF, 0xFFFFFFFF, 0xDEBB20E3, 4, true,  false },
+};
+
+/* ------------------------------------------------------------ */
+/*              Local Variables                                 */
+/* ------------------------------------------------------------ */
+
+static pthread_once_t   onceCrc = PTHREAD_ONCE_INIT;
+static uint32_t         rgrgT[C_CRC_TYPES][8][256];
+static _Atomic(CRC_FN)  rgpfnUpdate[C_CRC_TYPES];
+static _Atomic int      rgimpl[C_CRC_TYPES];
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static void     CrcInitOnce( void );
+static bool     ImplSupported( SERIAL_CRC_IMPL impl );
+static uint32_t ByteReflected( const uint32_t rgT[8][256], uint32_t crc, const uint8_t *pb, size_t cb );
+static uint32_t ByteNormal16( const uint32_t rgT[8][256], uint32_t crc, const uint8_t *pb, size_t cb );
+static uint32_t Slice8Reflected( const uint32_t rgT[8][256], uint32_t crc, const uint8_t *pb, size_t cb );
+static uint32_t Slice8Normal16( const uint32_t rgT[8][256], uint32_t crc, const uint8_t *pb, size_t cb );
+#if defined(CRC_HAVE_CLMUL)
+static uint32_t Crc32Clmul( const uint32_t rgT[8][256], uint32_t crc, const uint8_t *pb, size_t cb );
+#endif
+#if defined(CRC_HAVE_ARMV8)
+static uint32_t Crc32Armv8( const uint32_t rgT[8][256], uint32_t crc, const uint8_t *pb, size_t cb );
+#endif
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* Register value to start a CRC with. */
+uint32_t SerialCrcInit(SERIAL_CRC_TYPE type) {
+
+    return ( (unsigned)type < C_CRC_TYPES ) ? rgdesc[type].crcInit : 0;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialCrcUpdate
+**
+**  Synopsis:
+**      uint32_t SerialCrcUpdate(SERIAL_CRC_TYPE type, uint32_t crc,
+**                               const void *pv, size_t cb)
+**
+**  Parameters:
+**      type            CRC to compute
+**      crc             SerialCrcInit() or the result of the last update
+**      *pv             next piece of the data
+**      cb              number of bytes at pv
+**
+**  Return Values:
+**      the register after pv, for the next update or SerialCrcFinal()
+**
+**  Description:
+**      Feeding the data in any number of pieces gives the same result as
+**      one call over all of it.  SERIAL_CRC_NONE passes crc through.
+*/
+uint32_t SerialCrcUpdate(SERIAL_CRC_TYPE type, uint32_t crc, const void *pv, size_t cb) {
+
+    CRC_FN  pfn;
+
+    if ( (type == SERIAL_CRC_NONE) || ((unsigned)type >= C_CRC_TYPES) ) {
+        return crc;
+    }
+    pthread_once(&onceCrc, CrcInitOnce);
+    pfn = atomic_load_explicit(&rgpfnUpdate[type], memory_order_relaxed);
+    return pfn(rgrgT[type], crc, pv, cb);
+}
+
+/* The CRC of everything fed to SerialCrcUpdate(). */
+uint32_t SerialCrcFinal(SERIAL_CRC_TYPE type, uint32_t crc) {
+
+    return ( (unsigned)type < C_CRC_TYPES ) ? crc ^ rgdesc[type].crcXorOut : crc;
+}
+
+/* One shot CRC of pv. */
+uint32_t SerialCrc(SERIAL_CRC_TYPE type, const void *pv, size_t cb) {
+
+    return SerialCrcFinal(type, SerialCrcUpdate(type, SerialCrcInit(type), pv, cb));
+}
+
+/* Bytes the CRC takes on the wire, 0 for SERIAL_CRC_NONE. */
+size_t SerialCrcSize(SERIAL_CRC_TYPE type) {
+
+    return ( (unsigned)type < C_CRC_TYPES ) ? rgdesc[type].cbCrc : 0;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialCrcPut
+**
+**  Synopsis:
+**      size_t SerialCrcPut(SERIAL_CRC_TYPE type, uint32_t crcFinal, uint8_t *pb)
+**
+**  Parameters:
+**      type            CRC that was computed
+**      crcFinal        result of SerialCrc() or SerialCrcFinal()
+**      *pb             receives SerialCrcSize() bytes
+**
+**  Return Values:
+**      number of bytes written
+**
+**  Description:
+**      Stores the CRC in the byte order its protocol sends it in, the
+**      order SerialCrcCheck() expects after the data.
+*/
+size_t SerialCrcPut(SERIAL_CRC_TYPE type, uint32_t crcFinal, uint8_t *pb) {
+
+    size_t  cbCrc = SerialCrcSize(type);
+    size_t  ib;
+
+    for ( ib = 0; ib < cbCrc; ib++ ) {
+        pb[rgdesc[type].fBigEndian ? cbCrc - 1 - ib : ib] = (uint8_t)(crcFinal >> (8 * ib));
+    }
+    return cbCrc;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialCrcCheck
+**
+**  Synopsis:
+**      bool SerialCrcCheck(SERIAL_CRC_TYPE type, const void *pv, size_t cb)
+**
+**  Parameters:
+**      type            CRC the data carries
+**      *pv             data followed by its CRC as SerialCrcPut() stores it
+**      cb              number of bytes at pv, CRC included
+**
+**  Return Values:
+**      true if the CRC matches, always for SERIAL_CRC_NONE
+**
+**  Description:
+**      Runs the CRC over the trailer as well and compares the register
+**      with the residue every intact frame leaves, so the check is one
+**      pass with no trailer to pick apart.
+*/
+bool SerialCrcCheck(SERIAL_CRC_TYPE type, const void *pv, size_t cb) {
+
+    if ( (type == SERIAL_CRC_NONE) || ((unsigned)type >= C_CRC_TYPES) ) {
+        return true;
+    }
+    if ( cb < rgdesc[type].cbCrc ) {
+        return false;
+    }
+    return SerialCrcUpdate(type, rgdesc[type].crcInit, pv, cb) == rgdesc[type].crcResidue;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialCrcSetImpl
+**
+**  Synopsis:
+**      bool SerialCrcSetImpl(SERIAL_CRC_IMPL impl)
+**
+**  Parameters:
+**      impl            kernel to use from now on, SERIAL_CRC_IMPL_AUTO for
+**                      the fastest one available
+**
+**  Return Values:
+**      true on success
+**      false if this CPU cannot run impl, nothing changes
+**
+**  Description:
+**      For benchmarks and tests.  The CRC-32 only kernels leave the 16
+**      bit CRCs on slice-by-8.  The kernels all give the same results.
+*/
+bool SerialCrcSetImpl(SERIAL_CRC_IMPL impl) {
+
+    SERIAL_CRC_IMPL implType;
+    CRC_FN          pfn;
+    int             type;
+
+    pthread_once(&onceCrc, CrcInitOnce);
+
+    if ( impl == SERIAL_CRC_IMPL_AUTO ) {
+        if ( ImplSupported(SERIAL_CRC_IMPL_CLMUL) ) {
+            impl = SERIAL_CRC_IMPL_CLMUL;
+        } else if ( ImplSupported(SERIAL_CRC_IMPL_ARMV8) ) {
+            impl = SERIAL_CRC_IMPL_ARMV8;
+        } else {
+            impl = SERIAL_CRC_IMPL_SLICE8;
+        }
+    }
+    if ( !ImplSupported(impl) ) {
+        return false;
+    }
+
+    for ( type = SERIAL_CRC16_CCITT; type < C_CRC_TYPES; type++ ) {
+        implType = impl;
+        if ( (type != SERIAL_CRC32) &&
+             ((impl == SERIAL_CRC_IMPL_CLMUL) || (impl == SERIAL_CRC_IMPL_ARMV8)) ) {
+            implType = SERIAL_CRC_IMPL_SLICE8;
+        }
+        switch ( implType ) {
+            case SERIAL_CRC_IMPL_BYTE:
+                pfn = rgdesc[type].fReflected ? ByteReflected : ByteNormal16;
+                break;
+#if defined(CRC_HAVE_CLMUL)
+            case SERIAL_CRC_IMPL_CLMUL:
+                pfn = Crc32Clmul;
+                break;
+#endif
+#if defined(CRC_HAVE_ARMV8)
+            case SERIAL_CRC_IMPL_ARMV8:
+                pfn = Crc32Armv8;
+                break;
+#endif
+            default:
+                pfn = rgdesc[type].fReflected ? Slice8Reflected : Slice8Normal16;
+                break;
+        }
+        atomic_store_explicit(&rgpfnUpdate[type], pfn, memory_order_relaxed);
+        atomic_store_explicit(&rgimpl[type], implType, memory_order_relaxed);
+    }
+    return true;
+}
+
+/* Kernel type runs on, SERIAL_CRC_IMPL_AUTO for SERIAL_CRC_NONE. */
+SERIAL_CRC_IMPL SerialCrcGetImpl(SERIAL_CRC_TYPE type) {
+
+    if ( (type == SERIAL_CRC_NONE) || ((unsigned)type >= C_CRC_TYPES) ) {
+        return SERIAL_CRC_IMPL_AUTO;
+    }
+    pthread_once(&onceCrc, CrcInitOnce);
+    return (SERIAL_CRC_IMPL)atomic_load_explicit(&rgimpl[type], memory_order_relaxed);
+}
+
+const char *SerialCrcImplName(SERIAL_CRC_IMPL impl) {
+
+    switch ( impl ) {
+        case SERIAL_CRC_IMPL_BYTE:      return "byte";
+        case SERIAL_CRC_IMPL_SLICE8:    return "slice8";
+        case SERIAL_CRC_IMPL_CLMUL:     return "clmul";
+        case SERIAL_CRC_IMPL_ARMV8:     return "armv8";
+        default:                        return "auto";
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    CrcInitOnce
+**
+**  Synopsis:
+**      void CrcInitOnce(void)
+**
+**  Description:
+**      Builds the eight tables of every CRC and picks the kernels.
+**      rgT[k][n] is the register contribution of byte n when k more
+**      bytes follow it, rgT[0] being the classic byte table.
+*/
+static void CrcInitOnce(void) {
+
+    const CRC_DESC  *pdesc;
+    uint32_t        (*rgT)[256];
+    uint32_t        crc;
+    int             type;
+    int             n;
+    int             k;
+    int             ibit;
+
+    for ( type = SERIAL_CRC16_CCITT; type < C_CRC_TYPES; type++ ) {
+        pdesc = &rgdesc[type];
+        rgT = rgrgT[type];
+        for ( n = 0; n < 256; n++ ) {
+            if ( pdesc->fReflected ) {
+                crc = n;
+                for ( ibit = 0; ibit < 8; ibit++ ) {
+                    crc = ( crc & 1 ) ? (crc >> 1) ^ pdesc->poly : crc >> 1;
+                }
+            } else {
+                crc = (uint32_t)n << 8;
+                for ( ibit = 0; ibit < 8; ibit++ ) {
+                    crc = ( crc & 0x8000 ) ? ((crc << 1) ^ pdesc->poly) & 0xFFFF : (crc << 1) & 0xFFFF;
+                }
+            }
+            rgT[0][n] = crc;
+        }
+        for ( k = 1; k < 8; k++ ) {
+            for ( n = 0; n < 256; n++ ) {
+                crc = rgT[k - 1][n];
+                if ( pdesc->fReflected ) {
+                    rgT[k][n] = (crc >> 8) ^ rgT[0][crc & 0xFF];
+                } else {
+                    rgT[k][n] = ((crc << 8) & 0xFFFF) ^ rgT[0][crc >> 8];
+                }
+            }
+        }
+    }
+
+    // the once is still running, SerialCrcSetImpl() must not wait on it
+    for ( type = SERIAL_CRC16_CCITT; type < C_CRC_TYPES; type++ ) {
+        atomic_init(&rgpfnUpdate[type], rgdesc[type].fReflected ? Slice8Reflected : Slice8Normal16);
+        atomic_init(&rgimpl[type], SERIAL_CRC_IMPL_SLICE8);
+    }
+#if defined(CRC_HAVE_CLMUL)
+    if ( ImplSupported(SERIAL_CRC_IMPL_CLMUL) ) {
+        atomic_init(&rgpfnUpdate[SERIAL_CRC32], Crc32Clmul);
+        atomic_init(&rgimpl[SERIAL_CRC32], SERIAL_CRC_IMPL_CLMUL);
+    }
+#endif
+#if defined(CRC_HAVE_ARMV8)
+    if ( ImplSupported(SERIAL_CRC_IMPL_ARMV8) ) {
+        atomic_init(&rgpfnUpdate[SERIAL_CRC32], Crc32Armv8);
+        atomic_init(&rgimpl[SERIAL_CRC32], SERIAL_CRC_IMPL_ARMV8);
+    }
+#endif
+}
+
+static bool ImplSupported(SERIAL_CRC_IMPL impl) {
+
+    switch ( impl ) {
+        case SERIAL_CRC_IMPL_BYTE:
+        case SERIAL_CRC_IMPL_SLICE8:
+            return true;
+#if defined(CRC_HAVE_CLMUL)
+        case SERIAL_CRC_IMPL_CLMUL:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#endif
+#if defined(CRC_HAVE_ARMV8)
+        case SERIAL_CRC_IMPL_ARMV8:
+            return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#endif
+        default:
+            return false;
+    }
+}
+
+/* ------------------------------------------------------------ */
+/*              Kernels                                         */
+/* ------------------------------------------------------------ */
+
+static uint32_t ByteReflected(const uint32_t rgT[8][256], uint32_t crc, const uint8_t *pb, size_t cb) {
+
+    while ( cb-- > 0 ) {
+        crc = (crc >> 8) ^ rgT[0][(crc ^ *pb++) & 0xFF];
+    }
+    return crc;
+}
+
+static uint32_t ByteNormal16(const uint32_t rgT[8][256], uint32_t crc, const uint8_t *pb, size_t cb) {
+
+    while ( cb-- > 0 ) {
+        crc = ((crc << 8) & 0xFFFF) ^ rgT[0][((crc >> 8) ^ *pb++) & 0xFF];
+    }
+    return crc;
+}
+
+/* ------------------------------------------------------------ */
+/***    Slice8Reflected
+**
+**  Synopsis:
+**      uint32_t Slice8Reflected(const uint32_t rgT[8][256], uint32_t crc,
+**                               const uint8_t *pb, size_t cb)
+**
+**  Description:
+**      Eight independent lookups per eight bytes instead of a chain of
+**      eight dependent ones.  The register sits on the first bytes of
+**      each block, which works for any reflected CRC up to 32 bits.
+*/
+static uint32_t Slice8Reflected(const uint32_t rgT[8][256], uint32_t crc, const uint8_t *pb, size_t cb) {
+
+    uint32_t    lo;
+    uint32_t    hi;
+
+    for ( ; cb >= 8; cb -= 8, pb += 8 ) {
+        memcpy(&lo, pb, 4);
+        memcpy(&hi, pb + 4, 4);
+        lo = le32toh(lo) ^ crc;
+        hi = le32toh(hi);
+        crc = rgT[7][lo & 0xFF] ^ rgT[6][(lo >> 8) & 0xFF] ^
+              rgT[5][(lo >> 16) & 0xFF] ^ rgT[4][lo >> 24] ^
+              rgT[3][hi & 0xFF] ^ rgT[2][(hi >> 8) & 0xFF] ^
+              rgT[1][(hi >> 16) & 0xFF] ^ rgT[0][hi >> 24];
+    }
+    return ByteReflected(rgT, crc, pb, cb);
+}
+
+/* Slice8Reflected() for the MSB first 16 bit CRC, on big endian words. */
+static uint32_t Slice8Normal16(const uint32_t rgT[8][256], uint32_t crc, const uint8_t *pb, size_t cb) {
+
+    uint32_t    lo;
+    uint32_t    hi;
+
+    for ( ; cb >= 8; cb -= 8, pb += 8 ) {
+        memcpy(&lo, pb, 4);
+        memcpy(&hi, pb + 4, 4);
+        lo = be32toh(lo) ^ (crc << 16);
+        hi = be32toh(hi);
+        crc = rgT[7][lo >> 24] ^ rgT[6][(lo >> 16) & 0xFF] ^
+              rgT[5][(lo >> 8) & 0xFF] ^ rgT[4][lo & 0xFF] ^
+              rgT[3][hi >> 24] ^ rgT[2][(hi >> 16) & 0xFF] ^
+              rgT[1][(hi >> 8) & 0xFF] ^ rgT[0][hi & 0xFF];
+    }
+    return ByteNormal16(rgT, crc, pb, cb);
+}
+
+#if defined(CRC_HAVE_CLMUL)
+/* ------------------------------------------------------------ */
+/***    Crc32Clmul
+**
+**  Synopsis:
+**      uint32_t Crc32Clmul(const uint32_t rgT[8][256], uint32_t crc,
+**                          const uint8_t *pb, size_t cb)
+**
+**  Description:
+**      Folds four 128 bit lanes at a time with carry-less multiplies,
+**      then the lanes into one, then 128 bits down to 32 with a Barrett
+**      reduction, after Intel's "Fast CRC Computation for Generic
+**      Polynomials Using PCLMULQDQ".  The constants are the bit
+**      reflected powers of x modulo the CRC-32 polynomial from that
+**      paper.  Runs of under 64 bytes and the tail that is not a whole
+**      16 bytes go through slice-by-8.
+*/
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t Crc32Clmul(const uint32_t rgT[8][256], uint32_t crc, const uint8_t *pb, size_t cb) {
+
+    __m128i     x0, x1, x2, x3, x4, x5, x6, x7, x8;
+    __m128i     y5, y6, y7, y8;
+    __m128i     xMask;
+    size_t      cbFold;
+
+    if ( cb < 64 ) {
+        return Slice8Reflected(rgT, crc, pb, cb);
+    }
+    cbFold = cb & ~(size_t)15;
+    cb -= cbFold;
+
+    x1 = _mm_loadu_si128((const __m128i *)(pb + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(pb + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(pb + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(pb + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);    // k2:k1
+    pb += 64;
+    cbFold -= 64;
+
+    // four lanes, 64 bytes per step
+    while ( cbFold >= 64 ) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i *)(pb + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *)(pb + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *)(pb + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *)(pb + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        pb += 64;
+        cbFold -= 64;
+    }
+
+    // lanes into one
+    x0 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);    // k4:k3
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // one lane, 16 bytes per step
+    while ( cbFold >= 16 ) {
+        x2 = _mm_loadu_si128((const __m128i *)pb);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        pb += 16;
+        cbFold -= 16;
+    }
+
+    // 128 bits to 64
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    xMask = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_set_epi64x(0, 0x0163cd6124);                // k5
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, xMask);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32
+    x0 = _mm_set_epi64x(0x01f7011641, 0x01db710641);    // mu:P'
+    x2 = _mm_and_si128(x1, xMask);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, xMask);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    crc = (uint32_t)_mm_extract_epi32(x1, 1);
+
+    return Slice8Reflected(rgT, crc, pb, cb);
+}
+#endif
+
+#if defined(CRC_HAVE_ARMV8)
+/* CRC-32 on the ARMv8 CRC32X/CRC32B instructions, eight bytes per step. */
+ARMV8_TARGET
+static uint32_t Crc32Armv8(const uint32_t rgT[8][256], uint32_t crc, const uint8_t *pb, size_t cb) {
+
+    uint64_t    ull;
+
+    (void)rgT;
+    for ( ; (cb > 0) && ((uintptr_t)pb & 7); cb--, pb++ ) {
+        crc = ARMV8_CRC32B(crc, *pb);
+    }
+    for ( ; cb >= 8; cb -= 8, pb += 8 ) {
+        memcpy(&ull, pb, 8);
+        crc = ARMV8_CRC32X(crc, le64toh(ull));
+    }
+    for ( ; cb > 0; cb--, pb++ ) {
+        crc = ARMV8_CRC32B(crc, *pb);
+    }
+    return crc;
+}
+#endif
+
+
+/************************************ EOF ********************************/
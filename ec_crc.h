@@ -0,0 +1,89 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_crc.h --  EmbedCreativity's Serial checksum header file          */
+/*                                                                      */
+/************************************************************************/
+/*  Author:     agent                                                   */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*  This header file contains declarations the functions contained in   */
+/*  ec_crc.c                                                            */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026(agent): created                                          */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(_SERIALCRC_H)
+#define _SERIALCRC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------------ */
+/*                  General Type Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef enum {
+    SERIAL_CRC_NONE,
+    SERIAL_CRC16_CCITT,         // CRC-16/CCITT-FALSE, sent high byte first
+    SERIAL_CRC16_MODBUS,        // CRC-16/MODBUS, sent low byte first
+    SERIAL_CRC32                // CRC-32 as in Ethernet and zlib, sent low byte first
+} SERIAL_CRC_TYPE;
+
+typedef enum {
+    SERIAL_CRC_IMPL_AUTO,       // fastest the CPU supports
+    SERIAL_CRC_IMPL_BYTE,       // one table lookup per byte
+    SERIAL_CRC_IMPL_SLICE8,     // eight tables, eight bytes per step
+    SERIAL_CRC_IMPL_CLMUL,      // x86 PCLMULQDQ folding, CRC-32 only
+    SERIAL_CRC_IMPL_ARMV8       // ARMv8 CRC32 instructions, CRC-32 only
+} SERIAL_CRC_IMPL;
+
+/* ------------------------------------------------------------ */
+/*                  Function Prototypes                         */
+/* ------------------------------------------------------------ */
+
+uint32_t SerialCrcInit(SERIAL_CRC_TYPE type);
+uint32_t SerialCrcUpdate(SERIAL_CRC_TYPE type, uint32_t crc, const void *pv, size_t cb);
+uint32_t SerialCrcFinal(SERIAL_CRC_TYPE type, uint32_t crc);
+uint32_t SerialCrc(SERIAL_CRC_TYPE type, const void *pv, size_t cb);
+size_t  SerialCrcSize(SERIAL_CRC_TYPE type);
+size_t  SerialCrcPut(SERIAL_CRC_TYPE type, uint32_t crcFinal, uint8_t *pb);
+bool    SerialCrcCheck(SERIAL_CRC_TYPE type, const void *pv, size_t cb);
+bool    SerialCrcSetImpl(SERIAL_CRC_IMPL impl);
+SERIAL_CRC_IMPL SerialCrcGetImpl(SERIAL_CRC_TYPE type);
+const char *SerialCrcImplName(SERIAL_CRC_IMPL impl);
+/* ------------------------------------------------------------ */
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+
+/**********************************  EOF  **************************************/
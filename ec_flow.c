@@ -0,0 +1,306 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_flow.c --  EmbedCreativity's flow control and line counters      */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Ports open without flow control.  A sustained stream then loses     */
+/*  data in three places, and only the last is visible to the library:  */
+/*                                                                      */
+/*    the UART FIFO     the driver did not empty it in time, counted    */
+/*                      by the driver as an overrun                     */
+/*    the tty buffer    the reader did not keep up, counted by the      */
+/*                      driver as a buffer overrun                      */
+/*    the RX ring       the application did not keep up, counted in     */
+/*                      SerialPortRxOverflow()                          */
+/*                                                                      */
+/*  SerialPortSetFlowControl() turns on the RTS/CTS or XON/XOFF         */
+/*  handshake in the driver, which stops the sender when the tty        */
+/*  buffer fills.  The RX thread then stops reading when its ring is    */
+/*  full, leaving the data with the driver, so a slow application       */
+/*  pauses the sender instead of losing bytes.  SerialPortGetLineCounts */
+/*  reads the driver's error counters through TIOCGICOUNT.              */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*  10/16/2026 (agent): line counts add up in 64 bits across wraps of   */
+/*                      the driver's 32 bit counters                    */
+/*                                                                      */
+/************************************************************************/
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>   /* struct serial_icounter_struct */
+
+#include "ec_serial.h"
+#include "ec_serial_priv.h"
+
+/* ------------------------------------------------------------ */
+/*              Local Type Definitions                          */
+/* ------------------------------------------------------------ */
+
+#define CHAR_XON    0x11    // DC1
+#define CHAR_XOFF   0x13    // DC3
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static bool     GetRawCounts( SERIAL_PORT *port, SERIAL_LINE_COUNTS *pcounts );
+static void     AddCounts( SERIAL_PORT *port, const SERIAL_LINE_COUNTS *plc );
+static void     Rebase( SERIAL_PORT *port );
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    SerialPortSetFlowControl
+**
+**  Synopsis:
+**      bool SerialPortSetFlowControl(SERIAL_PORT *port, SERIAL_FLOW flow)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      flow            handshake to use from now on
+**
+**  Return Values:
+**      1               success
+**      0               failure, the previous handshake is still in effect
+**
+**  Errors:
+**      EINVAL for an unknown mode or one the driver would not take,
+**      otherwise errno from tcgetattr()/tcsetattr()
+**
+**  Description:
+**      With SERIAL_FLOW_RTSCTS the driver drops RTS when its buffer is
+**      nearly full and only sends while CTS is asserted.  With
+**      SERIAL_FLOW_XONXOFF it sends XOFF/XON instead and obeys those it
+**      receives, which corrupts binary data that contains 0x11 or 0x13.
+**      Either way the RX thread no longer drops data when its ring is
+**      full, it waits for the application and lets the handshake hold
+**      off the sender.  Writes can then block while the peer is busy.
+*/
+bool SerialPortSetFlowControl(SERIAL_PORT *port, SERIAL_FLOW flow) {
+
+    struct termios  options;
+    struct termios  optionsPrev;
+
+    if ( tcgetattr(port->fd, &options) != 0 ) {
+        return false;
+    }
+    optionsPrev = options;
+
+    options.c_cflag &= ~CRTSCTS;
+    options.c_iflag &= ~(IXON | IXOFF | IXANY);
+    switch ( flow ) {
+        case SERIAL_FLOW_NONE:
+            break;
+        case SERIAL_FLOW_RTSCTS:
+            options.c_cflag |= CRTSCTS;
+            break;
+        case SERIAL_FLOW_XONXOFF:
+            options.c_iflag |= IXON | IXOFF;
+            options.c_cc[VSTART] = CHAR_XON;
+            options.c_cc[VSTOP] = CHAR_XOFF;
+            break;
+        default:
+            errno = EINVAL;
+            return false;
+    }
+
+    if ( tcsetattr(port->fd, TCSANOW, &options) != 0 ) {
+        return false;
+    }
+
+    // tcsetattr() succeeds if any of the changes took, check ours did
+    tcgetattr(port->fd, &options);
+    if ( ((flow == SERIAL_FLOW_RTSCTS) && !(options.c_cflag & CRTSCTS)) ||
+         ((flow == SERIAL_FLOW_XONXOFF) && ((options.c_iflag & (IXON | IXOFF)) != (IXON | IXOFF))) ) {
+        SERIAL_LOG(SERIAL_LOG_WARN, "SERIAL %s: driver refused flow control %d", port->szDevice, flow);
+        tcsetattr(port->fd, TCSANOW, &optionsPrev);
+        errno = EINVAL;
+        return false;
+    }
+
+    port->termios = options;
+    atomic_store_explicit(&port->flow, flow, memory_order_relaxed);
+    SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL %s: flow control %d", port->szDevice, flow);
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortGetFlowControl
+**
+**  Synopsis:
+**      SERIAL_FLOW SerialPortGetFlowControl(SERIAL_PORT *port)
+**
+**  Return Values:
+**      handshake set by SerialPortSetFlowControl(), SERIAL_FLOW_NONE
+**      until then
+*/
+SERIAL_FLOW SerialPortGetFlowControl(SERIAL_PORT *port) {
+
+    return atomic_load_explicit(&port->flow, memory_order_relaxed);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortGetLineCounts
+**
+**  Synopsis:
+**      bool SerialPortGetLineCounts(SERIAL_PORT *port,
+**                                   SERIAL_LINE_COUNTS *pcounts)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      *pcounts        receives the counts
+**
+**  Return Values:
+**      1               success
+**      0               the driver keeps no counters, *pcounts is zeroed
+**
+**  Errors:
+**      errno from TIOCGICOUNT, typically ENOTTY or EINVAL for ptys and
+**      some USB adapters
+**
+**  Description:
+**      Counts since the port was opened or SerialPortResetStats() was
+**      last called, carried over a reconnect.  The driver's counters
+**      are 32 bits wide.  Each call adds what they moved since the
+**      previous call to 64 bit totals, so the counts stay right as long
+**      as no counter wraps twice between two calls, about 10 hours at
+**      1 Mbaud.
+*/
+bool SerialPortGetLineCounts(SERIAL_PORT *port, SERIAL_LINE_COUNTS *pcounts) {
+
+    SERIAL_LINE_COUNTS  lc;
+
+    pthread_mutex_lock(&port->mtxLines);
+    if ( !GetRawCounts(port, &lc) ) {
+        pthread_mutex_unlock(&port->mtxLines);
+        memset(pcounts, 0, sizeof(*pcounts));
+        return false;
+    }
+    AddCounts(port, &lc);
+    *pcounts = port->lcTotal;
+    pthread_mutex_unlock(&port->mtxLines);
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+/***    FlowResetLineCounts
+**
+**  Synopsis:
+**      void FlowResetLineCounts(SERIAL_PORT *port)
+**
+**  Description:
+**      Zeroes the totals of SerialPortGetLineCounts() and counts on from
+**      the current driver counters.  Called at open and by
+**      SerialPortResetStats().
+*/
+void FlowResetLineCounts(SERIAL_PORT *port) {
+
+    pthread_mutex_lock(&port->mtxLines);
+    memset(&port->lcTotal, 0, sizeof(port->lcTotal));
+    Rebase(port);
+    pthread_mutex_unlock(&port->mtxLines);
+}
+
+/* ------------------------------------------------------------ */
+/***    FlowRebaseLineCounts
+**
+**  Synopsis:
+**      void FlowRebaseLineCounts(SERIAL_PORT *port)
+**
+**  Description:
+**      Keeps the totals but counts on from the current driver
+**      counters.  Called after a reconnect, the new device's counters
+**      start over.
+*/
+void FlowRebaseLineCounts(SERIAL_PORT *port) {
+
+    pthread_mutex_lock(&port->mtxLines);
+    Rebase(port);
+    pthread_mutex_unlock(&port->mtxLines);
+}
+
+/* Adds what each driver counter moved since lcLast, modulo 2^32, to
+   lcTotal.  mtxLines held. */
+static void AddCounts(SERIAL_PORT *port, const SERIAL_LINE_COUNTS *plc) {
+
+    SERIAL_LINE_COUNTS  *plast = &port->lcLast;
+    SERIAL_LINE_COUNTS  *ptotal = &port->lcTotal;
+
+    ptotal->cRx += (uint32_t)(plc->cRx - plast->cRx);
+    ptotal->cTx += (uint32_t)(plc->cTx - plast->cTx);
+    ptotal->cOverrun += (uint32_t)(plc->cOverrun - plast->cOverrun);
+    ptotal->cBufOverrun += (uint32_t)(plc->cBufOverrun - plast->cBufOverrun);
+    ptotal->cFrame += (uint32_t)(plc->cFrame - plast->cFrame);
+    ptotal->cParity += (uint32_t)(plc->cParity - plast->cParity);
+    ptotal->cBreak += (uint32_t)(plc->cBreak - plast->cBreak);
+    ptotal->cCts += (uint32_t)(plc->cCts - plast->cCts);
+    *plast = *plc;
+}
+
+/* Current driver counters become lcLast.  mtxLines held. */
+static void Rebase(SERIAL_PORT *port) {
+
+    if ( !GetRawCounts(port, &port->lcLast) ) {
+        memset(&port->lcLast, 0, sizeof(port->lcLast));
+    }
+}
+
+/* Driver counters as they are, each still 32 bits wide. */
+static bool GetRawCounts(SERIAL_PORT *port, SERIAL_LINE_COUNTS *pcounts) {
+
+    struct serial_icounter_struct   icount;
+
+    memset(&icount, 0, sizeof(icount));
+    if ( ioctl(port->fd, TIOCGICOUNT, &icount) != 0 ) {
+        return false;
+    }
+
+    pcounts->cRx = (uint32_t)icount.rx;
+    pcounts->cTx = (uint32_t)icount.tx;
+    pcounts->cOverrun = (uint32_t)icount.overrun;
+    pcounts->cBufOverrun = (uint32_t)icount.buf_overrun;
+    pcounts->cFrame = (uint32_t)icount.frame;
+    pcounts->cParity = (uint32_t)icount.parity;
+    pcounts->cBreak = (uint32_t)icount.brk;
+    pcounts->cCts = (uint32_t)icount.cts;
+    return true;
+}
+
+
+/************************************ EOF ********************************/
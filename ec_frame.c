@@ -0,0 +1,900 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_frame.c --  EmbedCreativity's streaming frame decoder            */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Splits a received byte stream into frames.  Data is handed over a   */
+/*  chunk at a time with SerialFramerPush() and complete frames come    */
+/*  back from SerialFramerNext(), or through a callback with            */
+/*  SerialFramerFeed().                                                 */
+/*                                                                      */
+/*  Boundaries are found with memchr() over the whole chunk, which the  */
+/*  C library implements with vector instructions, so there is no per   */
+/*  byte state machine.  A frame that lies entirely inside the chunk    */
+/*  and needs no unescaping is returned in place without being copied.  */
+/*  Only the tail of a chunk that stops mid-frame is copied aside.      */
+/*                                                                      */
+/*  With a CRC configured every decoded frame is checked while it is    */
+/*  still in cache and the trailer is cut off before it is returned.    */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*  10/16/2026 (agent): optional CRC trailer, checked as frames are     */
+/*                      decoded and appended by SerialFrameEncode()     */
+/*                                                                      */
+/************************************************************************/
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+
+#include "ec_serial.h"
+#include "ec_serial_priv.h"
+#include "ec_frame.h"
+
+/* ------------------------------------------------------------ */
+/*              Local Type Definitions                          */
+/* ------------------------------------------------------------ */
+
+#define SERIAL_FRAME_READ   4096    // chunk size read by SerialPortReadFrame()
+
+struct SERIAL_FRAMER {
+    SERIAL_FRAME_CFG    cfg;
+
+    const uint8_t       *pbIn;          // unconsumed part of the pushed chunk
+    size_t              cbIn;
+
+    uint8_t             *rgbAcc;        // raw bytes of a frame split across chunks
+    size_t              cbAcc;
+    size_t              cbAccMax;
+    size_t              cbFrameLen;     // SERIAL_FRAME_LENGTH, size of the frame in rgbAcc
+    bool                fDiscard;       // skipping an oversize frame
+
+    uint8_t             *rgbOut;        // unescaped SLIP/COBS frames
+    uint64_t            cDropped;       // oversize or malformed frames
+    uint64_t            cCrcErrors;     // frames dropped for a bad CRC, also in cDropped
+
+    SERIAL_PORT         *portHeld;      // SerialPortReadFrame() ring bytes not yet consumed
+    size_t              cbHeld;
+    uint8_t             rgbRead[SERIAL_FRAME_READ];
+};
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static bool     NextDelimited( SERIAL_FRAMER *pfr, const uint8_t **ppbFrame, size_t *pcbFrame );
+static bool     NextLength( SERIAL_FRAMER *pfr, const uint8_t **ppbFrame, size_t *pcbFrame );
+static bool     Decode( SERIAL_FRAMER *pfr, const uint8_t *pbRaw, size_t cbRaw,
+                        const uint8_t **ppbFrame, size_t *pcbFrame );
+static size_t   ParseLength( const SERIAL_FRAME_CFG *pcfg, const uint8_t *pbHdr );
+static uint8_t *EscapeSlip( uint8_t *pbo, const uint8_t *pbIn, size_t cbIn );
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    SerialFramerCreate
+**
+**  Synopsis:
+**      SERIAL_FRAMER *SerialFramerCreate(const SERIAL_FRAME_CFG *pcfg)
+**
+**  Parameters:
+**      *pcfg           framing to decode, copied
+**
+**  Return Values:
+**      new framer, NULL on failure with errno set
+**
+**  Errors:
+**      EINVAL for an inconsistent configuration, or a CRC with
+**             SERIAL_FRAME_DELIMITER
+**
+**  Description:
+**      Allocates the framer and the buffers it needs for frames of up to
+**      cbMaxFrame bytes.  Nothing is allocated after this.
+*/
+SERIAL_FRAMER *SerialFramerCreate(const SERIAL_FRAME_CFG *pcfg) {
+
+    SERIAL_FRAMER   *pfr;
+    size_t          cbAccMax;
+
+    if ( (pcfg->cbMaxFrame == 0) || (pcfg->cbMaxFrame < SerialCrcSize(pcfg->crc)) ) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if ( (pcfg->crc != SERIAL_CRC_NONE) &&
+         ((pcfg->type == SERIAL_FRAME_DELIMITER) || (SerialCrcSize(pcfg->crc) == 0)) ) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if ( (pcfg->type == SERIAL_FRAME_LENGTH) &&
+         (pcfg->cbLength != 1) && (pcfg->cbLength != 2) && (pcfg->cbLength != 4) ) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    // an escaped frame can be up to twice as long on the wire
+    switch ( pcfg->type ) {
+        case SERIAL_FRAME_SLIP:     cbAccMax = 2 * pcfg->cbMaxFrame; break;
+        case SERIAL_FRAME_COBS:     cbAccMax = pcfg->cbMaxFrame + pcfg->cbMaxFrame / 254 + 1; break;
+        case SERIAL_FRAME_DELIMITER: cbAccMax = pcfg->cbMaxFrame + 1; break;
+        default:                    cbAccMax = pcfg->cbMaxFrame; break;
+    }
+
+    pfr = calloc(1, sizeof(*pfr));
+    if ( pfr == NULL ) {
+        return NULL;
+    }
+    pfr->cfg = *pcfg;
+    pfr->cbAccMax = cbAccMax;
+    pfr->rgbAcc = malloc(cbAccMax);
+    pfr->rgbOut = malloc(pcfg->cbMaxFrame);
+    if ( (pfr->rgbAcc == NULL) || (pfr->rgbOut == NULL) ) {
+        SerialFramerDestroy(pfr);
+        return NULL;
+    }
+    return pfr;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialFramerDestroy
+**
+**  Synopsis:
+**      void SerialFramerDestroy(SERIAL_FRAMER *pfr)
+**
+**  Description:
+**      Frees the framer.  NULL is ignored.
+*/
+void SerialFramerDestroy(SERIAL_FRAMER *pfr) {
+
+    if ( pfr == NULL ) {
+        return;
+    }
+    SerialFramerReset(pfr);
+    free(pfr->rgbAcc);
+    free(pfr->rgbOut);
+    free(pfr);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialFramerReset
+**
+**  Synopsis:
+**      void SerialFramerReset(SERIAL_FRAMER *pfr)
+**
+**  Description:
+**      Forgets any partial frame and pushed data, for example after the
+**      link has been re-synchronised.
+*/
+void SerialFramerReset(SERIAL_FRAMER *pfr) {
+
+    if ( (pfr->portHeld != NULL) && (pfr->portHeld->prx != NULL) ) {
+        RxConsume(pfr->portHeld, pfr->cbHeld);
+    }
+    pfr->portHeld = NULL;
+    pfr->cbHeld = 0;
+    pfr->pbIn = NULL;
+    pfr->cbIn = 0;
+    pfr->cbAcc = 0;
+    pfr->cbFrameLen = 0;
+    pfr->fDiscard = false;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialFramerPush
+**
+**  Synopsis:
+**      void SerialFramerPush(SERIAL_FRAMER *pfr, const uint8_t *pb, size_t cb)
+**
+**  Parameters:
+**      *pfr            framer
+**      *pb             received data
+**      cb              number of bytes at pb
+**
+**  Description:
+**      Hands the next chunk of the stream to the framer.  The chunk is not
+**      copied and must stay valid until SerialFramerNext() returns false,
+**      which is also the earliest the next chunk may be pushed.
+*/
+void SerialFramerPush(SERIAL_FRAMER *pfr, const uint8_t *pb, size_t cb) {
+
+    pfr->pbIn = pb;
+    pfr->cbIn = cb;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialFramerNext
+**
+**  Synopsis:
+**      bool SerialFramerNext(SERIAL_FRAMER *pfr, const uint8_t **ppbFrame,
+**                            size_t *pcbFrame)
+**
+**  Parameters:
+**      *pfr            framer
+**      **ppbFrame      receives the start of the frame
+**      *pcbFrame       receives the length of the frame
+**
+**  Return Values:
+**      1               a complete frame was returned
+**      0               the pushed chunk is used up, push the next one
+**
+**  Errors:
+**      none, malformed, oversize and bad CRC frames are skipped and counted
+**
+**  Description:
+**      The frame points either into the pushed chunk or into the framer
+**      and is valid until the next call on the framer.  Delimiters,
+**      escapes, COBS overhead and the CRC are removed.  Empty SLIP/COBS
+**      frames are skipped, an empty delimited frame is returned with
+**      length 0.
+*/
+bool SerialFramerNext(SERIAL_FRAMER *pfr, const uint8_t **ppbFrame, size_t *pcbFrame) {
+
+    bool    fFrame;
+
+    for (;;) {
+        if ( pfr->cfg.type == SERIAL_FRAME_LENGTH ) {
+            fFrame = NextLength(pfr, ppbFrame, pcbFrame);
+        } else {
+            fFrame = NextDelimited(pfr, ppbFrame, pcbFrame);
+        }
+        if ( !fFrame || (pfr->cfg.crc == SERIAL_CRC_NONE) ) {
+            return fFrame;
+        }
+        if ( SerialCrcCheck(pfr->cfg.crc, *ppbFrame, *pcbFrame) ) {
+            *pcbFrame -= SerialCrcSize(pfr->cfg.crc);
+            return true;
+        }
+        pfr->cCrcErrors++;
+        pfr->cDropped++;
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialFramerFeed
+**
+**  Synopsis:
+**      size_t SerialFramerFeed(SERIAL_FRAMER *pfr, const uint8_t *pb, size_t cb,
+**                              SERIAL_FRAME_CB pfnFrame, void *pvCtx)
+**
+**  Parameters:
+**      *pfr            framer
+**      *pb             received data
+**      cb              number of bytes at pb
+**      pfnFrame        called for every complete frame
+**      pvCtx           passed through to pfnFrame
+**
+**  Return Values:
+**      number of frames delivered
+**
+**  Description:
+**      Push and iterate in one call.  The frame passed to the callback is
+**      only valid for the duration of the call.
+*/
+size_t SerialFramerFeed(SERIAL_FRAMER *pfr, const uint8_t *pb, size_t cb,
+                        SERIAL_FRAME_CB pfnFrame, void *pvCtx) {
+
+    const uint8_t   *pbFrame;
+    size_t          cbFrame;
+    size_t          cFrames;
+
+    cFrames = 0;
+    SerialFramerPush(pfr, pb, cb);
+    while ( SerialFramerNext(pfr, &pbFrame, &cbFrame) ) {
+        pfnFrame(pvCtx, pbFrame, cbFrame);
+        cFrames++;
+    }
+    return cFrames;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialFramerDropped
+**
+**  Synopsis:
+**      uint64_t SerialFramerDropped(SERIAL_FRAMER *pfr)
+**
+**  Return Values:
+**      number of oversize, malformed or bad CRC frames skipped so far
+*/
+uint64_t SerialFramerDropped(SERIAL_FRAMER *pfr) {
+
+    return pfr->cDropped;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialFramerCrcErrors
+**
+**  Synopsis:
+**      uint64_t SerialFramerCrcErrors(SERIAL_FRAMER *pfr)
+**
+**  Return Values:
+**      number of frames skipped because their CRC did not match
+*/
+uint64_t SerialFramerCrcErrors(SERIAL_FRAMER *pfr) {
+
+    return pfr->cCrcErrors;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialFrameEncodedMax
+**
+**  Synopsis:
+**      size_t SerialFrameEncodedMax(const SERIAL_FRAME_CFG *pcfg, size_t cbIn)
+**
+**  Return Values:
+**      worst case size of SerialFrameEncode() output for cbIn bytes
+*/
+size_t SerialFrameEncodedMax(const SERIAL_FRAME_CFG *pcfg, size_t cbIn) {
+
+    cbIn += SerialCrcSize(pcfg->crc);
+    switch ( pcfg->type ) {
+        case SERIAL_FRAME_DELIMITER:    return cbIn + 1;
+        case SERIAL_FRAME_SLIP:         return 2 * cbIn + 2;
+        case SERIAL_FRAME_COBS:         return cbIn + cbIn / 254 + 2;
+        default:                        return cbIn;
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialFrameEncode
+**
+**  Synopsis:
+**      size_t SerialFrameEncode(const SERIAL_FRAME_CFG *pcfg, const uint8_t *pbIn,
+**                               size_t cbIn, uint8_t *pbOut, size_t cbOutMax)
+**
+**  Parameters:
+**      *pcfg           framing to produce
+**      *pbIn           payload.  For SERIAL_FRAME_LENGTH the whole frame,
+**                      header included, the length field is filled in.
+**      cbIn            size of the payload
+**      *pbOut          receives the frame as it goes on the wire
+**      cbOutMax        size of pbOut, SerialFrameEncodedMax() is always enough
+**
+**  Return Values:
+**      number of bytes placed in pbOut, 0 if it did not fit
+**
+**  Description:
+**      The transmit side counterpart of the framer.  A configured CRC is
+**      computed over the payload, for SERIAL_FRAME_LENGTH after the
+**      length field is filled in, and sent after it, inside the escaping.
+*/
+size_t SerialFrameEncode(const SERIAL_FRAME_CFG *pcfg, const uint8_t *pbIn, size_t cbIn,
+                         uint8_t *pbOut, size_t cbOutMax) {
+
+    const uint8_t   *rgpbSeg[2];
+    const uint8_t   *pbSeg;
+    const uint8_t   *pbEnd;
+    uint8_t         *pbo = pbOut;
+    uint8_t         *pbCode;
+    uint8_t         rgbCrc[4];
+    uint64_t        cbField;
+    size_t          rgcbSeg[2];
+    size_t          cbCrc;
+    size_t          ib;
+    int             iseg;
+
+    if ( cbOutMax < SerialFrameEncodedMax(pcfg, cbIn) ) {
+        return 0;
+    }
+    if ( (pcfg->crc != SERIAL_CRC_NONE) && (pcfg->type == SERIAL_FRAME_DELIMITER) ) {
+        return 0;
+    }
+    cbCrc = SerialCrcSize(pcfg->crc);
+
+    switch ( pcfg->type ) {
+        case SERIAL_FRAME_DELIMITER:
+            memcpy(pbo, pbIn, cbIn);
+            pbo[cbIn] = pcfg->bDelimiter;
+            return cbIn + 1;
+
+        case SERIAL_FRAME_LENGTH:
+            if ( cbIn < (size_t)pcfg->ibLength + pcfg->cbLength ) {
+                return 0;
+            }
+            memcpy(pbo, pbIn, cbIn);
+            cbField = (uint64_t)((int64_t)(cbIn + cbCrc) - pcfg->cbAdjust);
+            for ( ib = 0; ib < pcfg->cbLength; ib++ ) {
+                size_t ibDst = pcfg->fBigEndian ? pcfg->cbLength - 1 - ib : ib;
+                pbo[pcfg->ibLength + ibDst] = (uint8_t)(cbField >> (8 * ib));
+            }
+            if ( cbCrc > 0 ) {
+                SerialCrcPut(pcfg->crc, SerialCrc(pcfg->crc, pbo, cbIn), pbo + cbIn);
+            }
+            return cbIn + cbCrc;
+
+        default:
+            break;
+    }
+
+    // SLIP and COBS escape the payload and then the CRC as one stream
+    if ( cbCrc > 0 ) {
+        SerialCrcPut(pcfg->crc, SerialCrc(pcfg->crc, pbIn, cbIn), rgbCrc);
+    }
+    rgpbSeg[0] = pbIn;
+    rgcbSeg[0] = cbIn;
+    rgpbSeg[1] = rgbCrc;
+    rgcbSeg[1] = cbCrc;
+
+    switch ( pcfg->type ) {
+        case SERIAL_FRAME_SLIP:
+            *pbo++ = SERIAL_SLIP_END;   // flush any line noise at the receiver
+            for ( iseg = 0; iseg < 2; iseg++ ) {
+                pbo = EscapeSlip(pbo, rgpbSeg[iseg], rgcbSeg[iseg]);
+            }
+            *pbo++ = SERIAL_SLIP_END;
+            return pbo - pbOut;
+
+        case SERIAL_FRAME_COBS:
+            pbCode = pbo++;
+            *pbCode = 1;
+            for ( iseg = 0; iseg < 2; iseg++ ) {
+                pbEnd = rgpbSeg[iseg] + rgcbSeg[iseg];
+                for ( pbSeg = rgpbSeg[iseg]; pbSeg < pbEnd; pbSeg++ ) {
+                    if ( *pbSeg == 0 ) {
+                        pbCode = pbo++;
+                        *pbCode = 1;
+                    } else {
+                        *pbo++ = *pbSeg;
+                        if ( ++*pbCode == 0xFF ) {
+                            pbCode = pbo++;
+                            *pbCode = 1;
+                        }
+                    }
+                }
+            }
+            *pbo++ = 0;
+            return pbo - pbOut;
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortReadFrame
+**
+**  Synopsis:
+**      int SerialPortReadFrame(SERIAL_PORT *port, SERIAL_FRAMER *pfr,
+**                              const uint8_t **ppbFrame, uint32_t timeOutMs)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      *pfr            framer used for this port only
+**      **ppbFrame      receives the frame
+**      timeOutMs       0 to only use data already received,
+**                      SERIAL_WAIT_FOREVER to wait as long as it takes
+**
+**  Return Values:
+**      length of the frame
+**      -1 (SERIAL_ERROR_CODE) on error
+**      -2 (SERIAL_TIMEOUT_CODE) if no complete frame arrived in time
+**
+**  Errors:
+**      see SerialPortReadEx()
+**
+**  Description:
+**      Reads until the framer has a complete frame.  The frame is valid
+**      until the next call on the framer.  With the RX thread running the
+**      framer works directly on the ring, so frames that were not split
+**      are never copied at all.
+*/
+int SerialPortReadFrame(SERIAL_PORT *port, SERIAL_FRAMER *pfr,
+                        const uint8_t **ppbFrame, uint32_t timeOutMs) {
+
+    const uint8_t   *pb;
+    uint64_t        nsDeadline;
+    uint64_t        nsNow;
+    uint32_t        msLeft;
+    size_t          cbFrame;
+    size_t          cb;
+    int             rc;
+
+    nsDeadline = DeadlineFromMs(timeOutMs);
+
+    for (;;) {
+        if ( SerialFramerNext(pfr, ppbFrame, &cbFrame) ) {
+            return (int)cbFrame;
+        }
+
+        // the framer is done with the last chunk, hand ring space back
+        if ( pfr->portHeld != NULL ) {
+            if ( pfr->portHeld->prx != NULL ) {
+                RxConsume(pfr->portHeld, pfr->cbHeld);
+            }
+            pfr->portHeld = NULL;
+            pfr->cbHeld = 0;
+        }
+
+        if ( nsDeadline == UINT64_MAX ) {
+            msLeft = SERIAL_WAIT_FOREVER;
+        } else {
+            nsNow = MonoNowNs();
+            msLeft = ( nsNow >= nsDeadline ) ? 0 : (uint32_t)((nsDeadline - nsNow + 999999) / 1000000);
+        }
+
+        if ( port->prx != NULL ) {
+            cb = RingPeek(&port->prx->ring, &pb);
+            if ( cb == 0 ) {
+                rc = SerialPortRxWait(port, 1, msLeft);
+                if ( rc < 0 ) {
+                    return rc;
+                }
+                cb = RingPeek(&port->prx->ring, &pb);
+            }
+            pfr->portHeld = port;
+            pfr->cbHeld = cb;
+            SerialFramerPush(pfr, pb, cb);
+        } else {
+            rc = SerialPortReadEx(port, pfr->rgbRead, sizeof(pfr->rgbRead), 1, msLeft, 0);
+            if ( rc < 0 ) {
+                return rc;
+            }
+            SerialFramerPush(pfr, pfr->rgbRead, rc);
+        }
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    NextDelimited
+**
+**  Synopsis:
+**      bool NextDelimited(SERIAL_FRAMER *pfr, const uint8_t **ppbFrame,
+**                         size_t *pcbFrame)
+**
+**  Description:
+**      SerialFramerNext() for every framing that ends frames with a
+**      marker byte: delimiter, SLIP END and the COBS zero.
+*/
+static bool NextDelimited(SERIAL_FRAMER *pfr, const uint8_t **ppbFrame, size_t *pcbFrame) {
+
+    const uint8_t   *pbMark;
+    const uint8_t   *pbRaw;
+    size_t          cbRaw;
+    size_t          cbTake;
+    uint8_t         bMark;
+
+    switch ( pfr->cfg.type ) {
+        case SERIAL_FRAME_SLIP: bMark = SERIAL_SLIP_END; break;
+        case SERIAL_FRAME_COBS: bMark = 0; break;
+        default:                bMark = pfr->cfg.bDelimiter; break;
+    }
+
+    while ( pfr->cbIn > 0 ) {
+        pbMark = memchr(pfr->pbIn, bMark, pfr->cbIn);
+
+        if ( pbMark == NULL ) {
+            // the chunk ends mid-frame, keep the tail for the next push
+            if ( !pfr->fDiscard ) {
+                if ( pfr->cbAcc + pfr->cbIn > pfr->cbAccMax ) {
+                    pfr->fDiscard = true;
+                    pfr->cbAcc = 0;
+                    pfr->cDropped++;
+                } else {
+                    memcpy(pfr->rgbAcc + pfr->cbAcc, pfr->pbIn, pfr->cbIn);
+                    pfr->cbAcc += pfr->cbIn;
+                }
+            }
+            pfr->pbIn += pfr->cbIn;
+            pfr->cbIn = 0;
+            return false;
+        }
+
+        cbRaw = pbMark - pfr->pbIn;
+        cbTake = cbRaw;
+        if ( (pfr->cfg.type == SERIAL_FRAME_DELIMITER) && pfr->cfg.fKeepDelimiter ) {
+            cbTake++;
+        }
+
+        if ( pfr->fDiscard ) {
+            // end of the oversize frame, resume with the next one
+            pfr->fDiscard = false;
+            pbRaw = NULL;
+        } else if ( pfr->cbAcc == 0 ) {
+            pbRaw = pfr->pbIn;
+        } else if ( pfr->cbAcc + cbTake > pfr->cbAccMax ) {
+            pfr->cbAcc = 0;
+            pfr->cDropped++;
+            pbRaw = NULL;
+        } else {
+            memcpy(pfr->rgbAcc + pfr->cbAcc, pfr->pbIn, cbTake);
+            pbRaw = pfr->rgbAcc;
+            cbTake += pfr->cbAcc;
+            pfr->cbAcc = 0;
+        }
+
+        pfr->pbIn += cbRaw + 1;
+        pfr->cbIn -= cbRaw + 1;
+
+        if ( (pbRaw != NULL) && Decode(pfr, pbRaw, cbTake, ppbFrame, pcbFrame) ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* ------------------------------------------------------------ */
+/***    NextLength
+**
+**  Synopsis:
+**      bool NextLength(SERIAL_FRAMER *pfr, const uint8_t **ppbFrame,
+**                      size_t *pcbFrame)
+**
+**  Description:
+**      SerialFramerNext() for length prefixed frames.  A length that is
+**      too short or too long means the stream is out of step, the framer
+**      then slides forward one byte at a time until a plausible header
+**      turns up.
+*/
+static bool NextLength(SERIAL_FRAMER *pfr, const uint8_t **ppbFrame, size_t *pcbFrame) {
+
+    size_t  cbHdr = (size_t)pfr->cfg.ibLength + pfr->cfg.cbLength;
+    size_t  cbFrame;
+    size_t  cbNeed;
+
+    for (;;) {
+        if ( pfr->cbAcc == 0 ) {
+            if ( pfr->cbIn < cbHdr ) {
+                break;
+            }
+            cbFrame = ParseLength(&pfr->cfg, pfr->pbIn);
+            if ( cbFrame == 0 ) {
+                pfr->cDropped++;
+                pfr->pbIn++;
+                pfr->cbIn--;
+                continue;
+            }
+            if ( pfr->cbIn < cbFrame ) {
+                pfr->cbFrameLen = cbFrame;
+                break;
+            }
+            // whole frame in the chunk, hand it out in place
+            *ppbFrame = pfr->pbIn;
+            *pcbFrame = cbFrame;
+            pfr->pbIn += cbFrame;
+            pfr->cbIn -= cbFrame;
+            return true;
+        }
+
+        // continue the frame started in an earlier chunk
+        cbNeed = ( pfr->cbAcc < cbHdr ) ? cbHdr - pfr->cbAcc : pfr->cbFrameLen - pfr->cbAcc;
+        if ( cbNeed > pfr->cbIn ) {
+            cbNeed = pfr->cbIn;
+        }
+        memcpy(pfr->rgbAcc + pfr->cbAcc, pfr->pbIn, cbNeed);
+        pfr->cbAcc += cbNeed;
+        pfr->pbIn += cbNeed;
+        pfr->cbIn -= cbNeed;
+
+        if ( pfr->cbAcc == cbHdr ) {
+            pfr->cbFrameLen = ParseLength(&pfr->cfg, pfr->rgbAcc);
+            if ( pfr->cbFrameLen == 0 ) {
+                // slide one byte as the in place path does, the rest may start a header
+                pfr->cDropped++;
+                memmove(pfr->rgbAcc, pfr->rgbAcc + 1, cbHdr - 1);
+                pfr->cbAcc = cbHdr - 1;
+                continue;
+            }
+        }
+        if ( (pfr->cbAcc >= cbHdr) && (pfr->cbAcc == pfr->cbFrameLen) ) {
+            *ppbFrame = pfr->rgbAcc;
+            *pcbFrame = pfr->cbAcc;
+            pfr->cbAcc = 0;
+            return true;
+        }
+        if ( pfr->cbIn == 0 ) {
+            return false;
+        }
+    }
+
+    // keep the partial frame for the next push
+    memcpy(pfr->rgbAcc, pfr->pbIn, pfr->cbIn);
+    pfr->cbAcc = pfr->cbIn;
+    pfr->pbIn += pfr->cbIn;
+    pfr->cbIn = 0;
+    return false;
+}
+
+/* ------------------------------------------------------------ */
+/***    ParseLength
+**
+**  Synopsis:
+**      size_t ParseLength(const SERIAL_FRAME_CFG *pcfg, const uint8_t *pbHdr)
+**
+**  Return Values:
+**      size of the whole frame, 0 if the header cannot be right
+*/
+static size_t ParseLength(const SERIAL_FRAME_CFG *pcfg, const uint8_t *pbHdr) {
+
+    const uint8_t   *pb = pbHdr + pcfg->ibLength;
+    uint64_t        cbField;
+    int64_t         cbFrame;
+    size_t          ib;
+
+    cbField = 0;
+    for ( ib = 0; ib < pcfg->cbLength; ib++ ) {
+        size_t ibSrc = pcfg->fBigEndian ? ib : pcfg->cbLength - 1 - ib;
+        cbField = (cbField << 8) | pb[ibSrc];
+    }
+
+    cbFrame = (int64_t)cbField + pcfg->cbAdjust;
+    if ( (cbFrame < (int64_t)(pcfg->ibLength + pcfg->cbLength + SerialCrcSize(pcfg->crc))) ||
+         (cbFrame > (int64_t)pcfg->cbMaxFrame) ) {
+        return 0;
+    }
+    return (size_t)cbFrame;
+}
+
+/* ------------------------------------------------------------ */
+/***    EscapeSlip
+**
+**  Synopsis:
+**      uint8_t *EscapeSlip(uint8_t *pbo, const uint8_t *pbIn, size_t cbIn)
+**
+**  Return Values:
+**      pbo advanced past the escaped bytes
+*/
+static uint8_t *EscapeSlip(uint8_t *pbo, const uint8_t *pbIn, size_t cbIn) {
+
+    const uint8_t   *pbEnd = pbIn + cbIn;
+
+    for ( ; pbIn < pbEnd; pbIn++ ) {
+        if ( *pbIn == SERIAL_SLIP_END ) {
+            *pbo++ = SERIAL_SLIP_ESC;
+            *pbo++ = SERIAL_SLIP_ESC_END;
+        } else if ( *pbIn == SERIAL_SLIP_ESC ) {
+            *pbo++ = SERIAL_SLIP_ESC;
+            *pbo++ = SERIAL_SLIP_ESC_ESC;
+        } else {
+            *pbo++ = *pbIn;
+        }
+    }
+    return pbo;
+}
+
+/* ------------------------------------------------------------ */
+/***    Decode
+**
+**  Synopsis:
+**      bool Decode(SERIAL_FRAMER *pfr, const uint8_t *pbRaw, size_t cbRaw,
+**                  const uint8_t **ppbFrame, size_t *pcbFrame)
+**
+**  Description:
+**      Turns the bytes between two markers into the frame.  Plain and
+**      unescaped SLIP frames are passed through untouched.  SLIP escapes
+**      are located with memchr() and COBS blocks are copied whole, so the
+**      copy loop runs once per escape or block rather than per byte.
+**      Returns false for empty, oversize and malformed frames.
+*/
+static bool Decode(SERIAL_FRAMER *pfr, const uint8_t *pbRaw, size_t cbRaw,
+                   const uint8_t **ppbFrame, size_t *pcbFrame) {
+
+    const uint8_t   *pbEnd = pbRaw + cbRaw;
+    const uint8_t   *pbEsc;
+    uint8_t         *pbo;
+    uint8_t         *pboEnd;
+    size_t          cbRun;
+    uint8_t         bCode;
+
+    switch ( pfr->cfg.type ) {
+        case SERIAL_FRAME_DELIMITER:
+            if ( cbRaw > pfr->cfg.cbMaxFrame ) {
+                goto lDrop;
+            }
+            *ppbFrame = pbRaw;
+            *pcbFrame = cbRaw;
+            return true;
+
+        case SERIAL_FRAME_SLIP:
+            if ( cbRaw == 0 ) {
+                return false;
+            }
+            pbEsc = memchr(pbRaw, SERIAL_SLIP_ESC, cbRaw);
+            if ( pbEsc == NULL ) {
+                if ( cbRaw > pfr->cfg.cbMaxFrame ) {
+                    goto lDrop;
+                }
+                *ppbFrame = pbRaw;
+                *pcbFrame = cbRaw;
+                return true;
+            }
+            pbo = pfr->rgbOut;
+            pboEnd = pbo + pfr->cfg.cbMaxFrame;
+            while ( pbEsc != NULL ) {
+                cbRun = pbEsc - pbRaw;
+                if ( (pbEsc + 1 >= pbEnd) || ((size_t)(pboEnd - pbo) < cbRun + 1) ) {
+                    goto lDrop;
+                }
+                memcpy(pbo, pbRaw, cbRun);
+                pbo += cbRun;
+                if ( pbEsc[1] == SERIAL_SLIP_ESC_END ) {
+                    *pbo++ = SERIAL_SLIP_END;
+                } else if ( pbEsc[1] == SERIAL_SLIP_ESC_ESC ) {
+                    *pbo++ = SERIAL_SLIP_ESC;
+                } else {
+                    goto lDrop;
+                }
+                pbRaw = pbEsc + 2;
+                pbEsc = memchr(pbRaw, SERIAL_SLIP_ESC, pbEnd - pbRaw);
+            }
+            cbRun = pbEnd - pbRaw;
+            if ( (size_t)(pboEnd - pbo) < cbRun ) {
+                goto lDrop;
+            }
+            memcpy(pbo, pbRaw, cbRun);
+            pbo += cbRun;
+            *ppbFrame = pfr->rgbOut;
+            *pcbFrame = pbo - pfr->rgbOut;
+            return true;
+
+        case SERIAL_FRAME_COBS:
+            if ( cbRaw == 0 ) {
+                return false;
+            }
+            pbo = pfr->rgbOut;
+            pboEnd = pbo + pfr->cfg.cbMaxFrame;
+            while ( pbRaw < pbEnd ) {
+                bCode = *pbRaw++;
+                cbRun = bCode - 1;
+                if ( (bCode == 0) || (cbRun > (size_t)(pbEnd - pbRaw)) ||
+                     (cbRun > (size_t)(pboEnd - pbo)) ) {
+                    goto lDrop;
+                }
+                memcpy(pbo, pbRaw, cbRun);
+                pbo += cbRun;
+                pbRaw += cbRun;
+                if ( (bCode != 0xFF) && (pbRaw < pbEnd) ) {
+                    if ( pbo == pboEnd ) {
+                        goto lDrop;
+                    }
+                    *pbo++ = 0;
+                }
+            }
+            *ppbFrame = pfr->rgbOut;
+            *pcbFrame = pbo - pfr->rgbOut;
+            return true;
+
+        default:
+            break;
+    }
+
+lDrop:
+    pfr->cDropped++;
+    return false;
+}
+
+
+/************************************ EOF ********************************/
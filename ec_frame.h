@@ -0,0 +1,126 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_frame.h --  EmbedCreativity's Serial framing header file         */
+/*                                                                      */
+/************************************************************************/
+/*  Author:     agent                                                   */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*  This header file contains declarations the functions contained in   */
+/*  ec_frame.c                                                          */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026(agent): created                                          */
+/*  10/16/2026(agent): extern "C" guards for the C++ layer              */
+/*  10/16/2026(agent): optional CRC trailer                             */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(_SERIALFRAME_H)
+#define _SERIALFRAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ec_serial.h"
+#include "ec_crc.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------------ */
+/*                  Definitions                                 */
+/* ------------------------------------------------------------ */
+
+#define SERIAL_SLIP_END     0xC0
+#define SERIAL_SLIP_ESC     0xDB
+#define SERIAL_SLIP_ESC_END 0xDC
+#define SERIAL_SLIP_ESC_ESC 0xDD
+
+/* ------------------------------------------------------------ */
+/*                  General Type Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef enum {
+    SERIAL_FRAME_DELIMITER,     // frames end with bDelimiter
+    SERIAL_FRAME_LENGTH,        // a length field in the header gives the size
+    SERIAL_FRAME_SLIP,          // RFC 1055
+    SERIAL_FRAME_COBS           // consistent overhead byte stuffing, 0x00 ends a frame
+} SERIAL_FRAME_TYPE;
+
+typedef struct {
+    SERIAL_FRAME_TYPE   type;
+    size_t              cbMaxFrame;     // longer frames are dropped and counted, CRC included
+
+    // SERIAL_FRAME_DELIMITER
+    uint8_t             bDelimiter;
+    bool                fKeepDelimiter; // deliver the delimiter as the last byte
+
+    // SERIAL_FRAME_LENGTH
+    uint16_t            ibLength;       // offset of the length field in the frame
+    uint8_t             cbLength;       // size of the length field, 1, 2 or 4
+    bool                fBigEndian;     // byte order of the length field
+    int32_t             cbAdjust;       // whole frame size = length field + cbAdjust
+
+    // not with SERIAL_FRAME_DELIMITER, the CRC could contain the delimiter
+    SERIAL_CRC_TYPE     crc;            // trailer checked and removed by the framer
+} SERIAL_FRAME_CFG;
+
+// Called once per complete frame by SerialFramerFeed()
+typedef void (*SERIAL_FRAME_CB)(void *pvCtx, const uint8_t *pbFrame, size_t cbFrame);
+
+/* ------------------------------------------------------------ */
+/*                  Object Class Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef struct SERIAL_FRAMER SERIAL_FRAMER;
+
+/* ------------------------------------------------------------ */
+/*                  Function Prototypes                         */
+/* ------------------------------------------------------------ */
+
+SERIAL_FRAMER *SerialFramerCreate(const SERIAL_FRAME_CFG *pcfg);
+void    SerialFramerDestroy(SERIAL_FRAMER *pfr);
+void    SerialFramerReset(SERIAL_FRAMER *pfr);
+void    SerialFramerPush(SERIAL_FRAMER *pfr, const uint8_t *pb, size_t cb);
+bool    SerialFramerNext(SERIAL_FRAMER *pfr, const uint8_t **ppbFrame, size_t *pcbFrame);
+size_t  SerialFramerFeed(SERIAL_FRAMER *pfr, const uint8_t *pb, size_t cb,
+                         SERIAL_FRAME_CB pfnFrame, void *pvCtx);
+uint64_t SerialFramerDropped(SERIAL_FRAMER *pfr);
+uint64_t SerialFramerCrcErrors(SERIAL_FRAMER *pfr);
+size_t  SerialFrameEncode(const SERIAL_FRAME_CFG *pcfg, const uint8_t *pbIn, size_t cbIn,
+                          uint8_t *pbOut, size_t cbOutMax);
+size_t  SerialFrameEncodedMax(const SERIAL_FRAME_CFG *pcfg, size_t cbIn);
+int     SerialPortReadFrame(SERIAL_PORT *port, SERIAL_FRAMER *pfr,
+                            const uint8_t **ppbFrame, uint32_t timeOutMs);
+/* ------------------------------------------------------------ */
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+
+/**********************************  EOF  **************************************/
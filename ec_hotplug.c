@@ -0,0 +1,1010 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_hotplug.c --  EmbedCreativity's automatic reconnect              */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  A USB adapter that is pulled out, or resets itself, hangs up the    */
+/*  tty.  Every read and write then fails with EIO, and without help    */
+/*  the application has to notice, close the port, poll for the device  */
+/*  to come back and set it up again, losing whatever it sent while     */
+/*  doing so.                                                           */
+/*                                                                      */
+/*  SerialPortSetReconnect() keeps the port's handle usable across the  */
+/*  outage.  The first path that sees the hangup marks the port down;   */
+/*  from then on reads wait for the device instead of failing and       */
+/*  writes are queued.  One watcher thread, shared by every port,       */
+/*  waits on inotify for the device node or its /dev/serial/by-id link  */
+/*  to reappear, with a slow retry as a fallback.  It reopens the       */
+/*  path, applies the port's cached termios, rate and low latency       */
+/*  setting, and dup2()s the new device onto the port's descriptor so   */
+/*  the RX thread, the reactor and the application keep using the same  */
+/*  number.  The queued writes go out first, then the waiting readers   */
+/*  are woken.  The outage costs the time udev takes to create the      */
+/*  node, not a polling interval.                                       */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*  10/16/2026 (agent): a write whose drain fails is not queued again,  */
+/*                      the queue goes out without blocking the watcher */
+/*                                                                      */
+/************************************************************************/
+
+#define _GNU_SOURCE  /* ppoll */
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+
+#include "ec_serial.h"
+#include "ec_serial_priv.h"
+
+/* ------------------------------------------------------------ */
+/*              Local Type Definitions                          */
+/* ------------------------------------------------------------ */
+
+#define HOTPLUG_BY_ID       "/dev/serial/by-id"
+#define HOTPLUG_WATCH_MASK  (IN_CREATE | IN_ATTRIB | IN_MOVED_TO)
+#define HOTPLUG_FLUSH_MS    10      // next try at the queue while the device takes it
+
+// Reconnect state of one port, hung off port->photplug
+struct HOTPLUG {
+    struct HOTPLUG      *phpNext;       // watcher list, guarded by mtxWatch
+    SERIAL_PORT         *port;
+    SERIAL_RECONNECT_CFG cfg;
+    char                szPath[SERIAL_DEVICE_MAX];  // reopened by this name
+    int                 evtUp;          // eventfd, readable while the device is there
+    pthread_mutex_t     mtxTx;          // guards fDown going up or down and the queue
+    _Atomic bool        fDown;
+    uint64_t            nsDown;         // MonoNowNs() at the hangup
+    uint64_t            nsRetry;        // watcher only, next retry without an inotify event
+    bool                fLostSent;      // watcher only, SERIAL_CONN_LOST delivered
+    bool                fFailSent;      // watcher only, SERIAL_CONN_FAILED delivered
+    bool                fOpen;          // under mtxTx, reopened, the queue still going out
+    int                 flagsFd;        // watcher only, file status flags once the queue is out
+    int                 wd;             // watcher only, inotify watch on the directory, -1 for none
+    uint8_t             *pbTx;          // writes made while down
+    size_t              cbTx;
+    _Atomic uint64_t    cDisconnects;   // under mtxTx or on the watcher, see STAT_ADD
+    _Atomic uint64_t    cReconnects;
+    _Atomic uint64_t    cFailedOpens;
+    _Atomic uint64_t    nsLastDown;
+    _Atomic uint64_t    nsMaxDown;
+    _Atomic uint64_t    cbTxQueued;
+    _Atomic uint64_t    cbTxDropped;
+};
+
+typedef struct HOTPLUG HOTPLUG;
+
+// The watcher thread, started with the first port and stopped with the last
+static pthread_mutex_t  mtxWatchLife = PTHREAD_MUTEX_INITIALIZER;  // start/stop, taken first
+static pthread_mutex_t  mtxWatch = PTHREAD_MUTEX_INITIALIZER;      // list and callbacks
+static HOTPLUG          *phpFirst;
+static pthread_t        threadWatch;
+static int              evtWatchWake = -1;  // eventfd, a port went down or the thread should exit
+static bool             fWatchStop;
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static bool     ResolvePath( SERIAL_PORT *port, const char *szPath, char *szOut );
+static bool     MarkDown( HOTPLUG *php );
+static bool     WaitUp( HOTPLUG *php, int evtStop, uint64_t nsDeadline );
+static bool     IsHangup( int err );
+static void     *WatchThread( void *pv );
+static void     WatchPaths( int fdInotify, bool fAnyDown );
+static void     WatchPath( int fdInotify, HOTPLUG *php );
+static void     TryReopen( HOTPLUG *php );
+static bool     FlushQueue( HOTPLUG *php );
+static void     Notify( HOTPLUG *php, SERIAL_CONN_EVENT evt );
+static void     HotplugFree( HOTPLUG *php );
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    SerialPortSetReconnect
+**
+**  Synopsis:
+**      bool SerialPortSetReconnect(SERIAL_PORT *port,
+**                                  const SERIAL_RECONNECT_CFG *pcfg)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      *pcfg           how to reconnect, NULL turns reconnecting off
+**
+**  Return Values:
+**      1               success
+**      0               failure, nothing changed
+**
+**  Errors:
+**      EBUSY if reconnecting is already on, turn it off first, ENOMEM,
+**      ENAMETOOLONG, otherwise errno from eventfd() or pthread_create()
+**
+**  Description:
+**      From now on a hangup of the device no longer fails the port.
+**      Reads wait for the device to come back until their own deadline
+**      and return SERIAL_TIMEOUT_CODE if it does not.  Writes are queued,
+**      up to cbTxQueue bytes, and report the queued bytes as written;
+**      SERIAL_WRITE_DRAIN then only covers the part that reached the old
+**      device.  A write that reached it in full but whose drain failed
+**      returns SERIAL_DRAIN_ERROR_CODE and is not queued.  When the path
+**      reappears it is reopened with the port's current termios, rate
+**      and SERIAL_LL_DRIVER setting, the queue is sent, and the port
+**      carries on with the same descriptor number, so the RX thread and
+**      the reactor need no help.  Until the queue is out the port stays
+**      down, and new writes join the queue behind it.
+**
+**      With szPath NULL the port is reopened by its /dev/serial/by-id
+**      name when there is one, which follows an adapter that comes back
+**      as a different ttyUSB.  The hangup is noticed by the next read or
+**      write, at once by the RX thread or the reactor.
+**
+**      pfnEvent runs on the watcher thread shared by all ports, with the
+**      watcher's lock held.  It must not block for long, close a port or
+**      call SerialPortSetReconnect().  Turning reconnecting off, and
+**      closing the port, must not race other calls on the port.
+*/
+bool SerialPortSetReconnect(SERIAL_PORT *port, const SERIAL_RECONNECT_CFG *pcfg) {
+
+    HOTPLUG     *php;
+    int         errnoSave;
+
+    if ( pcfg == NULL ) {
+        HotplugPortFree(port);
+        return true;
+    }
+    if ( port->photplug != NULL ) {
+        errno = EBUSY;
+        return false;
+    }
+
+    php = calloc(1, sizeof(*php));
+    if ( php == NULL ) {
+        return false;
+    }
+    php->port = port;
+    php->cfg = *pcfg;
+    php->wd = -1;
+    if ( php->cfg.cbTxQueue == 0 ) {
+        php->cfg.cbTxQueue = SERIAL_RECONNECT_TX_DEFAULT;
+    }
+    if ( php->cfg.msRetry == 0 ) {
+        php->cfg.msRetry = SERIAL_RECONNECT_RETRY_DEFAULT;
+    }
+    if ( !ResolvePath(port, pcfg->szPath, php->szPath) ) {
+        free(php);
+        return false;
+    }
+    php->cfg.szPath = php->szPath;
+    pthread_mutex_init(&php->mtxTx, NULL);
+    php->evtUp = eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ( php->evtUp < 0 ) {
+        goto lErrorFree;
+    }
+
+    pthread_mutex_lock(&mtxWatchLife);
+    if ( phpFirst == NULL ) {
+        evtWatchWake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if ( evtWatchWake < 0 ) {
+            pthread_mutex_unlock(&mtxWatchLife);
+            goto lErrorFree;
+        }
+        fWatchStop = false;
+        errno = pthread_create(&threadWatch, NULL, WatchThread, NULL);
+        if ( errno != 0 ) {
+            errnoSave = errno;
+            close(evtWatchWake);
+            evtWatchWake = -1;
+            pthread_mutex_unlock(&mtxWatchLife);
+            errno = errnoSave;
+            goto lErrorFree;
+        }
+    }
+    pthread_mutex_lock(&mtxWatch);
+    php->phpNext = phpFirst;
+    phpFirst = php;
+    port->photplug = php;
+    pthread_mutex_unlock(&mtxWatch);
+    pthread_mutex_unlock(&mtxWatchLife);
+
+    SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL %s: reconnect by %s", port->szDevice, php->szPath);
+    return true;
+
+lErrorFree:
+    errnoSave = errno;
+    HotplugFree(php);
+    errno = errnoSave;
+    return false;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortIsConnected
+**
+**  Synopsis:
+**      bool SerialPortIsConnected(SERIAL_PORT *port)
+**
+**  Return Values:
+**      1               the device is there
+**      0               it hung up, with SerialPortSetReconnect() it is
+**                      being waited for
+**
+**  Description:
+**      Checks the descriptor for a hangup, so the answer is current even
+**      when no I/O has run into it yet.
+*/
+bool SerialPortIsConnected(SERIAL_PORT *port) {
+
+    struct pollfd   pfd;
+
+    if ( port->photplug != NULL ) {
+        return !HotplugLost(port);
+    }
+    pfd.fd = port->fd;
+    pfd.events = 0;
+    return !( (poll(&pfd, 1, 0) > 0) && (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) );
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortGetReconnectStats
+**
+**  Synopsis:
+**      void SerialPortGetReconnectStats(SERIAL_PORT *port,
+**                                       SERIAL_RECONNECT_STATS *pstats)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      *pstats         receives the counts, zeroed without reconnecting
+**
+**  Description:
+**      Counts since SerialPortSetReconnect().  nsLastDown runs from the
+**      I/O that saw the hangup to the queue being sent, the outage as the
+**      application saw it.
+*/
+void SerialPortGetReconnectStats(SERIAL_PORT *port, SERIAL_RECONNECT_STATS *pstats) {
+
+    HOTPLUG     *php = port->photplug;
+
+    memset(pstats, 0, sizeof(*pstats));
+    if ( php == NULL ) {
+        return;
+    }
+    pstats->cDisconnects = atomic_load_explicit(&php->cDisconnects, memory_order_relaxed);
+    pstats->cReconnects = atomic_load_explicit(&php->cReconnects, memory_order_relaxed);
+    pstats->cFailedOpens = atomic_load_explicit(&php->cFailedOpens, memory_order_relaxed);
+    pstats->nsLastDown = atomic_load_explicit(&php->nsLastDown, memory_order_relaxed);
+    pstats->nsMaxDown = atomic_load_explicit(&php->nsMaxDown, memory_order_relaxed);
+    pstats->cbTxQueued = atomic_load_explicit(&php->cbTxQueued, memory_order_relaxed);
+    pstats->cbTxDropped = atomic_load_explicit(&php->cbTxDropped, memory_order_relaxed);
+}
+
+/* ------------------------------------------------------------ */
+/***    HotplugReadEx
+**
+**  Synopsis:
+**      int HotplugReadEx(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+**                        uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs)
+**
+**  Description:
+**      SerialPortReadEx() on a port with reconnecting on.  A hangup, seen
+**      here or elsewhere, turns into a wait for the device within the
+**      same deadline, after which the read starts over on the new one.
+*/
+int HotplugReadEx(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+                  uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs) {
+
+    HOTPLUG     *php = port->photplug;
+    uint64_t    nsDeadline;
+    uint64_t    nsNow;
+    uint32_t    msLeft;
+    int         rc;
+
+    nsDeadline = DeadlineFromMs(timeOutMs);
+    for ( ; ; ) {
+        if ( atomic_load(&php->fDown) && !WaitUp(php, -1, nsDeadline) ) {
+            STAT_ADD_SHARED(port->stats.cTimeouts, 1);
+            return SERIAL_TIMEOUT_CODE;
+        }
+
+        msLeft = SERIAL_WAIT_FOREVER;
+        if ( nsDeadline != UINT64_MAX ) {
+            nsNow = MonoNowNs();
+            msLeft = ( nsNow < nsDeadline ) ? (uint32_t)((nsDeadline - nsNow + 999999) / 1000000) : 0;
+        }
+        rc = PortReadAny(port, result, len, minLen, msLeft, interByteUs);
+        if ( (rc != SERIAL_ERROR_CODE) || !IsHangup(errno) || !HotplugLost(port) ) {
+            return rc;
+        }
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    HotplugWriteV
+**
+**  Synopsis:
+**      int HotplugWriteV(SERIAL_PORT *port, const struct iovec *rgiov,
+**                        int ciov, uint32_t flags)
+**
+**  Description:
+**      SerialPortWriteV() on a port with reconnecting on.  What the
+**      device did not take because it hung up is queued for the
+**      reconnect, in order behind anything queued before.  Only
+**      writev() decides that, SERIAL_DRAIN_ERROR_CODE means every byte
+**      reached the old device.  Once the device is back but still
+**      taking the queue, a write waits for it like for a full driver
+**      buffer, so a fast writer cannot keep the port down by refilling
+**      the queue.
+*/
+int HotplugWriteV(SERIAL_PORT *port, const struct iovec *rgiov, int ciov, uint32_t flags) {
+
+    HOTPLUG     *php = port->photplug;
+    size_t      cbTotal;
+    size_t      cbDone;
+    size_t      cbSkip;
+    size_t      cbCopy;
+    uint8_t     *pb;
+    int         iiov;
+    int         rc;
+
+    cbTotal = 0;
+    for ( iiov = 0; iiov < ciov; iiov++ ) {
+        cbTotal += rgiov[iiov].iov_len;
+    }
+
+    cbDone = 0;
+    for ( ; ; ) {
+        if ( !atomic_load(&php->fDown) ) {
+            rc = PortWriteV(port, rgiov, ciov, flags);
+            if ( (rc == (int)cbTotal) || (rc == SERIAL_DRAIN_ERROR_CODE) || !IsHangup(errno) ) {
+                return rc;
+            }
+            cbDone = ( rc > 0 ) ? (size_t)rc : 0;
+        }
+
+        pthread_mutex_lock(&php->mtxTx);
+        if ( !MarkDown(php) ) {
+            // connected, either it came back already or the error was not a hangup
+            pthread_mutex_unlock(&php->mtxTx);
+            if ( cbDone > 0 ) {
+                return (int)cbDone;
+            }
+            return PortWriteV(port, rgiov, ciov, flags);
+        }
+        if ( !php->fOpen || (cbDone > 0) ) {
+            break;
+        }
+
+        // back already and busy with the queue
+        pthread_mutex_unlock(&php->mtxTx);
+        if ( flags & SERIAL_WRITE_NOWAIT ) {
+            errno = EAGAIN;
+            return 0;
+        }
+        (void)WaitUp(php, -1, MonoNowNs() + (uint64_t)HOTPLUG_FLUSH_MS * 1000000);
+    }
+
+    if ( php->pbTx == NULL ) {
+        php->pbTx = malloc(php->cfg.cbTxQueue);
+        if ( php->pbTx == NULL ) {
+            pthread_mutex_unlock(&php->mtxTx);
+            return ( cbDone > 0 ) ? (int)cbDone : SERIAL_ERROR_CODE;
+        }
+    }
+
+    // append what the device did not take, skipping the part it did
+    pb = php->pbTx;
+    cbSkip = cbDone;
+    for ( iiov = 0; (iiov < ciov) && (php->cbTx < php->cfg.cbTxQueue); iiov++ ) {
+        if ( cbSkip >= rgiov[iiov].iov_len ) {
+            cbSkip -= rgiov[iiov].iov_len;
+            continue;
+        }
+        cbCopy = rgiov[iiov].iov_len - cbSkip;
+        if ( cbCopy > php->cfg.cbTxQueue - php->cbTx ) {
+            cbCopy = php->cfg.cbTxQueue - php->cbTx;
+        }
+        memcpy(pb + php->cbTx, (const uint8_t *)rgiov[iiov].iov_base + cbSkip, cbCopy);
+        php->cbTx += cbCopy;
+        cbDone += cbCopy;
+        cbSkip = 0;
+    }
+    if ( cbDone < cbTotal ) {
+        STAT_ADD(php->cbTxDropped, cbTotal - cbDone);
+    }
+    pthread_mutex_unlock(&php->mtxTx);
+
+    if ( cbDone == 0 ) {
+        errno = ENOBUFS;
+        return SERIAL_ERROR_CODE;
+    }
+    return (int)cbDone;
+}
+
+/* ------------------------------------------------------------ */
+/***    HotplugLost
+**
+**  Synopsis:
+**      bool HotplugLost(SERIAL_PORT *port)
+**
+**  Return Values:
+**      1               the port is down, the watcher is on it
+**      0               the descriptor shows no hangup, the device is
+**                      there or was reconnected already
+**
+**  Description:
+**      Called by whichever path ran into an error or a hangup on a port
+**      with reconnecting on.
+*/
+bool HotplugLost(SERIAL_PORT *port) {
+
+    HOTPLUG     *php = port->photplug;
+    bool        fDown;
+
+    pthread_mutex_lock(&php->mtxTx);
+    fDown = MarkDown(php);
+    pthread_mutex_unlock(&php->mtxTx);
+    return fDown;
+}
+
+/* ------------------------------------------------------------ */
+/***    HotplugWaitUp
+**
+**  Synopsis:
+**      bool HotplugWaitUp(SERIAL_PORT *port, int evtStop)
+**
+**  Parameters:
+**      *port           port with reconnecting on
+**      evtStop         eventfd that ends the wait early, -1 for none
+**
+**  Return Values:
+**      1               the device is back
+**      0               evtStop was signalled
+**
+**  Description:
+**      Lets the RX thread and the broker sleep through an outage.
+*/
+bool HotplugWaitUp(SERIAL_PORT *port, int evtStop) {
+
+    return WaitUp(port->photplug, evtStop, UINT64_MAX);
+}
+
+/* ------------------------------------------------------------ */
+/***    HotplugPortFree
+**
+**  Synopsis:
+**      void HotplugPortFree(SERIAL_PORT *port)
+**
+**  Description:
+**      Turns reconnecting off, dropping anything still queued.  The
+**      watcher thread exits with the last port.  Called by
+**      SerialPortClose() once the RX thread and the reactor are done
+**      with the port.
+*/
+void HotplugPortFree(SERIAL_PORT *port) {
+
+    HOTPLUG     *php = port->photplug;
+    HOTPLUG     **pphp;
+    uint64_t    cWake = 1;
+
+    if ( php == NULL ) {
+        return;
+    }
+
+    pthread_mutex_lock(&mtxWatchLife);
+    pthread_mutex_lock(&mtxWatch);
+    for ( pphp = &phpFirst; *pphp != NULL; pphp = &(*pphp)->phpNext ) {
+        if ( *pphp == php ) {
+            *pphp = php->phpNext;
+            break;
+        }
+    }
+    port->photplug = NULL;
+    if ( phpFirst == NULL ) {
+        fWatchStop = true;
+    }
+    pthread_mutex_unlock(&mtxWatch);
+
+    if ( phpFirst == NULL ) {
+        (void)write(evtWatchWake, &cWake, sizeof(cWake));
+        pthread_join(threadWatch, NULL);
+        close(evtWatchWake);
+        evtWatchWake = -1;
+    }
+    pthread_mutex_unlock(&mtxWatchLife);
+
+    if ( php->fOpen ) {
+        (void)fcntl(port->fd, F_SETFL, php->flagsFd);
+    }
+    if ( php->cbTx > 0 ) {
+        SERIAL_LOG(SERIAL_LOG_WARN, "SERIAL %s: %zu queued bytes dropped", port->szDevice, php->cbTx);
+    }
+    HotplugFree(php);
+}
+
+/* Frees the state of a port, which is on no list. */
+static void HotplugFree(HOTPLUG *php) {
+
+    if ( php->evtUp >= 0 ) {
+        close(php->evtUp);
+    }
+    pthread_mutex_destroy(&php->mtxTx);
+    free(php->pbTx);
+    free(php);
+}
+
+/* ------------------------------------------------------------ */
+/***    ResolvePath
+**
+**  Synopsis:
+**      static bool ResolvePath(SERIAL_PORT *port, const char *szPath, char *szOut)
+**
+**  Description:
+**      Picks the name to reopen the port by, szPath if given, otherwise
+**      the /dev/serial/by-id link pointing at the device, otherwise the
+**      name it was opened by.  szOut holds SERIAL_DEVICE_MAX bytes.
+*/
+static bool ResolvePath(SERIAL_PORT *port, const char *szPath, char *szOut) {
+
+    char            szDev[PATH_MAX];
+    char            szLink[PATH_MAX];
+    char            szTarget[PATH_MAX];
+    DIR             *pdir;
+    struct dirent   *pde;
+
+    if ( szPath == NULL ) {
+        szPath = port->szDevice;
+        if ( (strncmp(szPath, "/dev/serial/", 12) != 0) &&
+             (realpath(port->szDevice, szDev) != NULL) &&
+             ((pdir = opendir(HOTPLUG_BY_ID)) != NULL) ) {
+            while ( (pde = readdir(pdir)) != NULL ) {
+                if ( pde->d_name[0] == '.' ) {
+                    continue;
+                }
+                snprintf(szLink, sizeof(szLink), "%s/%s", HOTPLUG_BY_ID, pde->d_name);
+                if ( (realpath(szLink, szTarget) != NULL) && (strcmp(szTarget, szDev) == 0) ) {
+                    if ( strlen(szLink) < SERIAL_DEVICE_MAX ) {
+                        strcpy(szOut, szLink);
+                        closedir(pdir);
+                        return true;
+                    }
+                }
+            }
+            closedir(pdir);
+        }
+    }
+
+    if ( strlen(szPath) >= SERIAL_DEVICE_MAX ) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    strcpy(szOut, szPath);
+    return true;
+}
+
+/* Hangup codes from a device that went away, as opposed to a bad call. */
+static bool IsHangup(int err) {
+
+    return (err == EIO) || (err == ENODEV) || (err == ENXIO) || (err == EBADF);
+}
+
+/* ------------------------------------------------------------ */
+/***    MarkDown
+**
+**  Synopsis:
+**      static bool MarkDown(HOTPLUG *php)
+**
+**  Return Values:
+**      1               the port is down, now or already
+**      0               the descriptor shows no hangup
+**
+**  Description:
+**      Marks the port down if its descriptor has hung up and hands it to
+**      the watcher.  A descriptor reopened by the watcher does not show
+**      the hangup, so a late report of the old one changes nothing.
+**      Called with mtxTx held.
+*/
+static bool MarkDown(HOTPLUG *php) {
+
+    struct pollfd   pfd;
+    uint64_t        cUp;
+    uint64_t        cWake = 1;
+
+    if ( atomic_load(&php->fDown) ) {
+        return true;
+    }
+    pfd.fd = php->port->fd;
+    pfd.events = 0;
+    if ( (poll(&pfd, 1, 0) <= 0) || !(pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) ) {
+        return false;
+    }
+
+    php->nsDown = MonoNowNs();
+    (void)read(php->evtUp, &cUp, sizeof(cUp));
+    atomic_store(&php->fDown, true);
+    STAT_ADD(php->cDisconnects, 1);
+    SERIAL_LOG(SERIAL_LOG_WARN, "SERIAL %s: device lost, waiting for %s", php->port->szDevice, php->szPath);
+    (void)write(evtWatchWake, &cWake, sizeof(cWake));
+    return true;
+}
+
+/* Sleeps until the port is up, evtStop fires or nsDeadline passes. */
+static bool WaitUp(HOTPLUG *php, int evtStop, uint64_t nsDeadline) {
+
+    struct pollfd   rgpfd[2];
+    struct timespec tsWait;
+    uint64_t        nsNow;
+    int             rc;
+
+    rgpfd[0].fd = php->evtUp;
+    rgpfd[0].events = POLLIN;
+    rgpfd[1].fd = evtStop;
+    rgpfd[1].events = POLLIN;
+    rgpfd[1].revents = 0;
+
+    while ( atomic_load(&php->fDown) ) {
+        nsNow = MonoNowNs();
+        if ( nsNow >= nsDeadline ) {
+            return false;
+        }
+        if ( nsDeadline != UINT64_MAX ) {
+            tsWait.tv_sec = (nsDeadline - nsNow) / 1000000000;
+            tsWait.tv_nsec = (nsDeadline - nsNow) % 1000000000;
+        }
+        rc = ppoll(rgpfd, ( evtStop >= 0 ) ? 2 : 1, ( nsDeadline == UINT64_MAX ) ? NULL : &tsWait, NULL);
+        if ( (rc < 0) && (errno != EINTR) ) {
+            return false;
+        }
+        if ( (rc > 0) && (rgpfd[1].revents & POLLIN) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+/***    WatchThread
+**
+**  Synopsis:
+**      static void *WatchThread(void *pv)
+**
+**  Description:
+**      Serves every port with reconnecting on.  While any is down it
+**      watches their directories through inotify and retries a port on
+**      any event there, or every msRetry in case the event was missed,
+**      for instance on a path whose parent did not exist yet.  The
+**      watches only exist during outages, so device churn in /dev costs
+**      nothing the rest of the time.  The inotify descriptor itself
+**      lives as long as the thread, closing one takes the kernel several
+**      milliseconds.
+*/
+static void *WatchThread(void *pv) {
+
+    struct pollfd   rgpfd[2];
+    struct timespec tsWait;
+    HOTPLUG         *php;
+    uint64_t        nsNow;
+    uint64_t        nsNext;
+    uint64_t        cWake;
+    uint8_t         rgbEvents[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int             fdInotify;
+    bool            fEvent = false;
+    bool            fAnyDown;
+
+    (void)pv;
+    fdInotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if ( fdInotify < 0 ) {
+        SERIAL_LOG(SERIAL_LOG_WARN, "SERIAL reconnect without inotify %d %s, retrying only",
+                   errno, strerror(errno));
+    }
+
+    pthread_mutex_lock(&mtxWatch);
+    while ( !fWatchStop ) {
+        nsNow = MonoNowNs();
+        nsNext = UINT64_MAX;
+        fAnyDown = false;
+        for ( php = phpFirst; php != NULL; php = php->phpNext ) {
+            if ( !atomic_load(&php->fDown) ) {
+                continue;
+            }
+            if ( !php->fLostSent ) {
+                php->fLostSent = true;
+                php->fFailSent = false;
+                Notify(php, SERIAL_CONN_LOST);
+                // it may be back already, try once the watch is there to catch it later
+                WatchPath(fdInotify, php);
+                php->nsRetry = nsNow;
+            }
+            if ( fEvent || (nsNow >= php->nsRetry) ) {
+                TryReopen(php);
+                php->nsRetry = nsNow + (uint64_t)( php->fOpen ? HOTPLUG_FLUSH_MS : php->cfg.msRetry ) * 1000000;
+            }
+            if ( atomic_load(&php->fDown) ) {
+                fAnyDown = true;
+                if ( php->nsRetry < nsNext ) {
+                    nsNext = php->nsRetry;
+                }
+            }
+        }
+
+        if ( fdInotify >= 0 ) {
+            WatchPaths(fdInotify, fAnyDown);
+        }
+        pthread_mutex_unlock(&mtxWatch);
+
+        rgpfd[0].fd = evtWatchWake;
+        rgpfd[0].events = POLLIN;
+        rgpfd[1].fd = fdInotify;
+        rgpfd[1].events = POLLIN;
+        rgpfd[1].revents = 0;
+        nsNow = MonoNowNs();
+        if ( nsNext != UINT64_MAX ) {
+            nsNext = ( nsNext > nsNow ) ? nsNext - nsNow : 0;
+            tsWait.tv_sec = nsNext / 1000000000;
+            tsWait.tv_nsec = nsNext % 1000000000;
+        }
+        (void)ppoll(rgpfd, ( fdInotify >= 0 ) ? 2 : 1, ( nsNext == UINT64_MAX ) ? NULL : &tsWait, NULL);
+
+        if ( rgpfd[0].revents & POLLIN ) {
+            (void)read(evtWatchWake, &cWake, sizeof(cWake));
+        }
+        // the names in the events do not matter, any change is worth a retry
+        fEvent = false;
+        if ( rgpfd[1].revents & POLLIN ) {
+            while ( read(fdInotify, rgbEvents, sizeof(rgbEvents)) > 0 ) {
+                fEvent = true;
+            }
+        }
+        pthread_mutex_lock(&mtxWatch);
+    }
+    pthread_mutex_unlock(&mtxWatch);
+
+    if ( fdInotify >= 0 ) {
+        close(fdInotify);
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------ */
+/***    WatchPaths
+**
+**  Synopsis:
+**      static void WatchPaths(int fdInotify, bool fAnyDown)
+**
+**  Description:
+**      Adds a watch on the directory of every missing path, or on the
+**      nearest parent that exists, /dev/serial/by-id is removed along
+**      with the last adapter.  Adding a watch twice is harmless, so this
+**      runs on every pass.  Once no port is down all the watches go.
+**      Called with mtxWatch held.
+*/
+static void WatchPaths(int fdInotify, bool fAnyDown) {
+
+    HOTPLUG     *php;
+
+    for ( php = phpFirst; php != NULL; php = php->phpNext ) {
+        if ( !fAnyDown ) {
+            // ports sharing a directory share the watch, the second removal fails harmlessly
+            if ( php->wd >= 0 ) {
+                (void)inotify_rm_watch(fdInotify, php->wd);
+                php->wd = -1;
+            }
+            continue;
+        }
+        if ( atomic_load(&php->fDown) ) {
+            WatchPath(fdInotify, php);
+        }
+    }
+}
+
+/* Watches the directory of one port's path, or its nearest existing parent. */
+static void WatchPath(int fdInotify, HOTPLUG *php) {
+
+    char        szDir[SERIAL_DEVICE_MAX];
+    char        *pch;
+
+    if ( fdInotify < 0 ) {
+        return;
+    }
+    strcpy(szDir, php->szPath);
+    while ( ((pch = strrchr(szDir, '/')) != NULL) && (pch != szDir) ) {
+        *pch = '\0';
+        php->wd = inotify_add_watch(fdInotify, szDir, HOTPLUG_WATCH_MASK);
+        if ( (php->wd >= 0) || (errno != ENOENT) ) {
+            break;
+        }
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    TryReopen
+**
+**  Synopsis:
+**      static void TryReopen(HOTPLUG *php)
+**
+**  Description:
+**      Opens the path and, if that works, sets the device up the way the
+**      port had it and puts it under the port's descriptor.  The queue
+**      is sent before the port is marked up, so new writes cannot pass
+**      it.  The descriptor stays non-blocking until then, a device that
+**      takes the queue slowly gets the rest on the next passes instead
+**      of holding mtxTx and the watcher.  Called on the watcher thread
+**      with mtxWatch held.
+*/
+static void TryReopen(HOTPLUG *php) {
+
+    SERIAL_PORT     *port = php->port;
+    uint64_t        cUp = 1;
+    uint64_t        nsDown;
+    int             fd;
+    int             flags;
+
+    if ( php->fOpen ) {
+        // back already, only the queue is left
+        pthread_mutex_lock(&php->mtxTx);
+        goto lFlush;
+    }
+
+    fd = open(php->szPath, O_RDWR | O_NOCTTY | O_NDELAY);
+    if ( fd < 0 ) {
+        if ( errno == ENOENT ) {
+            return;     // not back yet
+        }
+        goto lFailed;
+    }
+
+    // the cached settings, the old blocking mode once the queue is out
+    flags = fcntl(port->fd, F_GETFL);
+    if ( (flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) ||
+         (tcsetattr(fd, TCSANOW, &port->termios) != 0) ||
+         ((port->baudRate > 0) && (BaudGetFd(fd) != port->baudRate) && !BaudSetFd(fd, port->baudRate)) ) {
+        close(fd);
+        goto lFailed;
+    }
+
+    pthread_mutex_lock(&php->mtxTx);
+    if ( dup2(fd, port->fd) < 0 ) {
+        pthread_mutex_unlock(&php->mtxTx);
+        close(fd);
+        goto lFailed;
+    }
+    close(fd);
+    php->fOpen = true;
+    php->flagsFd = flags;
+    LowLatencyReapply(port);
+    FlowRebaseLineCounts(port);
+
+lFlush:
+    if ( !FlushQueue(php) ) {
+        // full for now, or gone again already and the descriptor shows it
+        php->fOpen = !IsHangup(errno);
+        pthread_mutex_unlock(&php->mtxTx);
+        return;
+    }
+    php->fOpen = false;
+    (void)fcntl(port->fd, F_SETFL, php->flagsFd);
+    atomic_store(&php->fDown, false);
+    (void)write(php->evtUp, &cUp, sizeof(cUp));
+    pthread_mutex_unlock(&php->mtxTx);
+
+    ReactorReconnected(port);
+    nsDown = MonoNowNs() - php->nsDown;
+    STAT_ADD(php->cReconnects, 1);
+    atomic_store_explicit(&php->nsLastDown, nsDown, memory_order_relaxed);
+    if ( nsDown > atomic_load_explicit(&php->nsMaxDown, memory_order_relaxed) ) {
+        atomic_store_explicit(&php->nsMaxDown, nsDown, memory_order_relaxed);
+    }
+    php->fLostSent = false;
+    SERIAL_LOG(SERIAL_LOG_INFO, "SERIAL %s: reconnected by %s after %llu ms", port->szDevice, php->szPath,
+               (unsigned long long)(nsDown / 1000000));
+    Notify(php, SERIAL_CONN_RESTORED);
+    return;
+
+lFailed:
+    STAT_ADD(php->cFailedOpens, 1);
+    SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL %s: reopening %s failed %d %s", port->szDevice, php->szPath,
+               errno, strerror(errno));
+    if ( !php->fFailSent ) {
+        php->fFailSent = true;
+        Notify(php, SERIAL_CONN_FAILED);
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    FlushQueue
+**
+**  Synopsis:
+**      static bool FlushQueue(HOTPLUG *php)
+**
+**  Return Values:
+**      1               the queue is empty
+**      0               the device is full, errno EAGAIN, or hung up
+**                      again, the rest is still queued
+**
+**  Description:
+**      Sends as much of the writes made during the outage as the new
+**      device takes without waiting.  Any other error drops them, the
+**      device is there but refuses them.  Called with mtxTx held.
+*/
+static bool FlushQueue(HOTPLUG *php) {
+
+    struct iovec    iov;
+    int             rc;
+
+    if ( php->cbTx == 0 ) {
+        return true;
+    }
+    iov.iov_base = php->pbTx;
+    iov.iov_len = php->cbTx;
+    rc = PortWriteV(php->port, &iov, 1, SERIAL_WRITE_NOWAIT);
+    if ( rc > 0 ) {
+        STAT_ADD(php->cbTxQueued, rc);
+        php->cbTx -= rc;
+        memmove(php->pbTx, php->pbTx + rc, php->cbTx);
+    }
+    if ( php->cbTx == 0 ) {
+        return true;
+    }
+    if ( (errno == EAGAIN) || (errno == EWOULDBLOCK) || IsHangup(errno) ) {
+        return false;
+    }
+    SERIAL_LOG(SERIAL_LOG_WARN, "SERIAL %s: %zu queued bytes dropped, write error %d %s",
+               php->port->szDevice, php->cbTx, errno, strerror(errno));
+    STAT_ADD(php->cbTxDropped, php->cbTx);
+    php->cbTx = 0;
+    return true;
+}
+
+/* Runs the port's listener, if it has one. */
+static void Notify(HOTPLUG *php, SERIAL_CONN_EVENT evt) {
+
+    if ( php->cfg.pfnEvent != NULL ) {
+        php->cfg.pfnEvent(php->cfg.pvCtx, php->port, evt);
+    }
+}
+
+
+/************************************ EOF ********************************/
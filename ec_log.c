@@ -0,0 +1,139 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_log.c --  EmbedCreativity's serial library diagnostics sink      */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Every message the library produces goes through SerialLog().  By    */
+/*  default errors, warnings and open/close notices are printed to      */
+/*  stdout as before.  Messages from inside the I/O loops are logged at */
+/*  SERIAL_LOG_DEBUG, which is filtered out before any formatting is    */
+/*  done, so a default build does no stdio work on the hot path.        */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*                                                                      */
+/************************************************************************/
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "ec_serial.h"
+#include "ec_serial_priv.h"
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static void     LogStdout( void *pvCtx, SERIAL_LOG_LEVEL level, const char *szMsg );
+
+/* ------------------------------------------------------------ */
+/*              Global Variables                                */
+/* ------------------------------------------------------------ */
+
+int levelSerialLog = SERIAL_LOG_INFO;   // most verbose level anyone wants, -1 for none
+
+/* ------------------------------------------------------------ */
+/*              Local Variables                                 */
+/* ------------------------------------------------------------ */
+
+static SERIAL_LOG_FN    pfnSerialLog = LogStdout;
+static void             *pvSerialLogCtx;
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    SerialSetLogger
+**
+**  Synopsis:
+**      void SerialSetLogger(SERIAL_LOG_FN pfnLog, void *pvCtx,
+**                           SERIAL_LOG_LEVEL levelMax)
+**
+**  Parameters:
+**      pfnLog          receives the messages, NULL silences the library
+**      pvCtx           passed through to pfnLog
+**      levelMax        most verbose level delivered
+**
+**  Return Values:
+**      none
+**
+**  Errors:
+**      none
+**
+**  Description:
+**      Replaces the default stdout sink for the whole process.  Call it
+**      before opening ports, the sink is read without locking.  The sink
+**      may be called from the RX thread and from any thread doing I/O.
+*/
+void SerialSetLogger(SERIAL_LOG_FN pfnLog, void *pvCtx, SERIAL_LOG_LEVEL levelMax) {
+
+    pfnSerialLog = pfnLog;
+    pvSerialLogCtx = pvCtx;
+    levelSerialLog = ( pfnLog != NULL ) ? (int)levelMax : -1;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialLog
+**
+**  Synopsis:
+**      void SerialLog(SERIAL_LOG_LEVEL level, const char *szFmt, ...)
+**
+**  Description:
+**      Formats a message and hands it to the sink.  Called through the
+**      SERIAL_LOG() macro, which has already checked the level.
+*/
+void SerialLog(SERIAL_LOG_LEVEL level, const char *szFmt, ...) {
+
+    char    szMsg[256];
+    va_list args;
+
+    if ( pfnSerialLog == NULL ) {
+        return;
+    }
+
+    va_start(args, szFmt);
+    vsnprintf(szMsg, sizeof(szMsg), szFmt, args);
+    va_end(args);
+
+    pfnSerialLog(pvSerialLogCtx, level, szMsg);
+}
+
+static void LogStdout(void *pvCtx, SERIAL_LOG_LEVEL level, const char *szMsg) {
+
+    (void)pvCtx;
+    (void)level;
+    printf("%s\n", szMsg);
+}
+
+
+/************************************ EOF ********************************/
@@ -0,0 +1,263 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_lowlat.c --  EmbedCreativity's low latency port profile          */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Most of the turnaround time of a USB serial adapter is spent        */
+/*  waiting: for the adapter's latency timer (16 ms on FTDI parts), for */
+/*  the tty layer to push the data up, and for the scheduler to wake    */
+/*  the reader.  SerialPortSetLowLatency() attacks each of these:       */
+/*                                                                      */
+/*    SERIAL_LL_DRIVER     ASYNC_LOW_LATENCY through TIOCSSERIAL.  On   */
+/*                         ftdi_sio this drops the latency timer to     */
+/*                         1 ms, on 8250 UARTs it flips data to the     */
+/*                         reader without the workqueue hop.            */
+/*    SERIAL_LL_BUSY_POLL  waiting reads spin for up to spinUs before   */
+/*                         going to sleep, given a second CPU to run    */
+/*                         the other side on                            */
+/*    SERIAL_LL_RX_CPU     the RX thread stays on one CPU               */
+/*    SERIAL_LL_RX_FIFO    the RX thread preempts normal threads        */
+/*                                                                      */
+/*  Every part is best effort; the return value says what took hold.    */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*  10/16/2026 (agent): SERIAL_LL_DRIVER is set again after a reconnect */
+/*                                                                      */
+/************************************************************************/
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#define _GNU_SOURCE  /* sched_getaffinity */
+
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>   /* struct serial_struct, ASYNC_LOW_LATENCY */
+
+#include "ec_serial.h"
+#include "ec_serial_priv.h"
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static bool     DriverLowLatency( SERIAL_PORT *port );
+static bool     CanSpin( SERIAL_PORT *port );
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    SerialPortSetLowLatency
+**
+**  Synopsis:
+**      uint32_t SerialPortSetLowLatency(SERIAL_PORT *port,
+**                                       const SERIAL_LOW_LATENCY *pll)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      *pll            settings wanted, copied.  Flags left out are
+**                      switched back off.
+**
+**  Return Values:
+**      SERIAL_LL_* flags that are now in effect
+**
+**  Errors:
+**      none, settings that cannot be applied are left out of the result
+**      and logged at SERIAL_LOG_WARN
+**
+**  Description:
+**      The RX thread settings are remembered and applied whenever the
+**      thread is started, so they may be given before
+**      SerialPortRxStart().  Until then they are not in the result.
+**      The driver flag is put back as it was by SerialPortClose().
+*/
+uint32_t SerialPortSetLowLatency(SERIAL_PORT *port, const SERIAL_LOW_LATENCY *pll) {
+
+    uint32_t    applied = 0;
+
+    port->ll = *pll;
+
+    if ( pll->flags & SERIAL_LL_DRIVER ) {
+        if ( DriverLowLatency(port) ) {
+            applied |= SERIAL_LL_DRIVER;
+        }
+    } else {
+        LowLatencyRestore(port);
+    }
+
+    if ( (pll->flags & SERIAL_LL_BUSY_POLL) && (pll->spinUs > 0) && CanSpin(port) ) {
+        atomic_store_explicit(&port->nsSpin, (uint64_t)pll->spinUs * 1000, memory_order_relaxed);
+        applied |= SERIAL_LL_BUSY_POLL;
+    } else {
+        atomic_store_explicit(&port->nsSpin, 0, memory_order_relaxed);
+    }
+
+    if ( port->prx != NULL ) {
+        applied |= RxApplySched(port);
+    }
+
+    port->llApplied = applied;
+    SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL %s: low latency wanted 0x%x, applied 0x%x",
+               port->szDevice, pll->flags, applied);
+    return applied;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortGetLowLatency
+**
+**  Synopsis:
+**      uint32_t SerialPortGetLowLatency(SERIAL_PORT *port)
+**
+**  Return Values:
+**      SERIAL_LL_* flags currently in effect, including the RX thread
+**      settings once the thread has started
+*/
+uint32_t SerialPortGetLowLatency(SERIAL_PORT *port) {
+
+    return port->llApplied;
+}
+
+/* ------------------------------------------------------------ */
+/***    LowLatencyRestore
+**
+**  Synopsis:
+**      void LowLatencyRestore(SERIAL_PORT *port)
+**
+**  Description:
+**      Puts the driver's ASYNC_* flags back the way they were before
+**      SERIAL_LL_DRIVER.  The flags belong to the device rather than to
+**      the descriptor and would otherwise outlive the port.
+*/
+void LowLatencyRestore(SERIAL_PORT *port) {
+
+    struct serial_struct ss;
+
+    if ( !port->fAsyncSaved ) {
+        return;
+    }
+    if ( 0 == ioctl(port->fd, TIOCGSERIAL, &ss) ) {
+        ss.flags = port->asyncFlagsSaved;
+        (void)ioctl(port->fd, TIOCSSERIAL, &ss);
+    }
+    port->fAsyncSaved = false;
+    port->llApplied &= ~SERIAL_LL_DRIVER;
+}
+
+/* ------------------------------------------------------------ */
+/***    LowLatencyReapply
+**
+**  Synopsis:
+**      void LowLatencyReapply(SERIAL_PORT *port)
+**
+**  Description:
+**      Sets SERIAL_LL_DRIVER again on a device that was reopened after a
+**      hot-plug, the new device starts with the driver's defaults.  The
+**      flags saved from the first device are the ones restored at close.
+*/
+void LowLatencyReapply(SERIAL_PORT *port) {
+
+    if ( (port->llApplied & SERIAL_LL_DRIVER) && !DriverLowLatency(port) ) {
+        port->llApplied &= ~SERIAL_LL_DRIVER;
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    CanSpin
+**
+**  Synopsis:
+**      bool CanSpin(SERIAL_PORT *port)
+**
+**  Description:
+**      Spinning only pays when whatever produces the data (the tty flip
+**      work, the RX thread, a peer process) has another CPU to run on;
+**      with a single one it just delays the data by the whole budget.
+*/
+static bool CanSpin(SERIAL_PORT *port) {
+
+    cpu_set_t   cpus;
+
+    if ( (0 == sched_getaffinity(0, sizeof(cpus), &cpus)) && (CPU_COUNT(&cpus) < 2) ) {
+        SERIAL_LOG(SERIAL_LOG_WARN, "SERIAL %s: busy polling needs more than one CPU",
+                   port->szDevice);
+        return false;
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+/***    DriverLowLatency
+**
+**  Synopsis:
+**      bool DriverLowLatency(SERIAL_PORT *port)
+**
+**  Return Values:
+**      true if the driver reports ASYNC_LOW_LATENCY set afterwards
+**
+**  Description:
+**      Drivers without serial_struct support (ptys, CDC-ACM on older
+**      kernels) fail TIOCGSERIAL with ENOTTY; some accept TIOCSSERIAL
+**      and ignore the flag, hence the read back.
+*/
+static bool DriverLowLatency(SERIAL_PORT *port) {
+
+    struct serial_struct ss;
+
+    if ( 0 != ioctl(port->fd, TIOCGSERIAL, &ss) ) {
+        goto lFail;
+    }
+    if ( !port->fAsyncSaved ) {
+        port->asyncFlagsSaved = ss.flags;
+        port->fAsyncSaved = true;
+    }
+    if ( !(ss.flags & ASYNC_LOW_LATENCY) ) {
+        ss.flags |= ASYNC_LOW_LATENCY;
+        if ( (0 != ioctl(port->fd, TIOCSSERIAL, &ss)) ||
+             (0 != ioctl(port->fd, TIOCGSERIAL, &ss)) ) {
+            goto lFail;
+        }
+    }
+    if ( ss.flags & ASYNC_LOW_LATENCY ) {
+        return true;
+    }
+    errno = EOPNOTSUPP;
+
+lFail:
+    SERIAL_LOG(SERIAL_LOG_WARN, "SERIAL %s: driver low latency mode not available: %s",
+               port->szDevice, strerror(errno));
+    return false;
+}
+
+
+/************************************ EOF ********************************/
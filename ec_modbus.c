@@ -0,0 +1,724 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_modbus.c --  EmbedCreativity's Modbus RTU master                 */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Modbus RTU has no delimiters, a frame ends when the line has been   */
+/*  quiet for 3.5 character times (t3.5), and the next frame may not    */
+/*  start before that.  At 19200 baud that is about 2 ms, far below     */
+/*  what a millisecond poll of the port can resolve.                    */
+/*                                                                      */
+/*  The master reads with SerialPortReadEx(), whose inter-byte timer    */
+/*  restarts from CLOCK_MONOTONIC each time a chunk arrives, with the   */
+/*  gap set to t3.5 for the configured baud rate.  For the function     */
+/*  codes whose response length follows from the request (1 to 6, 15,   */
+/*  16 and 23) it does not wait for the gap at all: the response is     */
+/*  complete once its last byte is in and its CRC checks.  The next     */
+/*  request then goes out t3.5 after that byte, the least turnaround    */
+/*  the spec allows, instead of after a fixed safety delay.             */
+/*                                                                      */
+/*  SerialModbusPoll() runs a whole cycle of requests to many slaves.   */
+/*  The bus is half duplex so only one request is ever outstanding,     */
+/*  but each request is framed and its CRC computed while the previous  */
+/*  one is on the wire, so the only dead time left between two slaves   */
+/*  is the t3.5 the spec requires.                                      */
+/*                                                                      */
+/*  Behind USB adapters that batch received data, a response can be     */
+/*  split by a gap longer than t3.5 and then fails its CRC.  Enable     */
+/*  the adapter's low latency mode (SerialPortSetLowLatency()) or set   */
+/*  a longer usT35.                                                     */
+/*                                                                      */
+/*  The master does no locking; nothing else should read the port       */
+/*  while it is in use.                                                 */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*                                                                      */
+/************************************************************************/
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "ec_serial.h"
+#include "ec_serial_priv.h"
+#include "ec_crc.h"
+#include "ec_modbus.h"
+
+/* ------------------------------------------------------------ */
+/*              Local Type Definitions                          */
+/* ------------------------------------------------------------ */
+
+#define BITS_PER_CHAR       11      // start, 8 data, parity or second stop, stop
+#define BAUD_FIXED_GAP      19200   // above this the spec fixes t3.5 ...
+#define US_FIXED_T35        1750    // ... at this
+#define CB_EXCEPTION_ADU    5       // unit, function | 0x80, code, CRC
+#define CB_MIN_ADU          4       // unit, function, CRC
+
+#define FC_EXCEPTION        0x80
+
+struct SERIAL_MODBUS {
+    SERIAL_PORT         *port;
+    uint32_t            usT35;
+    uint32_t            msTimeout;
+    uint32_t            msTurnaround;
+    uint32_t            cRetry;
+    uint64_t            nsChar;         // one character on the wire
+    uint64_t            nsBusFree;      // earliest start of the next request
+
+    uint8_t             rgrgbAdu[2][SERIAL_MODBUS_MAX_ADU];  // current and next request
+    uint8_t             rgbRx[SERIAL_MODBUS_MAX_ADU];
+    SERIAL_MODBUS_STATS stats;
+};
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static size_t   Encode( const SERIAL_MODBUS_REQ *preq, uint8_t *pbAdu );
+static uint64_t Send( SERIAL_MODBUS *pmb, const uint8_t *pbAdu, size_t cbAdu );
+static SERIAL_MODBUS_STATUS Await( SERIAL_MODBUS *pmb, SERIAL_MODBUS_REQ *preq, uint64_t nsTxDone );
+static int      Receive( SERIAL_MODBUS *pmb, size_t cbExpected, uint64_t nsDeadline );
+static size_t   ExpectedLength( const uint8_t *pbPdu, size_t cbPdu );
+static bool     HasByteCount( uint8_t bFunction );
+static uint32_t MsUntil( uint64_t nsDeadline );
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    SerialModbusCreate
+**
+**  Synopsis:
+**      SERIAL_MODBUS *SerialModbusCreate(SERIAL_PORT *port,
+**                                        const SERIAL_MODBUS_CFG *pcfg)
+**
+**  Parameters:
+**      *port           port the bus is on
+**      *pcfg           timing and retries, copied; NULL for the defaults
+**
+**  Return Values:
+**      new master, NULL on failure with errno set
+**
+**  Errors:
+**      EINVAL if the baud rate is neither configured nor known for the
+**      port, ENOMEM
+**
+**  Description:
+**      t3.5 is 3.5 eleven bit characters at the configured rate, and a
+**      fixed 1750 us above 19200 baud as the spec recommends.  The rate
+**      is only used for timing; set the port's rate with
+**      SerialPortSetBaud().
+*/
+SERIAL_MODBUS *SerialModbusCreate(SERIAL_PORT *port, const SERIAL_MODBUS_CFG *pcfg) {
+
+    SERIAL_MODBUS       *pmb;
+    SERIAL_MODBUS_CFG   cfg;
+    int                 baudRate;
+
+    memset(&cfg, 0, sizeof(cfg));
+    if ( pcfg != NULL ) {
+        cfg = *pcfg;
+    }
+
+    baudRate = ( cfg.baudRate != 0 ) ? cfg.baudRate : SerialPortGetBaud(port);
+    if ( baudRate <= 0 ) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    pmb = calloc(1, sizeof(*pmb));
+    if ( pmb == NULL ) {
+        return NULL;
+    }
+
+    pmb->port = port;
+    pmb->nsChar = (uint64_t)BITS_PER_CHAR * 1000000000 / baudRate;
+    if ( cfg.usT35 != 0 ) {
+        pmb->usT35 = cfg.usT35;
+    } else if ( baudRate > BAUD_FIXED_GAP ) {
+        pmb->usT35 = US_FIXED_T35;
+    } else {
+        pmb->usT35 = (uint32_t)((pmb->nsChar * 7 / 2 + 999) / 1000);
+    }
+    pmb->msTimeout = ( cfg.msTimeout != 0 ) ? cfg.msTimeout : SERIAL_MODBUS_TIMEOUT_MS;
+    pmb->msTurnaround = ( cfg.msTurnaround != 0 ) ? cfg.msTurnaround : SERIAL_MODBUS_TURNAROUND_MS;
+    pmb->cRetry = cfg.cRetry;
+
+    SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL %s: modbus master, %d baud, t3.5 %u us",
+               port->szDevice, baudRate, pmb->usT35);
+    return pmb;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialModbusDestroy
+**
+**  Synopsis:
+**      void SerialModbusDestroy(SERIAL_MODBUS *pmb)
+**
+**  Description:
+**      Frees the master.  The port stays open.
+*/
+void SerialModbusDestroy(SERIAL_MODBUS *pmb) {
+
+    free(pmb);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialModbusPoll
+**
+**  Synopsis:
+**      int SerialModbusPoll(SERIAL_MODBUS *pmb, SERIAL_MODBUS_REQ *rgreq,
+**                           size_t creq)
+**
+**  Parameters:
+**      *pmb            master returned by SerialModbusCreate()
+**      rgreq           requests to run, in order
+**      creq            number of requests
+**
+**  Return Values:
+**      number of requests that completed with SERIAL_MODBUS_OK
+**
+**  Errors:
+**      status, cbRsp, bException and usRtt of every request are set;
+**      errno is set for the last request that failed with
+**      SERIAL_MODBUS_ERROR
+**
+**  Description:
+**      Runs the requests back to back, each as soon as the bus has been
+**      quiet for t3.5.  A request that times out, fails its CRC or is
+**      answered by another unit or function is sent again, up to
+**      cRetry times.  Exceptions are final.  A broadcast (unit 0) gets
+**      no response; the next request waits msTurnaround instead.
+*/
+int SerialModbusPoll(SERIAL_MODBUS *pmb, SERIAL_MODBUS_REQ *rgreq, size_t creq) {
+
+    SERIAL_MODBUS_REQ       *preq;
+    SERIAL_MODBUS_STATUS    status;
+    size_t      rgcbAdu[2];
+    size_t      ireq;
+    uint64_t    nsTxDone;
+    uint32_t    iAttempt;
+    bool        fNextDone;
+    int         iadu = 0;
+    int         cOk = 0;
+
+    if ( creq == 0 ) {
+        return 0;
+    }
+
+    rgcbAdu[0] = Encode(&rgreq[0], pmb->rgrgbAdu[0]);
+    for ( ireq = 0; ireq < creq; ireq++, iadu ^= 1 ) {
+        preq = &rgreq[ireq];
+        preq->cbRsp = 0;
+        preq->bException = 0;
+        preq->usRtt = 0;
+        pmb->stats.cRequests++;
+        fNextDone = false;
+
+        if ( rgcbAdu[iadu] == 0 ) {
+            errno = EINVAL;
+            status = SERIAL_MODBUS_ERROR;
+        } else {
+            for ( iAttempt = 0; ; iAttempt++ ) {
+                nsTxDone = Send(pmb, pmb->rgrgbAdu[iadu], rgcbAdu[iadu]);
+                if ( nsTxDone == 0 ) {
+                    status = SERIAL_MODBUS_ERROR;
+                    break;
+                }
+                if ( !fNextDone && (ireq + 1 < creq) ) {
+                    // frame the next request while this one is on the wire
+                    rgcbAdu[iadu ^ 1] = Encode(&rgreq[ireq + 1], pmb->rgrgbAdu[iadu ^ 1]);
+                    fNextDone = true;
+                }
+
+                status = Await(pmb, preq, nsTxDone);
+                if ( ((status != SERIAL_MODBUS_TIMEOUT) && (status != SERIAL_MODBUS_CRC) &&
+                      (status != SERIAL_MODBUS_BAD_RESPONSE)) || (iAttempt == pmb->cRetry) ) {
+                    break;
+                }
+                pmb->stats.cRetries++;
+            }
+        }
+
+        if ( !fNextDone && (ireq + 1 < creq) ) {
+            rgcbAdu[iadu ^ 1] = Encode(&rgreq[ireq + 1], pmb->rgrgbAdu[iadu ^ 1]);
+        }
+
+        preq->status = status;
+        if ( status == SERIAL_MODBUS_OK ) {
+            pmb->stats.cOk++;
+            cOk++;
+        } else if ( status == SERIAL_MODBUS_EXCEPTION ) {
+            pmb->stats.cExceptions++;
+        }
+    }
+
+    return cOk;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialModbusTransact
+**
+**  Synopsis:
+**      SERIAL_MODBUS_STATUS SerialModbusTransact(SERIAL_MODBUS *pmb,
+**                                                SERIAL_MODBUS_REQ *preq)
+**
+**  Return Values:
+**      preq->status
+**
+**  Description:
+**      SerialModbusPoll() with a single request.
+*/
+SERIAL_MODBUS_STATUS SerialModbusTransact(SERIAL_MODBUS *pmb, SERIAL_MODBUS_REQ *preq) {
+
+    SerialModbusPoll(pmb, preq, 1);
+    return preq->status;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialModbusReadRegisters
+**
+**  Synopsis:
+**      SERIAL_MODBUS_STATUS SerialModbusReadRegisters(SERIAL_MODBUS *pmb,
+**                              uint8_t unit, uint8_t bFunction,
+**                              uint16_t addr, uint16_t cReg,
+**                              uint16_t *rgwReg)
+**
+**  Parameters:
+**      *pmb            master returned by SerialModbusCreate()
+**      unit            slave address, 1 to 247
+**      bFunction       3 for holding registers, 4 for input registers
+**      addr            first register, zero based
+**      cReg            number of registers, 1 to SERIAL_MODBUS_MAX_READ
+**      rgwReg          receives the registers in host byte order
+**
+**  Return Values:
+**      status of the transaction
+**
+**  Errors:
+**      EINVAL with SERIAL_MODBUS_ERROR for a bad function, unit or count
+*/
+SERIAL_MODBUS_STATUS SerialModbusReadRegisters(SERIAL_MODBUS *pmb, uint8_t unit, uint8_t bFunction,
+                                               uint16_t addr, uint16_t cReg, uint16_t *rgwReg) {
+
+    SERIAL_MODBUS_REQ   req;
+    uint8_t     rgbPdu[5];
+    uint8_t     rgbRsp[2 + 2 * SERIAL_MODBUS_MAX_READ];
+    uint16_t    iReg;
+
+    if ( ((bFunction != 3) && (bFunction != 4)) || (unit == 0) ||
+         (cReg == 0) || (cReg > SERIAL_MODBUS_MAX_READ) ) {
+        errno = EINVAL;
+        return SERIAL_MODBUS_ERROR;
+    }
+
+    rgbPdu[0] = bFunction;
+    rgbPdu[1] = addr >> 8;
+    rgbPdu[2] = addr & 0xFF;
+    rgbPdu[3] = cReg >> 8;
+    rgbPdu[4] = cReg & 0xFF;
+
+    memset(&req, 0, sizeof(req));
+    req.unit = unit;
+    req.pbPdu = rgbPdu;
+    req.cbPdu = sizeof(rgbPdu);
+    req.pbRsp = rgbRsp;
+    req.cbRspMax = sizeof(rgbRsp);
+    if ( SerialModbusTransact(pmb, &req) != SERIAL_MODBUS_OK ) {
+        return req.status;
+    }
+
+    for ( iReg = 0; iReg < cReg; iReg++ ) {
+        rgwReg[iReg] = (uint16_t)((rgbRsp[2 + 2 * iReg] << 8) | rgbRsp[3 + 2 * iReg]);
+    }
+    return SERIAL_MODBUS_OK;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialModbusWriteRegisters
+**
+**  Synopsis:
+**      SERIAL_MODBUS_STATUS SerialModbusWriteRegisters(SERIAL_MODBUS *pmb,
+**                              uint8_t unit, uint16_t addr, uint16_t cReg,
+**                              const uint16_t *rgwReg)
+**
+**  Parameters:
+**      *pmb            master returned by SerialModbusCreate()
+**      unit            slave address, 0 to broadcast
+**      addr            first register, zero based
+**      cReg            number of registers, 1 to SERIAL_MODBUS_MAX_WRITE
+**      rgwReg          register values in host byte order
+**
+**  Return Values:
+**      status of the transaction
+**
+**  Errors:
+**      EINVAL with SERIAL_MODBUS_ERROR for a bad count
+**
+**  Description:
+**      Uses function 16, write multiple registers, for any count.
+*/
+SERIAL_MODBUS_STATUS SerialModbusWriteRegisters(SERIAL_MODBUS *pmb, uint8_t unit,
+                                                uint16_t addr, uint16_t cReg, const uint16_t *rgwReg) {
+
+    SERIAL_MODBUS_REQ   req;
+    uint8_t     rgbPdu[6 + 2 * SERIAL_MODBUS_MAX_WRITE];
+    uint8_t     rgbRsp[5];
+    uint16_t    iReg;
+
+    if ( (cReg == 0) || (cReg > SERIAL_MODBUS_MAX_WRITE) ) {
+        errno = EINVAL;
+        return SERIAL_MODBUS_ERROR;
+    }
+
+    rgbPdu[0] = 16;
+    rgbPdu[1] = addr >> 8;
+    rgbPdu[2] = addr & 0xFF;
+    rgbPdu[3] = cReg >> 8;
+    rgbPdu[4] = cReg & 0xFF;
+    rgbPdu[5] = 2 * cReg;
+    for ( iReg = 0; iReg < cReg; iReg++ ) {
+        rgbPdu[6 + 2 * iReg] = rgwReg[iReg] >> 8;
+        rgbPdu[7 + 2 * iReg] = rgwReg[iReg] & 0xFF;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.unit = unit;
+    req.pbPdu = rgbPdu;
+    req.cbPdu = 6 + 2 * cReg;
+    req.pbRsp = rgbRsp;
+    req.cbRspMax = sizeof(rgbRsp);
+    return SerialModbusTransact(pmb, &req);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialModbusGapUs
+**
+**  Synopsis:
+**      uint32_t SerialModbusGapUs(SERIAL_MODBUS *pmb)
+**
+**  Return Values:
+**      t3.5 in microseconds, the silence that ends a frame
+*/
+uint32_t SerialModbusGapUs(SERIAL_MODBUS *pmb) {
+
+    return pmb->usT35;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialModbusGetStats
+**
+**  Synopsis:
+**      void SerialModbusGetStats(SERIAL_MODBUS *pmb,
+**                                SERIAL_MODBUS_STATS *pstats)
+**
+**  Description:
+**      Counts since the master was created or its stats last reset.
+*/
+void SerialModbusGetStats(SERIAL_MODBUS *pmb, SERIAL_MODBUS_STATS *pstats) {
+
+    *pstats = pmb->stats;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialModbusResetStats
+**
+**  Synopsis:
+**      void SerialModbusResetStats(SERIAL_MODBUS *pmb)
+*/
+void SerialModbusResetStats(SERIAL_MODBUS *pmb) {
+
+    memset(&pmb->stats, 0, sizeof(pmb->stats));
+}
+
+/* ------------------------------------------------------------ */
+/***    Encode
+**
+**  Synopsis:
+**      static size_t Encode(const SERIAL_MODBUS_REQ *preq, uint8_t *pbAdu)
+**
+**  Return Values:
+**      length of the frame in pbAdu, 0 if the PDU is empty or too long
+**
+**  Description:
+**      Builds unit, PDU and CRC-16/MODBUS, low byte first.
+*/
+static size_t Encode(const SERIAL_MODBUS_REQ *preq, uint8_t *pbAdu) {
+
+    uint32_t    crc;
+
+    if ( (preq->cbPdu == 0) || (preq->cbPdu > SERIAL_MODBUS_MAX_PDU) ) {
+        return 0;
+    }
+
+    pbAdu[0] = preq->unit;
+    memcpy(pbAdu + 1, preq->pbPdu, preq->cbPdu);
+    crc = SerialCrc(SERIAL_CRC16_MODBUS, pbAdu, 1 + preq->cbPdu);
+    return 1 + preq->cbPdu + SerialCrcPut(SERIAL_CRC16_MODBUS, crc, pbAdu + 1 + preq->cbPdu);
+}
+
+/* ------------------------------------------------------------ */
+/***    Send
+**
+**  Synopsis:
+**      static uint64_t Send(SERIAL_MODBUS *pmb, const uint8_t *pbAdu,
+**                           size_t cbAdu)
+**
+**  Return Values:
+**      CLOCK_MONOTONIC ns when the last byte will have left the UART,
+**      0 on a port error
+**
+**  Description:
+**      Waits for the bus to have been quiet for t3.5, drops anything
+**      that arrived since the last response so it cannot be taken for
+**      the next one, and writes the frame in one call.
+*/
+static uint64_t Send(SERIAL_MODBUS *pmb, const uint8_t *pbAdu, size_t cbAdu) {
+
+    struct timespec ts;
+    int             rc;
+
+    if ( MonoNowNs() < pmb->nsBusFree ) {
+        ts.tv_sec = pmb->nsBusFree / 1000000000;
+        ts.tv_nsec = pmb->nsBusFree % 1000000000;
+        while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR ) {
+        }
+    }
+
+    while ( (rc = SerialPortReadEx(pmb->port, pmb->rgbRx, sizeof(pmb->rgbRx), 1, 0, 0)) > 0 ) {
+        pmb->stats.cbDiscarded += rc;
+    }
+    if ( rc == SERIAL_ERROR_CODE ) {
+        return 0;
+    }
+
+    rc = SerialPortWrite(pmb->port, pbAdu, cbAdu, 0);
+    if ( rc != (int)cbAdu ) {
+        if ( rc >= 0 ) {
+            errno = EIO;
+        }
+        return 0;
+    }
+    return MonoNowNs() + cbAdu * pmb->nsChar;
+}
+
+/* ------------------------------------------------------------ */
+/***    Await
+**
+**  Synopsis:
+**      static SERIAL_MODBUS_STATUS Await(SERIAL_MODBUS *pmb,
+**                                        SERIAL_MODBUS_REQ *preq,
+**                                        uint64_t nsTxDone)
+**
+**  Parameters:
+**      *pmb            master
+**      *preq           request just sent
+**      nsTxDone        when its last byte left, the response timeout
+**                      starts there
+**
+**  Return Values:
+**      outcome of this attempt; the response PDU is in preq->pbRsp
+**
+**  Errors:
+**      ENOBUFS with SERIAL_MODBUS_ERROR if the response does not fit
+*/
+static SERIAL_MODBUS_STATUS Await(SERIAL_MODBUS *pmb, SERIAL_MODBUS_REQ *preq, uint64_t nsTxDone) {
+
+    const uint8_t   *pb = pmb->rgbRx;
+    size_t          cbExpected;
+    uint64_t        nsNow;
+    int             cb;
+
+    if ( preq->unit == 0 ) {
+        pmb->nsBusFree = nsTxDone + (uint64_t)pmb->msTurnaround * 1000000;
+        return SERIAL_MODBUS_OK;
+    }
+
+    cbExpected = ExpectedLength(preq->pbPdu, preq->cbPdu);
+    cb = Receive(pmb, cbExpected, nsTxDone + (uint64_t)pmb->msTimeout * 1000000);
+    if ( cb == SERIAL_ERROR_CODE ) {
+        return SERIAL_MODBUS_ERROR;
+    }
+    if ( cb == SERIAL_TIMEOUT_CODE ) {
+        pmb->stats.cTimeouts++;
+        return SERIAL_MODBUS_TIMEOUT;
+    }
+    nsNow = MonoNowNs();
+    preq->usRtt = ( nsNow > nsTxDone ) ? (uint32_t)((nsNow - nsTxDone) / 1000) : 0;
+
+    if ( (cb < CB_MIN_ADU) || !SerialCrcCheck(SERIAL_CRC16_MODBUS, pb, cb) ) {
+        pmb->stats.cCrcErrors++;
+        return SERIAL_MODBUS_CRC;
+    }
+    if ( (pb[0] != preq->unit) || ((pb[1] & ~FC_EXCEPTION) != preq->pbPdu[0]) ||
+         ((pb[1] & FC_EXCEPTION) ? (cb != CB_EXCEPTION_ADU) : ((cbExpected != 0) && ((size_t)cb != cbExpected))) ||
+         (!(pb[1] & FC_EXCEPTION) && HasByteCount(pb[1]) && (pb[2] != cb - 5)) ) {
+        pmb->stats.cBadResponses++;
+        return SERIAL_MODBUS_BAD_RESPONSE;
+    }
+
+    preq->cbRsp = cb - 3;
+    if ( preq->pbRsp != NULL ) {
+        if ( preq->cbRsp > preq->cbRspMax ) {
+            preq->cbRsp = 0;
+            errno = ENOBUFS;
+            return SERIAL_MODBUS_ERROR;
+        }
+        memcpy(preq->pbRsp, pb + 1, preq->cbRsp);
+    }
+    if ( pb[1] & FC_EXCEPTION ) {
+        preq->bException = pb[2];
+        return SERIAL_MODBUS_EXCEPTION;
+    }
+    return SERIAL_MODBUS_OK;
+}
+
+/* ------------------------------------------------------------ */
+/***    Receive
+**
+**  Synopsis:
+**      static int Receive(SERIAL_MODBUS *pmb, size_t cbExpected,
+**                         uint64_t nsDeadline)
+**
+**  Parameters:
+**      *pmb            master, the frame goes to pmb->rgbRx
+**      cbExpected      length of a normal response, 0 if unknown
+**      nsDeadline      response timeout
+**
+**  Return Values:
+**      length of the frame, SERIAL_TIMEOUT_CODE if nothing arrived,
+**      SERIAL_ERROR_CODE on a port error
+**
+**  Description:
+**      A frame ends at cbExpected bytes, at CB_EXCEPTION_ADU bytes if
+**      it is an exception, or when the line goes quiet for t3.5.  The
+**      first read stops at the exception length so that an exception
+**      does not have to wait out the gap either.  Sets nsBusFree to t3.5
+**      after the last byte, which is now if the gap ended the frame.
+*/
+static int Receive(SERIAL_MODBUS *pmb, size_t cbExpected, uint64_t nsDeadline) {
+
+    uint8_t     *pb = pmb->rgbRx;
+    uint32_t    minLen;
+    int         cb;
+    int         rc;
+
+    minLen = sizeof(pmb->rgbRx);
+    if ( cbExpected != 0 ) {
+        minLen = ( cbExpected < CB_EXCEPTION_ADU ) ? cbExpected : CB_EXCEPTION_ADU;
+    }
+    cb = SerialPortReadEx(pmb->port, pb, sizeof(pmb->rgbRx), minLen, MsUntil(nsDeadline), pmb->usT35);
+    if ( cb < 0 ) {
+        pmb->nsBusFree = MonoNowNs();
+        return cb;
+    }
+
+    if ( (cb >= CB_EXCEPTION_ADU) && !(pb[1] & FC_EXCEPTION) && ((size_t)cb < cbExpected) ) {
+        rc = SerialPortReadEx(pmb->port, pb + cb, sizeof(pmb->rgbRx) - cb,
+                              cbExpected - cb, MsUntil(nsDeadline), pmb->usT35);
+        if ( rc == SERIAL_ERROR_CODE ) {
+            return rc;
+        }
+        if ( rc > 0 ) {
+            cb += rc;
+        }
+    }
+
+    pmb->nsBusFree = MonoNowNs();
+    if ( (cbExpected != 0) && ((size_t)cb >= ((pb[1] & FC_EXCEPTION) ? CB_EXCEPTION_ADU : cbExpected)) ) {
+        // complete by length, the gap after it has not passed yet
+        pmb->nsBusFree += (uint64_t)pmb->usT35 * 1000;
+    }
+    return cb;
+}
+
+/* ------------------------------------------------------------ */
+/***    ExpectedLength
+**
+**  Synopsis:
+**      static size_t ExpectedLength(const uint8_t *pbPdu, size_t cbPdu)
+**
+**  Return Values:
+**      length of the normal response frame to this request, 0 when it
+**      cannot be told from the request
+*/
+static size_t ExpectedLength(const uint8_t *pbPdu, size_t cbPdu) {
+
+    uint32_t    cItem;
+
+    if ( cbPdu < 5 ) {
+        return 0;
+    }
+
+    cItem = ((uint32_t)pbPdu[3] << 8) | pbPdu[4];
+    switch ( pbPdu[0] ) {
+        case 1:                     // read coils
+        case 2:                     // read discrete inputs
+            return 5 + (cItem + 7) / 8;
+        case 3:                     // read holding registers
+        case 4:                     // read input registers
+        case 23:                    // read/write registers, cItem is the read count
+            return 5 + 2 * cItem;
+        case 5:                     // write single coil, echoed
+        case 6:                     // write single register, echoed
+        case 15:                    // write coils
+        case 16:                    // write registers
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+/* Reads whose response carries its data length in the third byte. */
+static bool HasByteCount(uint8_t bFunction) {
+
+    return ( (bFunction >= 1) && (bFunction <= 4) ) || ( bFunction == 23 );
+}
+
+/* Whole ms left until nsDeadline, rounded up. */
+static uint32_t MsUntil(uint64_t nsDeadline) {
+
+    uint64_t    nsNow;
+
+    nsNow = MonoNowNs();
+    if ( nsNow >= nsDeadline ) {
+        return 0;
+    }
+    return (uint32_t)((nsDeadline - nsNow + 999999) / 1000000);
+}
+
+
+/************************************ EOF ********************************/
@@ -0,0 +1,136 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_modbus.h --  EmbedCreativity's Modbus RTU master header file     */
+/*                                                                      */
+/************************************************************************/
+/*  Author:     agent                                                   */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*  This header file contains declarations the functions contained in   */
+/*  ec_modbus.c                                                         */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026(agent): created                                          */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(_SERIALMODBUS_H)
+#define _SERIALMODBUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ec_serial.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------------ */
+/*                  Definitions                                 */
+/* ------------------------------------------------------------ */
+
+#define SERIAL_MODBUS_MAX_PDU       253     // function code and data
+#define SERIAL_MODBUS_MAX_ADU       256     // unit, PDU and CRC
+#define SERIAL_MODBUS_MAX_READ      125     // registers in one read
+#define SERIAL_MODBUS_MAX_WRITE     123     // registers in one write
+#define SERIAL_MODBUS_TIMEOUT_MS    100     // default response timeout
+#define SERIAL_MODBUS_TURNAROUND_MS 100     // default wait after a broadcast
+
+/* ------------------------------------------------------------ */
+/*                  General Type Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef enum {
+    SERIAL_MODBUS_OK,           // a valid response arrived, or a broadcast went out
+    SERIAL_MODBUS_EXCEPTION,    // the slave answered with an exception code
+    SERIAL_MODBUS_TIMEOUT,      // no response after the last retry
+    SERIAL_MODBUS_CRC,          // the last response was short or failed its CRC
+    SERIAL_MODBUS_BAD_RESPONSE, // wrong unit, function or length
+    SERIAL_MODBUS_ERROR         // bad request or port error, see errno
+} SERIAL_MODBUS_STATUS;
+
+typedef struct {
+    int         baudRate;       // 0: the port's current rate
+    uint32_t    usT35;          // end of frame silence, 0: 3.5 characters
+    uint32_t    msTimeout;      // response timeout, 0: SERIAL_MODBUS_TIMEOUT_MS
+    uint32_t    msTurnaround;   // wait after a broadcast, 0: SERIAL_MODBUS_TURNAROUND_MS
+    uint32_t    cRetry;         // extra attempts after a timeout or bad response
+} SERIAL_MODBUS_CFG;
+
+// One request of a poll cycle.  The engine fills in the second half.
+typedef struct {
+    uint8_t             unit;       // slave address, 0 to broadcast
+    const uint8_t       *pbPdu;     // function code and data
+    size_t              cbPdu;
+    uint8_t             *pbRsp;     // receives the response PDU, may be NULL
+    size_t              cbRspMax;
+
+    SERIAL_MODBUS_STATUS status;
+    size_t              cbRsp;      // response PDU length, function code included
+    uint8_t             bException; // with SERIAL_MODBUS_EXCEPTION
+    uint32_t            usRtt;      // end of request to end of response
+} SERIAL_MODBUS_REQ;
+
+typedef struct {
+    uint64_t    cRequests;
+    uint64_t    cOk;
+    uint64_t    cExceptions;
+    uint64_t    cRetries;           // requests sent again
+    uint64_t    cTimeouts;          // attempts without a response
+    uint64_t    cCrcErrors;         // attempts with a short or corrupt response
+    uint64_t    cBadResponses;      // attempts answered by the wrong unit or function
+    uint64_t    cbDiscarded;        // stray bytes flushed before a request
+} SERIAL_MODBUS_STATS;
+
+/* ------------------------------------------------------------ */
+/*                  Object Class Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef struct SERIAL_MODBUS SERIAL_MODBUS;
+
+/* ------------------------------------------------------------ */
+/*                  Function Prototypes                         */
+/* ------------------------------------------------------------ */
+
+SERIAL_MODBUS *SerialModbusCreate(SERIAL_PORT *port, const SERIAL_MODBUS_CFG *pcfg);
+void    SerialModbusDestroy(SERIAL_MODBUS *pmb);
+int     SerialModbusPoll(SERIAL_MODBUS *pmb, SERIAL_MODBUS_REQ *rgreq, size_t creq);
+SERIAL_MODBUS_STATUS SerialModbusTransact(SERIAL_MODBUS *pmb, SERIAL_MODBUS_REQ *preq);
+SERIAL_MODBUS_STATUS SerialModbusReadRegisters(SERIAL_MODBUS *pmb, uint8_t unit, uint8_t bFunction,
+                                               uint16_t addr, uint16_t cReg, uint16_t *rgwReg);
+SERIAL_MODBUS_STATUS SerialModbusWriteRegisters(SERIAL_MODBUS *pmb, uint8_t unit,
+                                                uint16_t addr, uint16_t cReg, const uint16_t *rgwReg);
+uint32_t SerialModbusGapUs(SERIAL_MODBUS *pmb);
+void    SerialModbusGetStats(SERIAL_MODBUS *pmb, SERIAL_MODBUS_STATS *pstats);
+void    SerialModbusResetStats(SERIAL_MODBUS *pmb);
+/* ------------------------------------------------------------ */
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+
+/**********************************  EOF  **************************************/
@@ -0,0 +1,1361 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_reactor.c --  EmbedCreativity's sharded epoll reactor            */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Serves any number of ports from a handful of threads.  Each shard   */
+/*  is one thread sleeping in epoll_wait() on its own epoll set, so an  */
+/*  idle port costs nothing and a busy one costs in proportion to its   */
+/*  traffic.  New ports go to the shard serving the fewest.             */
+/*                                                                      */
+/*  A shard holds its lock while it dispatches a batch of events.       */
+/*  SerialReactorRemove() takes the same lock, so once it returns no    */
+/*  callback is running or will run for that port.  Removed entries     */
+/*  are only freed by the shard itself, after the batch that may still  */
+/*  name them.                                                          */
+/*                                                                      */
+/*  With SERIAL_REACTOR_URING a shard keeps a poll->READ_FIXED chain    */
+/*  queued in its io_uring for every port instead, each reading into    */
+/*  the port's slot of one registered buffer.  Re-arming the ports that */
+/*  were served, writes queued by SerialReactorWrite() and the wait for */
+/*  the next completions all go to the kernel in one io_uring_enter(),  */
+/*  however many ports were busy.  Only the shard thread touches the    */
+/*  ring; other threads leave work on the shard's to-do list and wake   */
+/*  it through the eventfd, which the ring itself keeps a read posted   */
+/*  on.  An entry is freed once the kernel holds nothing of it, so a    */
+/*  removal from another thread waits for its requests to be cancelled. */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*  10/16/2026 (agent): io_uring shards, SerialReactorWrite() and the   */
+/*                      shard statistics                                */
+/*  10/16/2026 (agent): reads and writes feed SerialPortCaptureStart()  */
+/*  10/16/2026 (agent): ports are watched again after a reconnect       */
+/*                                                                      */
+/************************************************************************/
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#define _GNU_SOURCE  /* pthread_setaffinity_np */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "ec_serial.h"
+#include "ec_serial_priv.h"
+#include "ec_reactor.h"
+#include "ec_uring.h"
+
+/* ------------------------------------------------------------ */
+/*              Local Type Definitions                          */
+/* ------------------------------------------------------------ */
+
+#define REACTOR_EVENTS      64      // events taken per epoll_wait()
+#define REACTOR_READ        4096    // bytes read per read() call
+
+#define REACTOR_URING_SQ    256     // submission queue of an io_uring shard
+#define REACTOR_URING_RX    1024    // registered receive slot per port
+#define REACTOR_URING_SLOT  (REACTOR_URING_RX + SERIAL_REACTOR_URING_TX)
+
+// io_uring user_data is the entry pointer with the request in the low bits,
+// a NULL entry is the shard's own eventfd read
+#define URING_OP_POLL       0
+#define URING_OP_READ       1
+#define URING_OP_WRITE      2
+#define URING_OP_CANCEL     3
+#define URING_OP_MASK       3
+
+typedef struct REACTOR_SHARD REACTOR_SHARD;
+
+typedef struct REACTOR_ENTRY {
+    struct REACTOR_ENTRY *pNext;        // shard's list of ports
+    struct REACTOR_ENTRY *pPrev;
+    struct REACTOR_ENTRY *pNextDead;    // shard's list of entries to free
+    struct REACTOR_ENTRY *pNextTodo;    // io_uring: shard's list of work
+    REACTOR_SHARD       *pshard;
+    SERIAL_PORT         *port;
+    SERIAL_REACTOR_CBS  cbs;
+    uint32_t            events;         // EPOLL* interest
+    bool                fRemoved;       // no more callbacks
+    bool                fHungUp;        // no longer in the epoll set
+    bool                fTodo;          // io_uring: on the to-do list
+    bool                fArmed;         // io_uring: poll/read chain queued
+    bool                fCancelled;     // io_uring: cancel queued
+    bool                fWantWrite;     // io_uring: report WRITABLE
+    bool                fKickWritable;  // io_uring: report it now if idle
+    int                 revents;        // io_uring: result of the last poll
+    unsigned            cInflight;      // io_uring: requests the kernel holds
+    int                 islot;          // io_uring: registered buffer slot
+    uint32_t            cbTx;           // io_uring: bytes queued in the slot
+    uint32_t            cbTxBusy;       // io_uring: of those, being written
+} REACTOR_ENTRY;
+
+struct REACTOR_SHARD {
+    pthread_t           thread;
+    pthread_mutex_t     mtx;            // held while dispatching
+    int                 epfd;
+    int                 evtStop;        // io_uring: wakes the shard for any reason
+    _Atomic uint32_t    cPorts;
+    REACTOR_ENTRY       *pentryFirst;
+    REACTOR_ENTRY       *pentryDead;
+    _Atomic uint64_t    cbRead;         // SERIAL_REACTOR_STATS, shard thread only
+    _Atomic uint64_t    cbWritten;
+    _Atomic uint64_t    cSyscalls;
+    URING               ring;           // io_uring shards from here on
+    bool                fRing;
+    bool                fStop;
+    unsigned            cInflight;      // requests in the ring, wake read included
+    uint64_t            cWake;          // eventfd read lands here
+    uint8_t             *pbSlots;       // registered, one REACTOR_URING_SLOT per port
+    int                 rgislotFree[SERIAL_REACTOR_URING_PORTS];
+    int                 cSlotsFree;
+    REACTOR_ENTRY       *pentryTodo;
+    pthread_cond_t      cvFreed;        // dead entries were freed
+    uint8_t             rgbRead[REACTOR_READ];
+};
+
+struct SERIAL_REACTOR {
+    int                 cShards;
+    int                 cStarted;
+    uint32_t            flags;          // SERIAL_REACTOR_* in effect
+    pthread_mutex_t     mtxAdd;         // serializes the least-loaded choice
+    REACTOR_SHARD       rgshard[];
+};
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static void     *ShardThread( void *pv );
+static void     Dispatch( REACTOR_SHARD *pshard, REACTOR_ENTRY *pentry, uint32_t events );
+static void     HangUp( REACTOR_SHARD *pshard, REACTOR_ENTRY *pentry );
+static void     Unlink( REACTOR_SHARD *pshard, REACTOR_ENTRY *pentry );
+static bool     ShardInitUring( REACTOR_SHARD *pshard );
+static void     *UringShardThread( void *pv );
+static void     UringTodo( REACTOR_SHARD *pshard, REACTOR_ENTRY *pentry );
+static void     UringRunTodo( REACTOR_SHARD *pshard );
+static void     UringComplete( REACTOR_SHARD *pshard, uint64_t userData, int res );
+static void     UringFreeDead( REACTOR_SHARD *pshard );
+static struct io_uring_sqe *UringShardSqe( REACTOR_SHARD *pshard );
+static void     UringArmWake( REACTOR_SHARD *pshard );
+static void     Wake( REACTOR_SHARD *pshard );
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    SerialReactorCreate
+**
+**  Synopsis:
+**      SERIAL_REACTOR *SerialReactorCreate(int cShards, uint32_t flags)
+**
+**  Parameters:
+**      cShards         number of threads, 0 for one per CPU the process
+**                      may run on
+**      flags           SERIAL_REACTOR_PIN to pin each thread to its CPU
+**                      SERIAL_REACTOR_URING to batch I/O through io_uring
+**
+**  Return Values:
+**      new reactor with its threads running, NULL on failure with errno set
+**
+**  Description:
+**      SERIAL_REACTOR_URING falls back to epoll, logged at
+**      SERIAL_LOG_INFO, when the kernel cannot provide it;
+**      SerialReactorFlags() tells which one is running.
+*/
+SERIAL_REACTOR *SerialReactorCreate(int cShards, uint32_t flags) {
+
+    SERIAL_REACTOR      *prt;
+    REACTOR_SHARD       *pshard;
+    struct epoll_event  ev;
+    cpu_set_t           cpusProc;
+    cpu_set_t           cpus;
+    int                 icpu;
+    int                 ishard;
+    int                 err;
+
+    if ( 0 != sched_getaffinity(0, sizeof(cpusProc), &cpusProc) ) {
+        CPU_ZERO(&cpusProc);
+        CPU_SET(0, &cpusProc);
+    }
+    if ( cShards <= 0 ) {
+        cShards = CPU_COUNT(&cpusProc);
+    }
+
+    prt = calloc(1, sizeof(*prt) + cShards * sizeof(REACTOR_SHARD));
+    if ( prt == NULL ) {
+        return NULL;
+    }
+    prt->cShards = cShards;
+    prt->flags = flags;
+    pthread_mutex_init(&prt->mtxAdd, NULL);
+
+    for ( ishard = 0; ishard < cShards; ishard++ ) {
+        prt->rgshard[ishard].epfd = -1;
+        prt->rgshard[ishard].evtStop = -1;
+        prt->rgshard[ishard].ring.fd = -1;
+        pthread_mutex_init(&prt->rgshard[ishard].mtx, NULL);
+        pthread_cond_init(&prt->rgshard[ishard].cvFreed, NULL);
+    }
+
+    icpu = -1;
+    for ( ishard = 0; ishard < cShards; ishard++ ) {
+        pshard = &prt->rgshard[ishard];
+        atomic_init(&pshard->cPorts, 0);
+
+        pshard->evtStop = eventfd(0, EFD_CLOEXEC);
+        if ( pshard->evtStop < 0 ) {
+            goto lError;
+        }
+
+        if ( (prt->flags & SERIAL_REACTOR_URING) && !ShardInitUring(pshard) ) {
+            if ( ishard > 0 ) {
+                goto lError;
+            }
+            SERIAL_LOG(SERIAL_LOG_INFO, "SERIAL reactor: io_uring not available, using epoll: %s",
+                       strerror(errno));
+            prt->flags &= ~SERIAL_REACTOR_URING;
+        }
+
+        if ( !pshard->fRing ) {
+            pshard->epfd = epoll_create1(EPOLL_CLOEXEC);
+            if ( pshard->epfd < 0 ) {
+                goto lError;
+            }
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.ptr = NULL;
+            if ( 0 != epoll_ctl(pshard->epfd, EPOLL_CTL_ADD, pshard->evtStop, &ev) ) {
+                goto lError;
+            }
+        }
+
+        err = pthread_create(&pshard->thread, NULL,
+                             pshard->fRing ? UringShardThread : ShardThread, pshard);
+        if ( err != 0 ) {
+            errno = err;
+            goto lError;
+        }
+        prt->cStarted++;
+
+        if ( flags & SERIAL_REACTOR_PIN ) {
+            // next CPU the process may use, wrapping around
+            do {
+                icpu = (icpu + 1) % CPU_SETSIZE;
+            } while ( !CPU_ISSET(icpu, &cpusProc) );
+            CPU_ZERO(&cpus);
+            CPU_SET(icpu, &cpus);
+            err = pthread_setaffinity_np(pshard->thread, sizeof(cpus), &cpus);
+            if ( err != 0 ) {
+                SERIAL_LOG(SERIAL_LOG_WARN, "SERIAL reactor: cannot pin shard %d to CPU %d: %s",
+                           ishard, icpu, strerror(err));
+            }
+        }
+    }
+
+    return prt;
+
+lError:
+    err = errno;
+    SerialReactorDestroy(prt);
+    errno = err;
+    return NULL;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialReactorDestroy
+**
+**  Synopsis:
+**      void SerialReactorDestroy(SERIAL_REACTOR *prt)
+**
+**  Description:
+**      Stops every shard and forgets all ports still registered.  The
+**      ports themselves stay open.  Must not be called from a callback.
+**      NULL is ignored.
+*/
+void SerialReactorDestroy(SERIAL_REACTOR *prt) {
+
+    REACTOR_SHARD   *pshard;
+    REACTOR_ENTRY   *pentry;
+    uint64_t        one = 1;
+    int             ishard;
+
+    if ( prt == NULL ) {
+        return;
+    }
+
+    for ( ishard = 0; ishard < prt->cShards; ishard++ ) {
+        pshard = &prt->rgshard[ishard];
+        if ( ishard < prt->cStarted ) {
+            pthread_mutex_lock(&pshard->mtx);
+            pshard->fStop = true;
+            pthread_mutex_unlock(&pshard->mtx);
+            while ( (write(pshard->evtStop, &one, sizeof(one)) < 0) && (errno == EINTR) ) {
+            }
+            pthread_join(pshard->thread, NULL);
+        }
+
+        while ( (pentry = pshard->pentryFirst) != NULL ) {
+            Unlink(pshard, pentry);
+            pentry->port->pvReactor = NULL;
+            free(pentry);
+        }
+        while ( (pentry = pshard->pentryDead) != NULL ) {
+            pshard->pentryDead = pentry->pNextDead;
+            free(pentry);
+        }
+
+        // the shard thread reaped every request, nothing writes the slots
+        UringFree(&pshard->ring);
+        free(pshard->pbSlots);
+        if ( pshard->epfd >= 0 ) {
+            close(pshard->epfd);
+        }
+        if ( pshard->evtStop >= 0 ) {
+            close(pshard->evtStop);
+        }
+        pthread_cond_destroy(&pshard->cvFreed);
+        pthread_mutex_destroy(&pshard->mtx);
+    }
+
+    pthread_mutex_destroy(&prt->mtxAdd);
+    free(prt);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialReactorAdd
+**
+**  Synopsis:
+**      int SerialReactorAdd(SERIAL_REACTOR *prt, SERIAL_PORT *port,
+**                           const SERIAL_REACTOR_CBS *pcbs)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      *pcbs           callbacks, copied
+**
+**  Return Values:
+**      index of the shard now serving the port
+**      -1 (SERIAL_ERROR_CODE) on failure, see errno
+**
+**  Errors:
+**      EBUSY           the port already belongs to a reactor or has its
+**                      own RX thread
+**      ENOSPC          every io_uring shard already serves
+**                      SERIAL_REACTOR_URING_PORTS ports
+**
+**  Description:
+**      From here on the shard reads the port and hands the data to
+**      pfnData; the application must not read the port itself.
+*/
+int SerialReactorAdd(SERIAL_REACTOR *prt, SERIAL_PORT *port, const SERIAL_REACTOR_CBS *pcbs) {
+
+    REACTOR_SHARD       *pshard;
+    REACTOR_ENTRY       *pentry;
+    struct epoll_event  ev;
+    int                 ishardBest;
+    int                 ishard;
+
+    if ( (port->pvReactor != NULL) || (port->prx != NULL) ) {
+        errno = EBUSY;
+        return SERIAL_ERROR_CODE;
+    }
+
+    pentry = calloc(1, sizeof(*pentry));
+    if ( pentry == NULL ) {
+        return SERIAL_ERROR_CODE;
+    }
+    pentry->port = port;
+    pentry->cbs = *pcbs;
+    pentry->events = EPOLLIN | EPOLLRDHUP;
+
+    pthread_mutex_lock(&prt->mtxAdd);
+
+    ishardBest = 0;
+    for ( ishard = 1; ishard < prt->cShards; ishard++ ) {
+        if ( atomic_load(&prt->rgshard[ishard].cPorts) <
+             atomic_load(&prt->rgshard[ishardBest].cPorts) ) {
+            ishardBest = ishard;
+        }
+    }
+    pshard = &prt->rgshard[ishardBest];
+    pentry->pshard = pshard;
+
+    pthread_mutex_lock(&pshard->mtx);
+    if ( pshard->fRing ) {
+        if ( pshard->cSlotsFree == 0 ) {
+            pthread_mutex_unlock(&pshard->mtx);
+            pthread_mutex_unlock(&prt->mtxAdd);
+            free(pentry);
+            errno = ENOSPC;
+            return SERIAL_ERROR_CODE;
+        }
+        pentry->islot = pshard->rgislotFree[--pshard->cSlotsFree];
+    }
+
+    pentry->pNext = pshard->pentryFirst;
+    if ( pshard->pentryFirst != NULL ) {
+        pshard->pentryFirst->pPrev = pentry;
+    }
+    pshard->pentryFirst = pentry;
+    port->pvReactor = pentry;
+
+    if ( pshard->fRing ) {
+        // the shard queues the first poll/read chain
+        UringTodo(pshard, pentry);
+        Wake(pshard);
+    } else {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = pentry->events;
+        ev.data.ptr = pentry;
+        if ( 0 != epoll_ctl(pshard->epfd, EPOLL_CTL_ADD, port->fd, &ev) ) {
+            Unlink(pshard, pentry);
+            port->pvReactor = NULL;
+            pthread_mutex_unlock(&pshard->mtx);
+            pthread_mutex_unlock(&prt->mtxAdd);
+            free(pentry);
+            return SERIAL_ERROR_CODE;
+        }
+    }
+    atomic_fetch_add(&pshard->cPorts, 1);
+    pthread_mutex_unlock(&pshard->mtx);
+
+    pthread_mutex_unlock(&prt->mtxAdd);
+
+    SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL %s: served by reactor shard %d", port->szDevice, ishardBest);
+    return ishardBest;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialReactorRemove
+**
+**  Synopsis:
+**      bool SerialReactorRemove(SERIAL_REACTOR *prt, SERIAL_PORT *port)
+**
+**  Return Values:
+**      true once no callback for the port is running or will run
+**      false if the port was not registered
+**
+**  Description:
+**      May be called from any thread, including from a callback of the
+**      same shard.  A callback must not remove a port of another shard.
+**      On an io_uring shard a call from another thread also waits until
+**      the kernel has let go of the port's requests, so no read started
+**      by the reactor can take data from the port afterwards.
+*/
+bool SerialReactorRemove(SERIAL_REACTOR *prt, SERIAL_PORT *port) {
+
+    REACTOR_ENTRY   *pentry = port->pvReactor;
+    REACTOR_ENTRY   *pentryDead;
+    REACTOR_SHARD   *pshard;
+    bool            fLock;
+
+    (void)prt;
+    if ( pentry == NULL ) {
+        return false;
+    }
+    pshard = pentry->pshard;
+
+    // the shard thread already holds its lock while in a callback
+    fLock = !pthread_equal(pthread_self(), pshard->thread);
+    if ( fLock ) {
+        pthread_mutex_lock(&pshard->mtx);
+    }
+
+    if ( !pentry->fHungUp && !pshard->fRing ) {
+        (void)epoll_ctl(pshard->epfd, EPOLL_CTL_DEL, port->fd, NULL);
+    }
+    pentry->fRemoved = true;
+    Unlink(pshard, pentry);
+    pentry->pNextDead = pshard->pentryDead;
+    pshard->pentryDead = pentry;
+    port->pvReactor = NULL;
+    atomic_fetch_sub(&pshard->cPorts, 1);
+
+    if ( pshard->fRing ) {
+        // the shard cancels what is in flight and frees the entry after
+        UringTodo(pshard, pentry);
+        if ( fLock ) {
+            Wake(pshard);
+            for (;;) {
+                for ( pentryDead = pshard->pentryDead;
+                      (pentryDead != NULL) && (pentryDead != pentry);
+                      pentryDead = pentryDead->pNextDead ) {
+                }
+                if ( pentryDead == NULL ) {
+                    break;
+                }
+                pthread_cond_wait(&pshard->cvFreed, &pshard->mtx);
+            }
+        }
+    }
+
+    if ( fLock ) {
+        pthread_mutex_unlock(&pshard->mtx);
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialReactorWrite
+**
+**  Synopsis:
+**      int SerialReactorWrite(SERIAL_REACTOR *prt, SERIAL_PORT *port,
+**                             const uint8_t *pb, size_t cb)
+**
+**  Parameters:
+**      *port           port served by the reactor
+**      *pb, cb         data to send
+**
+**  Return Values:
+**      number of bytes taken, which may be fewer than cb
+**      -1 (SERIAL_ERROR_CODE) on failure, see errno
+**
+**  Errors:
+**      ENOENT          the port is not served by the reactor
+**      EIO             the device hung up
+**      EAGAIN          an io_uring shard has no room left for the port
+**
+**  Description:
+**      On epoll shards this is SerialPortWrite() and blocks until all of
+**      it is written.  On io_uring shards the data is copied into the
+**      port's registered transmit slot, up to SERIAL_REACTOR_URING_TX
+**      bytes, and the call returns at once.  The shard writes it with
+**      its next batch; from a callback that costs no system call at all.
+**      SerialReactorWantWrite() reports when the slot is empty again.
+*/
+int SerialReactorWrite(SERIAL_REACTOR *prt, SERIAL_PORT *port, const uint8_t *pb, size_t cb) {
+
+    REACTOR_ENTRY   *pentry = port->pvReactor;
+    REACTOR_SHARD   *pshard;
+    size_t          cbCopy;
+    bool            fLock;
+
+    (void)prt;
+    if ( pentry == NULL ) {
+        errno = ENOENT;
+        return SERIAL_ERROR_CODE;
+    }
+    pshard = pentry->pshard;
+    if ( !pshard->fRing ) {
+        return SerialPortWrite(port, pb, cb, 0);
+    }
+
+    fLock = !pthread_equal(pthread_self(), pshard->thread);
+    if ( fLock ) {
+        pthread_mutex_lock(&pshard->mtx);
+    }
+
+    cbCopy = 0;
+    if ( pentry->fHungUp && (port->photplug == NULL) ) {
+        errno = EIO;
+    } else {
+        // a write in flight only covers the front of the slot
+        cbCopy = SERIAL_REACTOR_URING_TX - pentry->cbTx;
+        cbCopy = ( cb < cbCopy ) ? cb : cbCopy;
+        memcpy(pshard->pbSlots + (size_t)pentry->islot * REACTOR_URING_SLOT + REACTOR_URING_RX +
+               pentry->cbTx, pb, cbCopy);
+        pentry->cbTx += cbCopy;
+        if ( (cbCopy > 0) && (pentry->cbTxBusy == 0) ) {
+            UringTodo(pshard, pentry);
+            Wake(pshard);
+        }
+        if ( cbCopy == 0 ) {
+            errno = EAGAIN;
+        }
+    }
+
+    if ( fLock ) {
+        pthread_mutex_unlock(&pshard->mtx);
+    }
+    if ( (cbCopy == 0) && (cb > 0) ) {
+        return SERIAL_ERROR_CODE;
+    }
+    return (int)cbCopy;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialReactorWantWrite
+**
+**  Synopsis:
+**      bool SerialReactorWantWrite(SERIAL_REACTOR *prt, SERIAL_PORT *port, bool fWant)
+**
+**  Return Values:
+**      true on success, false if the port is not being watched
+**
+**  Description:
+**      Turns SERIAL_REACTOR_WRITABLE events on or off.  On epoll shards
+**      they repeat for as long as the driver has room, so turn them off
+**      again once the pending data is written.  On io_uring shards one
+**      is reported each time the transmit slot empties, and once straight
+**      away if it already is.
+*/
+bool SerialReactorWantWrite(SERIAL_REACTOR *prt, SERIAL_PORT *port, bool fWant) {
+
+    REACTOR_ENTRY       *pentry = port->pvReactor;
+    REACTOR_SHARD       *pshard;
+    struct epoll_event  ev;
+    bool                fLock;
+
+    (void)prt;
+    if ( (pentry == NULL) || pentry->fHungUp ) {
+        errno = ENOENT;
+        return false;
+    }
+    pshard = pentry->pshard;
+
+    if ( pshard->fRing ) {
+        fLock = !pthread_equal(pthread_self(), pshard->thread);
+        if ( fLock ) {
+            pthread_mutex_lock(&pshard->mtx);
+        }
+        pentry->fWantWrite = fWant;
+        if ( fWant && (pentry->cbTx == 0) ) {
+            pentry->fKickWritable = true;
+            UringTodo(pshard, pentry);
+            Wake(pshard);
+        }
+        if ( fLock ) {
+            pthread_mutex_unlock(&pshard->mtx);
+        }
+        return true;
+    }
+
+    pentry->events = fWant ? (pentry->events | EPOLLOUT) : (pentry->events & ~EPOLLOUT);
+    memset(&ev, 0, sizeof(ev));
+    ev.events = pentry->events;
+    ev.data.ptr = pentry;
+    return ( 0 == epoll_ctl(pshard->epfd, EPOLL_CTL_MOD, port->fd, &ev) );
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialReactorFlags
+**
+**  Return Values:
+**      SERIAL_REACTOR_* flags in effect, SERIAL_REACTOR_URING is missing
+**      if the reactor fell back to epoll
+*/
+uint32_t SerialReactorFlags(SERIAL_REACTOR *prt) {
+
+    return prt->flags;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialReactorShards
+**
+**  Return Values:
+**      number of shards
+*/
+int SerialReactorShards(SERIAL_REACTOR *prt) {
+
+    return prt->cShards;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialReactorShardPorts
+**
+**  Return Values:
+**      number of ports shard ishard serves
+*/
+uint32_t SerialReactorShardPorts(SERIAL_REACTOR *prt, int ishard) {
+
+    if ( (ishard < 0) || (ishard >= prt->cShards) ) {
+        return 0;
+    }
+    return atomic_load(&prt->rgshard[ishard].cPorts);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialReactorGetStats
+**
+**  Synopsis:
+**      void SerialReactorGetStats(SERIAL_REACTOR *prt, SERIAL_REACTOR_STATS *pstats)
+**
+**  Description:
+**      Sums the counters of all shards since the reactor was created.
+**      The shards keep running, each counter is read on its own.
+*/
+void SerialReactorGetStats(SERIAL_REACTOR *prt, SERIAL_REACTOR_STATS *pstats) {
+
+    REACTOR_SHARD   *pshard;
+    int             ishard;
+
+    memset(pstats, 0, sizeof(*pstats));
+    for ( ishard = 0; ishard < prt->cShards; ishard++ ) {
+        pshard = &prt->rgshard[ishard];
+        pstats->cbRead += atomic_load_explicit(&pshard->cbRead, memory_order_relaxed);
+        pstats->cbWritten += atomic_load_explicit(&pshard->cbWritten, memory_order_relaxed);
+        pstats->cSyscalls += atomic_load_explicit(&pshard->cSyscalls, memory_order_relaxed);
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    ReactorDetach
+**
+**  Synopsis:
+**      void ReactorDetach(SERIAL_PORT *port)
+**
+**  Description:
+**      Called by SerialPortClose() so a port closed while registered
+**      does not leave a dangling entry behind.
+*/
+void ReactorDetach(SERIAL_PORT *port) {
+
+    if ( port->pvReactor != NULL ) {
+        SerialReactorRemove(NULL, port);
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    ReactorReconnected
+**
+**  Synopsis:
+**      void ReactorReconnected(SERIAL_PORT *port)
+**
+**  Description:
+**      Called from the reconnect thread once the port's descriptor is a
+**      new device.  Closing the old one took it out of the epoll set, so
+**      it is added again; io_uring shards queue a fresh poll/read chain
+**      and send what waited in the transmit slot.
+*/
+void ReactorReconnected(SERIAL_PORT *port) {
+
+    REACTOR_ENTRY       *pentry = port->pvReactor;
+    REACTOR_SHARD       *pshard;
+    struct epoll_event  ev;
+
+    if ( pentry == NULL ) {
+        return;
+    }
+    pshard = pentry->pshard;
+
+    pthread_mutex_lock(&pshard->mtx);
+    if ( !pentry->fRemoved ) {
+        if ( pshard->fRing ) {
+            if ( pentry->fHungUp ) {
+                pentry->fHungUp = false;
+                UringTodo(pshard, pentry);
+                Wake(pshard);
+            }
+        } else {
+            memset(&ev, 0, sizeof(ev));
+            ev.events = pentry->events;
+            ev.data.ptr = pentry;
+            if ( (epoll_ctl(pshard->epfd, EPOLL_CTL_ADD, port->fd, &ev) == 0) || (errno == EEXIST) ) {
+                pentry->fHungUp = false;
+            }
+        }
+    }
+    pthread_mutex_unlock(&pshard->mtx);
+}
+
+/* ------------------------------------------------------------ */
+/***    ShardThread
+**
+**  Synopsis:
+**      void *ShardThread(void *pv)
+**
+**  Parameters:
+**      pv              the REACTOR_SHARD to run
+**
+**  Description:
+**      Sleeps in epoll_wait() until a port or the stop eventfd is ready,
+**      then dispatches the whole batch under the shard lock.
+*/
+static void *ShardThread(void *pv) {
+
+    REACTOR_SHARD       *pshard = pv;
+    REACTOR_ENTRY       *pentry;
+    struct epoll_event  rgev[REACTOR_EVENTS];
+    int                 cev;
+    int                 iev;
+
+    for (;;) {
+        cev = epoll_wait(pshard->epfd, rgev, REACTOR_EVENTS, -1);
+        STAT_ADD(pshard->cSyscalls, 1);
+        if ( cev < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            SERIAL_LOG(SERIAL_LOG_ERROR, "SERIAL reactor: epoll_wait failed: %s", strerror(errno));
+            return NULL;
+        }
+
+        pthread_mutex_lock(&pshard->mtx);
+        for ( iev = 0; iev < cev; iev++ ) {
+            pentry = rgev[iev].data.ptr;
+            if ( pentry == NULL ) {
+                pthread_mutex_unlock(&pshard->mtx);
+                return NULL;
+            }
+            if ( !pentry->fRemoved ) {
+                Dispatch(pshard, pentry, rgev[iev].events);
+            }
+        }
+
+        while ( (pentry = pshard->pentryDead) != NULL ) {
+            pshard->pentryDead = pentry->pNextDead;
+            free(pentry);
+        }
+        pthread_mutex_unlock(&pshard->mtx);
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    Dispatch
+**
+**  Synopsis:
+**      void Dispatch(REACTOR_SHARD *pshard, REACTOR_ENTRY *pentry, uint32_t events)
+**
+**  Description:
+**      Drains the port into the shard's buffer and hands each chunk to
+**      pfnData.  Stops early if a callback removes the port.
+*/
+static void Dispatch(REACTOR_SHARD *pshard, REACTOR_ENTRY *pentry, uint32_t events) {
+
+    SERIAL_PORT *port = pentry->port;
+    ssize_t     cbRead;
+
+    if ( events & EPOLLIN ) {
+        for (;;) {
+            cbRead = read(port->fd, pshard->rgbRead, sizeof(pshard->rgbRead));
+            STAT_ADD_SHARED(port->stats.cReadCalls, 1);
+            STAT_ADD(pshard->cSyscalls, 1);
+            if ( cbRead > 0 ) {
+                STAT_ADD_SHARED(port->stats.cbRead, cbRead);
+                STAT_ADD(pshard->cbRead, cbRead);
+                CAPTURE_DATA(port, SERIAL_CAPTURE_RX, pshard->rgbRead, cbRead);
+                pentry->cbs.pfnData(pentry->cbs.pvUser, port, pshard->rgbRead, cbRead);
+                if ( pentry->fRemoved ) {
+                    return;
+                }
+                if ( cbRead < (ssize_t)sizeof(pshard->rgbRead) ) {
+                    break;
+                }
+                continue;
+            }
+            if ( cbRead < 0 ) {
+                if ( errno == EINTR ) {
+                    continue;
+                }
+                if ( errno == EAGAIN ) {
+                    STAT_ADD_SHARED(port->stats.cEagain, 1);
+                    break;
+                }
+                STAT_ADD_SHARED(port->stats.cErrors, 1);
+                SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL %s: reactor read error %d %s",
+                           port->szDevice, errno, strerror(errno));
+                HangUp(pshard, pentry);
+                return;
+            }
+            // readable but empty: only a hangup does that
+            if ( events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR) ) {
+                HangUp(pshard, pentry);
+                return;
+            }
+            break;
+        }
+    } else if ( events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR) ) {
+        HangUp(pshard, pentry);
+        return;
+    }
+
+    if ( (events & EPOLLOUT) && (pentry->cbs.pfnEvent != NULL) ) {
+        pentry->cbs.pfnEvent(pentry->cbs.pvUser, port, SERIAL_REACTOR_WRITABLE);
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    HangUp
+**
+**  Description:
+**      Stops watching a port whose device went away, a level-triggered
+**      hangup would otherwise wake the shard forever.  The port stays
+**      registered until SerialReactorRemove().  A port set up with
+**      SerialPortSetReconnect() is watched again once the device is
+**      back, see ReactorReconnected().
+*/
+static void HangUp(REACTOR_SHARD *pshard, REACTOR_ENTRY *pentry) {
+
+    struct epoll_event ev;
+
+    if ( pentry->fHungUp ) {
+        return;
+    }
+    if ( (pentry->port->photplug != NULL) && !HotplugLost(pentry->port) ) {
+        // reconnected already, the hangup was on the descriptor it replaced
+        if ( pshard->fRing ) {
+            UringTodo(pshard, pentry);
+        } else {
+            memset(&ev, 0, sizeof(ev));
+            ev.events = pentry->events;
+            ev.data.ptr = pentry;
+            (void)epoll_ctl(pshard->epfd, EPOLL_CTL_ADD, pentry->port->fd, &ev);
+        }
+        return;
+    }
+
+    if ( !pshard->fRing ) {
+        (void)epoll_ctl(pshard->epfd, EPOLL_CTL_DEL, pentry->port->fd, NULL);
+    }
+    pentry->fHungUp = true;
+    SERIAL_LOG(SERIAL_LOG_INFO, "SERIAL %s: hangup", pentry->port->szDevice);
+    if ( pentry->cbs.pfnEvent != NULL ) {
+        pentry->cbs.pfnEvent(pentry->cbs.pvUser, pentry->port, SERIAL_REACTOR_HANGUP);
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    Unlink
+**
+**  Description:
+**      Takes an entry off its shard's list of ports.
+*/
+static void Unlink(REACTOR_SHARD *pshard, REACTOR_ENTRY *pentry) {
+
+    if ( pentry->pPrev != NULL ) {
+        pentry->pPrev->pNext = pentry->pNext;
+    } else {
+        pshard->pentryFirst = pentry->pNext;
+    }
+    if ( pentry->pNext != NULL ) {
+        pentry->pNext->pPrev = pentry->pPrev;
+    }
+    pentry->pNext = NULL;
+    pentry->pPrev = NULL;
+}
+
+/* ------------------------------------------------------------ */
+/***    ShardInitUring
+**
+**  Synopsis:
+**      bool ShardInitUring(REACTOR_SHARD *pshard)
+**
+**  Return Values:
+**      true if the shard now runs on io_uring, false with errno set
+**
+**  Description:
+**      Registers all of the shard's port slots as one fixed buffer.
+*/
+static bool ShardInitUring(REACTOR_SHARD *pshard) {
+
+    static const uint8_t rgop[] = {
+        IORING_OP_POLL_ADD, IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED,
+        IORING_OP_ASYNC_CANCEL, IORING_OP_READ
+    };
+    struct iovec    iov;
+    int             islot;
+
+    iov.iov_len = (size_t)SERIAL_REACTOR_URING_PORTS * REACTOR_URING_SLOT;
+    pshard->pbSlots = aligned_alloc(4096, iov.iov_len);
+    if ( pshard->pbSlots == NULL ) {
+        return false;
+    }
+    iov.iov_base = pshard->pbSlots;
+    if ( !UringInit(&pshard->ring, REACTOR_URING_SQ, &iov, 1, rgop, sizeof(rgop)) ) {
+        free(pshard->pbSlots);
+        pshard->pbSlots = NULL;
+        return false;
+    }
+
+    // hand out low slots first
+    for ( islot = 0; islot < SERIAL_REACTOR_URING_PORTS; islot++ ) {
+        pshard->rgislotFree[islot] = SERIAL_REACTOR_URING_PORTS - 1 - islot;
+    }
+    pshard->cSlotsFree = SERIAL_REACTOR_URING_PORTS;
+    pshard->fRing = true;
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+/***    UringShardThread
+**
+**  Synopsis:
+**      void *UringShardThread(void *pv)
+**
+**  Parameters:
+**      pv              the REACTOR_SHARD to run
+**
+**  Description:
+**      Queues whatever the to-do list asks for, then submits it and
+**      waits for completions in the same io_uring_enter().  Every
+**      completion is handled under the shard lock.  On stop it cancels
+**      everything and runs until the kernel holds no more requests.
+*/
+static void *UringShardThread(void *pv) {
+
+    REACTOR_SHARD       *pshard = pv;
+    struct io_uring_cqe *pcqe;
+    uint64_t            userData;
+    int                 res;
+    int                 rc;
+
+    pthread_mutex_lock(&pshard->mtx);
+    UringArmWake(pshard);
+
+    for (;;) {
+        UringRunTodo(pshard);
+        UringFreeDead(pshard);
+        if ( pshard->fStop && (pshard->cInflight == 0) ) {
+            break;
+        }
+        pthread_mutex_unlock(&pshard->mtx);
+
+        rc = UringEnter(&pshard->ring, 1);
+        STAT_ADD(pshard->cSyscalls, 1);
+
+        pthread_mutex_lock(&pshard->mtx);
+        if ( (rc < 0) && (errno != EINTR) ) {
+            SERIAL_LOG(SERIAL_LOG_ERROR, "SERIAL reactor: io_uring_enter failed: %s", strerror(errno));
+            break;
+        }
+        while ( (pcqe = UringPeek(&pshard->ring)) != NULL ) {
+            userData = pcqe->user_data;
+            res = pcqe->res;
+            UringSeen(&pshard->ring);
+            UringComplete(pshard, userData, res);
+        }
+    }
+
+    pthread_mutex_unlock(&pshard->mtx);
+    return NULL;
+}
+
+/* ------------------------------------------------------------ */
+/***    UringTodo
+**
+**  Synopsis:
+**      void UringTodo(REACTOR_SHARD *pshard, REACTOR_ENTRY *pentry)
+**
+**  Description:
+**      Puts an entry on the shard's to-do list, shard lock held.  The
+**      shard works out what it needs when it gets to it.
+*/
+static void UringTodo(REACTOR_SHARD *pshard, REACTOR_ENTRY *pentry) {
+
+    if ( !pentry->fTodo ) {
+        pentry->fTodo = true;
+        pentry->pNextTodo = pshard->pentryTodo;
+        pshard->pentryTodo = pentry;
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    UringRunTodo
+**
+**  Synopsis:
+**      void UringRunTodo(REACTOR_SHARD *pshard)
+**
+**  Description:
+**      Queues, for every entry on the to-do list, the poll/read chain if
+**      none is armed and a write of whatever waits in its transmit slot,
+**      or the cancellation of its requests once removed or stopping.
+*/
+static void UringRunTodo(REACTOR_SHARD *pshard) {
+
+    REACTOR_ENTRY       *pentry;
+    struct io_uring_sqe *psqe;
+    uint8_t             *pbSlot;
+
+    while ( (pentry = pshard->pentryTodo) != NULL ) {
+        pshard->pentryTodo = pentry->pNextTodo;
+        pentry->fTodo = false;
+        pbSlot = pshard->pbSlots + (size_t)pentry->islot * REACTOR_URING_SLOT;
+
+        if ( pentry->fRemoved || pshard->fStop ) {
+            if ( pentry->fCancelled ) {
+                continue;
+            }
+            pentry->fCancelled = true;
+            if ( pentry->fArmed ) {
+                // the read linked behind the poll fails with it
+                psqe = UringShardSqe(pshard);
+                psqe->opcode = IORING_OP_ASYNC_CANCEL;
+                psqe->fd = -1;
+                psqe->addr = (uintptr_t)pentry | URING_OP_POLL;
+                psqe->user_data = (uintptr_t)pentry | URING_OP_CANCEL;
+                pentry->cInflight++;
+                pshard->cInflight++;
+            }
+            if ( pentry->cbTxBusy > 0 ) {
+                psqe = UringShardSqe(pshard);
+                psqe->opcode = IORING_OP_ASYNC_CANCEL;
+                psqe->fd = -1;
+                psqe->addr = (uintptr_t)pentry | URING_OP_WRITE;
+                psqe->user_data = (uintptr_t)pentry | URING_OP_CANCEL;
+                pentry->cInflight++;
+                pshard->cInflight++;
+            }
+            continue;
+        }
+        if ( pentry->fHungUp ) {
+            continue;
+        }
+
+        if ( !pentry->fArmed ) {
+            psqe = UringShardSqe(pshard);
+            psqe->opcode = IORING_OP_POLL_ADD;
+            psqe->fd = pentry->port->fd;
+            psqe->poll32_events = POLLIN;
+            psqe->flags = IOSQE_IO_LINK;
+            psqe->user_data = (uintptr_t)pentry | URING_OP_POLL;
+            psqe = UringShardSqe(pshard);
+            psqe->opcode = IORING_OP_READ_FIXED;
+            psqe->fd = pentry->port->fd;
+            psqe->addr = (uintptr_t)pbSlot;
+            psqe->len = REACTOR_URING_RX;
+            psqe->buf_index = 0;
+            psqe->user_data = (uintptr_t)pentry | URING_OP_READ;
+            pentry->fArmed = true;
+            pentry->cInflight += 2;
+            pshard->cInflight += 2;
+        }
+
+        if ( (pentry->cbTx > 0) && (pentry->cbTxBusy == 0) ) {
+            psqe = UringShardSqe(pshard);
+            psqe->opcode = IORING_OP_WRITE_FIXED;
+            psqe->fd = pentry->port->fd;
+            psqe->addr = (uintptr_t)(pbSlot + REACTOR_URING_RX);
+            psqe->len = pentry->cbTx;
+            psqe->buf_index = 0;
+            psqe->user_data = (uintptr_t)pentry | URING_OP_WRITE;
+            pentry->cbTxBusy = pentry->cbTx;
+            pentry->cInflight++;
+            pshard->cInflight++;
+        }
+
+        if ( pentry->fKickWritable ) {
+            pentry->fKickWritable = false;
+            if ( pentry->fWantWrite && (pentry->cbTx == 0) && (pentry->cbs.pfnEvent != NULL) ) {
+                pentry->cbs.pfnEvent(pentry->cbs.pvUser, pentry->port, SERIAL_REACTOR_WRITABLE);
+            }
+        }
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    UringComplete
+**
+**  Synopsis:
+**      void UringComplete(REACTOR_SHARD *pshard, uint64_t userData, int res)
+**
+**  Description:
+**      Handles one completion, shard lock held.  Data goes to pfnData
+**      straight from the port's receive slot; the port is then put back
+**      on the to-do list so its next read goes out with the next batch.
+*/
+static void UringComplete(REACTOR_SHARD *pshard, uint64_t userData, int res) {
+
+    REACTOR_ENTRY   *pentry = (REACTOR_ENTRY *)(uintptr_t)(userData & ~(uint64_t)URING_OP_MASK);
+    SERIAL_PORT     *port;
+    uint8_t         *pbSlot;
+
+    pshard->cInflight--;
+    if ( pentry == NULL ) {
+        // the eventfd was written: new work, or stop
+        if ( !pshard->fStop ) {
+            UringArmWake(pshard);
+        } else {
+            for ( pentry = pshard->pentryFirst; pentry != NULL; pentry = pentry->pNext ) {
+                UringTodo(pshard, pentry);
+            }
+        }
+        return;
+    }
+    pentry->cInflight--;
+    port = pentry->port;
+    pbSlot = pshard->pbSlots + (size_t)pentry->islot * REACTOR_URING_SLOT;
+
+    switch ( userData & URING_OP_MASK ) {
+        case URING_OP_POLL:
+            pentry->revents = res;
+            break;
+
+        case URING_OP_READ:
+            pentry->fArmed = false;
+            if ( pentry->fRemoved || pshard->fStop ) {
+                break;
+            }
+            if ( res > 0 ) {
+                STAT_ADD_SHARED(port->stats.cbRead, res);
+                STAT_ADD(pshard->cbRead, res);
+                CAPTURE_DATA(port, SERIAL_CAPTURE_RX, pbSlot, res);
+                pentry->cbs.pfnData(pentry->cbs.pvUser, port, pbSlot, res);
+                if ( !pentry->fRemoved ) {
+                    UringTodo(pshard, pentry);
+                }
+            } else if ( (res == 0) || (res == -ECANCELED) ) {
+                // readable but empty, or the poll itself failed: a hangup
+                if ( (pentry->revents < 0) || (pentry->revents & (POLLHUP | POLLERR)) ) {
+                    HangUp(pshard, pentry);
+                } else {
+                    UringTodo(pshard, pentry);
+                }
+            } else if ( (res == -EINTR) || (res == -EAGAIN) ) {
+                UringTodo(pshard, pentry);
+            } else {
+                STAT_ADD_SHARED(port->stats.cErrors, 1);
+                SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL %s: reactor read error %d %s",
+                           port->szDevice, -res, strerror(-res));
+                HangUp(pshard, pentry);
+            }
+            break;
+
+        case URING_OP_WRITE:
+            pentry->cbTxBusy = 0;
+            if ( res > 0 ) {
+                STAT_ADD_SHARED(port->stats.cbWritten, res);
+                STAT_ADD(pshard->cbWritten, res);
+                CAPTURE_DATA(port, SERIAL_CAPTURE_TX, pbSlot + REACTOR_URING_RX, res);
+                pentry->cbTx -= res;
+                memmove(pbSlot + REACTOR_URING_RX, pbSlot + REACTOR_URING_RX + res, pentry->cbTx);
+            } else if ( (res == -EIO) && (port->photplug != NULL) ) {
+                // kept for the reconnect, which writes it to the new device
+                HangUp(pshard, pentry);
+            } else if ( (res != -EINTR) && (res != -EAGAIN) ) {
+                // the read side reports a hangup, the data is lost either way
+                STAT_ADD_SHARED(port->stats.cErrors, 1);
+                pentry->cbTx = 0;
+            }
+            if ( pentry->fRemoved || pshard->fStop || pentry->fHungUp ) {
+                break;
+            }
+            if ( pentry->cbTx > 0 ) {
+                UringTodo(pshard, pentry);
+            } else if ( pentry->fWantWrite && (pentry->cbs.pfnEvent != NULL) ) {
+                pentry->cbs.pfnEvent(pentry->cbs.pvUser, port, SERIAL_REACTOR_WRITABLE);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    UringFreeDead
+**
+**  Synopsis:
+**      void UringFreeDead(REACTOR_SHARD *pshard)
+**
+**  Description:
+**      Frees removed entries the kernel no longer holds requests for and
+**      returns their slots.  Wakes removers waiting on them.
+*/
+static void UringFreeDead(REACTOR_SHARD *pshard) {
+
+    REACTOR_ENTRY   **ppentry;
+    REACTOR_ENTRY   *pentry;
+    bool            fFreed = false;
+
+    ppentry = &pshard->pentryDead;
+    while ( (pentry = *ppentry) != NULL ) {
+        if ( (pentry->cInflight > 0) || pentry->fTodo ) {
+            ppentry = &pentry->pNextDead;
+            continue;
+        }
+        *ppentry = pentry->pNextDead;
+        pshard->rgislotFree[pshard->cSlotsFree++] = pentry->islot;
+        free(pentry);
+        fFreed = true;
+    }
+    if ( fFreed ) {
+        pthread_cond_broadcast(&pshard->cvFreed);
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    UringShardSqe
+**
+**  Synopsis:
+**      struct io_uring_sqe *UringShardSqe(REACTOR_SHARD *pshard)
+**
+**  Description:
+**      Next submission entry, submitting what is queued first if the
+**      queue is full.
+*/
+static struct io_uring_sqe *UringShardSqe(REACTOR_SHARD *pshard) {
+
+    struct io_uring_sqe *psqe;
+
+    while ( (psqe = UringSqe(&pshard->ring)) == NULL ) {
+        (void)UringEnter(&pshard->ring, 0);
+        STAT_ADD(pshard->cSyscalls, 1);
+    }
+    return psqe;
+}
+
+/* ------------------------------------------------------------ */
+/***    UringArmWake
+**
+**  Description:
+**      Posts a read on the shard's eventfd so other threads can wake it.
+*/
+static void UringArmWake(REACTOR_SHARD *pshard) {
+
+    struct io_uring_sqe *psqe;
+
+    psqe = UringShardSqe(pshard);
+    psqe->opcode = IORING_OP_READ;
+    psqe->fd = pshard->evtStop;
+    psqe->addr = (uintptr_t)&pshard->cWake;
+    psqe->len = sizeof(pshard->cWake);
+    psqe->user_data = 0;
+    pshard->cInflight++;
+}
+
+/* ------------------------------------------------------------ */
+/***    Wake
+**
+**  Description:
+**      Gets an io_uring shard out of io_uring_enter() to look at its
+**      to-do list.  Not needed from the shard's own thread.
+*/
+static void Wake(REACTOR_SHARD *pshard) {
+
+    uint64_t    one = 1;
+
+    if ( pthread_equal(pthread_self(), pshard->thread) ) {
+        return;
+    }
+    while ( (write(pshard->evtStop, &one, sizeof(one)) < 0) && (errno == EINTR) ) {
+    }
+}
+
+
+/************************************ EOF ********************************/
@@ -0,0 +1,121 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_reactor.h --  EmbedCreativity's Serial reactor header file       */
+/*                                                                      */
+/************************************************************************/
+/*  Author:     agent                                                   */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*  This header file contains declarations the functions contained in   */
+/*  ec_reactor.c                                                        */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026(agent): created                                          */
+/*  10/16/2026(agent): added io_uring shards and SerialReactorWrite()   */
+/*  10/16/2026(agent): extern "C" guards for the C++ layer              */
+/*  10/16/2026(agent): hangups of ports that reconnect                  */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(_SERIALREACTOR_H)
+#define _SERIALREACTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ec_serial.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------------ */
+/*                  Definitions                                 */
+/* ------------------------------------------------------------ */
+
+// SerialReactorCreate() flags
+#define SERIAL_REACTOR_PIN      0x0001  // pin shard i to the i-th CPU of the process
+#define SERIAL_REACTOR_URING    0x0002  // shards batch their I/O through io_uring
+
+#define SERIAL_REACTOR_URING_PORTS  256 // ports one io_uring shard can serve
+#define SERIAL_REACTOR_URING_TX     1024 // bytes SerialReactorWrite() can queue per port
+
+/* ------------------------------------------------------------ */
+/*                  General Type Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef enum {
+    SERIAL_REACTOR_WRITABLE,    // the driver takes data again, see SerialReactorWantWrite()
+    SERIAL_REACTOR_HANGUP       // the device went away, the port is no longer watched
+                                // until SerialPortSetReconnect() brings it back
+} SERIAL_REACTOR_EVENT;
+
+// Data just read from the port, valid only during the call
+typedef void (*SERIAL_REACTOR_DATA_FN)(void *pvUser, SERIAL_PORT *port,
+                                       const uint8_t *pb, size_t cb);
+typedef void (*SERIAL_REACTOR_EVENT_FN)(void *pvUser, SERIAL_PORT *port,
+                                        SERIAL_REACTOR_EVENT evt);
+
+// Work done by the shard threads, see SerialReactorGetStats()
+typedef struct {
+    uint64_t    cbRead;             // bytes handed to pfnData
+    uint64_t    cbWritten;          // bytes written by io_uring shards
+    uint64_t    cSyscalls;          // system calls the shard threads made
+} SERIAL_REACTOR_STATS;
+
+typedef struct {
+    SERIAL_REACTOR_DATA_FN  pfnData;
+    SERIAL_REACTOR_EVENT_FN pfnEvent;   // may be NULL
+    void                    *pvUser;
+} SERIAL_REACTOR_CBS;
+
+/* ------------------------------------------------------------ */
+/*                  Object Class Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef struct SERIAL_REACTOR SERIAL_REACTOR;
+
+/* ------------------------------------------------------------ */
+/*                  Function Prototypes                         */
+/* ------------------------------------------------------------ */
+
+SERIAL_REACTOR *SerialReactorCreate(int cShards, uint32_t flags);
+void    SerialReactorDestroy(SERIAL_REACTOR *prt);
+int     SerialReactorAdd(SERIAL_REACTOR *prt, SERIAL_PORT *port, const SERIAL_REACTOR_CBS *pcbs);
+bool    SerialReactorRemove(SERIAL_REACTOR *prt, SERIAL_PORT *port);
+int     SerialReactorWrite(SERIAL_REACTOR *prt, SERIAL_PORT *port, const uint8_t *pb, size_t cb);
+bool    SerialReactorWantWrite(SERIAL_REACTOR *prt, SERIAL_PORT *port, bool fWant);
+uint32_t SerialReactorFlags(SERIAL_REACTOR *prt);
+int     SerialReactorShards(SERIAL_REACTOR *prt);
+uint32_t SerialReactorShardPorts(SERIAL_REACTOR *prt, int ishard);
+void    SerialReactorGetStats(SERIAL_REACTOR *prt, SERIAL_REACTOR_STATS *pstats);
+/* ------------------------------------------------------------ */
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+
+/**********************************  EOF  **************************************/
@@ -0,0 +1,205 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+  
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_ring.h --  EmbedCreativity's single producer/consumer ring       */
+/*                                                                      */
+/************************************************************************/
+/*  Author:     agent                                                   */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*  Lock-free byte ring shared by exactly one producer thread and one   */
+/*  consumer thread.  Indices run freely and are masked on use, so the  */
+/*  full capacity is usable.  Each side keeps a private copy of the     */
+/*  other side's index and only reloads the shared one when the copy    */
+/*  says it is out of room, which keeps the cache lines from bouncing.  */
+/*  Everything is inline, this sits on the receive hot path.            */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026(agent): created                                          */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(_SERIALRING_H)
+#define _SERIALRING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+
+/* ------------------------------------------------------------ */
+/*                  Definitions                                 */
+/* ------------------------------------------------------------ */
+
+#define SERIAL_CACHE_LINE   64
+
+/* ------------------------------------------------------------ */
+/*                  Object Class Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef struct {
+    // producer side
+    _Alignas(SERIAL_CACHE_LINE) _Atomic size_t  ibHead;
+    size_t                                      ibTailCache;
+    // consumer side
+    _Alignas(SERIAL_CACHE_LINE) _Atomic size_t  ibTail;
+    size_t                                      ibHeadCache;
+    // read only after init
+    _Alignas(SERIAL_CACHE_LINE) uint8_t         *rgb;
+    size_t                                      cb;
+    size_t                                      cbMask;
+} SERIAL_RING;
+
+/* ------------------------------------------------------------ */
+/*                  Procedure Definitions                       */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    RingInit
+**
+**  Synopsis:
+**      bool RingInit(SERIAL_RING *pring, size_t cb)
+**
+**  Description:
+**      Allocates the storage, cb is rounded up to a power of two.
+*/
+static inline bool RingInit(SERIAL_RING *pring, size_t cb) {
+
+    size_t cbRound;
+
+    for ( cbRound = SERIAL_CACHE_LINE; cbRound < cb; cbRound <<= 1 ) {
+    }
+
+    pring->rgb = aligned_alloc(SERIAL_CACHE_LINE, cbRound);
+    if ( pring->rgb == NULL ) {
+        return false;
+    }
+    pring->cb = cbRound;
+    pring->cbMask = cbRound - 1;
+    atomic_init(&pring->ibHead, 0);
+    atomic_init(&pring->ibTail, 0);
+    pring->ibTailCache = 0;
+    pring->ibHeadCache = 0;
+    return true;
+}
+
+static inline void RingFree(SERIAL_RING *pring) {
+
+    free(pring->rgb);
+    pring->rgb = NULL;
+}
+
+/* ------------------------------------------------------------ */
+/***    RingWritable
+**
+**  Synopsis:
+**      size_t RingWritable(SERIAL_RING *pring, struct iovec rgiov[2])
+**
+**  Description:
+**      Producer only.  Describes the free space as at most two regions
+**      (before and after the wrap) so a single readv() can fill both.
+**      Returns the total number of free bytes.
+*/
+static inline size_t RingWritable(SERIAL_RING *pring, struct iovec rgiov[2]) {
+
+    size_t ibHead = atomic_load_explicit(&pring->ibHead, memory_order_relaxed);
+    size_t cbFree = pring->cb - (ibHead - pring->ibTailCache);
+    size_t ibStart;
+    size_t cbFirst;
+
+    if ( cbFree == 0 ) {
+        pring->ibTailCache = atomic_load_explicit(&pring->ibTail, memory_order_acquire);
+        cbFree = pring->cb - (ibHead - pring->ibTailCache);
+    }
+
+    ibStart = ibHead & pring->cbMask;
+    cbFirst = pring->cb - ibStart;
+    if ( cbFirst > cbFree ) {
+        cbFirst = cbFree;
+    }
+    rgiov[0].iov_base = pring->rgb + ibStart;
+    rgiov[0].iov_len = cbFirst;
+    rgiov[1].iov_base = pring->rgb;
+    rgiov[1].iov_len = cbFree - cbFirst;
+    return cbFree;
+}
+
+/* Producer only, publishes cb bytes written into the RingWritable() space. */
+static inline void RingCommit(SERIAL_RING *pring, size_t cb) {
+
+    size_t ibHead = atomic_load_explicit(&pring->ibHead, memory_order_relaxed);
+
+    atomic_store_explicit(&pring->ibHead, ibHead + cb, memory_order_release);
+}
+
+/* ------------------------------------------------------------ */
+/***    RingPeek
+**
+**  Synopsis:
+**      size_t RingPeek(SERIAL_RING *pring, const uint8_t **ppb)
+**
+**  Description:
+**      Consumer only.  Points *ppb at the oldest unread byte and returns
+**      how many bytes are contiguous from there.  Call again after
+**      RingConsume() to see the part that wrapped.
+*/
+static inline size_t RingPeek(SERIAL_RING *pring, const uint8_t **ppb) {
+
+    size_t ibTail = atomic_load_explicit(&pring->ibTail, memory_order_relaxed);
+    size_t cbUsed = pring->ibHeadCache - ibTail;
+    size_t ibStart;
+
+    if ( cbUsed == 0 ) {
+        pring->ibHeadCache = atomic_load_explicit(&pring->ibHead, memory_order_acquire);
+        cbUsed = pring->ibHeadCache - ibTail;
+    }
+
+    ibStart = ibTail & pring->cbMask;
+    if ( cbUsed > pring->cb - ibStart ) {
+        cbUsed = pring->cb - ibStart;
+    }
+    *ppb = pring->rgb + ibStart;
+    return cbUsed;
+}
+
+/* Consumer only, hands cb bytes back to the producer. */
+static inline void RingConsume(SERIAL_RING *pring, size_t cb) {
+
+    size_t ibTail = atomic_load_explicit(&pring->ibTail, memory_order_relaxed);
+
+    atomic_store_explicit(&pring->ibTail, ibTail + cb, memory_order_release);
+}
+
+/* Either side, number of unread bytes at this instant. */
+static inline size_t RingUsed(SERIAL_RING *pring) {
+
+    return atomic_load_explicit(&pring->ibHead, memory_order_seq_cst) -
+           atomic_load_explicit(&pring->ibTail, memory_order_seq_cst);
+}
+
+/* ------------------------------------------------------------ */
+
+#endif
+
+/**********************************  EOF  **************************************/
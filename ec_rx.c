@@ -0,0 +1,809 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_rx.c --  EmbedCreativity's background receive thread             */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Optional receive mode for a SERIAL_PORT.  A dedicated thread keeps  */
+/*  the kernel tty buffer drained into a SERIAL_RING so that data is    */
+/*  not lost while the application is busy elsewhere.  The              */
+/*  application is the ring's only consumer, either through             */
+/*  SerialPortReadEx() or by peeking at and consuming the ring in       */
+/*  place.                                                              */
+/*                                                                      */
+/*  The consumer only pays for a wakeup when it is actually asleep: it  */
+/*  raises fWaiting before it blocks and the reader only writes the     */
+/*  eventfd when it finds that flag set.                                */
+/*                                                                      */
+/*  The same handshake runs the other way when flow control is on: a    */
+/*  reader that finds the ring full sleeps until the consumer frees     */
+/*  space, and the driver's handshake holds the sender off meanwhile.   */
+/*  Watermark callbacks tell the application when the ring fills past   */
+/*  a high mark and when it has drained back to a low one.              */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*  10/16/2026 (agent): busy polling and RX thread placement            */
+/*  10/16/2026 (agent): waits for ring space under flow control instead */
+/*                      of dropping, high/low watermark callbacks       */
+/*  10/16/2026 (agent): received chunks feed SerialPortCaptureStart()   */
+/*  10/16/2026 (agent): the RX thread waits out an unplugged device     */
+/*                                                                      */
+/************************************************************************/
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#define _GNU_SOURCE  /* ppoll, pthread_setaffinity_np */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+
+#include "ec_serial.h"
+#include "ec_serial_priv.h"
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static void    *RxThread( void *pv );
+static void     RxWake( SERIAL_RX *prx );
+static int      RxWaitUntil( SERIAL_PORT *port, size_t cbMin, uint64_t nsDeadline );
+static bool     RxWaitSpace( SERIAL_PORT *port );
+static void     RxCheckHigh( SERIAL_PORT *port );
+static void     RxCheckLow( SERIAL_PORT *port );
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    SerialPortRxStart
+**
+**  Synopsis:
+**      bool SerialPortRxStart(SERIAL_PORT *port, size_t cbRing)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      cbRing          ring size in bytes, rounded up to a power of two
+**
+**  Return Values:
+**      1               success, or the thread was already running
+**      0               failure, see errno
+**
+**  Errors:
+**      none
+**
+**  Description:
+**      Starts the receive thread.  From here on SerialPortReadEx() and
+**      friends take their data from the ring, and SerialPortRxPeek() /
+**      SerialPortRxConsume() give access to it without a copy.
+*/
+bool SerialPortRxStart(SERIAL_PORT *port, size_t cbRing) {
+
+    SERIAL_RX   *prx;
+    int         err;
+
+    if ( port->prx != NULL ) {
+        return true;
+    }
+    if ( port->pvReactor != NULL ) {
+        // a reactor shard is reading the port already
+        errno = EBUSY;
+        return false;
+    }
+
+    prx = calloc(1, sizeof(*prx));
+    if ( prx == NULL ) {
+        return false;
+    }
+    prx->evtStop = -1;
+    prx->evtData = -1;
+    prx->evtSpace = -1;
+
+    if ( !RingInit(&prx->ring, cbRing) ) {
+        goto lErrorFree;
+    }
+
+    prx->evtStop = eventfd(0, EFD_CLOEXEC);
+    prx->evtData = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    prx->evtSpace = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if ( (prx->evtStop < 0) || (prx->evtData < 0) || (prx->evtSpace < 0) ) {
+        goto lErrorRing;
+    }
+
+    atomic_init(&prx->fWaiting, 0);
+    atomic_init(&prx->fHangup, false);
+    atomic_init(&prx->cbOverflow, 0);
+    atomic_init(&prx->fParked, 0);
+    atomic_init(&prx->cbHigh, 0);
+    atomic_init(&prx->cbLow, 0);
+    atomic_init(&prx->fAboveHigh, false);
+
+    port->prx = prx;
+    err = pthread_create(&prx->thread, NULL, RxThread, port);
+    if ( err != 0 ) {
+        port->prx = NULL;
+        errno = err;
+        goto lErrorRing;
+    }
+
+    // apply the CPU and priority asked for by SerialPortSetLowLatency()
+    port->llApplied &= ~(SERIAL_LL_RX_CPU | SERIAL_LL_RX_FIFO);
+    port->llApplied |= RxApplySched(port);
+
+    return true;
+
+lErrorRing:
+    if ( prx->evtStop >= 0 ) {
+        close(prx->evtStop);
+    }
+    if ( prx->evtData >= 0 ) {
+        close(prx->evtData);
+    }
+    if ( prx->evtSpace >= 0 ) {
+        close(prx->evtSpace);
+    }
+    RingFree(&prx->ring);
+lErrorFree:
+    free(prx);
+    return false;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortRxStop
+**
+**  Synopsis:
+**      void SerialPortRxStop(SERIAL_PORT *port)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**
+**  Return Values:
+**      none
+**
+**  Errors:
+**      none
+**
+**  Description:
+**      Stops the receive thread and frees the ring.  Data still in the
+**      ring is discarded.  Does nothing if the thread is not running.
+*/
+void SerialPortRxStop(SERIAL_PORT *port) {
+
+    SERIAL_RX   *prx = port->prx;
+    uint64_t    one = 1;
+
+    if ( prx == NULL ) {
+        return;
+    }
+
+    while ( (write(prx->evtStop, &one, sizeof(one)) < 0) && (errno == EINTR) ) {
+    }
+    pthread_join(prx->thread, NULL);
+
+    port->prx = NULL;
+    port->llApplied &= ~(SERIAL_LL_RX_CPU | SERIAL_LL_RX_FIFO);
+    close(prx->evtStop);
+    close(prx->evtData);
+    close(prx->evtSpace);
+    RingFree(&prx->ring);
+    free(prx);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortRxPeek
+**
+**  Synopsis:
+**      size_t SerialPortRxPeek(SERIAL_PORT *port, const uint8_t **ppb)
+**
+**  Parameters:
+**      *port           port with a running RX thread
+**      **ppb           receives a pointer to the oldest unread byte
+**
+**  Return Values:
+**      number of bytes readable in place at *ppb, 0 if the ring is empty
+**
+**  Errors:
+**      none
+**
+**  Description:
+**      The region stays valid until it is handed back with
+**      SerialPortRxConsume().  Data that wrapped around the end of the
+**      ring shows up on the next call.
+*/
+size_t SerialPortRxPeek(SERIAL_PORT *port, const uint8_t **ppb) {
+
+    return RingPeek(&port->prx->ring, ppb);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortRxConsume
+**
+**  Synopsis:
+**      void SerialPortRxConsume(SERIAL_PORT *port, size_t cb)
+**
+**  Parameters:
+**      *port           port with a running RX thread
+**      cb              bytes to release, no more than the last peek returned
+**
+**  Description:
+**      Gives the space back to the reader thread.  May call the low
+**      watermark callback.
+*/
+void SerialPortRxConsume(SERIAL_PORT *port, size_t cb) {
+
+    RxConsume(port, cb);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortRxWait
+**
+**  Synopsis:
+**      int SerialPortRxWait(SERIAL_PORT *port, size_t cbMin, uint32_t timeOutMs)
+**
+**  Parameters:
+**      *port           port with a running RX thread
+**      cbMin           number of buffered bytes to wait for
+**      timeOutMs       0 to only check, SERIAL_WAIT_FOREVER to never give up
+**
+**  Return Values:
+**      number of bytes buffered, at least cbMin
+**      -1 (SERIAL_ERROR_CODE) if the device hung up, errno is EIO
+**      -2 (SERIAL_TIMEOUT_CODE) if cbMin bytes did not arrive in time
+**
+**  Description:
+**      Sleeps until the reader thread has buffered at least cbMin bytes.
+*/
+int SerialPortRxWait(SERIAL_PORT *port, size_t cbMin, uint32_t timeOutMs) {
+
+    return RxWaitUntil(port, cbMin, DeadlineFromMs(timeOutMs));
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortRxOverflow
+**
+**  Synopsis:
+**      uint64_t SerialPortRxOverflow(SERIAL_PORT *port)
+**
+**  Parameters:
+**      *port           port with a running RX thread
+**
+**  Return Values:
+**      total number of received bytes thrown away because the ring was full
+**
+**  Description:
+**      Compare against an earlier value to find out whether the ring has
+**      overflowed in the meantime.
+*/
+uint64_t SerialPortRxOverflow(SERIAL_PORT *port) {
+
+    return atomic_load_explicit(&port->prx->cbOverflow, memory_order_relaxed);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortRxSetWatermarks
+**
+**  Synopsis:
+**      void SerialPortRxSetWatermarks(SERIAL_PORT *port, size_t cbHigh,
+**                                     size_t cbLow,
+**                                     SERIAL_RX_WATERMARK_FN pfnWatermark,
+**                                     void *pvCtx)
+**
+**  Parameters:
+**      *port           port with a running RX thread
+**      cbHigh          ring fill that signals backpressure, 0 to turn off
+**      cbLow           ring fill that ends it, below cbHigh
+**      pfnWatermark    called on each crossing, may be NULL to only poll
+**                      SerialPortRxBackpressure()
+**      pvCtx           passed through to pfnWatermark
+**
+**  Description:
+**      pfnWatermark(pvCtx, port, true) runs on the RX thread once the
+**      ring holds cbHigh bytes, pfnWatermark(pvCtx, port, false) on the
+**      consuming thread once it is back down to cbLow.  The calls
+**      alternate, but may overlap if the ring swings fast, so keep them
+**      short and do not call back into the port.  Call this before the
+**      data starts to flow.
+*/
+void SerialPortRxSetWatermarks(SERIAL_PORT *port, size_t cbHigh, size_t cbLow,
+                               SERIAL_RX_WATERMARK_FN pfnWatermark, void *pvCtx) {
+
+    SERIAL_RX   *prx = port->prx;
+
+    atomic_store(&prx->cbHigh, 0);
+    prx->pfnWatermark = pfnWatermark;
+    prx->pvWatermark = pvCtx;
+    atomic_store(&prx->fAboveHigh, false);
+    atomic_store(&prx->cbLow, ( cbLow < cbHigh ) ? cbLow : cbHigh / 2);
+    atomic_store(&prx->cbHigh, cbHigh);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortRxBackpressure
+**
+**  Synopsis:
+**      bool SerialPortRxBackpressure(SERIAL_PORT *port)
+**
+**  Parameters:
+**      *port           port with a running RX thread
+**
+**  Return Values:
+**      true between a high watermark crossing and the following low one
+*/
+bool SerialPortRxBackpressure(SERIAL_PORT *port) {
+
+    return atomic_load_explicit(&port->prx->fAboveHigh, memory_order_relaxed);
+}
+
+/* ------------------------------------------------------------ */
+/***    RxConsume
+**
+**  Synopsis:
+**      void RxConsume(SERIAL_PORT *port, size_t cb)
+**
+**  Description:
+**      Every consumer hands ring space back through here.  Without flow
+**      control or watermarks this is the plain RingConsume().  Otherwise
+**      the fence pairs with the one a parking reader or a high crossing
+**      makes, so a reader waiting for space is always woken and a low
+**      crossing is never missed.
+*/
+void RxConsume(SERIAL_PORT *port, size_t cb) {
+
+    SERIAL_RX   *prx = port->prx;
+    uint64_t    one = 1;
+
+    RingConsume(&prx->ring, cb);
+
+    if ( (atomic_load_explicit(&port->flow, memory_order_relaxed) == SERIAL_FLOW_NONE) &&
+         (atomic_load_explicit(&prx->cbHigh, memory_order_relaxed) == 0) ) {
+        return;
+    }
+    atomic_thread_fence(memory_order_seq_cst);
+    if ( atomic_load_explicit(&prx->fParked, memory_order_relaxed) &&
+         atomic_exchange(&prx->fParked, 0) ) {
+        (void)write(prx->evtSpace, &one, sizeof(one));
+    }
+    if ( atomic_load_explicit(&prx->fAboveHigh, memory_order_relaxed) ) {
+        RxCheckLow(port);
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    RxReadEx
+**
+**  Synopsis:
+**      int RxReadEx(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+**                   uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs)
+**
+**  Description:
+**      SerialPortReadEx() for a port whose RX thread is running.  Same
+**      parameters and return values, the data comes out of the ring.
+*/
+int RxReadEx(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+             uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs) {
+
+    SERIAL_RX       *prx = port->prx;
+    const uint8_t   *pb;
+    uint64_t        nsDeadline;
+    uint64_t        nsIdle;
+    uint64_t        nsWake;
+    uint32_t        totalBytesRead;
+    size_t          cb;
+    bool            fGot;
+    int             rc;
+
+    totalBytesRead = 0;
+    nsDeadline = DeadlineFromMs(timeOutMs);
+    nsIdle = UINT64_MAX;
+
+    for (;;) {
+        fGot = false;
+        while ( (totalBytesRead < len) && ((cb = RingPeek(&prx->ring, &pb)) > 0) ) {
+            if ( cb > len - totalBytesRead ) {
+                cb = len - totalBytesRead;
+            }
+            memcpy(result + totalBytesRead, pb, cb);
+            RxConsume(port, cb);
+            totalBytesRead += cb;
+            fGot = true;
+        }
+
+        if ( (totalBytesRead >= minLen) && (totalBytesRead > 0 || minLen == 0) ) {
+            return totalBytesRead;
+        }
+        if ( fGot ) {
+            STAT_ADD_SHARED(port->stats.cPartialReads, 1);
+        }
+        if ( timeOutMs == 0 ) {
+            break;
+        }
+        if ( fGot && (interByteUs != 0) ) {
+            nsIdle = MonoNowNs() + (uint64_t)interByteUs * 1000;
+        }
+
+        nsWake = ( nsIdle < nsDeadline ) ? nsIdle : nsDeadline;
+        rc = RxWaitUntil(port, 1, nsWake);
+        if ( rc == SERIAL_ERROR_CODE ) {
+            return ( totalBytesRead > 0 ) ? (int)totalBytesRead : SERIAL_ERROR_CODE;
+        }
+        if ( rc == SERIAL_TIMEOUT_CODE ) {
+            STAT_ADD_SHARED(port->stats.cTimeouts, 1);
+            break;
+        }
+    }
+
+    return ( totalBytesRead > 0 ) ? (int)totalBytesRead : SERIAL_TIMEOUT_CODE;
+}
+
+/* ------------------------------------------------------------ */
+/***    RxApplySched
+**
+**  Synopsis:
+**      uint32_t RxApplySched(SERIAL_PORT *port)
+**
+**  Parameters:
+**      *port           port with a running RX thread
+**
+**  Return Values:
+**      SERIAL_LL_RX_CPU and/or SERIAL_LL_RX_FIFO for what took effect
+**
+**  Description:
+**      Pins the RX thread and sets its scheduling class as port->ll asks.
+**      Settings applied earlier but no longer asked for are undone: the
+**      thread goes back to the process's CPUs and to SCHED_OTHER.
+**      SCHED_FIFO needs CAP_SYS_NICE or an RLIMIT_RTPRIO allowance.
+*/
+uint32_t RxApplySched(SERIAL_PORT *port) {
+
+    pthread_t           thread = port->prx->thread;
+    struct sched_param  sp;
+    cpu_set_t           cpus;
+    uint32_t            applied = 0;
+    int                 err;
+
+    if ( port->ll.flags & SERIAL_LL_RX_CPU ) {
+        err = EINVAL;
+        if ( (port->ll.cpuRx >= 0) && (port->ll.cpuRx < CPU_SETSIZE) ) {
+            CPU_ZERO(&cpus);
+            CPU_SET(port->ll.cpuRx, &cpus);
+            err = pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+        }
+        if ( err == 0 ) {
+            applied |= SERIAL_LL_RX_CPU;
+        } else {
+            SERIAL_LOG(SERIAL_LOG_WARN, "SERIAL %s: cannot pin RX thread to CPU %d: %s",
+                       port->szDevice, port->ll.cpuRx, strerror(err));
+        }
+    } else if ( (port->llApplied & SERIAL_LL_RX_CPU) &&
+                (sched_getaffinity(0, sizeof(cpus), &cpus) == 0) ) {
+        pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+    }
+
+    if ( port->ll.flags & SERIAL_LL_RX_FIFO ) {
+        memset(&sp, 0, sizeof(sp));
+        sp.sched_priority = port->ll.prioRx;
+        err = pthread_setschedparam(thread, SCHED_FIFO, &sp);
+        if ( err == 0 ) {
+            applied |= SERIAL_LL_RX_FIFO;
+        } else {
+            SERIAL_LOG(SERIAL_LOG_WARN, "SERIAL %s: cannot run RX thread SCHED_FIFO %d: %s",
+                       port->szDevice, port->ll.prioRx, strerror(err));
+        }
+    } else if ( port->llApplied & SERIAL_LL_RX_FIFO ) {
+        memset(&sp, 0, sizeof(sp));
+        pthread_setschedparam(thread, SCHED_OTHER, &sp);
+    }
+
+    return applied;
+}
+
+/* ------------------------------------------------------------ */
+/***    RxWaitUntil
+**
+**  Synopsis:
+**      int RxWaitUntil(SERIAL_PORT *port, size_t cbMin, uint64_t nsDeadline)
+**
+**  Description:
+**      Consumer side sleep.  fWaiting is raised before the ring is checked
+**      for the last time, the reader checks it after publishing, so one of
+**      the two always sees the other and no wakeup is lost.  With busy
+**      polling on, the ring is watched for nsSpin first, which costs no
+**      system calls at all.
+*/
+static int RxWaitUntil(SERIAL_PORT *port, size_t cbMin, uint64_t nsDeadline) {
+
+    SERIAL_RX       *prx = port->prx;
+    struct pollfd   pfd;
+    struct timespec tsWait;
+    uint64_t        nsNow;
+    uint64_t        nsSpinEnd;
+    uint64_t        u64;
+    size_t          cbUsed;
+
+    pfd.fd = prx->evtData;
+    pfd.events = POLLIN;
+    nsSpinEnd = atomic_load_explicit(&port->nsSpin, memory_order_relaxed);
+    if ( nsSpinEnd != 0 ) {
+        nsSpinEnd += MonoNowNs();
+    }
+
+    while ( (cbUsed = RingUsed(&prx->ring)) < cbMin ) {
+        if ( atomic_load(&prx->fHangup) ) {
+            errno = EIO;
+            return SERIAL_ERROR_CODE;
+        }
+        nsNow = MonoNowNs();
+        if ( nsNow >= nsDeadline ) {
+            return SERIAL_TIMEOUT_CODE;
+        }
+        if ( nsNow < nsSpinEnd ) {
+            CpuRelax();
+            continue;
+        }
+
+        atomic_store(&prx->fWaiting, 1);
+        if ( (RingUsed(&prx->ring) < cbMin) && !atomic_load(&prx->fHangup) ) {
+            if ( nsDeadline != UINT64_MAX ) {
+                tsWait.tv_sec = (nsDeadline - nsNow) / 1000000000;
+                tsWait.tv_nsec = (nsDeadline - nsNow) % 1000000000;
+            }
+            ppoll(&pfd, 1, ( nsDeadline == UINT64_MAX ) ? NULL : &tsWait, NULL);
+            // clear the eventfd, it is non-blocking so an empty one is fine
+            (void)read(prx->evtData, &u64, sizeof(u64));
+        }
+        atomic_store(&prx->fWaiting, 0);
+    }
+
+    return (int)cbUsed;
+}
+
+/* ------------------------------------------------------------ */
+/***    RxWake
+**
+**  Synopsis:
+**      void RxWake(SERIAL_RX *prx)
+**
+**  Description:
+**      Reader side of the handshake in RxWaitUntil().  Costs a fence and
+**      a load unless the consumer is actually asleep.
+*/
+static void RxWake(SERIAL_RX *prx) {
+
+    uint64_t one = 1;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if ( atomic_load_explicit(&prx->fWaiting, memory_order_relaxed) &&
+         atomic_exchange(&prx->fWaiting, 0) ) {
+        (void)write(prx->evtData, &one, sizeof(one));
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    RxWaitSpace
+**
+**  Synopsis:
+**      bool RxWaitSpace(SERIAL_PORT *port)
+**
+**  Return Values:
+**      true once the ring has room, false if the thread is to stop
+**
+**  Description:
+**      Reader side sleep for a full ring, the mirror of RxWaitUntil().
+**      While the reader sleeps the tty buffer fills and the driver drops
+**      RTS or sends XOFF.
+*/
+static bool RxWaitSpace(SERIAL_PORT *port) {
+
+    SERIAL_RX       *prx = port->prx;
+    struct pollfd   rgpfd[2];
+    struct iovec    rgiov[2];
+    uint64_t        u64;
+    int             rc;
+
+    rgpfd[0].fd = prx->evtSpace;
+    rgpfd[0].events = POLLIN;
+    rgpfd[1].fd = prx->evtStop;
+    rgpfd[1].events = POLLIN;
+    STAT_ADD_SHARED(port->stats.cRxThrottles, 1);
+
+    for (;;) {
+        atomic_store(&prx->fParked, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if ( RingWritable(&prx->ring, rgiov) > 0 ) {
+            atomic_store(&prx->fParked, 0);
+            return true;
+        }
+
+        STAT_ADD_SHARED(port->stats.cPollCalls, 1);
+        rc = poll(rgpfd, 2, -1);
+        if ( (rc < 0) && (errno != EINTR) ) {
+            STAT_ADD_SHARED(port->stats.cErrors, 1);
+            return false;
+        }
+        if ( (rc > 0) && rgpfd[1].revents ) {
+            return false;
+        }
+        (void)read(prx->evtSpace, &u64, sizeof(u64));
+    }
+}
+
+/* RX thread side of the watermarks, runs after each commit. */
+static void RxCheckHigh(SERIAL_PORT *port) {
+
+    SERIAL_RX   *prx = port->prx;
+
+    if ( atomic_load_explicit(&prx->fAboveHigh, memory_order_relaxed) ||
+         (RingUsed(&prx->ring) < atomic_load_explicit(&prx->cbHigh, memory_order_relaxed)) ||
+         atomic_exchange(&prx->fAboveHigh, true) ) {
+        return;
+    }
+    if ( prx->pfnWatermark != NULL ) {
+        prx->pfnWatermark(prx->pvWatermark, port, true);
+    }
+    // the consumer may have drained it before it saw fAboveHigh
+    RxCheckLow(port);
+}
+
+/* Either side, signals the low crossing if the ring is down to cbLow. */
+static void RxCheckLow(SERIAL_PORT *port) {
+
+    SERIAL_RX   *prx = port->prx;
+
+    if ( (RingUsed(&prx->ring) <= atomic_load_explicit(&prx->cbLow, memory_order_relaxed)) &&
+         atomic_exchange(&prx->fAboveHigh, false) && (prx->pfnWatermark != NULL) ) {
+        prx->pfnWatermark(prx->pvWatermark, port, false);
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    RxThread
+**
+**  Synopsis:
+**      void *RxThread(void *pv)
+**
+**  Parameters:
+**      pv              the SERIAL_PORT being served
+**
+**  Description:
+**      Sleeps until the device or the stop eventfd is readable, then reads
+**      straight into the free space of the ring with one readv() covering
+**      both sides of the wrap.  When the ring is full the data is read
+**      into a scratch buffer and counted as overflow, the kernel would
+**      otherwise drop it without telling anyone.  Under flow control the
+**      thread waits for space instead and lets the driver throttle the
+**      sender.  With busy polling on,
+**      the thread keeps polling without a timeout for nsSpin after each
+**      chunk, so the next one is picked up without a scheduler wakeup.
+*/
+static void *RxThread(void *pv) {
+
+    SERIAL_PORT     *port = pv;
+    SERIAL_RX       *prx = port->prx;
+    struct pollfd   rgpfd[2];
+    struct iovec    rgiov[2];
+    uint64_t        nsSpin;
+    uint64_t        nsSpinEnd = 0;
+    size_t          cbFree;
+    ssize_t         cbRead;
+    int             rc;
+
+    rgpfd[0].fd = port->fd;
+    rgpfd[0].events = POLLIN;
+    rgpfd[1].fd = prx->evtStop;
+    rgpfd[1].events = POLLIN;
+
+    for (;;) {
+        STAT_ADD_SHARED(port->stats.cPollCalls, 1);
+        rc = poll(rgpfd, 2, ( (nsSpinEnd != 0) && (MonoNowNs() < nsSpinEnd) ) ? 0 : -1);
+        if ( rc < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            STAT_ADD_SHARED(port->stats.cErrors, 1);
+            break;
+        }
+        if ( rc == 0 ) {
+            CpuRelax();
+            continue;
+        }
+        if ( rgpfd[1].revents ) {
+            return NULL;
+        }
+
+        cbFree = RingWritable(&prx->ring, rgiov);
+        if ( (cbFree == 0) &&
+             (atomic_load_explicit(&port->flow, memory_order_relaxed) != SERIAL_FLOW_NONE) ) {
+            if ( !RxWaitSpace(port) ) {
+                return NULL;
+            }
+            continue;
+        }
+        STAT_ADD_SHARED(port->stats.cReadCalls, 1);
+        if ( cbFree == 0 ) {
+            cbRead = read(port->fd, prx->rgbDiscard, sizeof(prx->rgbDiscard));
+            if ( cbRead > 0 ) {
+                atomic_fetch_add_explicit(&prx->cbOverflow, cbRead, memory_order_relaxed);
+            }
+        } else {
+            cbRead = readv(port->fd, rgiov, ( rgiov[1].iov_len > 0 ) ? 2 : 1);
+            if ( cbRead > 0 ) {
+                CAPTURE_DATAV(port, SERIAL_CAPTURE_RX, rgiov, 2, cbRead);
+                RingCommit(&prx->ring, cbRead);
+                RxWake(prx);
+                if ( atomic_load_explicit(&prx->cbHigh, memory_order_relaxed) != 0 ) {
+                    RxCheckHigh(port);
+                }
+                nsSpin = atomic_load_explicit(&port->nsSpin, memory_order_relaxed);
+                nsSpinEnd = ( nsSpin != 0 ) ? MonoNowNs() + nsSpin : 0;
+            }
+        }
+
+        if ( cbRead < 0 ) {
+            if ( (errno == EINTR) || (errno == EAGAIN) ) {
+                if ( errno == EAGAIN ) {
+                    STAT_ADD_SHARED(port->stats.cEagain, 1);
+                }
+                continue;
+            }
+            STAT_ADD_SHARED(port->stats.cErrors, 1);
+            SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL RX thread read error %d %s", errno, strerror(errno));
+        } else {
+            STAT_ADD_SHARED(port->stats.cbRead, cbRead);
+            if ( (cbRead > 0) || !(rgpfd[0].revents & (POLLHUP | POLLERR)) ) {
+                continue;
+            }
+        }
+
+        // the device went away, wait for SerialPortSetReconnect() to bring it back
+        if ( port->photplug == NULL ) {
+            break;
+        }
+        if ( HotplugLost(port) && !HotplugWaitUp(port, prx->evtStop) ) {
+            return NULL;
+        }
+    }
+
+    // the device went away, let a sleeping consumer find out
+    atomic_store(&prx->fHangup, true);
+    atomic_store(&prx->fWaiting, 1);
+    RxWake(prx);
+    return NULL;
+}
+
+
+/************************************ EOF ********************************/
@@ -43,6 +43,30 @@
 /*                      again.                                          */
 /*  02/24/2017 (MarkT): Adding timeout capability to SerialRead()       */
 /*  07/16/2017 (MarkT): Packaged into a library                         */
+/*  10/16/2026 (agent): Bulk SerialWrite()/SerialWriteV() replace the   */
+/*                      byte at a time write loop                       */
+/*  10/16/2026 (agent): SerialReadEx() sleeps in ppoll() against a      */
+/*                      CLOCK_MONOTONIC deadline instead of polling     */
+/*  10/16/2026 (agent): Every port lives in its own SERIAL_PORT handle, */
+/*                      the old API drives a default handle             */
+/*  10/16/2026 (agent): SerialPortReadEx() drains the RX thread's ring  */
+/*                      when one is running                             */
+/*  10/16/2026 (agent): Arbitrary rates through termios2/BOTHER, see    */
+/*                      SerialPortSetBaud()                             */
+/*  10/16/2026 (agent): Per port counters and histograms, messages go   */
+/*                      through SERIAL_LOG() instead of stdout          */
+/*  10/16/2026 (agent): Reads can busy-poll before sleeping, see        */
+/*                      SerialPortSetLowLatency()                       */
+/*  10/16/2026 (agent): Waiting reads can go through io_uring, see      */
+/*                      SerialPortSetIoBackend()                        */
+/*  10/16/2026 (agent): SERIAL_WRITE_NOWAIT hands EAGAIN back to event  */
+/*                      loops such as the ec_serial.hpp coroutines      */
+/*  10/16/2026 (agent): Flow control can be switched on after open, see */
+/*                      SerialPortSetFlowControl()                      */
+/*  10/16/2026 (agent): Reads and writes feed SerialPortCaptureStart()  */
+/*  10/16/2026 (agent): Reads wait and writes queue while a port set up */
+/*                      by SerialPortSetReconnect() is unplugged        */
+/*  10/16/2026 (agent): SerialPortSetFormat() for lines other than 8N1  */
 /*                                                                      */
 /************************************************************************/
 
@@ -50,29 +74,34 @@
 /*              Include File Definitions                        */
 /* ------------------------------------------------------------ */
 
+#define _GNU_SOURCE  /* ppoll */
+
 #include <stdlib.h>
-#include <stdio.h>   /* Standard input/output definitions */
 #include <string.h>  /* String function definitions */
 #include <unistd.h>  /* UNIX standard function definitions */
 #include <fcntl.h>   /* File control definitions */
 #include <errno.h>   /* Error number definitions */
 #include <termios.h> /* POSIX terminal control definitions */
 #include <stdbool.h>
-#include <sys/time.h>
+#include <sys/uio.h>  /* writev */
+#include <poll.h>
 #include <time.h>
 
 #include "ec_serial.h"
+#include "ec_serial_priv.h"
 
 /* ------------------------------------------------------------ */
 /*              Local Type Definitions                          */
 /* ------------------------------------------------------------ */
 
+#define SERIAL_IOV_BATCH    64  // iovecs handed to a single writev()
+
 
 /* ------------------------------------------------------------ */
 /*              Global Variables                                */
 /* ------------------------------------------------------------ */
 
-static int fd;
+static SERIAL_PORT *pportDefault;  // port driven by the SerialInit() interface
 
 /* ------------------------------------------------------------ */
 /*              Local Variables                                 */
@@ -83,20 +112,208 @@ static int fd;
 /*              Forward Declarations                            */
 /* ------------------------------------------------------------ */
 
-static bool    GetTimeDiff ( struct timeval *result,
-            struct timeval *t2, struct timeval *t1 );
+static int      PortReadEx( SERIAL_PORT *port, uint8_t *result, uint32_t len,
+                            uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs );
 
 /* ------------------------------------------------------------ */
 /*              Procedure Definitions                           */
 /* ------------------------------------------------------------ */
 
 /* ------------------------------------------------------------ */
-/***    SerialWriteNBytes
+/***    SerialPortWriteV
+**
+**  Synopsis:
+**      int SerialPortWriteV(SERIAL_PORT *port, const struct iovec *rgiov,
+**                           int ciov, uint32_t flags)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      *rgiov          array of buffers to be written back to back
+**      ciov            number of entries in rgiov
+**      flags           SERIAL_WRITE_DRAIN to wait until the data is on the wire
+**                      SERIAL_WRITE_NOWAIT to return when the driver is full
+**
+**  Return Values:
+**      number of bytes written on success
+**      with SERIAL_WRITE_NOWAIT, the bytes taken so far (may be 0) and
+**      errno EAGAIN when the driver buffer filled up
+**      fewer bytes than requested if an error occurred part way through
+**      -1 (SERIAL_ERROR_CODE) if nothing could be written
+**      -3 (SERIAL_DRAIN_ERROR_CODE) with SERIAL_WRITE_DRAIN, if every
+**      byte was written but tcdrain() then failed
+**
+**  Errors:
+**      errno is left set by the failing write/tcdrain call
+**
+**  Description:
+**      Gathers the buffers into as few writev() calls as the driver will
+**      accept.  Partial writes are resumed from the exact byte they stopped
+**      at, EINTR is retried and EAGAIN waits for the port to become
+**      writable again, unless SERIAL_WRITE_NOWAIT asks for the short count
+**      so an event loop can wait for POLLOUT on its own terms.  With
+**      SERIAL_WRITE_DRAIN the call does not return until tcdrain() reports
+**      the transmitter empty.  While a port with SerialPortSetReconnect()
+**      is unplugged, the data is queued for the reconnect and counted as
+**      written.
+*/
+int SerialPortWriteV(SERIAL_PORT *port, const struct iovec *rgiov, int ciov, uint32_t flags) {
+
+    uint64_t    nsStart;
+    int         rc;
+
+    nsStart = MonoNowNs();
+    if ( port->photplug != NULL ) {
+        rc = HotplugWriteV(port, rgiov, ciov, flags);
+    } else {
+        rc = PortWriteV(port, rgiov, ciov, flags);
+    }
+    HistRecord(&port->stats.histWrite, MonoNowNs() - nsStart);
+    return rc;
+}
+
+/* ------------------------------------------------------------ */
+/***    PortWriteV
+**
+**  Synopsis:
+**      int PortWriteV(SERIAL_PORT *port, const struct iovec *rgiov,
+**                     int ciov, uint32_t flags)
+**
+**  Description:
+**      SerialPortWriteV() without the timing or the reconnect queue.
+*/
+int PortWriteV(SERIAL_PORT *port, const struct iovec *rgiov, int ciov, uint32_t flags) {
+
+    struct iovec    rgiovBatch[SERIAL_IOV_BATCH];
+    struct pollfd   pfd;
+    int             iiov;       // index of the first unwritten buffer
+    size_t          ibOff;      // offset already written within rgiov[iiov]
+    size_t          cbTotal;
+    size_t          cbBatch;
+    ssize_t         cbWritten;
+    int             ciovBatch;
+
+    iiov = 0;
+    ibOff = 0;
+    cbTotal = 0;
+
+    while ( iiov < ciov ) {
+        // skip over empty or completed buffers
+        if ( ibOff >= rgiov[iiov].iov_len ) {
+            iiov++;
+            ibOff = 0;
+            continue;
+        }
+
+        // build the next batch, starting mid-buffer after a partial write
+        ciovBatch = 0;
+        rgiovBatch[ciovBatch].iov_base = (uint8_t *)rgiov[iiov].iov_base + ibOff;
+        rgiovBatch[ciovBatch].iov_len = rgiov[iiov].iov_len - ibOff;
+        cbBatch = rgiovBatch[ciovBatch].iov_len;
+        ciovBatch++;
+        while ( (ciovBatch < SERIAL_IOV_BATCH) && (iiov + ciovBatch < ciov) ) {
+            rgiovBatch[ciovBatch] = rgiov[iiov + ciovBatch];
+            cbBatch += rgiovBatch[ciovBatch].iov_len;
+            ciovBatch++;
+        }
+
+        cbWritten = writev(port->fd, rgiovBatch, ciovBatch);
+        STAT_ADD_SHARED(port->stats.cWriteCalls, 1);
+        if ( cbWritten < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            if ( (errno == EAGAIN) || (errno == EWOULDBLOCK) ) {
+                // kernel tx buffer is full, sleep until it drains
+                STAT_ADD_SHARED(port->stats.cEagain, 1);
+                if ( flags & SERIAL_WRITE_NOWAIT ) {
+                    // caller waits for POLLOUT itself, errno stays EAGAIN
+                    return (int)cbTotal;
+                }
+                STAT_ADD_SHARED(port->stats.cPollCalls, 1);
+                pfd.fd = port->fd;
+                pfd.events = POLLOUT;
+                if ( (poll(&pfd, 1, -1) >= 0) || (errno == EINTR) ) {
+                    continue;
+                }
+            }
+            STAT_ADD_SHARED(port->stats.cErrors, 1);
+            SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL write error %d %s", errno, strerror(errno));
+            return ( cbTotal > 0 ) ? (int)cbTotal : SERIAL_ERROR_CODE;
+        }
+
+        STAT_ADD_SHARED(port->stats.cbWritten, cbWritten);
+        CAPTURE_DATAV(port, SERIAL_CAPTURE_TX, rgiovBatch, ciovBatch, cbWritten);
+        if ( (size_t)cbWritten < cbBatch ) {
+            STAT_ADD_SHARED(port->stats.cPartialWrites, 1);
+        }
+        cbTotal += cbWritten;
+
+        // advance (iiov, ibOff) past the bytes the kernel accepted
+        while ( (iiov < ciov) && (cbWritten > 0) ) {
+            size_t cbLeft = rgiov[iiov].iov_len - ibOff;
+            if ( (size_t)cbWritten < cbLeft ) {
+                ibOff += cbWritten;
+                cbWritten = 0;
+            } else {
+                cbWritten -= cbLeft;
+                iiov++;
+                ibOff = 0;
+            }
+        }
+    }
+
+    if ( flags & SERIAL_WRITE_DRAIN ) {
+        while ( 0 != tcdrain(port->fd) ) {
+            if ( errno != EINTR ) {
+                // the data went out, say so apart from a failed write
+                STAT_ADD_SHARED(port->stats.cErrors, 1);
+                return SERIAL_DRAIN_ERROR_CODE;
+            }
+        }
+    }
+
+    return (int)cbTotal;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortWrite
 **
 **  Synopsis:
-**      int SerialWriteNBytes(uint8_t *rgbChars, int n)
+**      int SerialPortWrite(SERIAL_PORT *port, const uint8_t *rgbBuf,
+**                          size_t cb, uint32_t flags)
 **
 **  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      *rgbBuf         pointer to data
+**      cb              number of bytes to be written to serial port
+**      flags           SERIAL_WRITE_DRAIN to wait until the data is on the wire
+**
+**  Return Values:
+**      number of bytes written, see SerialPortWriteV()
+**
+**  Errors:
+**      see SerialPortWriteV()
+**
+**  Description:
+**      Writes the whole buffer using as few system calls as possible.
+*/
+int SerialPortWrite(SERIAL_PORT *port, const uint8_t *rgbBuf, size_t cb, uint32_t flags) {
+
+    struct iovec iov;
+
+    iov.iov_base = (void *)rgbBuf;
+    iov.iov_len = cb;
+    return SerialPortWriteV(port, &iov, 1, flags);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortWriteNBytes
+**
+**  Synopsis:
+**      bool SerialPortWriteNBytes(SERIAL_PORT *port, uint8_t *rgbChars, int n)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
 **      *rgbChars       pointer to string
 **      n               number of characters to be written to serial port
 **
@@ -108,36 +325,28 @@ static bool    GetTimeDiff ( struct timeval *result,
 **      none
 **
 **  Description:
-**      Uses the a globally defined integer "file descriptor" fd to write
-**      to the serial port.  The serial port must be previously opened and
-**      the fd must be the assigned file descriptor for the serial port.
-**      Please use the SerialInit(char *szDevice) prior to using this function.
+**      Operates on the port returned by SerialPortOpen().  Nothing is
+**      shared between ports, so different threads may drive different
+**      ports without any locking.
+**      Kept for compatibility, use SerialPortWrite() to learn how many
+**      bytes actually went out.
 */
-bool SerialWriteNBytes(uint8_t *rgbChars, int n) {
+bool SerialPortWriteNBytes(SERIAL_PORT *port, uint8_t *rgbChars, int n) {
 
-    int i;
-
-    for(i = 0; i < n; i++) {
-        //printf("SerialWriteNBytes(n=%d)\n", n);
-        int n = write(fd, rgbChars, 1);
-        if (n < 0) {
-            //printf("Write Error : %d,  %s\n", errno, strerror(errno));
-            //printf("0x%x ", *rgbChars);
-            return false;
-        }
-        //printf("0x%x ", *rgbChars);
-        rgbChars++; //increment pointer
+    if ( n < 0 ) {
+        return false;
     }
-    return true;
+    return ( SerialPortWrite(port, rgbChars, n, 0) == n );
 }
 
 /* ------------------------------------------------------------ */
-/***    SerialWriteByte
+/***    SerialPortWriteByte
 **
 **  Synopsis:
-**      int SerialWriteByte(uint8_t *pByte)
+**      bool SerialPortWriteByte(SERIAL_PORT *port, uint8_t *pByte)
 **
 **  Parameters:
+**      *port           port returned by SerialPortOpen()
 **      *pByte          pointer to a char
 **
 **  Return Values:
@@ -148,115 +357,283 @@ bool SerialWriteNBytes(uint8_t *rgbChars, int n) {
 **      none
 **
 **  Description:
-**      Uses the a globally defined integer "file descriptor" fd to write
-**      to the serial port.  The serial port must be previously opened and
-**      the fd must be the assigned file descriptor for the serial port.
-**      Please use the SerialInit(char *szDevice) prior to using this function.
+**      Operates on the port returned by SerialPortOpen().  Nothing is
+**      shared between ports, so different threads may drive different
+**      ports without any locking.
 */
-bool SerialWriteByte(uint8_t *pByte) {
+bool SerialPortWriteByte(SERIAL_PORT *port, uint8_t *pByte) {
 
-    int n = write(fd, pByte, 1);
-    if (n < 0) {
-        //printf("Write Error : %d,  %s\n", errno, strerror(errno));
-        //printf("0x%x ", *pByte);
-        return false;
-    }
-
-    return true;
+    return ( SerialPortWrite(port, pByte, 1, 0) == 1 );
 }
 
 /* ------------------------------------------------------------ */
-/***    SerialRead
+/***    SerialPortReadEx
 **
 **  Synopsis:
-**      int SerialRead(uint8_t *result)
+**      int SerialPortReadEx(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+**                           uint32_t minLen, uint32_t timeOutMs,
+**                           uint32_t interByteUs)
 **
 **  Parameters:
-**      *result         pointer to string
+**      *port           port returned by SerialPortOpen()
+**      *result         buffer receiving the data
+**      len             size of result, never more than this is read
+**      minLen          number of bytes that satisfies the read:
+**                          len         read exactly len bytes
+**                          n < len     read at least n bytes
+**                          1           whatever is available, once
+**                                      something has arrived
+**      timeOutMs       overall deadline, 0 returns without waiting and
+**                      SERIAL_WAIT_FOREVER never expires
+**      interByteUs     once data has started arriving, give up if the line
+**                      stays quiet for this long.  0 disables.
 **
 **  Return Values:
-**      number of characters read on success
-**      -1 on error
+**      number of characters read, which is less than minLen only when a
+**          deadline expired after some data arrived
+**      -1 (SERIAL_ERROR_CODE) on error
+**      -2 (SERIAL_TIMEOUT_CODE) if the deadline expired before any data
 **
 **  Errors:
-**      none
+**      errno is left set by the failing read/ppoll call.  EIO is reported
+**      if the device hung up.
 **
 **  Description:
-**      Uses the a globally defined integer "file descriptor" fd to write
-**      to the serial port.  The serial port must be previously opened and
-**      the fd must be the assigned file descriptor for the serial port.
-**      Please use the SerialInit(char *szDevice) prior to using this function.
-**      Places the read NULL terminated string into *result.
+**      Sleeps in ppoll() between reads so that the caller wakes as soon as
+**      the driver has data, rather than on the next polling interval.  Both
+**      deadlines are absolute CLOCK_MONOTONIC times, so stepping the wall
+**      clock has no effect on them.  On SERIAL_IO_URING the wait and the
+**      read are one io_uring_enter() instead, see SerialPortSetIoBackend().
+**      A port with SerialPortSetReconnect() waits out an unplugged device
+**      until the deadline instead of failing with EIO.
 */
-int SerialRead(uint8_t *result, uint32_t len, uint32_t timeOutMs) {
-    int bytesRead;
-    int totalBytesRead;
-    struct timeval tvBegin, tvEnd, tvDiff;
-    long int elapsedMs;
-    uint8_t *ptr;
+int SerialPortReadEx(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+                     uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs) {
 
-    // init locals
-    ptr = result;
-    totalBytesRead = 0;
+    if ( minLen > len ) {
+        minLen = len;
+    }
+    if ( port->photplug != NULL ) {
+        return HotplugReadEx(port, result, len, minLen, timeOutMs, interByteUs);
+    }
+    return PortReadAny(port, result, len, minLen, timeOutMs, interByteUs);
+}
+
+/* ------------------------------------------------------------ */
+/***    PortReadAny
+**
+**  Synopsis:
+**      int PortReadAny(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+**                      uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs)
+**
+**  Description:
+**      SerialPortReadEx() through whichever path serves the port, without
+**      the reconnect handling, minLen <= len.
+*/
+int PortReadAny(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+                uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs) {
 
-    // Get timestamp starting now
-    gettimeofday(&tvBegin, NULL);
+    uint64_t    nsStart;
+    int         rc;
 
-    do {
-        // call serial read function
-        bytesRead = read(fd, ptr, len);
+    // only reads that may block are worth timing
+    if ( timeOutMs == 0 ) {
+        if ( port->prx != NULL ) {
+            return RxReadEx(port, result, len, minLen, timeOutMs, interByteUs);
+        }
+        return PortReadEx(port, result, len, minLen, timeOutMs, interByteUs);
+    }
 
-        totalBytesRead += bytesRead;
-        if (bytesRead < 0) {
-            if (errno == EAGAIN) {
-                printf("SERIAL EAGAIN ERROR\n");
-                return SERIAL_ERROR_CODE;
-            } else {
-                printf("SERIAL read error %d %s\n", errno, strerror(errno));
-                return SERIAL_ERROR_CODE;
-            }
-        } else {
-            // caller does not have a timeout defined. Return
-            // what we've got now
-            if ( timeOutMs == 0 ) {
-                return bytesRead;
-            }
-            if ( bytesRead == 0 ) {
-                usleep(1000); // sleep 1ms before calling read again
+    nsStart = MonoNowNs();
+    if ( port->prx != NULL ) {
+        // the RX thread owns the descriptor, take the data from its ring
+        rc = RxReadEx(port, result, len, minLen, timeOutMs, interByteUs);
+    } else if ( (port->puring != NULL) && (minLen > 0) &&
+                (atomic_load_explicit(&port->nsSpin, memory_order_relaxed) == 0) ) {
+        rc = UringReadEx(port, result, len, minLen, timeOutMs, interByteUs);
+    } else {
+        rc = PortReadEx(port, result, len, minLen, timeOutMs, interByteUs);
+    }
+    HistRecord(&port->stats.histReadWait, MonoNowNs() - nsStart);
+    return rc;
+}
+
+/* ------------------------------------------------------------ */
+/***    PortReadEx
+**
+**  Synopsis:
+**      int PortReadEx(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+**                     uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs)
+**
+**  Description:
+**      SerialPortReadEx() straight from the descriptor, minLen <= len.
+*/
+static int PortReadEx(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+                      uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs) {
+
+    struct pollfd   pfd;
+    struct timespec tsWait;
+    uint64_t        nsDeadline;
+    uint64_t        nsIdle;
+    uint64_t        nsNow;
+    uint64_t        nsWake;
+    uint64_t        nsSpin;
+    uint64_t        nsSpinEnd;
+    uint32_t        totalBytesRead;
+    ssize_t         bytesRead;
+    bool            fWait;
+    int             rc;
+
+    totalBytesRead = 0;
+    nsNow = MonoNowNs();
+    nsDeadline = DeadlineFromMs(timeOutMs);
+    nsIdle = UINT64_MAX;
+    nsSpin = atomic_load_explicit(&port->nsSpin, memory_order_relaxed);
+    nsSpinEnd = ( nsSpin != 0 ) ? nsNow + nsSpin : 0;
+    pfd.fd = port->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    // the first read is optimistic, the data may already be waiting
+    fWait = false;
+
+    for (;;) {
+        if ( fWait ) {
+            nsWake = ( nsIdle < nsDeadline ) ? nsIdle : nsDeadline;
+            if ( nsNow >= nsWake ) {
+                break;
             }
-            if ( len < bytesRead ) {
-                printf("ERROR: Read too much data!\n");
-                return SERIAL_ERROR_CODE;
+            if ( nsNow < nsSpinEnd ) {
+                // busy-poll: with VMIN=0 read() returns at once, skip the sleep
+                CpuRelax();
+                pfd.revents = 0;
+                nsNow = MonoNowNs();
             } else {
-                ptr += bytesRead; // advance pointer
-                len -= bytesRead; // decrement desired count of future bytes
+                if ( nsWake != UINT64_MAX ) {
+                    tsWait.tv_sec = (nsWake - nsNow) / 1000000000;
+                    tsWait.tv_nsec = (nsWake - nsNow) % 1000000000;
+                }
+                rc = ppoll(&pfd, 1, ( nsWake == UINT64_MAX ) ? NULL : &tsWait, NULL);
+                STAT_ADD_SHARED(port->stats.cPollCalls, 1);
+                if ( rc < 0 ) {
+                    if ( errno != EINTR ) {
+                        STAT_ADD_SHARED(port->stats.cErrors, 1);
+                        SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL poll error %d %s", errno, strerror(errno));
+                        return SERIAL_ERROR_CODE;
+                    }
+                } else if ( (rc > 0) && !(pfd.revents & POLLIN) ) {
+                    // POLLHUP/POLLERR without data, the device has gone away
+                    errno = EIO;
+                    return ( totalBytesRead > 0 ) ? (int)totalBytesRead : SERIAL_ERROR_CODE;
+                }
+                nsNow = MonoNowNs();
+                if ( rc <= 0 ) {
+                    continue;
+                }
             }
         }
-        // grab timestamp
-        gettimeofday(&tvEnd, NULL);
-        // calculate elapsed time
-        if ( GetTimeDiff(&tvDiff, &tvEnd, &tvBegin) ) {
-            elapsedMs = (1000*tvDiff.tv_sec + (tvDiff.tv_usec/1000));
-        } else {
-            printf("ERROR: elapsed time error\n");
+
+        bytesRead = read(port->fd, result + totalBytesRead, len - totalBytesRead);
+        STAT_ADD_SHARED(port->stats.cReadCalls, 1);
+        if ( bytesRead < 0 ) {
+            if ( errno == EINTR || errno == EAGAIN ) {
+                if ( errno == EAGAIN ) {
+                    STAT_ADD_SHARED(port->stats.cEagain, 1);
+                }
+                fWait = true;
+                continue;
+            }
+            STAT_ADD_SHARED(port->stats.cErrors, 1);
+            SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL read error %d %s", errno, strerror(errno));
             return SERIAL_ERROR_CODE;
         }
-    } while ( (elapsedMs < timeOutMs) && (len > 0) );
+        STAT_ADD_SHARED(port->stats.cbRead, bytesRead);
+        CAPTURE_DATA(port, SERIAL_CAPTURE_RX, result + totalBytesRead, bytesRead);
+
+        if ( (bytesRead == 0) && fWait && (pfd.revents & (POLLHUP | POLLERR)) ) {
+            // readable but empty after a hangup, the device has gone away
+            errno = EIO;
+            return ( totalBytesRead > 0 ) ? (int)totalBytesRead : SERIAL_ERROR_CODE;
+        }
 
-    if ( elapsedMs >= timeOutMs ) {
+        totalBytesRead += bytesRead;
+        if ( (totalBytesRead >= minLen) && (totalBytesRead > 0 || minLen == 0) ) {
+            return totalBytesRead;
+        }
+        if ( bytesRead > 0 ) {
+            STAT_ADD_SHARED(port->stats.cPartialReads, 1);
+        }
+        if ( timeOutMs == 0 ) {
+            break;
+        }
+        if ( (bytesRead > 0) && ((interByteUs != 0) || (nsSpin != 0)) ) {
+            nsNow = MonoNowNs();
+            if ( interByteUs != 0 ) {
+                nsIdle = nsNow + (uint64_t)interByteUs * 1000;
+            }
+            if ( nsSpin != 0 ) {
+                nsSpinEnd = nsNow + nsSpin;
+            }
+        }
+        fWait = true;
+    }
+
+    if ( timeOutMs != 0 ) {
+        STAT_ADD_SHARED(port->stats.cTimeouts, 1);
+    }
+    return ( totalBytesRead > 0 ) ? (int)totalBytesRead : SERIAL_TIMEOUT_CODE;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortRead
+**
+**  Synopsis:
+**      int SerialPortRead(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+**                         uint32_t timeOutMs)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      *result         pointer to string
+**      len             number of characters wanted
+**      timeOutMs       0 to return whatever is available right now
+**
+**  Return Values:
+**      number of characters read on success
+**      -1 on error
+**      -2 if all len characters did not arrive within timeOutMs
+**
+**  Errors:
+**      none
+**
+**  Description:
+**      Operates on the port returned by SerialPortOpen().  Nothing is
+**      shared between ports, so different threads may drive different
+**      ports without any locking.
+**      With a timeout this waits for exactly len characters, see
+**      SerialPortReadEx() for the other read modes.
+*/
+int SerialPortRead(SERIAL_PORT *port, uint8_t *result, uint32_t len, uint32_t timeOutMs) {
+    int totalBytesRead;
+
+    if ( timeOutMs == 0 ) {
+        return SerialPortReadEx(port, result, len, 0, 0, 0);
+    }
+
+    totalBytesRead = SerialPortReadEx(port, result, len, len, timeOutMs, 0);
+    if ( (totalBytesRead >= 0) && ((uint32_t)totalBytesRead < len) ) {
         return SERIAL_TIMEOUT_CODE;
     }
     return totalBytesRead;
 }
 
 /* ------------------------------------------------------------ */
-/***    SerialGetBaud
+/***    SerialPortGetBaud
 **
 **  Synopsis:
-**      int SerialGetBaud( void )
+**      int SerialPortGetBaud( SERIAL_PORT *port )
 **
 **  Parameters:
-**      none
+**      *port           port returned by SerialPortOpen()
 **
 **  Return Values:
 **      inputSpeed          integer value relating baud rate
@@ -265,17 +642,23 @@ int SerialRead(uint8_t *result, uint32_t len, uint32_t timeOutMs) {
 **      none
 **
 **  Description:
-**      Uses the a globally defined integer "file descriptor" fd to write
-**      to the serial port.  The serial port must be previously opened and
-**      the fd must be the assigned file descriptor for the serial port.
-**      Please use the SerialInit(char *szDevice) prior to using this function.
+**      Operates on the port returned by SerialPortOpen().  Nothing is
+**      shared between ports, so different threads may drive different
+**      ports without any locking.
 **      Places the defined baud rate value into inputSpeed and returns.
 */
-int SerialGetBaud( void ) {
+int SerialPortGetBaud( SERIAL_PORT *port ) {
     struct termios termAttr;
     int inputSpeed = -1;
     speed_t baudRate;
-    tcgetattr(fd, &termAttr);
+
+    // the rate the driver actually programmed, including non-standard ones
+    inputSpeed = BaudGetFd(port->fd);
+    if ( inputSpeed >= 0 ) {
+        return inputSpeed;
+    }
+
+    tcgetattr(port->fd, &termAttr);
     /* Get the input speed. */
     baudRate = cfgetispeed(&termAttr);
     switch (baudRate) {
@@ -297,10 +680,197 @@ int SerialGetBaud( void ) {
         case B57600:  inputSpeed = 57600; break;
         case B115200:  inputSpeed = 115200; break;
         case B230400:  inputSpeed = 230400; break;
+        case B460800:  inputSpeed = 460800; break;
+        case B500000:  inputSpeed = 500000; break;
+        case B576000:  inputSpeed = 576000; break;
+        case B921600:  inputSpeed = 921600; break;
+        case B1000000: inputSpeed = 1000000; break;
+        case B1152000: inputSpeed = 1152000; break;
+        case B1500000: inputSpeed = 1500000; break;
+        case B2000000: inputSpeed = 2000000; break;
+        case B2500000: inputSpeed = 2500000; break;
+        case B3000000: inputSpeed = 3000000; break;
+        case B3500000: inputSpeed = 3500000; break;
+        case B4000000: inputSpeed = 4000000; break;
     }
     return inputSpeed;
 }
 
+/* ------------------------------------------------------------ */
+/***    SerialPortSetBaud
+**
+**  Synopsis:
+**      bool SerialPortSetBaud( SERIAL_PORT *port, int baudRate )
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      baudRate        any rate in bits per second, standard or not
+**
+**  Return Values:
+**      1               success
+**      0               failure, the previous rate is still in effect
+**
+**  Errors:
+**      EINVAL if the driver cannot get within SERIAL_BAUD_TOLERANCE_PCT
+**      of the requested rate, otherwise errno from the ioctl
+**
+**  Description:
+**      Programs the rate through termios2/BOTHER, so values such as
+**      921600, 3000000 or 250000 work wherever the driver supports them.
+**      The rate the driver actually chose is read back and checked; use
+**      SerialPortGetBaud() to learn the exact value.
+*/
+bool SerialPortSetBaud( SERIAL_PORT *port, int baudRate ) {
+
+    int baudPrev;
+    int baudActual;
+
+    if ( baudRate <= 0 ) {
+        errno = EINVAL;
+        return false;
+    }
+
+    baudPrev = SerialPortGetBaud(port);
+    if ( !BaudSetFd(port->fd, baudRate) ) {
+        return false;
+    }
+
+    baudActual = SerialPortGetBaud(port);
+    if ( (baudActual <= 0) ||
+         ((int64_t)abs(baudActual - baudRate) * 100 > (int64_t)baudRate * SERIAL_BAUD_TOLERANCE_PCT) ) {
+        if ( baudPrev > 0 ) {
+            BaudSetFd(port->fd, baudPrev);
+        }
+        errno = EINVAL;
+        return false;
+    }
+
+    port->baudRate = baudActual;
+    tcgetattr(port->fd, &port->termios);
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortSetFormat
+**
+**  Synopsis:
+**      bool SerialPortSetFormat( SERIAL_PORT *port, int cDataBits,
+**                                char parity, int cStopBits )
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      cDataBits       5 to 8
+**      parity          'N', 'E' or 'O'
+**      cStopBits       1 or 2
+**
+**  Return Values:
+**      1               success
+**      0               failure, the previous format is still in effect
+**
+**  Errors:
+**      EINVAL for a format out of range or one the driver would not
+**      take, otherwise errno from tcgetattr()/tcsetattr()
+**
+**  Description:
+**      SerialPortOpen() sets 8N1.  With parity on, characters that fail
+**      the check are dropped by the driver and counted in cParity of
+**      SerialPortGetLineCounts().  The format is kept across a
+**      reconnect.
+*/
+bool SerialPortSetFormat( SERIAL_PORT *port, int cDataBits, char parity, int cStopBits ) {
+
+    static const tcflag_t rgcs[] = { CS5, CS6, CS7, CS8 };
+    struct termios  options;
+    struct termios  optionsPrev;
+    tcflag_t        cflagWant;
+
+    if ( (cDataBits < 5) || (cDataBits > 8) || ((cStopBits != 1) && (cStopBits != 2)) ||
+         ((parity != 'N') && (parity != 'E') && (parity != 'O')) ) {
+        errno = EINVAL;
+        return false;
+    }
+    if ( tcgetattr(port->fd, &options) != 0 ) {
+        return false;
+    }
+    optionsPrev = options;
+
+    cflagWant = rgcs[cDataBits - 5];
+    cflagWant |= ( cStopBits == 2 ) ? CSTOPB : 0;
+    cflagWant |= ( parity != 'N' ) ? PARENB : 0;
+    cflagWant |= ( parity == 'O' ) ? PARODD : 0;
+    options.c_cflag &= ~(CSIZE | CSTOPB | PARENB | PARODD);
+    options.c_cflag |= cflagWant;
+    options.c_iflag &= ~(INPCK | IGNPAR);
+    options.c_iflag |= ( parity != 'N' ) ? (INPCK | IGNPAR) : 0;
+
+    if ( tcsetattr(port->fd, TCSANOW, &options) != 0 ) {
+        return false;
+    }
+
+    // tcsetattr() succeeds if any of the changes took, check ours did
+    tcgetattr(port->fd, &options);
+    if ( (options.c_cflag & (CSIZE | CSTOPB | PARENB | PARODD)) != cflagWant ) {
+        SERIAL_LOG(SERIAL_LOG_WARN, "SERIAL %s: driver refused %d%c%d", port->szDevice,
+                   cDataBits, parity, cStopBits);
+        tcsetattr(port->fd, TCSANOW, &optionsPrev);
+        errno = EINVAL;
+        return false;
+    }
+
+    port->termios = options;
+    SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL %s: format %d%c%d", port->szDevice, cDataBits, parity, cStopBits);
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortProbeBauds
+**
+**  Synopsis:
+**      int SerialPortProbeBauds( SERIAL_PORT *port, const int *rgBaud,
+**                                int cBaud, int *rgActual )
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      *rgBaud         rates to try
+**      cBaud           number of entries in rgBaud and rgActual
+**      *rgActual       receives the rate programmed for each entry, or 0
+**                      if the driver refused it or missed it by more than
+**                      SERIAL_BAUD_TOLERANCE_PCT
+**
+**  Return Values:
+**      number of rates the device accepted
+**      -1 (SERIAL_ERROR_CODE) if the original rate could not be restored
+**
+**  Errors:
+**      none
+**
+**  Description:
+**      Tries every rate in turn and puts the original rate back at the
+**      end.  Do not probe while traffic is flowing.
+*/
+int SerialPortProbeBauds( SERIAL_PORT *port, const int *rgBaud, int cBaud, int *rgActual ) {
+
+    int baudOrig;
+    int cAccepted;
+    int i;
+
+    baudOrig = SerialPortGetBaud(port);
+    cAccepted = 0;
+
+    for ( i = 0; i < cBaud; i++ ) {
+        if ( SerialPortSetBaud(port, rgBaud[i]) ) {
+            rgActual[i] = port->baudRate;
+            cAccepted++;
+        } else {
+            rgActual[i] = 0;
+        }
+    }
+
+    if ( (baudOrig > 0) && !SerialPortSetBaud(port, baudOrig) ) {
+        return SERIAL_ERROR_CODE;
+    }
+    return cAccepted;
+}
 
 /* ------------------------------------------------------------ */
 /***    IntToBaud
@@ -313,6 +883,7 @@ int SerialGetBaud( void ) {
 **
 **  Return Values:
 **      OS Baud Rate type
+**      B0 if the rate has no Bxxx constant, see SerialPortSetBaud()
 **
 **  Errors:
 **      none
@@ -341,59 +912,86 @@ speed_t IntToBaud( int baudRate ) {
         case 57600:     osBaudRate = B57600; break;
         case 115200:    osBaudRate = B115200; break;
         case 230400:    osBaudRate = B230400; break;
+        case 460800:    osBaudRate = B460800; break;
+        case 500000:    osBaudRate = B500000; break;
+        case 576000:    osBaudRate = B576000; break;
+        case 921600:    osBaudRate = B921600; break;
+        case 1000000:   osBaudRate = B1000000; break;
+        case 1152000:   osBaudRate = B1152000; break;
+        case 1500000:   osBaudRate = B1500000; break;
+        case 2000000:   osBaudRate = B2000000; break;
+        case 2500000:   osBaudRate = B2500000; break;
+        case 3000000:   osBaudRate = B3000000; break;
+        case 3500000:   osBaudRate = B3500000; break;
+        case 4000000:   osBaudRate = B4000000; break;
         default: osBaudRate = B0; break;
     }
     return osBaudRate;
 }
 
 /* ------------------------------------------------------------ */
-/***    SerialInit
+/***    SerialPortOpen
 **
 **  Synopsis:
-**      int SerialInit( char *szDevice )
+**      SERIAL_PORT *SerialPortOpen( const char *szDevice, int baudRate )
 **
 **  Parameters:
 **      char *szDevice           string indicating location of serial port "file"
 **      int baudRate
 **
 **  Return Values:
-**      1                   success
-**      0                   failure
+**      handle for the opened port
+**      NULL on failure
 **
 **  Errors:
-**      none
+**      errno is left set by the failing open/tcgetattr/tcsetattr call
 **
 **  Description:
-**      Uses the a globally defined integer "file descriptor" fd to write
-**      to the serial port.  The serial port must be previously opened and
-**      the fd must be the assigned file descriptor for the serial port.
-**      Please use the SerialInit(char *szDevice) prior to using this function.
-**      Opens the serial port with a baud rate of 9600.  No parity or flow control.
-**      One stop bit.
+**      Opens the serial port and allocates the handle that owns its file
+**      descriptor and line settings.  Eight data bits, no parity or flow
+**      control and one stop bit, SerialPortSetFlowControl() adds a
+**      handshake.  Release it with SerialPortClose().  Fails rather than
+**      hanging up the line if the rate cannot be set.
 */
-bool SerialInit(char *szDevice, int baudRate) {
+SERIAL_PORT *SerialPortOpen(const char *szDevice, int baudRate) {
+
+    SERIAL_PORT     *port;
+    struct termios  options;
+    bool            fCustomBaud;
+    int             errnoSave;
+
+    port = calloc(1, sizeof(*port));
+    if ( port == NULL ) {
+        return NULL;
+    }
+    strncpy(port->szDevice, szDevice, sizeof(port->szDevice) - 1);
+    port->baudRate = baudRate;
+    pthread_mutex_init(&port->mtxCapture, NULL);
+    pthread_mutex_init(&port->mtxLines, NULL);
 
-    struct termios options;
     memset (&options, 0, sizeof(options)); // clear whatever was in there before
 
-    fd = open(szDevice, O_RDWR | O_NOCTTY | O_NDELAY);
+    port->fd = open(szDevice, O_RDWR | O_NOCTTY | O_NDELAY);
 
-    if (fd == -1) {
-        printf("Unable to open %s!", szDevice);
-        return false;
+    if (port->fd == -1) {
+        SERIAL_LOG(SERIAL_LOG_ERROR, "Unable to open %s!", szDevice);
+        goto lErrorFree;
     } else {
-        fcntl(fd, F_SETFL, 0);
+        fcntl(port->fd, F_SETFL, 0);
     }
 
     // Get the current options for the port...
-    if ( 0 != tcgetattr(fd, &options) ) {
-        printf("SerialInit Error - unable to get options!\n");
-        return false;
+    if ( 0 != tcgetattr(port->fd, &options) ) {
+        SERIAL_LOG(SERIAL_LOG_ERROR, "SerialInit Error - unable to get options!");
+        goto lErrorClose;
     }
 
-    // Set the baud rates
-    cfsetispeed(&options, IntToBaud(baudRate));
-    cfsetospeed(&options, IntToBaud(baudRate));
+    // Set the baud rates, anything without a Bxxx constant is set below
+    fCustomBaud = ( (baudRate != 0) && (IntToBaud(baudRate) == B0) );
+    if ( !fCustomBaud ) {
+        cfsetispeed(&options, IntToBaud(baudRate));
+        cfsetospeed(&options, IntToBaud(baudRate));
+    }
     // Enable the receiver and set local mode...
     options.c_cflag |= (CLOCAL | CREAD);
 
@@ -402,6 +1000,7 @@ bool SerialInit(char *szDevice, int baudRate) {
     options.c_cflag &= ~CSIZE; //ready value for character size
     options.c_cflag |= CS8; //8-bit character size
     options.c_iflag &= ~IGNBRK; // disable break processing
+    options.c_iflag &= ~(BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL); // 8-bit clean input
     options.c_lflag = 0; // no signalling chars, no echo, no canonical processing
     options.c_oflag = 0; // no remapping, no delays
     options.c_cc[VMIN] = 0; // read doesn't block
@@ -410,66 +1009,314 @@ bool SerialInit(char *szDevice, int baudRate) {
     options.c_cflag &= ~CRTSCTS;
 
     // Set the new options for the port...
-    if ( 0 != tcsetattr(fd, TCSANOW, &options) ) { //change attributes NOW
-        printf("SerialInit Error - unable to set options!\n");
-        return false;
+    if ( 0 != tcsetattr(port->fd, TCSANOW, &options) ) { //change attributes NOW
+        SERIAL_LOG(SERIAL_LOG_ERROR, "SerialInit Error - unable to set options!");
+        goto lErrorClose;
     }
-    return true;
+    port->termios = options;
+    atomic_init(&port->flow, SERIAL_FLOW_NONE);
+
+    if ( fCustomBaud && !SerialPortSetBaud(port, baudRate) ) {
+        SERIAL_LOG(SERIAL_LOG_ERROR, "SerialInit Error - unable to set %d baud!", baudRate);
+        goto lErrorClose;
+    }
+    FlowResetLineCounts(port);
+
+    return port;
+
+lErrorClose:
+    errnoSave = errno;
+    close(port->fd);
+    errno = errnoSave;
+lErrorFree:
+    pthread_mutex_destroy(&port->mtxCapture);
+    pthread_mutex_destroy(&port->mtxLines);
+    free(port);
+    return NULL;
 }
 
 /* ------------------------------------------------------------ */
-/***    SerialClose
+/***    SerialPortClose
 **
 **  Synopsis:
-**      void SerialClose( void)
+**      bool SerialPortClose( SERIAL_PORT *port )
 **
 **  Parameters:
-**
+**      *port           port returned by SerialPortOpen(), may be NULL
 **
 **  Return Values:
+**      1               success
+**      0               close() reported an error, see errno
+**
+**  Errors:
+**      none
+**
+**  Description:
+**      Closes the file descriptor and frees the handle.  The handle must
+**      not be used again, whatever the return value.
+*/
+bool SerialPortClose(SERIAL_PORT *port) {
+
+    bool fSuccess;
+
+    if ( port == NULL ) {
+        return true;
+    }
+
+    ReactorDetach(port);
+    SerialPortRxStop(port);
+    HotplugPortFree(port);
+    LowLatencyRestore(port);
+    UringPortFree(port);
+    CapturePortFree(port);
+    fSuccess = ( 0 == close(port->fd) );
+    pthread_mutex_destroy(&port->mtxLines);
+    free(port);
+    return fSuccess;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortGetFd
 **
+**  Synopsis:
+**      int SerialPortGetFd( SERIAL_PORT *port )
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**
+**  Return Values:
+**      the file descriptor of the port
 **
 **  Errors:
 **      none
 **
 **  Description:
-**      Uses the a globally defined integer "file descriptor" fd to write
-**      to the serial port.  The serial port must be previously opened and
-**      the fd must be the assigned file descriptor for the serial port.
-**      Please use the SerialInit(char *szDevice) prior to using this function.
-**      Closes the fd file descriptor.
+**      For callers that want to wait on the port in their own poll/epoll
+**      set.  The descriptor remains owned by the port.
 */
-void SerialClose(void) {
-    if(0 > close(fd)) {
-        printf("SerialClose: Error - %d,  %s\n", errno, strerror(errno));
+int SerialPortGetFd(SERIAL_PORT *port) {
+
+    return port->fd;
+}
+
+/* ------------------------------------------------------------ */
+/*              Single Port Compatibility Interface             */
+/*                                                              */
+/*  The original API drove one port through a global fd.  It    */
+/*  now forwards to a default handle owned by SerialInit().     */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    SerialWrite
+**
+**  Synopsis:
+**      int SerialWrite(const uint8_t *rgbBuf, size_t cb, uint32_t flags)
+**
+**  Description:
+**      SerialPortWrite() on the port opened by SerialInit().
+*/
+int SerialWrite(const uint8_t *rgbBuf, size_t cb, uint32_t flags) {
+
+    if ( pportDefault == NULL ) {
+        errno = EBADF;
+        return SERIAL_ERROR_CODE;
     }
-    else {
-        printf("Serial connection closed.\n");
+    return SerialPortWrite(pportDefault, rgbBuf, cb, flags);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialWriteV
+**
+**  Synopsis:
+**      int SerialWriteV(const struct iovec *rgiov, int ciov, uint32_t flags)
+**
+**  Description:
+**      SerialPortWriteV() on the port opened by SerialInit().
+*/
+int SerialWriteV(const struct iovec *rgiov, int ciov, uint32_t flags) {
+
+    if ( pportDefault == NULL ) {
+        errno = EBADF;
+        return SERIAL_ERROR_CODE;
+    }
+    return SerialPortWriteV(pportDefault, rgiov, ciov, flags);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialWriteNBytes
+**
+**  Synopsis:
+**      bool SerialWriteNBytes(uint8_t *rgbChars, int n)
+**
+**  Description:
+**      SerialPortWriteNBytes() on the port opened by SerialInit().
+*/
+bool SerialWriteNBytes(uint8_t *rgbChars, int n) {
+
+    return ( pportDefault != NULL ) && SerialPortWriteNBytes(pportDefault, rgbChars, n);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialWriteByte
+**
+**  Synopsis:
+**      bool SerialWriteByte(uint8_t *pByte)
+**
+**  Description:
+**      SerialPortWriteByte() on the port opened by SerialInit().
+*/
+bool SerialWriteByte(uint8_t *pByte) {
+
+    return ( pportDefault != NULL ) && SerialPortWriteByte(pportDefault, pByte);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialRead
+**
+**  Synopsis:
+**      int SerialRead(uint8_t *result, uint32_t len, uint32_t timeOutMs)
+**
+**  Description:
+**      SerialPortRead() on the port opened by SerialInit().
+*/
+int SerialRead(uint8_t *result, uint32_t len, uint32_t timeOutMs) {
+
+    if ( pportDefault == NULL ) {
+        errno = EBADF;
+        return SERIAL_ERROR_CODE;
     }
+    return SerialPortRead(pportDefault, result, len, timeOutMs);
 }
 
-// Helper functions for enabling a timeout
-static bool GetTimeDiff ( struct timeval *result, struct timeval *t2, struct timeval *t1 )
-{
-    long int diff;
-    //long int elapsedMs;
+/* ------------------------------------------------------------ */
+/***    SerialReadEx
+**
+**  Synopsis:
+**      int SerialReadEx(uint8_t *result, uint32_t len, uint32_t minLen,
+**                       uint32_t timeOutMs, uint32_t interByteUs)
+**
+**  Description:
+**      SerialPortReadEx() on the port opened by SerialInit().
+*/
+int SerialReadEx(uint8_t *result, uint32_t len, uint32_t minLen,
+                 uint32_t timeOutMs, uint32_t interByteUs) {
+
+    if ( pportDefault == NULL ) {
+        errno = EBADF;
+        return SERIAL_ERROR_CODE;
+    }
+    return SerialPortReadEx(pportDefault, result, len, minLen, timeOutMs, interByteUs);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialGetBaud
+**
+**  Synopsis:
+**      int SerialGetBaud( void )
+**
+**  Description:
+**      SerialPortGetBaud() on the port opened by SerialInit().
+*/
+int SerialGetBaud( void ) {
 
-    diff = (t2->tv_usec + (1000000 * t2->tv_sec)) - (t1->tv_usec + (1000000 * t1->tv_sec));
-    result->tv_sec = diff / 1000000;
-    result->tv_usec = diff % 1000000;
+    return ( pportDefault != NULL ) ? SerialPortGetBaud(pportDefault) : -1;
+}
 
-    //elapsedMs = (1000*result->tv_sec + (result->tv_usec/1000));
-    //printf("%ld.%06ld\n", result->tv_sec, result->tv_usec);
-    //printf("elapsed milliseconds: %ld\n", elapsedMs);
+/* ------------------------------------------------------------ */
+/***    SerialSetFlowControl
+**
+**  Synopsis:
+**      bool SerialSetFlowControl( SERIAL_FLOW flow )
+**
+**  Description:
+**      SerialPortSetFlowControl() on the port opened by SerialInit().
+*/
+bool SerialSetFlowControl( SERIAL_FLOW flow ) {
 
-    if ( diff > 0 ) {
-        return true;
-    } else {
+    if ( pportDefault == NULL ) {
+        errno = EBADF;
+        return false;
+    }
+    return SerialPortSetFlowControl(pportDefault, flow);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialSetReconnect
+**
+**  Synopsis:
+**      bool SerialSetReconnect( const SERIAL_RECONNECT_CFG *pcfg )
+**
+**  Description:
+**      SerialPortSetReconnect() on the port opened by SerialInit().
+*/
+bool SerialSetReconnect( const SERIAL_RECONNECT_CFG *pcfg ) {
+
+    if ( pportDefault == NULL ) {
+        errno = EBADF;
         return false;
     }
+    return SerialPortSetReconnect(pportDefault, pcfg);
 }
 
+/* ------------------------------------------------------------ */
+/***    SerialInit
+**
+**  Synopsis:
+**      bool SerialInit( char *szDevice, int baudRate )
+**
+**  Parameters:
+**      char *szDevice           string indicating location of serial port "file"
+**      int baudRate
+**
+**  Return Values:
+**      1                   success
+**      0                   failure
+**
+**  Errors:
+**      none
+**
+**  Description:
+**      Opens the default port used by the functions in this section.  A
+**      port that is already open is closed first.
+*/
+bool SerialInit(char *szDevice, int baudRate) {
 
+    if ( pportDefault != NULL ) {
+        SerialPortClose(pportDefault);
+    }
+    pportDefault = SerialPortOpen(szDevice, baudRate);
+    return ( pportDefault != NULL );
+}
 
+/* ------------------------------------------------------------ */
+/***    SerialClose
+**
+**  Synopsis:
+**      void SerialClose( void)
+**
+**  Parameters:
+**
+**
+**  Return Values:
+**
+**
+**  Errors:
+**      none
+**
+**  Description:
+**      Closes the default port opened by SerialInit().
+*/
+void SerialClose(void) {
+    if ( pportDefault == NULL ) {
+        return;
+    }
+    if ( !SerialPortClose(pportDefault) ) {
+        SERIAL_LOG(SERIAL_LOG_ERROR, "SerialClose: Error - %d,  %s", errno, strerror(errno));
+    }
+    else {
+        SERIAL_LOG(SERIAL_LOG_INFO, "Serial connection closed.");
+    }
+    pportDefault = NULL;
+}
 
 /************************************ EOF ********************************/
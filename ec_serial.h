@@ -32,25 +32,172 @@
 /*                                                                      */
 /*  02/02/2009(MarkT): created                                          */
 /*  02/24/2017(MarkT): added support for timeout in SerialRead()        */
+/*  10/16/2026(agent): added SerialWrite() and SerialWriteV()           */
+/*  10/16/2026(agent): added SerialReadEx()                             */
+/*  10/16/2026(agent): added the SERIAL_PORT handle API                 */
+/*  10/16/2026(agent): added the background RX thread                   */
+/*  10/16/2026(agent): added SerialPortSetBaud() and the rate probe     */
+/*  10/16/2026(agent): added port statistics and the logging sink       */
+/*  10/16/2026(agent): added the low latency profile                    */
+/*  10/16/2026(agent): added the io_uring backend                       */
+/*  10/16/2026(agent): extern "C" guards, SERIAL_WRITE_NOWAIT           */
+/*  10/16/2026(agent): flow control, line counters, RX watermarks       */
+/*  10/16/2026(agent): automatic reconnect after a hot-plug             */
+/*  10/16/2026(agent): added SerialPortSetFormat()                      */
+/*  10/16/2026(agent): SERIAL_DRAIN_ERROR_CODE for a failed drain       */
 /*                                                                      */
 /************************************************************************/
 
 #if !defined(_SERIALCONTROL_H)
-#define _SERIALCONTOL_H
+#define _SERIALCONTROL_H
 
 #include <stdint.h>  /* for unsigned values*/
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/uio.h> /* struct iovec */
 
+#if defined(__cplusplus)
+extern "C" {
+#endif
 
 /* ------------------------------------------------------------ */
 /*                  Definitions                                 */
 /* ------------------------------------------------------------ */
 #define SERIAL_ERROR_CODE   -1
 #define SERIAL_TIMEOUT_CODE -2
+#define SERIAL_DRAIN_ERROR_CODE -3  // SerialWriteV() wrote every byte, tcdrain() failed
+
+#define SERIAL_WAIT_FOREVER 0xFFFFFFFF  // SerialReadEx() timeout
+
+#define SERIAL_BAUD_TOLERANCE_PCT   3   // accepted error of a programmed rate
+
+// Latency histograms keep 2^SERIAL_HIST_SUB_BITS buckets per power of two
+// (about 6% resolution) for values up to 2^SERIAL_HIST_MAX_BITS ns.
+#define SERIAL_HIST_SUB_BITS    4
+#define SERIAL_HIST_MAX_BITS    40
+#define SERIAL_HIST_BUCKETS     ((SERIAL_HIST_MAX_BITS - SERIAL_HIST_SUB_BITS + 2) << SERIAL_HIST_SUB_BITS)
+
+// SerialWrite()/SerialWriteV() flags
+#define SERIAL_WRITE_DRAIN  0x0001  // return once the data has left the UART
+#define SERIAL_WRITE_NOWAIT 0x0002  // return what the driver took, never block
+
+// SERIAL_LOW_LATENCY flags, also what SerialPortSetLowLatency() reports
+#define SERIAL_LL_DRIVER    0x0001  // ASYNC_LOW_LATENCY set in the driver
+#define SERIAL_LL_BUSY_POLL 0x0002  // waiting reads spin for spinUs before sleeping
+#define SERIAL_LL_RX_CPU    0x0004  // RX thread pinned to cpuRx
+#define SERIAL_LL_RX_FIFO   0x0008  // RX thread runs SCHED_FIFO at prioRx
+
+#define SERIAL_RECONNECT_TX_DEFAULT     (64 * 1024)     // SERIAL_RECONNECT_CFG defaults
+#define SERIAL_RECONNECT_RETRY_DEFAULT  250
 
 /* ------------------------------------------------------------ */
 /*                  General Type Declarations                   */
 /* ------------------------------------------------------------ */
 
+// One open serial port.  Each handle owns its own descriptor and line
+// settings, so threads driving different ports never share state.
+typedef struct SERIAL_PORT SERIAL_PORT;
+
+typedef struct {
+    uint64_t    cSamples;
+    uint64_t    nsSum;
+    uint64_t    nsMax;
+    uint64_t    rgc[SERIAL_HIST_BUCKETS];   // see SerialHistPercentile()
+} SERIAL_HIST;
+
+// Snapshot of a port's counters, see SerialPortGetStats()
+typedef struct {
+    uint64_t    cbRead;             // bytes taken from the device
+    uint64_t    cbWritten;          // bytes handed to the device
+    uint64_t    cReadCalls;         // read()/readv() system calls
+    uint64_t    cWriteCalls;        // write()/writev() system calls
+    uint64_t    cPollCalls;         // poll()/ppoll() system calls
+    uint64_t    cUringCalls;        // io_uring_enter() system calls
+    uint64_t    cPartialReads;      // reads that returned less than the caller still needed
+    uint64_t    cPartialWrites;     // writes the driver only partly accepted
+    uint64_t    cTimeouts;          // reads that ended on a deadline
+    uint64_t    cEagain;            // EAGAIN from the driver
+    uint64_t    cErrors;            // failed system calls
+    uint64_t    cRxThrottles;       // RX thread found the ring full and left data with the driver
+    SERIAL_HIST histReadWait;       // ns spent inside each waiting read
+    SERIAL_HIST histWrite;          // ns taken by each write, drain included
+} SERIAL_STATS;
+
+// Opt-in latency settings, see SerialPortSetLowLatency()
+typedef struct {
+    uint32_t    flags;              // SERIAL_LL_* wanted
+    uint32_t    spinUs;             // SERIAL_LL_BUSY_POLL budget per wait
+    int         cpuRx;              // SERIAL_LL_RX_CPU
+    int         prioRx;             // SERIAL_LL_RX_FIFO, 1 to 99
+} SERIAL_LOW_LATENCY;
+
+// Handshake for SerialPortSetFlowControl()
+typedef enum {
+    SERIAL_FLOW_NONE,
+    SERIAL_FLOW_RTSCTS,             // hardware, RTS and CTS lines
+    SERIAL_FLOW_XONXOFF             // software, DC3/DC1 in band, text protocols only
+} SERIAL_FLOW;
+
+// Driver counters since SerialPortOpen() or SerialPortResetStats(),
+// see SerialPortGetLineCounts()
+typedef struct {
+    uint64_t    cRx;                // characters received by the UART
+    uint64_t    cTx;                // characters sent by the UART
+    uint64_t    cOverrun;           // lost in the UART, its FIFO was not emptied in time
+    uint64_t    cBufOverrun;        // lost in the kernel, the tty buffer was full
+    uint64_t    cFrame;             // framing errors, usually a baud rate mismatch
+    uint64_t    cParity;            // parity errors
+    uint64_t    cBreak;             // break conditions
+    uint64_t    cCts;               // CTS transitions
+} SERIAL_LINE_COUNTS;
+
+// Called as the RX ring crosses a watermark, see SerialPortRxSetWatermarks()
+typedef void (*SERIAL_RX_WATERMARK_FN)(void *pvCtx, SERIAL_PORT *port, bool fHigh);
+
+// Reported by SerialPortSetReconnect() listeners
+typedef enum {
+    SERIAL_CONN_LOST,               // the device went away, writes are queued from now on
+    SERIAL_CONN_RESTORED,           // reopened with the port's settings, queue sent
+    SERIAL_CONN_FAILED              // the device is back but could not be set up, still waiting
+} SERIAL_CONN_EVENT;
+
+typedef void (*SERIAL_CONN_FN)(void *pvCtx, SERIAL_PORT *port, SERIAL_CONN_EVENT evt);
+
+// Automatic reconnect, see SerialPortSetReconnect()
+typedef struct {
+    const char      *szPath;        // reopened by this name, NULL finds the /dev/serial/by-id link
+    size_t          cbTxQueue;      // writes kept while the device is away, 0 for the default
+    uint32_t        msRetry;        // retry this often besides the inotify wakeups, 0 for the default
+    SERIAL_CONN_FN  pfnEvent;       // may be NULL
+    void            *pvCtx;
+} SERIAL_RECONNECT_CFG;
+
+typedef struct {
+    uint64_t    cDisconnects;
+    uint64_t    cReconnects;
+    uint64_t    cFailedOpens;       // the path was there but open or setup failed
+    uint64_t    nsLastDown;         // time from the hangup to the port working again
+    uint64_t    nsMaxDown;
+    uint64_t    cbTxQueued;         // written while away and sent after the reconnect
+    uint64_t    cbTxDropped;        // refused because the queue was full
+} SERIAL_RECONNECT_STATS;
+
+// How waiting reads reach the driver, see SerialPortSetIoBackend()
+typedef enum {
+    SERIAL_IO_POLL,                 // read() with ppoll() in between
+    SERIAL_IO_URING                 // linked poll/read chains through io_uring
+} SERIAL_IO_BACKEND;
+
+typedef enum {
+    SERIAL_LOG_ERROR,
+    SERIAL_LOG_WARN,
+    SERIAL_LOG_INFO,
+    SERIAL_LOG_DEBUG
+} SERIAL_LOG_LEVEL;
+
+// Receives every library message at or below the configured level
+typedef void (*SERIAL_LOG_FN)(void *pvCtx, SERIAL_LOG_LEVEL level, const char *szMsg);
+
 
 /* ------------------------------------------------------------ */
 /*                  Object Class Declarations                   */
@@ -67,14 +214,75 @@
 /*                  Function Prototypes                         */
 /* ------------------------------------------------------------ */
 
+SERIAL_PORT *SerialPortOpen(const char *szDevice, int baudRate);
+bool    SerialPortClose(SERIAL_PORT *port);
+int     SerialPortGetFd(SERIAL_PORT *port);
+int     SerialPortWrite(SERIAL_PORT *port, const uint8_t *rgbBuf, size_t cb, uint32_t flags);
+int     SerialPortWriteV(SERIAL_PORT *port, const struct iovec *rgiov, int ciov, uint32_t flags);
+bool    SerialPortWriteNBytes(SERIAL_PORT *port, uint8_t *rgbChars, int n);
+bool    SerialPortWriteByte(SERIAL_PORT *port, uint8_t *pByte);
+int     SerialPortRead(SERIAL_PORT *port, uint8_t *result, uint32_t len, uint32_t timeOutMs);
+int     SerialPortReadEx(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+                         uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs);
+int     SerialPortGetBaud(SERIAL_PORT *port);
+bool    SerialPortSetBaud(SERIAL_PORT *port, int baudRate);
+bool    SerialPortSetFormat(SERIAL_PORT *port, int cDataBits, char parity, int cStopBits);
+int     SerialPortProbeBauds(SERIAL_PORT *port, const int *rgBaud, int cBaud, int *rgActual);
+
+// low latency profile, see ec_lowlat.c
+uint32_t SerialPortSetLowLatency(SERIAL_PORT *port, const SERIAL_LOW_LATENCY *pll);
+uint32_t SerialPortGetLowLatency(SERIAL_PORT *port);
+
+// io_uring backend, see ec_uring.c
+SERIAL_IO_BACKEND SerialPortSetIoBackend(SERIAL_PORT *port, SERIAL_IO_BACKEND backend);
+
+// flow control and line counters, see ec_flow.c
+bool    SerialPortSetFlowControl(SERIAL_PORT *port, SERIAL_FLOW flow);
+SERIAL_FLOW SerialPortGetFlowControl(SERIAL_PORT *port);
+bool    SerialPortGetLineCounts(SERIAL_PORT *port, SERIAL_LINE_COUNTS *pcounts);
+
+// automatic reconnect, see ec_hotplug.c
+bool    SerialPortSetReconnect(SERIAL_PORT *port, const SERIAL_RECONNECT_CFG *pcfg);
+bool    SerialPortIsConnected(SERIAL_PORT *port);
+void    SerialPortGetReconnectStats(SERIAL_PORT *port, SERIAL_RECONNECT_STATS *pstats);
+
+// counters and logging, see ec_stats.c and ec_log.c
+void    SerialPortGetStats(SERIAL_PORT *port, SERIAL_STATS *pstats);
+void    SerialPortResetStats(SERIAL_PORT *port);
+uint64_t SerialHistPercentile(const SERIAL_HIST *phist, double pct);
+void    SerialSetLogger(SERIAL_LOG_FN pfnLog, void *pvCtx, SERIAL_LOG_LEVEL levelMax);
+
+// background receive thread, see ec_rx.c
+bool    SerialPortRxStart(SERIAL_PORT *port, size_t cbRing);
+void    SerialPortRxStop(SERIAL_PORT *port);
+size_t  SerialPortRxPeek(SERIAL_PORT *port, const uint8_t **ppb);
+void    SerialPortRxConsume(SERIAL_PORT *port, size_t cb);
+int     SerialPortRxWait(SERIAL_PORT *port, size_t cbMin, uint32_t timeOutMs);
+uint64_t SerialPortRxOverflow(SERIAL_PORT *port);
+void    SerialPortRxSetWatermarks(SERIAL_PORT *port, size_t cbHigh, size_t cbLow,
+                                  SERIAL_RX_WATERMARK_FN pfnWatermark, void *pvCtx);
+bool    SerialPortRxBackpressure(SERIAL_PORT *port);
+
+// single port interface, operates on the port opened by SerialInit()
+
+int     SerialWrite(const uint8_t *rgbBuf, size_t cb, uint32_t flags);
+int     SerialWriteV(const struct iovec *rgiov, int ciov, uint32_t flags);
 bool    SerialWriteNBytes(uint8_t *rgbChars, int n);
 bool    SerialWriteByte(uint8_t *pByte);
 int     SerialRead(uint8_t *result, uint32_t len, uint32_t timeOutMs);
+int     SerialReadEx(uint8_t *result, uint32_t len, uint32_t minLen,
+                     uint32_t timeOutMs, uint32_t interByteUs);
 int     SerialGetBaud(void);
+bool    SerialSetFlowControl(SERIAL_FLOW flow);
+bool    SerialSetReconnect(const SERIAL_RECONNECT_CFG *pcfg);
 bool    SerialInit(char *szDevice, int baudRate);
 void    SerialClose(void);
 /* ------------------------------------------------------------ */
 
+#if defined(__cplusplus)
+}
+#endif
+
 #endif
 
 /**********************************  EOF  **************************************/
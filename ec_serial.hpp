@@ -0,0 +1,794 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_serial.hpp --  C++20 coroutines over EmbedCreativity's serial    */
+/*                    library                                           */
+/*                                                                      */
+/************************************************************************/
+/*  Author:     agent                                                   */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*  Header only.  One ec::EventLoop per thread drives any number of     */
+/*  ec::Port conversations written as coroutines:                       */
+/*                                                                      */
+/*      ec::Task<> Poll(ec::Port &port) {                               */
+/*          static const uint8_t rgbCmd[] = { 'R', '?', '\n' };         */
+/*          uint8_t rgb[64];                                            */
+/*          co_await port.write(rgbCmd, ec::after(100ms));              */
+/*          size_t cb = co_await port.read_until(rgb, '\n');            */
+/*      }                                                               */
+/*                                                                      */
+/*      ec::EventLoop loop;                                             */
+/*      ec::Port port(loop, "/dev/ttyUSB0", 115200);                    */
+/*      loop.spawn(Poll(port));                                         */
+/*      loop.run();                                                     */
+/*                                                                      */
+/*  Nothing blocks: a Port switches its descriptor to O_NONBLOCK and    */
+/*  writes with SERIAL_WRITE_NOWAIT, and the loop sleeps in a single    */
+/*  epoll_wait() for every port and deadline it owns.  Errors and       */
+/*  expired deadlines are thrown as std::system_error.  A Port must     */
+/*  not be used from another thread, nor with the RX thread or a        */
+/*  reactor, which take the descriptor over.                            */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026(agent): created                                          */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(_SERIAL_HPP)
+#define _SERIAL_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <map>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "ec_serial.h"
+
+namespace ec {
+
+/* ------------------------------------------------------------ */
+/*                  Definitions                                 */
+/* ------------------------------------------------------------ */
+
+using Clock = std::chrono::steady_clock;
+using Deadline = Clock::time_point;
+
+inline constexpr Deadline kForever = Deadline::max();
+
+inline Deadline after(Clock::duration dur) {
+    return Clock::now() + dur;
+}
+
+// what ended an EventLoop::wait_readable()/wait_writable()
+enum class Wake { ready, timeout, hangup };
+
+template <typename T = void> class Task;
+
+namespace detail {
+
+[[noreturn]] inline void ThrowErrno(int err, const char *szWhat) {
+    throw std::system_error(err, std::generic_category(), szWhat);
+}
+
+struct PromiseBase {
+    std::coroutine_handle<>     hContinuation;  // whoever co_awaits the task
+    std::exception_ptr          error;
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+            // symmetric transfer, so long chains of tasks do not grow the stack
+            std::coroutine_handle<> hNext = h.promise().hContinuation;
+            return hNext ? hNext : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    std::optional<T>    value;
+
+    template <typename U>
+    void return_value(U &&u) { value.emplace(std::forward<U>(u)); }
+    T take() {
+        if ( error ) {
+            std::rethrow_exception(error);
+        }
+        return std::move(*value);
+    }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    void return_void() noexcept {}
+    void take() {
+        if ( error ) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+}   // namespace detail
+
+/* ------------------------------------------------------------ */
+/*                  Object Class Declarations                   */
+/* ------------------------------------------------------------ */
+
+/***    Task
+**
+**  Description:
+**      Lazy coroutine result.  Nothing runs until the task is co_awaited
+**      or handed to EventLoop::spawn(), and an exception thrown inside
+**      comes out of the co_await.  Move only, destroying a task that has
+**      not finished destroys its frame.
+*/
+template <typename T>
+class [[nodiscard]] Task {
+public:
+    struct promise_type : detail::Promise<T> {
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+    Task() noexcept = default;
+    Task(Task &&other) noexcept : h(std::exchange(other.h, nullptr)) {}
+    Task &operator=(Task &&other) noexcept {
+        if ( this != &other ) {
+            if ( h ) {
+                h.destroy();
+            }
+            h = std::exchange(other.h, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+    ~Task() {
+        if ( h ) {
+            h.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return !h || h.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> hCaller) noexcept {
+        h.promise().hContinuation = hCaller;
+        return h;
+    }
+    T await_resume() { return h.promise().take(); }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> hNew) noexcept : h(hNew) {}
+
+    std::coroutine_handle<promise_type>     h;
+};
+
+/***    EventLoop
+**
+**  Description:
+**      Single threaded executor.  Descriptors are attached once, edge
+**      triggered, so waiting on one costs no system call beyond the
+**      shared epoll_wait().  Deadlines sit in an ordered map and bound
+**      that wait.  run() returns when every spawned task has finished
+**      and rethrows the first exception one of them let escape.
+*/
+class EventLoop {
+public:
+    class FdWait;
+    class Sleep;
+
+    EventLoop() {
+        fdEpoll = epoll_create1(EPOLL_CLOEXEC);
+        if ( fdEpoll < 0 ) {
+            detail::ThrowErrno(errno, "epoll_create1");
+        }
+    }
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+    ~EventLoop() {
+        // tasks that never got to run
+        for ( std::coroutine_handle<> h : dqhReady ) {
+            h.destroy();
+        }
+        close(fdEpoll);
+    }
+
+    // start watching fd, a Port does this for its own descriptor
+    void attach(int fd) {
+        struct epoll_event  ev;
+
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = fd;
+        if ( epoll_ctl(fdEpoll, EPOLL_CTL_ADD, fd, &ev) != 0 ) {
+            detail::ThrowErrno(errno, "epoll_ctl");
+        }
+        mpfdst[fd] = FdState();
+    }
+
+    // stop watching fd, which must have nobody waiting on it
+    void detach(int fd) noexcept {
+        epoll_ctl(fdEpoll, EPOLL_CTL_DEL, fd, nullptr);
+        mpfdst.erase(fd);
+    }
+
+    void spawn(Task<void> task) {
+        cTasks++;
+        dqhReady.push_back(Drive(std::move(task)).h);
+    }
+
+    FdWait wait_readable(int fd, Deadline dl = kForever);
+    FdWait wait_writable(int fd, Deadline dl = kForever);
+    Sleep sleep_until(Deadline dl);
+    Sleep sleep_for(Clock::duration dur);
+
+    void run();
+
+private:
+    struct Waiter {
+        std::coroutine_handle<>     h;
+        Wake                        wake;
+        int                         fd;
+        bool                        fWrite;
+        bool                        fTimer;
+        std::multimap<Deadline, Waiter *>::iterator itTimer;
+    };
+
+    struct FdState {
+        Waiter      *pwRead = nullptr;
+        Waiter      *pwWrite = nullptr;
+        bool        fReadable = true;   // edge seen that nobody has consumed
+        bool        fWritable = true;
+        bool        fHup = false;
+    };
+
+    // root coroutine for spawn(), frees itself when the task is done
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() {
+                return Detached{std::coroutine_handle<promise_type>::from_promise(*this)};
+            }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept { std::terminate(); }
+        };
+        std::coroutine_handle<promise_type>     h;
+    };
+
+    Detached Drive(Task<void> task) {
+        try {
+            co_await task;
+        } catch (...) {
+            if ( !error ) {
+                error = std::current_exception();
+            }
+        }
+        cTasks--;
+    }
+
+    void Arm(Waiter *pw, Deadline dl) {
+        if ( dl != kForever ) {
+            pw->itTimer = mptimer.emplace(dl, pw);
+            pw->fTimer = true;
+        }
+    }
+
+    // unlink pw from its descriptor and its deadline and queue it to resume
+    void Fire(Waiter *pw, Wake wake) {
+        if ( pw->fd >= 0 ) {
+            auto it = mpfdst.find(pw->fd);
+            if ( it != mpfdst.end() ) {
+                (pw->fWrite ? it->second.pwWrite : it->second.pwRead) = nullptr;
+            }
+        }
+        if ( pw->fTimer ) {
+            mptimer.erase(pw->itTimer);
+            pw->fTimer = false;
+        }
+        pw->wake = wake;
+        vecpwFired.push_back(pw);
+    }
+
+    std::unordered_map<int, FdState>        mpfdst;
+    std::multimap<Deadline, Waiter *>       mptimer;
+    std::deque<std::coroutine_handle<>>     dqhReady;
+    std::vector<Waiter *>                   vecpwFired;
+    std::exception_ptr                      error;
+    size_t                                  cTasks = 0;
+    int                                     fdEpoll = -1;
+};
+
+/***    EventLoop::FdWait
+**
+**  Description:
+**      co_await result of wait_readable()/wait_writable().  Finishes at
+**      once when an edge arrived since the last wait, so the caller has
+**      to try the I/O first and only wait once it comes back empty.
+*/
+class EventLoop::FdWait {
+public:
+    FdWait(EventLoop &loopIn, int fdIn, bool fWriteIn, Deadline dlIn) noexcept
+        : loop(loopIn), dl(dlIn) {
+        w.fd = fdIn;
+        w.fWrite = fWriteIn;
+        w.fTimer = false;
+        w.wake = Wake::ready;
+    }
+
+    bool await_ready() {
+        auto it = loop.mpfdst.find(w.fd);
+        if ( it == loop.mpfdst.end() ) {
+            detail::ThrowErrno(EBADF, "EventLoop wait on a descriptor not attached");
+        }
+        FdState &st = it->second;
+        bool &fEdge = w.fWrite ? st.fWritable : st.fReadable;
+        if ( st.fHup ) {
+            w.wake = Wake::hangup;
+            return true;
+        }
+        if ( fEdge ) {
+            fEdge = false;
+            return true;
+        }
+        if ( Clock::now() >= dl ) {
+            w.wake = Wake::timeout;
+            return true;
+        }
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> h) {
+        Waiter *&pwSlot = w.fWrite ? loop.mpfdst[w.fd].pwWrite : loop.mpfdst[w.fd].pwRead;
+        if ( pwSlot != nullptr ) {
+            detail::ThrowErrno(EBUSY, "EventLoop descriptor already has a waiter");
+        }
+        w.h = h;
+        pwSlot = &w;
+        loop.Arm(&w, dl);
+    }
+    Wake await_resume() const noexcept { return w.wake; }
+
+private:
+    EventLoop   &loop;
+    Waiter      w;
+    Deadline    dl;
+};
+
+/***    EventLoop::Sleep
+**
+**  Description:
+**      co_await result of sleep_until()/sleep_for().
+*/
+class EventLoop::Sleep {
+public:
+    Sleep(EventLoop &loopIn, Deadline dlIn) noexcept : loop(loopIn), dl(dlIn) {
+        w.fd = -1;
+        w.fWrite = false;
+        w.fTimer = false;
+        w.wake = Wake::timeout;
+    }
+
+    bool await_ready() const noexcept { return Clock::now() >= dl; }
+    void await_suspend(std::coroutine_handle<> h) {
+        w.h = h;
+        loop.Arm(&w, dl);
+    }
+    void await_resume() const noexcept {}
+
+private:
+    EventLoop   &loop;
+    Waiter      w;
+    Deadline    dl;
+};
+
+inline EventLoop::FdWait EventLoop::wait_readable(int fd, Deadline dl) {
+    return FdWait(*this, fd, false, dl);
+}
+
+inline EventLoop::FdWait EventLoop::wait_writable(int fd, Deadline dl) {
+    return FdWait(*this, fd, true, dl);
+}
+
+inline EventLoop::Sleep EventLoop::sleep_until(Deadline dl) {
+    return Sleep(*this, dl);
+}
+
+inline EventLoop::Sleep EventLoop::sleep_for(Clock::duration dur) {
+    return Sleep(*this, Clock::now() + dur);
+}
+
+/* ------------------------------------------------------------ */
+/***    EventLoop::run
+**
+**  Synopsis:
+**      void run()
+**
+**  Errors:
+**      std::system_error if epoll_wait() fails, otherwise the first
+**      exception that escaped a spawned task, once all of them are done
+**
+**  Description:
+**      Starts the spawned tasks, then sleeps in epoll_wait() until the
+**      nearest deadline and resumes whoever the events and deadlines
+**      woke.  Wakeups are collected before anything resumes, so a task
+**      that detaches a descriptor or spawns another cannot disturb the
+**      batch being dispatched.
+*/
+inline void EventLoop::run() {
+
+    struct epoll_event  rgev[64];
+    std::exception_ptr  errorRun;
+    int                 msWait;
+    int                 cev;
+    int                 iev;
+
+    while ( cTasks > 0 ) {
+        while ( !dqhReady.empty() ) {
+            std::coroutine_handle<> h = dqhReady.front();
+            dqhReady.pop_front();
+            h.resume();
+        }
+        if ( cTasks == 0 ) {
+            break;
+        }
+
+        msWait = -1;
+        if ( !mptimer.empty() ) {
+            // round up, waking early would only spin until the deadline
+            auto nsLeft = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                mptimer.begin()->first - Clock::now()).count();
+            msWait = ( nsLeft <= 0 ) ? 0 : (int)std::min<int64_t>((nsLeft + 999999) / 1000000, 60000);
+        }
+
+        cev = epoll_wait(fdEpoll, rgev, sizeof(rgev) / sizeof(rgev[0]), msWait);
+        if ( cev < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            detail::ThrowErrno(errno, "epoll_wait");
+        }
+
+        for ( iev = 0; iev < cev; iev++ ) {
+            auto it = mpfdst.find(rgev[iev].data.fd);
+            if ( it == mpfdst.end() ) {
+                continue;
+            }
+            FdState &st = it->second;
+            uint32_t events = rgev[iev].events;
+            Wake wake = Wake::ready;
+            if ( events & (EPOLLHUP | EPOLLERR) ) {
+                st.fHup = true;
+                wake = Wake::hangup;
+            }
+            if ( events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR) ) {
+                if ( st.pwRead != nullptr ) {
+                    Fire(st.pwRead, wake);
+                } else {
+                    st.fReadable = true;
+                }
+            }
+            if ( events & (EPOLLOUT | EPOLLHUP | EPOLLERR) ) {
+                if ( st.pwWrite != nullptr ) {
+                    Fire(st.pwWrite, wake);
+                } else {
+                    st.fWritable = true;
+                }
+            }
+        }
+
+        Deadline dlNow = Clock::now();
+        while ( !mptimer.empty() && (mptimer.begin()->first <= dlNow) ) {
+            Fire(mptimer.begin()->second, Wake::timeout);
+        }
+
+        std::vector<Waiter *> vecpw;
+        vecpw.swap(vecpwFired);
+        for ( Waiter *pw : vecpw ) {
+            pw->h.resume();
+        }
+    }
+
+    if ( error ) {
+        std::swap(errorRun, error);
+        std::rethrow_exception(errorRun);
+    }
+}
+
+/***    Port
+**
+**  Description:
+**      Owns a SERIAL_PORT for its lifetime and closes it on destruction.
+**      Move only.  The operations are coroutines that keep a pointer to
+**      the Port, so it must neither move nor die while one is pending.
+**      Bytes received past a read_until() delimiter, or by a read_exact()
+**      that ran out of time, are kept for the next read.
+*/
+class Port {
+public:
+    Port(EventLoop &loopIn, const char *szDevice, int baudRate) : ploop(&loopIn) {
+        int     flags;
+
+        port = SerialPortOpen(szDevice, baudRate);
+        if ( port == nullptr ) {
+            detail::ThrowErrno(( errno != 0 ) ? errno : ENODEV, "SerialPortOpen");
+        }
+        fd = SerialPortGetFd(port);
+        flags = fcntl(fd, F_GETFL);
+        if ( (flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) ) {
+            int err = errno;
+            SerialPortClose(port);
+            detail::ThrowErrno(err, "fcntl");
+        }
+        try {
+            ploop->attach(fd);
+        } catch (...) {
+            SerialPortClose(port);
+            throw;
+        }
+    }
+    Port(Port &&other) noexcept
+        : ploop(other.ploop), port(std::exchange(other.port, nullptr)),
+          fd(std::exchange(other.fd, -1)), vecbPending(std::move(other.vecbPending)) {}
+    Port &operator=(Port &&other) noexcept {
+        if ( this != &other ) {
+            Close();
+            ploop = other.ploop;
+            port = std::exchange(other.port, nullptr);
+            fd = std::exchange(other.fd, -1);
+            vecbPending = std::move(other.vecbPending);
+        }
+        return *this;
+    }
+    Port(const Port &) = delete;
+    Port &operator=(const Port &) = delete;
+    ~Port() { Close(); }
+
+    // the C handle, for SerialPortGetStats(), SerialPortSetBaud() and such
+    SERIAL_PORT *native() const noexcept { return port; }
+    EventLoop &loop() const noexcept { return *ploop; }
+
+    Task<size_t> read_exact(std::span<uint8_t> buf, Deadline dl = kForever);
+    Task<size_t> read_until(std::span<uint8_t> buf, uint8_t bDelim, Deadline dl = kForever);
+    Task<size_t> write(std::span<const uint8_t> buf, Deadline dl = kForever);
+
+private:
+    void Close() noexcept {
+        if ( port != nullptr ) {
+            ploop->detach(fd);
+            SerialPortClose(port);
+            port = nullptr;
+            fd = -1;
+        }
+    }
+
+    size_t TakePending(std::span<uint8_t> buf) {
+        size_t cb = std::min(buf.size(), vecbPending.size());
+        if ( cb == 0 ) {
+            return 0;
+        }
+        std::memcpy(buf.data(), vecbPending.data(), cb);
+        vecbPending.erase(vecbPending.begin(), vecbPending.begin() + cb);
+        return cb;
+    }
+
+    void PutBack(std::span<const uint8_t> buf) {
+        vecbPending.insert(vecbPending.begin(), buf.begin(), buf.end());
+    }
+
+    // one non-blocking read, 0 when nothing is waiting
+    size_t ReadSome(std::span<uint8_t> buf) {
+        int rc = SerialPortReadEx(port, buf.data(), (uint32_t)buf.size(), 0, 0, 0);
+        if ( rc == SERIAL_ERROR_CODE ) {
+            detail::ThrowErrno(errno, "SerialPortReadEx");
+        }
+        return ( rc > 0 ) ? (size_t)rc : 0;
+    }
+
+    EventLoop               *ploop;
+    SERIAL_PORT             *port = nullptr;
+    int                     fd = -1;
+    std::vector<uint8_t>    vecbPending;
+};
+
+/* ------------------------------------------------------------ */
+/*                  Procedure Definitions                       */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    Port::read_exact
+**
+**  Synopsis:
+**      Task<size_t> read_exact(std::span<uint8_t> buf, Deadline dl)
+**
+**  Return Values:
+**      buf.size(), always
+**
+**  Errors:
+**      std::errc::timed_out if dl passes first, the bytes that did
+**      arrive go back to the front of the port for the next read
+**      EIO if the device hung up, anything else the read reported
+**
+**  Description:
+**      Fills all of buf.
+*/
+inline Task<size_t> Port::read_exact(std::span<uint8_t> buf, Deadline dl) {
+
+    size_t  cbGot;
+    size_t  cb;
+    Wake    wake;
+
+    cbGot = TakePending(buf);
+    while ( cbGot < buf.size() ) {
+        cb = ReadSome(buf.subspan(cbGot));
+        if ( cb > 0 ) {
+            cbGot += cb;
+            continue;
+        }
+        wake = co_await ploop->wait_readable(fd, dl);
+        if ( wake == Wake::timeout ) {
+            PutBack(buf.first(cbGot));
+            detail::ThrowErrno(ETIMEDOUT, "Port::read_exact");
+        }
+        if ( wake == Wake::hangup ) {
+            cb = ReadSome(buf.subspan(cbGot));
+            if ( cb == 0 ) {
+                PutBack(buf.first(cbGot));
+                detail::ThrowErrno(EIO, "Port::read_exact");
+            }
+            cbGot += cb;
+        }
+    }
+    co_return cbGot;
+}
+
+/* ------------------------------------------------------------ */
+/***    Port::read_until
+**
+**  Synopsis:
+**      Task<size_t> read_until(std::span<uint8_t> buf, uint8_t bDelim,
+**                              Deadline dl)
+**
+**  Return Values:
+**      number of bytes placed in buf, the last of them bDelim
+**
+**  Errors:
+**      std::errc::no_buffer_space if buf fills without a delimiter, the
+**      buffer holds what was read
+**      std::errc::timed_out and EIO as for read_exact()
+**
+**  Description:
+**      Reads up to and including the first bDelim.  Bytes that arrived
+**      with it but belong after it are kept for the next read.
+*/
+inline Task<size_t> Port::read_until(std::span<uint8_t> buf, uint8_t bDelim, Deadline dl) {
+
+    const uint8_t   *pbDelim;
+    size_t          cbGot;
+    size_t          cbScanned;
+    size_t          cb;
+    Wake            wake;
+
+    cbGot = TakePending(buf);
+    cbScanned = 0;
+    for (;;) {
+        pbDelim = (const uint8_t *)std::memchr(buf.data() + cbScanned, bDelim, cbGot - cbScanned);
+        if ( pbDelim != nullptr ) {
+            cb = pbDelim - buf.data() + 1;
+            PutBack(buf.subspan(cb, cbGot - cb));
+            co_return cb;
+        }
+        cbScanned = cbGot;
+        if ( cbGot == buf.size() ) {
+            detail::ThrowErrno(ENOBUFS, "Port::read_until");
+        }
+
+        cb = ReadSome(buf.subspan(cbGot));
+        if ( cb > 0 ) {
+            cbGot += cb;
+            continue;
+        }
+        wake = co_await ploop->wait_readable(fd, dl);
+        if ( wake == Wake::timeout ) {
+            PutBack(buf.first(cbGot));
+            detail::ThrowErrno(ETIMEDOUT, "Port::read_until");
+        }
+        if ( wake == Wake::hangup ) {
+            cb = ReadSome(buf.subspan(cbGot));
+            if ( cb == 0 ) {
+                PutBack(buf.first(cbGot));
+                detail::ThrowErrno(EIO, "Port::read_until");
+            }
+            cbGot += cb;
+        }
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    Port::write
+**
+**  Synopsis:
+**      Task<size_t> write(std::span<const uint8_t> buf, Deadline dl)
+**
+**  Return Values:
+**      buf.size(), always
+**
+**  Errors:
+**      std::errc::timed_out if the driver has not taken everything by dl,
+**      part of buf may already be on its way
+**      anything SerialPortWrite() reported
+**
+**  Description:
+**      Hands buf to the driver with SERIAL_WRITE_NOWAIT, waiting for
+**      room whenever its buffer is full.  Completes when the driver has
+**      the data, not when it has left the UART.
+*/
+inline Task<size_t> Port::write(std::span<const uint8_t> buf, Deadline dl) {
+
+    size_t  cbDone;
+    int     rc;
+
+    cbDone = 0;
+    while ( cbDone < buf.size() ) {
+        rc = SerialPortWrite(port, buf.data() + cbDone, buf.size() - cbDone, SERIAL_WRITE_NOWAIT);
+        if ( rc < 0 ) {
+            detail::ThrowErrno(errno, "SerialPortWrite");
+        }
+        cbDone += rc;
+        if ( cbDone < buf.size() ) {
+            Wake wake = co_await ploop->wait_writable(fd, dl);
+            if ( wake == Wake::timeout ) {
+                detail::ThrowErrno(ETIMEDOUT, "Port::write");
+            }
+            if ( wake == Wake::hangup ) {
+                detail::ThrowErrno(EIO, "Port::write");
+            }
+        }
+    }
+    co_return cbDone;
+}
+
+}   // namespace ec
+
+#endif
+
+/**********************************  EOF  **************************************/
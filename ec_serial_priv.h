@@ -0,0 +1,292 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+  
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_serial_priv.h --  EmbedCreativity's Serial Comm private header   */
+/*                                                                      */
+/************************************************************************/
+/*  Author:     agent                                                   */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*  Layout of the SERIAL_PORT handle.  Only the library's own source    */
+/*  files include this, applications see the handle as opaque.          */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026(agent): created                                          */
+/*  10/16/2026(agent): flow control state and RX watermarks             */
+/*  10/16/2026(agent): traffic capture hooks                            */
+/*  10/16/2026(agent): reconnect state                                  */
+/*  10/16/2026(agent): 64 bit line count totals                         */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(_SERIALPRIV_H)
+#define _SERIALPRIV_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/uio.h>
+
+#include "ec_serial.h"
+#include "ec_ring.h"
+#include "ec_capture.h"
+
+/* ------------------------------------------------------------ */
+/*                  Definitions                                 */
+/* ------------------------------------------------------------ */
+
+#define SERIAL_DEVICE_MAX   256     // longest device path remembered
+#define SERIAL_RX_DISCARD   4096    // scratch the RX thread drains into when full
+
+/* ------------------------------------------------------------ */
+/*                  Object Class Declarations                   */
+/* ------------------------------------------------------------ */
+
+// Live counters behind SERIAL_STATS.  The reading and the writing side
+// of a port both count polls, EAGAINs and errors, and either can race
+// SerialPortResetStats(), so every count is a relaxed atomic add, see
+// STAT_ADD_SHARED(), and each histogram's nsMax a compare-exchange loop
+// in HistRecord().  Next to the system call they count that is noise.
+typedef struct {
+    _Atomic uint64_t    cSamples;
+    _Atomic uint64_t    nsSum;
+    _Atomic uint64_t    nsMax;
+    _Atomic uint64_t    rgc[SERIAL_HIST_BUCKETS];
+} SERIAL_HIST_LIVE;
+
+typedef struct {
+    _Atomic uint64_t    cbRead;
+    _Atomic uint64_t    cbWritten;
+    _Atomic uint64_t    cReadCalls;
+    _Atomic uint64_t    cWriteCalls;
+    _Atomic uint64_t    cPollCalls;
+    _Atomic uint64_t    cUringCalls;
+    _Atomic uint64_t    cPartialReads;
+    _Atomic uint64_t    cPartialWrites;
+    _Atomic uint64_t    cTimeouts;
+    _Atomic uint64_t    cEagain;
+    _Atomic uint64_t    cErrors;
+    _Atomic uint64_t    cRxThrottles;
+    SERIAL_HIST_LIVE    histReadWait;
+    SERIAL_HIST_LIVE    histWrite;
+} SERIAL_STATS_LIVE;
+
+// State of the background receive thread, see ec_rx.c
+typedef struct {
+    SERIAL_RING         ring;           // reader thread -> consumer
+    pthread_t           thread;
+    int                 evtStop;        // eventfd, tells the reader to exit
+    int                 evtData;        // eventfd, wakes a consumer waiting for data
+    _Atomic int         fWaiting;       // consumer is about to sleep on evtData
+    _Atomic bool        fHangup;        // the reader saw the device go away
+    _Atomic uint64_t    cbOverflow;     // bytes dropped because the ring was full
+    int                 evtSpace;       // eventfd, wakes a reader waiting for ring space
+    _Atomic int         fParked;        // reader is about to sleep on evtSpace
+    _Atomic size_t      cbHigh;         // watermarks, cbHigh 0 when off
+    _Atomic size_t      cbLow;
+    SERIAL_RX_WATERMARK_FN pfnWatermark;
+    void                *pvWatermark;
+    _Atomic bool        fAboveHigh;     // passed cbHigh, not yet back down to cbLow
+    uint8_t             rgbDiscard[SERIAL_RX_DISCARD];
+} SERIAL_RX;
+
+struct SERIAL_PORT {
+    int             fd;             // open descriptor of the device
+    int             baudRate;       // rate requested at open
+    struct termios  termios;        // line settings applied at open
+    SERIAL_RX       *prx;           // non-NULL while the RX thread runs
+    void            *pvReactor;     // reactor entry while registered, see ec_reactor.c
+    struct URING_PORT *puring;      // non-NULL on SERIAL_IO_URING, see ec_uring.c
+    SERIAL_STATS_LIVE stats;
+    SERIAL_LOW_LATENCY ll;          // requested by SerialPortSetLowLatency()
+    uint32_t        llApplied;      // SERIAL_LL_* actually in effect
+    _Atomic uint64_t nsSpin;        // busy-poll budget per wait, 0 when off
+    int             asyncFlagsSaved; // driver ASYNC_* flags before SERIAL_LL_DRIVER
+    bool            fAsyncSaved;
+    _Atomic SERIAL_FLOW flow;       // handshake in effect, see ec_flow.c
+    pthread_mutex_t mtxLines;       // guards lcLast and lcTotal
+    SERIAL_LINE_COUNTS lcLast;      // raw driver counters at the last read
+    SERIAL_LINE_COUNTS lcTotal;     // accumulated since open or the last reset
+    _Atomic bool    fCapture;       // a capture is running, see ec_capture.c
+    pthread_mutex_t mtxCapture;     // guards pcapw
+    struct CAPTURE_WRITER *pcapw;
+    struct HOTPLUG  *photplug;      // non-NULL with SerialPortSetReconnect(), see ec_hotplug.c
+    char            szDevice[SERIAL_DEVICE_MAX];
+};
+
+/* ------------------------------------------------------------ */
+/*                  Variable Declarations                       */
+/* ------------------------------------------------------------ */
+
+extern int levelSerialLog;     // ec_log.c
+
+/* ------------------------------------------------------------ */
+/*                  Procedure Definitions                       */
+/* ------------------------------------------------------------ */
+
+// Only formats the message if some sink wants it.  Define SERIAL_NO_LOG
+// to compile every message out of the library.
+#if defined(SERIAL_NO_LOG)
+#define SERIAL_LOG(level, ...)  do { } while (0)
+#else
+#define SERIAL_LOG(level, ...) \
+    do { if ( (level) <= levelSerialLog ) SerialLog((level), __VA_ARGS__); } while (0)
+#endif
+
+// Counter update for a counter with only one writing thread, a relaxed
+// load/store pair.  Two writers would lose each other's counts.
+#define STAT_ADD(ctr, n) \
+    atomic_store_explicit(&(ctr), atomic_load_explicit(&(ctr), memory_order_relaxed) + (n), \
+                          memory_order_relaxed)
+
+// Counter update safe from any thread, for SERIAL_STATS_LIVE
+#define STAT_ADD_SHARED(ctr, n) \
+    atomic_fetch_add_explicit(&(ctr), (n), memory_order_relaxed)
+
+// Hands data that crossed the port to a running capture, see ec_capture.c.
+// CAPTURE_DATAV() records the first cb bytes described by rgiov.
+#define CAPTURE_DATA(port, dir, pv, cb) \
+    do { if ( atomic_load_explicit(&(port)->fCapture, memory_order_relaxed) ) \
+             CaptureAddV((port), (dir), &(struct iovec){ (void *)(pv), (cb) }, 1, (cb)); } while (0)
+#define CAPTURE_DATAV(port, dir, rgiov, ciov, cb) \
+    do { if ( atomic_load_explicit(&(port)->fCapture, memory_order_relaxed) ) \
+             CaptureAddV((port), (dir), (rgiov), (ciov), (cb)); } while (0)
+
+/* Histogram bucket for a value, log-linear like HdrHistogram. */
+static inline unsigned HistIndex( uint64_t v ) {
+    unsigned msb;
+    unsigned grp;
+
+    if ( v < (1u << SERIAL_HIST_SUB_BITS) ) {
+        return (unsigned)v;
+    }
+    if ( v >= ((uint64_t)1 << SERIAL_HIST_MAX_BITS) ) {
+        return SERIAL_HIST_BUCKETS - 1;
+    }
+    msb = 63 - __builtin_clzll(v);
+    grp = msb - SERIAL_HIST_SUB_BITS + 1;
+    return (grp << SERIAL_HIST_SUB_BITS) +
+           (unsigned)((v >> (grp - 1)) - (1u << SERIAL_HIST_SUB_BITS));
+}
+
+static inline void HistRecord( SERIAL_HIST_LIVE *phist, uint64_t ns ) {
+
+    uint64_t    nsMax;
+
+    STAT_ADD_SHARED(phist->rgc[HistIndex(ns)], 1);
+    STAT_ADD_SHARED(phist->cSamples, 1);
+    STAT_ADD_SHARED(phist->nsSum, ns);
+
+    // a failed exchange reloads nsMax, stop once it is at least ns
+    nsMax = atomic_load_explicit(&phist->nsMax, memory_order_relaxed);
+    while ( (ns > nsMax) &&
+            !atomic_compare_exchange_weak_explicit(&phist->nsMax, &nsMax, ns,
+                                                   memory_order_relaxed, memory_order_relaxed) ) {
+    }
+}
+
+/* Pause hint for busy-poll loops, eases off the sibling hyperthread. */
+static inline void CpuRelax( void ) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/* CLOCK_MONOTONIC in nanoseconds, used for every deadline in the library. */
+static inline uint64_t MonoNowNs( void ) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Converts an ms timeout into an absolute deadline, SERIAL_WAIT_FOREVER -> never. */
+static inline uint64_t DeadlineFromMs( uint32_t timeOutMs ) {
+
+    if ( timeOutMs == SERIAL_WAIT_FOREVER ) {
+        return UINT64_MAX;
+    }
+    return MonoNowNs() + (uint64_t)timeOutMs * 1000000;
+}
+
+/* ------------------------------------------------------------ */
+/*                  Function Prototypes                         */
+/* ------------------------------------------------------------ */
+
+// ec_serial.c
+int     PortWriteV(SERIAL_PORT *port, const struct iovec *rgiov, int ciov, uint32_t flags);
+int     PortReadAny(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+                    uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs);
+
+// ec_log.c
+void    SerialLog(SERIAL_LOG_LEVEL level, const char *szFmt, ...)
+            __attribute__((format(printf, 2, 3)));
+
+// ec_baud.c
+bool    BaudSetFd(int fd, int baudRate);
+int     BaudGetFd(int fd);
+
+// ec_lowlat.c
+void    LowLatencyRestore(SERIAL_PORT *port);
+void    LowLatencyReapply(SERIAL_PORT *port);
+
+// ec_flow.c
+void    FlowResetLineCounts(SERIAL_PORT *port);
+void    FlowRebaseLineCounts(SERIAL_PORT *port);
+
+// ec_capture.c
+void    CaptureAddV(SERIAL_PORT *port, SERIAL_CAPTURE_DIR dir,
+                    const struct iovec *rgiov, int ciov, size_t cb);
+void    CapturePortFree(SERIAL_PORT *port);
+
+// ec_hotplug.c
+int     HotplugReadEx(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+                      uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs);
+int     HotplugWriteV(SERIAL_PORT *port, const struct iovec *rgiov, int ciov, uint32_t flags);
+bool    HotplugLost(SERIAL_PORT *port);
+bool    HotplugWaitUp(SERIAL_PORT *port, int evtStop);
+void    HotplugPortFree(SERIAL_PORT *port);
+
+// ec_reactor.c
+void    ReactorDetach(SERIAL_PORT *port);
+void    ReactorReconnected(SERIAL_PORT *port);
+
+// ec_uring.c
+int     UringReadEx(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+                    uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs);
+void    UringPortFree(SERIAL_PORT *port);
+
+// ec_rx.c
+int     RxReadEx(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+                 uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs);
+uint32_t RxApplySched(SERIAL_PORT *port);
+void    RxConsume(SERIAL_PORT *port, size_t cb);
+
+/* ------------------------------------------------------------ */
+
+#endif
+
+/**********************************  EOF  **************************************/
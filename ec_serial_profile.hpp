@@ -0,0 +1,858 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_serial_profile.hpp --  compile time port profiles for            */
+/*                            EmbedCreativity's serial library          */
+/*                                                                      */
+/************************************************************************/
+/*  Author:     agent                                                   */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*  Header only, C++20.  A deployment that always talks 8N1 at 921600   */
+/*  with COBS frames and a CRC-32 can say so once, as a type:           */
+/*                                                                      */
+/*      using Link = ec::Profile<ec::Baud<921600>, ec::Line8N1,         */
+/*                               ec::Cobs, ec::Crc32,                   */
+/*                               ec::TimeoutFrames<4>, 1024>;           */
+/*                                                                      */
+/*      ec::ProfilePort<Link> port("/dev/ttyUSB0");                     */
+/*      port.write_frame(rgbCmd, sizeof(rgbCmd));                       */
+/*      int cb = port.read_frame(&pbFrame);                             */
+/*                                                                      */
+/*  Settings that cannot work together fail to compile: CRC trailers    */
+/*  on delimited frames, binary framing on a line of fewer than eight   */
+/*  data bits, a delimiter the line cannot carry, or a timeout shorter  */
+/*  than one frame takes on the wire.                                   */
+/*                                                                      */
+/*  ec::Framer<P> and the encoder are built for the one framing and     */
+/*  CRC of the profile.  The CRC tables are generated by the compiler,  */
+/*  buffers are sized at compile time, and the decode loop has no       */
+/*  switch on the framing.  CRC-32 frames of 64 bytes or more still go  */
+/*  to the library's kernel, which beats any table on CLMUL and ARMv8   */
+/*  CPUs.  The frames are the same on the wire as SerialFramer/         */
+/*  SerialFrameEncode() with Profile::frame_cfg(), so either end can    */
+/*  use either path.                                                    */
+/*                                                                      */
+/*  The port is opened with SerialPortOpen(), so the RX thread, stats,  */
+/*  capture and reconnect work as for any other port.                   */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026(agent): created                                          */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(_SERIAL_PROFILE_HPP)
+#define _SERIAL_PROFILE_HPP
+
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+#include <type_traits>
+
+#include "ec_serial.h"
+#include "ec_frame.h"
+#include "ec_crc.h"
+
+namespace ec {
+
+/* ------------------------------------------------------------ */
+/*                  Definitions                                 */
+/* ------------------------------------------------------------ */
+
+namespace detail {
+
+inline uint32_t LoadLe32(const uint8_t *pb) {
+    uint32_t dw;
+
+    std::memcpy(&dw, pb, sizeof(dw));
+    if constexpr ( std::endian::native == std::endian::big ) {
+        dw = __builtin_bswap32(dw);
+    }
+    return dw;
+}
+
+inline uint32_t LoadBe32(const uint8_t *pb) {
+    uint32_t dw;
+
+    std::memcpy(&dw, pb, sizeof(dw));
+    if constexpr ( std::endian::native == std::endian::little ) {
+        dw = __builtin_bswap32(dw);
+    }
+    return dw;
+}
+
+/***    CrcTables
+**
+**  Description:
+**      Slice by 8 tables for one polynomial, filled in at compile time.
+**      Reflected CRCs keep the register in the low bits.  The others
+**      keep it in the top bits of 32, so CRC-16/CCITT shares the
+**      32 bit update.
+*/
+template <unsigned Width, uint32_t Poly, bool Reflected>
+struct CrcTables {
+    using Table = std::array<std::array<uint32_t, 256>, 8>;
+
+    static constexpr Table Make() {
+        Table   rgrg{};
+
+        for ( uint32_t i = 0; i < 256; i++ ) {
+            uint32_t crc;
+            if constexpr ( Reflected ) {
+                crc = i;
+                for ( int ibit = 0; ibit < 8; ibit++ ) {
+                    crc = ( crc & 1 ) ? (crc >> 1) ^ Poly : crc >> 1;
+                }
+            } else {
+                crc = i << 24;
+                for ( int ibit = 0; ibit < 8; ibit++ ) {
+                    crc = ( crc & 0x80000000 ) ? (crc << 1) ^ (Poly << (32 - Width)) : crc << 1;
+                }
+            }
+            rgrg[0][i] = crc;
+        }
+        for ( size_t k = 1; k < 8; k++ ) {
+            for ( uint32_t i = 0; i < 256; i++ ) {
+                uint32_t crcPrev = rgrg[k - 1][i];
+                rgrg[k][i] = Reflected ? (crcPrev >> 8) ^ rgrg[0][crcPrev & 0xFF] :
+                                         (crcPrev << 8) ^ rgrg[0][crcPrev >> 24];
+            }
+        }
+        return rgrg;
+    }
+
+    static constexpr Table rgrgcrc = Make();
+
+    static uint32_t Update(uint32_t reg, const uint8_t *pb, size_t cb) {
+        const Table &t = rgrgcrc;
+
+        if constexpr ( Reflected ) {
+            for ( ; cb >= 8; pb += 8, cb -= 8 ) {
+                uint32_t dwLo = LoadLe32(pb) ^ reg;
+                uint32_t dwHi = LoadLe32(pb + 4);
+                reg = t[7][dwLo & 0xFF] ^ t[6][(dwLo >> 8) & 0xFF] ^ t[5][(dwLo >> 16) & 0xFF] ^
+                      t[4][dwLo >> 24] ^ t[3][dwHi & 0xFF] ^ t[2][(dwHi >> 8) & 0xFF] ^
+                      t[1][(dwHi >> 16) & 0xFF] ^ t[0][dwHi >> 24];
+            }
+            for ( ; cb > 0; pb++, cb-- ) {
+                reg = (reg >> 8) ^ t[0][(reg ^ *pb) & 0xFF];
+            }
+        } else {
+            for ( ; cb >= 8; pb += 8, cb -= 8 ) {
+                uint32_t dwHi = LoadBe32(pb) ^ reg;
+                uint32_t dwLo = LoadBe32(pb + 4);
+                reg = t[7][dwHi >> 24] ^ t[6][(dwHi >> 16) & 0xFF] ^ t[5][(dwHi >> 8) & 0xFF] ^
+                      t[4][dwHi & 0xFF] ^ t[3][dwLo >> 24] ^ t[2][(dwLo >> 16) & 0xFF] ^
+                      t[1][(dwLo >> 8) & 0xFF] ^ t[0][dwLo & 0xFF];
+            }
+            for ( ; cb > 0; pb++, cb-- ) {
+                reg = (reg << 8) ^ t[0][(reg >> 24) ^ *pb];
+            }
+        }
+        return reg;
+    }
+};
+
+}   // namespace detail
+
+/* ------------------------------------------------------------ */
+/*                  General Type Declarations                   */
+/* ------------------------------------------------------------ */
+
+/***    Baud
+**
+**  Description:
+**      Line rate.  Rates without a Bxxx constant are fine, the port is
+**      then opened through termios2 as SerialPortSetBaud() does.
+*/
+template <int Rate>
+struct Baud {
+    static_assert(Rate >= 50 && Rate <= 4000000, "baud rate out of range");
+
+    static constexpr int kRate = Rate;
+};
+
+/***    Line
+**
+**  Description:
+**      Character format, Parity is 'N', 'E' or 'O'.
+*/
+template <int DataBits, char Parity, int StopBits>
+struct Line {
+    static_assert(DataBits >= 5 && DataBits <= 8, "5 to 8 data bits");
+    static_assert(Parity == 'N' || Parity == 'E' || Parity == 'O', "parity is 'N', 'E' or 'O'");
+    static_assert(StopBits == 1 || StopBits == 2, "1 or 2 stop bits");
+
+    static constexpr int kDataBits = DataBits;
+    static constexpr char kParity = Parity;
+    static constexpr int kStopBits = StopBits;
+    static constexpr uint32_t kBitsPerChar = 1 + DataBits + (Parity != 'N') + StopBits;
+    static constexpr bool k8N1 = (DataBits == 8) && (Parity == 'N') && (StopBits == 1);
+};
+
+using Line8N1 = Line<8, 'N', 1>;
+using Line8E1 = Line<8, 'E', 1>;
+using Line7E1 = Line<7, 'E', 1>;
+
+/***    NoCrc, Crc16Ccitt, Crc16Modbus, Crc32
+**
+**  Description:
+**      Frame check sequences, computed and placed as SerialCrc() and
+**      SerialCrcPut() do for the matching SERIAL_CRC_TYPE.  Short frames
+**      use the compile time tables inline.  CRC-32 frames of kcbLibrary
+**      bytes or more go to SerialCrc() instead, whose CLMUL and ARMv8
+**      kernels are several times faster than any table once the call
+**      is paid for.
+*/
+struct NoCrc {
+    static constexpr SERIAL_CRC_TYPE kType = SERIAL_CRC_NONE;
+    static constexpr size_t kSize = 0;
+};
+
+template <SERIAL_CRC_TYPE Type, unsigned Width, uint32_t Poly, bool Reflected,
+          uint32_t Init, uint32_t XorOut, bool BigEndian>
+struct CrcPolicy {
+    static constexpr SERIAL_CRC_TYPE kType = Type;
+    static constexpr size_t kSize = Width / 8;
+
+    static constexpr size_t kcbLibrary = ( Type == SERIAL_CRC32 ) ? 64 : SIZE_MAX;
+
+    using Tables = detail::CrcTables<Width, Poly, Reflected>;
+
+    static uint32_t Compute(const uint8_t *pb, size_t cb) {
+        if ( cb >= kcbLibrary ) {
+            return SerialCrc(Type, pb, cb);
+        }
+        uint32_t reg = Tables::Update(Reflected ? Init : Init << (32 - Width), pb, cb);
+        if constexpr ( !Reflected ) {
+            reg >>= 32 - Width;
+        }
+        return reg ^ XorOut;
+    }
+
+    static void Put(uint32_t crc, uint8_t *pb) {
+        for ( size_t ib = 0; ib < kSize; ib++ ) {
+            pb[BigEndian ? kSize - 1 - ib : ib] = (uint8_t)(crc >> (8 * ib));
+        }
+    }
+
+    // cb includes the trailer
+    static bool Check(const uint8_t *pb, size_t cb) {
+        uint8_t rgbCrc[kSize];
+
+        if ( cb < kSize ) {
+            return false;
+        }
+        Put(Compute(pb, cb - kSize), rgbCrc);
+        return std::memcmp(rgbCrc, pb + cb - kSize, kSize) == 0;
+    }
+};
+
+using Crc16Ccitt = CrcPolicy<SERIAL_CRC16_CCITT, 16, 0x1021, false, 0xFFFF, 0, true>;
+using Crc16Modbus = CrcPolicy<SERIAL_CRC16_MODBUS, 16, 0xA001, true, 0xFFFF, 0, false>;
+using Crc32 = CrcPolicy<SERIAL_CRC32, 32, 0xEDB88320, true, 0xFFFFFFFF, 0xFFFFFFFF, false>;
+
+/***    Cobs, Slip, Delimited
+**
+**  Description:
+**      Framings.  Each knows the byte that ends a frame, how large a
+**      frame can get on the wire, and how to decode the bytes before
+**      that marker and encode a payload followed by its trailer.
+**      Decode() returns false for malformed and oversize frames.
+*/
+struct Cobs {
+    static constexpr SERIAL_FRAME_TYPE kType = SERIAL_FRAME_COBS;
+    static constexpr uint8_t kMark = 0;
+    static constexpr bool kBinary = true;
+
+    static constexpr size_t RawMax(size_t cbMax) { return cbMax + cbMax / 254 + 1; }
+    static constexpr size_t EncodedMax(size_t cb) { return cb + cb / 254 + 2; }
+
+    static bool Decode(const uint8_t *pbRaw, size_t cbRaw, uint8_t *pbOut, size_t cbOutMax,
+                       const uint8_t **ppbFrame, size_t *pcbFrame) {
+        const uint8_t   *pbEnd = pbRaw + cbRaw;
+        uint8_t         *pbo = pbOut;
+        uint8_t         *pboEnd = pbOut + cbOutMax;
+        size_t          cbRun;
+        uint8_t         bCode;
+
+        if ( cbRaw == 0 ) {
+            return false;
+        }
+        while ( pbRaw < pbEnd ) {
+            bCode = *pbRaw++;
+            cbRun = bCode - 1;
+            if ( (bCode == 0) || (cbRun > (size_t)(pbEnd - pbRaw)) || (cbRun > (size_t)(pboEnd - pbo)) ) {
+                return false;
+            }
+            std::memcpy(pbo, pbRaw, cbRun);
+            pbo += cbRun;
+            pbRaw += cbRun;
+            if ( (bCode != 0xFF) && (pbRaw < pbEnd) ) {
+                if ( pbo == pboEnd ) {
+                    return false;
+                }
+                *pbo++ = 0;
+            }
+        }
+        *ppbFrame = pbOut;
+        *pcbFrame = pbo - pbOut;
+        return true;
+    }
+
+    // copies the runs between zeros whole, the same bytes as SerialFrameEncode()
+    static size_t Encode(const uint8_t *pb, size_t cb, const uint8_t *pbTrail, size_t cbTrail,
+                         uint8_t *pbOut) {
+        const uint8_t   *rgpb[2] = { pb, pbTrail };
+        size_t          rgcb[2] = { cb, cbTrail };
+        uint8_t         *pbo = pbOut + 1;
+        uint8_t         *pbCode = pbOut;
+        size_t          cbRun = 0;
+        size_t          cbTake;
+        const uint8_t   *pbZero;
+
+        for ( int iseg = 0; iseg < 2; iseg++ ) {
+            const uint8_t *pbSeg = rgpb[iseg];
+            size_t cbSeg = rgcb[iseg];
+            while ( cbSeg > 0 ) {
+                cbTake = std::min(cbSeg, 254 - cbRun);
+                pbZero = (const uint8_t *)std::memchr(pbSeg, 0, cbTake);
+                if ( pbZero != nullptr ) {
+                    cbTake = pbZero - pbSeg;
+                }
+                std::memcpy(pbo, pbSeg, cbTake);
+                pbo += cbTake;
+                cbRun += cbTake;
+                pbSeg += cbTake;
+                cbSeg -= cbTake;
+                if ( (pbZero != nullptr) || (cbRun == 254) ) {
+                    *pbCode = (uint8_t)(cbRun + 1);
+                    pbCode = pbo++;
+                    cbRun = 0;
+                    if ( pbZero != nullptr ) {
+                        pbSeg++;
+                        cbSeg--;
+                    }
+                }
+            }
+        }
+        *pbCode = (uint8_t)(cbRun + 1);
+        *pbo++ = 0;
+        return pbo - pbOut;
+    }
+};
+
+struct Slip {
+    static constexpr SERIAL_FRAME_TYPE kType = SERIAL_FRAME_SLIP;
+    static constexpr uint8_t kMark = SERIAL_SLIP_END;
+    static constexpr bool kBinary = true;
+
+    static constexpr size_t RawMax(size_t cbMax) { return 2 * cbMax; }
+    static constexpr size_t EncodedMax(size_t cb) { return 2 * cb + 2; }
+
+    static bool Decode(const uint8_t *pbRaw, size_t cbRaw, uint8_t *pbOut, size_t cbOutMax,
+                       const uint8_t **ppbFrame, size_t *pcbFrame) {
+        const uint8_t   *pbEnd = pbRaw + cbRaw;
+        const uint8_t   *pbEsc;
+        uint8_t         *pbo = pbOut;
+        uint8_t         *pboEnd = pbOut + cbOutMax;
+        size_t          cbRun;
+
+        if ( cbRaw == 0 ) {
+            return false;
+        }
+        pbEsc = (const uint8_t *)std::memchr(pbRaw, SERIAL_SLIP_ESC, cbRaw);
+        if ( pbEsc == nullptr ) {
+            if ( cbRaw > cbOutMax ) {
+                return false;
+            }
+            *ppbFrame = pbRaw;
+            *pcbFrame = cbRaw;
+            return true;
+        }
+        while ( pbEsc != nullptr ) {
+            cbRun = pbEsc - pbRaw;
+            if ( (pbEsc + 1 >= pbEnd) || ((size_t)(pboEnd - pbo) < cbRun + 1) ) {
+                return false;
+            }
+            std::memcpy(pbo, pbRaw, cbRun);
+            pbo += cbRun;
+            if ( pbEsc[1] == SERIAL_SLIP_ESC_END ) {
+                *pbo++ = SERIAL_SLIP_END;
+            } else if ( pbEsc[1] == SERIAL_SLIP_ESC_ESC ) {
+                *pbo++ = SERIAL_SLIP_ESC;
+            } else {
+                return false;
+            }
+            pbRaw = pbEsc + 2;
+            pbEsc = (const uint8_t *)std::memchr(pbRaw, SERIAL_SLIP_ESC, pbEnd - pbRaw);
+        }
+        cbRun = pbEnd - pbRaw;
+        if ( (size_t)(pboEnd - pbo) < cbRun ) {
+            return false;
+        }
+        std::memcpy(pbo, pbRaw, cbRun);
+        pbo += cbRun;
+        *ppbFrame = pbOut;
+        *pcbFrame = pbo - pbOut;
+        return true;
+    }
+
+    static size_t Encode(const uint8_t *pb, size_t cb, const uint8_t *pbTrail, size_t cbTrail,
+                         uint8_t *pbOut) {
+        uint8_t *pbo = pbOut;
+
+        *pbo++ = SERIAL_SLIP_END;   // flush any line noise at the receiver
+        pbo = Escape(pbo, pb, cb);
+        pbo = Escape(pbo, pbTrail, cbTrail);
+        *pbo++ = SERIAL_SLIP_END;
+        return pbo - pbOut;
+    }
+
+private:
+    static uint8_t *Escape(uint8_t *pbo, const uint8_t *pb, size_t cb) {
+        for ( const uint8_t *pbEnd = pb + cb; pb < pbEnd; pb++ ) {
+            if ( *pb == SERIAL_SLIP_END ) {
+                *pbo++ = SERIAL_SLIP_ESC;
+                *pbo++ = SERIAL_SLIP_ESC_END;
+            } else if ( *pb == SERIAL_SLIP_ESC ) {
+                *pbo++ = SERIAL_SLIP_ESC;
+                *pbo++ = SERIAL_SLIP_ESC_ESC;
+            } else {
+                *pbo++ = *pb;
+            }
+        }
+        return pbo;
+    }
+};
+
+// frames end with Delimiter, delivered as their last byte with KeepDelimiter
+template <uint8_t Delimiter, bool KeepDelimiter = false>
+struct Delimited {
+    static constexpr SERIAL_FRAME_TYPE kType = SERIAL_FRAME_DELIMITER;
+    static constexpr uint8_t kMark = Delimiter;
+    static constexpr bool kBinary = false;
+    static constexpr bool kKeepDelimiter = KeepDelimiter;
+
+    static constexpr size_t RawMax(size_t cbMax) { return cbMax + 1; }
+    static constexpr size_t EncodedMax(size_t cb) { return cb + 1; }
+
+    static bool Decode(const uint8_t *pbRaw, size_t cbRaw, uint8_t *, size_t cbOutMax,
+                       const uint8_t **ppbFrame, size_t *pcbFrame) {
+        if ( cbRaw > cbOutMax ) {
+            return false;
+        }
+        *ppbFrame = pbRaw;
+        *pcbFrame = cbRaw;
+        return true;
+    }
+
+    static size_t Encode(const uint8_t *pb, size_t cb, const uint8_t *, size_t, uint8_t *pbOut) {
+        std::memcpy(pbOut, pb, cb);
+        pbOut[cb] = Delimiter;
+        return cb + 1;
+    }
+};
+
+/***    TimeoutMs, TimeoutFrames
+**
+**  Description:
+**      Default timeout of ProfilePort::read_frame().  TimeoutFrames is
+**      the wire time of that many frames of the largest size at the
+**      profile's rate and format, plus MsSlack for the adapter.
+*/
+template <uint32_t Ms>
+struct TimeoutMs {
+    static constexpr bool kFixed = true;
+
+    template <size_t CbWire, uint32_t BitsPerChar, int Rate>
+    static constexpr uint32_t Resolve() { return Ms; }
+};
+
+template <uint32_t CFrames, uint32_t MsSlack = 10>
+struct TimeoutFrames {
+    static_assert(CFrames > 0, "at least one frame");
+
+    static constexpr bool kFixed = false;
+
+    template <size_t CbWire, uint32_t BitsPerChar, int Rate>
+    static constexpr uint32_t Resolve() {
+        return (uint32_t)(((uint64_t)CFrames * CbWire * BitsPerChar * 1000 + Rate - 1) / Rate) + MsSlack;
+    }
+};
+
+/***    Profile
+**
+**  Description:
+**      Everything a port needs to know about its line, checked when the
+**      type is used.  CbMaxPayload is the largest payload, the CRC is
+**      on top of it.
+*/
+template <typename BaudT, typename LineT, typename FrameT, typename CrcT, typename TimeoutT,
+          size_t CbMaxPayload = 1024>
+struct Profile {
+    using BaudPolicy = BaudT;
+    using LinePolicy = LineT;
+    using FramePolicy = FrameT;
+    using CrcPolicy = CrcT;
+
+    static constexpr int kBaud = BaudT::kRate;
+    static constexpr size_t kcbMaxPayload = CbMaxPayload;
+    static constexpr size_t kcbMaxFrame = CbMaxPayload + CrcT::kSize;
+    static constexpr size_t kcbWireMax = FrameT::EncodedMax(kcbMaxFrame);
+    static constexpr uint32_t kBitsPerChar = LineT::kBitsPerChar;
+    static constexpr uint32_t kTimeoutMs =
+        TimeoutT::template Resolve<kcbWireMax, LineT::kBitsPerChar, BaudT::kRate>();
+
+    static_assert(CbMaxPayload > 0 && CbMaxPayload <= 65536, "payload of 1 byte to 64 KB");
+    static_assert(FrameT::kType != SERIAL_FRAME_DELIMITER || CrcT::kSize == 0,
+                  "a CRC trailer could contain the delimiter, use COBS or SLIP");
+    static_assert(!FrameT::kBinary || LineT::kDataBits == 8,
+                  "binary framing needs 8 data bits");
+    static_assert(FrameT::kBinary || FrameT::kMark < (1u << LineT::kDataBits),
+                  "the delimiter does not fit in a character of this line");
+    static_assert(!TimeoutT::kFixed || kTimeoutMs == 0 || kTimeoutMs == SERIAL_WAIT_FOREVER ||
+                  (uint64_t)kTimeoutMs * kBaud >= (uint64_t)kcbWireMax * kBitsPerChar * 1000,
+                  "the timeout is shorter than the largest frame takes at this baud rate");
+
+    // the same framing for SerialFramerCreate() and SerialFrameEncode()
+    static SERIAL_FRAME_CFG frame_cfg() {
+        SERIAL_FRAME_CFG    cfg{};
+
+        cfg.type = FrameT::kType;
+        cfg.cbMaxFrame = kcbMaxFrame;
+        cfg.crc = CrcT::kType;
+        if constexpr ( FrameT::kType == SERIAL_FRAME_DELIMITER ) {
+            cfg.bDelimiter = FrameT::kMark;
+            cfg.fKeepDelimiter = FrameT::kKeepDelimiter;
+        }
+        return cfg;
+    }
+};
+
+/* ------------------------------------------------------------ */
+/*                  Object Class Declarations                   */
+/* ------------------------------------------------------------ */
+
+/***    Framer
+**
+**  Description:
+**      SerialFramer for one profile, with the same push/next contract
+**      and the same counters.  Holds its buffers inline, so it is about
+**      three times the largest frame in size and never allocates.
+*/
+template <typename P>
+class Framer {
+public:
+    using FrameT = typename P::FramePolicy;
+    using CrcT = typename P::CrcPolicy;
+
+    void push(const uint8_t *pb, size_t cb) noexcept {
+        pbIn = pb;
+        cbIn = cb;
+    }
+
+    bool next(const uint8_t **ppbFrame, size_t *pcbFrame) noexcept;
+
+    void reset() noexcept {
+        pbIn = nullptr;
+        cbIn = 0;
+        cbAcc = 0;
+        fDiscard = false;
+    }
+
+    uint64_t dropped() const noexcept { return cDropped; }
+    uint64_t crc_errors() const noexcept { return cCrcErrors; }
+
+private:
+    bool NextRaw(const uint8_t **ppbFrame, size_t *pcbFrame) noexcept;
+
+    static constexpr size_t kcbAccMax = FrameT::RawMax(P::kcbMaxFrame);
+
+    const uint8_t                           *pbIn = nullptr;
+    size_t                                  cbIn = 0;
+    size_t                                  cbAcc = 0;
+    bool                                    fDiscard = false;
+    uint64_t                                cDropped = 0;
+    uint64_t                                cCrcErrors = 0;
+    std::array<uint8_t, kcbAccMax>          rgbAcc;
+    std::array<uint8_t, P::kcbMaxFrame>     rgbOut;
+};
+
+/***    ProfilePort
+**
+**  Description:
+**      Owns a SERIAL_PORT opened with the profile's rate and format and
+**      closes it on destruction.  Neither copied nor moved, it holds its
+**      buffers inline.  read_frame() and write_frame() follow
+**      SerialPortReadFrame() and SerialPortWrite(): they block, and
+**      report errors and timeouts in the return value.  The constructor
+**      throws std::system_error if the port cannot be opened or set up.
+*/
+template <typename P>
+class ProfilePort {
+public:
+    explicit ProfilePort(const char *szDevice) {
+        port = SerialPortOpen(szDevice, P::kBaud);
+        if ( port == nullptr ) {
+            throw std::system_error(( errno != 0 ) ? errno : ENODEV, std::generic_category(), "SerialPortOpen");
+        }
+        if constexpr ( !P::LinePolicy::k8N1 ) {
+            if ( !SerialPortSetFormat(port, P::LinePolicy::kDataBits, P::LinePolicy::kParity,
+                                      P::LinePolicy::kStopBits) ) {
+                int err = errno;
+                SerialPortClose(port);
+                throw std::system_error(err, std::generic_category(), "SerialPortSetFormat");
+            }
+        }
+    }
+    ProfilePort(const ProfilePort &) = delete;
+    ProfilePort &operator=(const ProfilePort &) = delete;
+    ~ProfilePort() { SerialPortClose(port); }
+
+    // the C handle, for SerialPortGetStats(), SerialPortRxStart() and such
+    SERIAL_PORT *native() const noexcept { return port; }
+    Framer<P> &framer() noexcept { return fr; }
+
+    int read_frame(const uint8_t **ppbFrame, uint32_t timeOutMs = P::kTimeoutMs);
+    int write_frame(const uint8_t *pb, size_t cb);
+
+private:
+    static constexpr size_t kcbRead = 4096;
+
+    SERIAL_PORT                             *port = nullptr;
+    Framer<P>                               fr;
+    std::array<uint8_t, kcbRead>            rgbRead;
+    std::array<uint8_t, P::kcbWireMax>      rgbWire;
+};
+
+/* ------------------------------------------------------------ */
+/*                  Procedure Definitions                       */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    Framer::next
+**
+**  Synopsis:
+**      bool next(const uint8_t **ppbFrame, size_t *pcbFrame)
+**
+**  Return Values:
+**      true            a complete frame was returned
+**      false           the pushed chunk is used up, push the next one
+**
+**  Description:
+**      As SerialFramerNext(): the frame points into the pushed chunk or
+**      the framer, without the framing or the CRC, and bad frames are
+**      skipped and counted.
+*/
+template <typename P>
+inline bool Framer<P>::next(const uint8_t **ppbFrame, size_t *pcbFrame) noexcept {
+
+    for (;;) {
+        if ( !NextRaw(ppbFrame, pcbFrame) ) {
+            return false;
+        }
+        if constexpr ( CrcT::kSize == 0 ) {
+            return true;
+        } else {
+            if ( CrcT::Check(*ppbFrame, *pcbFrame) ) {
+                *pcbFrame -= CrcT::kSize;
+                return true;
+            }
+            cCrcErrors++;
+            cDropped++;
+        }
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    Framer::NextRaw
+**
+**  Synopsis:
+**      bool NextRaw(const uint8_t **ppbFrame, size_t *pcbFrame)
+**
+**  Description:
+**      Finds the next marker, joins a frame split across chunks and
+**      decodes it, the CRC still on.
+*/
+template <typename P>
+inline bool Framer<P>::NextRaw(const uint8_t **ppbFrame, size_t *pcbFrame) noexcept {
+
+    const uint8_t   *pbMark;
+    const uint8_t   *pbRaw;
+    size_t          cbRaw;
+    size_t          cbTake;
+
+    while ( cbIn > 0 ) {
+        pbMark = (const uint8_t *)std::memchr(pbIn, FrameT::kMark, cbIn);
+
+        if ( pbMark == nullptr ) {
+            // the chunk ends mid-frame, keep the tail for the next push
+            if ( !fDiscard ) {
+                if ( cbAcc + cbIn > kcbAccMax ) {
+                    fDiscard = true;
+                    cbAcc = 0;
+                    cDropped++;
+                } else {
+                    std::memcpy(rgbAcc.data() + cbAcc, pbIn, cbIn);
+                    cbAcc += cbIn;
+                }
+            }
+            pbIn += cbIn;
+            cbIn = 0;
+            return false;
+        }
+
+        cbRaw = pbMark - pbIn;
+        cbTake = cbRaw;
+        if constexpr ( FrameT::kType == SERIAL_FRAME_DELIMITER ) {
+            cbTake += FrameT::kKeepDelimiter;
+        }
+
+        if ( fDiscard ) {
+            // end of the oversize frame, resume with the next one
+            fDiscard = false;
+            pbRaw = nullptr;
+        } else if ( cbAcc == 0 ) {
+            pbRaw = pbIn;
+        } else if ( cbAcc + cbTake > kcbAccMax ) {
+            cbAcc = 0;
+            cDropped++;
+            pbRaw = nullptr;
+        } else {
+            std::memcpy(rgbAcc.data() + cbAcc, pbIn, cbTake);
+            pbRaw = rgbAcc.data();
+            cbTake += cbAcc;
+            cbAcc = 0;
+        }
+
+        pbIn += cbRaw + 1;
+        cbIn -= cbRaw + 1;
+
+        if ( pbRaw != nullptr ) {
+            if ( FrameT::Decode(pbRaw, cbTake, rgbOut.data(), rgbOut.size(), ppbFrame, pcbFrame) ) {
+                return true;
+            }
+            // empty COBS and SLIP frames are line noise, not errors
+            if ( cbTake > 0 ) {
+                cDropped++;
+            }
+        }
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------ */
+/***    ProfilePort::read_frame
+**
+**  Synopsis:
+**      int read_frame(const uint8_t **ppbFrame, uint32_t timeOutMs)
+**
+**  Parameters:
+**      **ppbFrame      receives the frame
+**      timeOutMs       defaults to the profile's timeout, 0 to only use
+**                      data already received, SERIAL_WAIT_FOREVER
+**
+**  Return Values:
+**      length of the frame
+**      -1 (SERIAL_ERROR_CODE) on error, see errno
+**      -2 (SERIAL_TIMEOUT_CODE) if no complete frame arrived in time
+**
+**  Description:
+**      As SerialPortReadFrame().  With the RX thread running the bytes
+**      are copied out of its ring rather than decoded in place.
+*/
+template <typename P>
+inline int ProfilePort<P>::read_frame(const uint8_t **ppbFrame, uint32_t timeOutMs) {
+
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point   tpDeadline = Clock::now() + std::chrono::milliseconds(timeOutMs);
+    size_t              cbFrame;
+    uint32_t            msLeft;
+    int64_t             msRemain;
+    int                 rc;
+
+    for (;;) {
+        if ( fr.next(ppbFrame, &cbFrame) ) {
+            return (int)cbFrame;
+        }
+
+        if ( timeOutMs == SERIAL_WAIT_FOREVER ) {
+            msLeft = SERIAL_WAIT_FOREVER;
+        } else {
+            // round up, waking early would only spin until the deadline
+            msRemain = std::chrono::ceil<std::chrono::milliseconds>(tpDeadline - Clock::now()).count();
+            msLeft = ( msRemain <= 0 ) ? 0 : (uint32_t)msRemain;
+        }
+        rc = SerialPortReadEx(port, rgbRead.data(), (uint32_t)rgbRead.size(), 1, msLeft, 0);
+        if ( rc < 0 ) {
+            return rc;
+        }
+        fr.push(rgbRead.data(), (size_t)rc);
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    ProfilePort::write_frame
+**
+**  Synopsis:
+**      int write_frame(const uint8_t *pb, size_t cb)
+**
+**  Return Values:
+**      number of bytes written to the line, framing and CRC included
+**      -1 (SERIAL_ERROR_CODE) on error, EMSGSIZE for a payload above
+**      CbMaxPayload, otherwise see SerialPortWrite()
+**
+**  Description:
+**      Appends the CRC, encodes the frame in the port's buffer and
+**      writes it with a single SerialPortWrite().
+*/
+template <typename P>
+inline int ProfilePort<P>::write_frame(const uint8_t *pb, size_t cb) {
+
+    using CrcT = typename P::CrcPolicy;
+
+    uint8_t     rgbCrc[CrcT::kSize + 1];
+    size_t      cbWire;
+
+    if ( cb > P::kcbMaxPayload ) {
+        errno = EMSGSIZE;
+        return SERIAL_ERROR_CODE;
+    }
+    if constexpr ( CrcT::kSize > 0 ) {
+        CrcT::Put(CrcT::Compute(pb, cb), rgbCrc);
+    }
+    cbWire = P::FramePolicy::Encode(pb, cb, rgbCrc, CrcT::kSize, rgbWire.data());
+    return SerialPortWrite(port, rgbWire.data(), cbWire, 0);
+}
+
+}   // namespace ec
+
+#endif
+
+/**********************************  EOF  **************************************/
@@ -0,0 +1,1014 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_shm.c --  EmbedCreativity's shared memory fan-out broker         */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  One process owns the port and runs a broker.  The broker reads the  */
+/*  device straight into a ring in a POSIX shared memory segment, and   */
+/*  any number of processes attach to the segment and read the stream   */
+/*  in place, each at its own cursor.  Writes go the other way through  */
+/*  a queue in the same segment, which the broker drains to the port.   */
+/*                                                                      */
+/*  The segment holds a header page, one cache line per reader, the     */
+/*  receive ring and the transmit queue.  Both rings are mapped twice,  */
+/*  back to back, so anything up to a whole ring is contiguous and a    */
+/*  reader gets one pointer, never two pieces.                          */
+/*                                                                      */
+/*  The broker never waits for readers.  A reader that falls more than  */
+/*  a ring behind has lost data; it finds out on its next call, skips   */
+/*  to the newest byte and counts what it missed.  Because readers      */
+/*  look at the ring in place, the broker publishes how far it is       */
+/*  about to write (ibReserve) before each read(), and a reader checks  */
+/*  it after it is done with a span, as a seqlock reader would.         */
+/*                                                                      */
+/*  Sleeping readers and the broker's transmit thread are woken with    */
+/*  shared futexes.  The transmit queue is a byte ring of length        */
+/*  prefixed records under a robust process-shared mutex, so a writer   */
+/*  that dies holding it does not stop the others.                      */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*  10/16/2026 (agent): the broker feeds SerialPortCaptureStart()       */
+/*  10/16/2026 (agent): the broker waits out an unplugged device        */
+/*                                                                      */
+/************************************************************************/
+
+#define _GNU_SOURCE  /* FUTEX_WAIT_BITSET */
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "ec_serial.h"
+#include "ec_serial_priv.h"
+#include "ec_ring.h"    /* SERIAL_CACHE_LINE */
+#include "ec_shm.h"
+
+/* ------------------------------------------------------------ */
+/*              Local Type Definitions                          */
+/* ------------------------------------------------------------ */
+
+#define SHM_MAGIC       0x48534345      // "ECSH"
+#define SHM_VERSION     1
+#define CB_TX_LEN       sizeof(uint32_t)
+
+_Static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared counters must be lock free");
+
+// One per reader.  fInUse holds the owner's pid so that slots of
+// readers that died can be taken over.
+typedef struct {
+    _Alignas(SERIAL_CACHE_LINE) _Atomic uint32_t pidOwner;  // 0 when free
+    _Atomic uint64_t    ibCursor;       // next byte the reader will consume
+    _Atomic uint64_t    cLagEvents;
+    _Atomic uint64_t    cbLost;
+} SHM_SLOT;
+
+typedef struct {
+    // set once by the broker
+    uint32_t            magic;
+    uint32_t            version;
+    _Atomic uint32_t    fReady;         // the rest of the header is valid
+    _Atomic uint32_t    fClosed;        // the broker stopped or the device went away
+    int32_t             pidBroker;
+    uint32_t            cMaxReaders;
+    uint64_t            cbHdr;          // header and slots, page aligned
+    uint64_t            cbRing;
+    uint64_t            cbTx;
+
+    // receive ring, written by the broker only
+    _Alignas(SERIAL_CACHE_LINE) _Atomic uint64_t ibHead;    // bytes published
+    _Atomic uint64_t    ibReserve;      // bytes the broker may be writing up to
+    _Atomic uint32_t    seqRx;          // futex word, bumped per publish
+    _Atomic uint32_t    cRxWaiters;     // readers in or about to enter FUTEX_WAIT
+
+    // transmit queue, producers under mtxTx
+    _Alignas(SERIAL_CACHE_LINE) pthread_mutex_t mtxTx;
+    _Atomic uint64_t    ibTxHead;
+    _Atomic uint32_t    seqTx;          // futex word, bumped per queued write
+
+    // transmit queue, broker side
+    _Alignas(SERIAL_CACHE_LINE) _Atomic uint64_t ibTxTail;
+    _Atomic uint32_t    seqTxSpace;     // futex word, bumped as records are sent
+    _Atomic uint64_t    cbTxSent;
+
+    SHM_SLOT            rgslot[];
+} SHM_HDR;
+
+// A process's view of the segment.
+typedef struct {
+    uint8_t             *pbBase;
+    size_t              cbMap;
+    SHM_HDR             *phdr;
+    uint8_t             *pbRing;        // cbRing, mapped twice
+    uint8_t             *pbTx;          // cbTx, mapped twice
+    uint64_t            cbRingMask;
+    uint64_t            cbTxMask;
+} SHM_MAP;
+
+struct SERIAL_SHM_BROKER {
+    SERIAL_PORT         *port;
+    SHM_MAP             map;
+    size_t              cbChunk;        // most one read() may put in the ring
+    int                 evtStop;        // eventfd, stops the receive thread
+    _Atomic bool        fStop;          // stops the transmit thread
+    pthread_t           threadRx;
+    pthread_t           threadTx;
+    char                szName[NAME_MAX];
+};
+
+struct SERIAL_SHM_READER {
+    SHM_MAP             map;
+    SHM_SLOT            *pslot;
+    uint64_t            ibCursor;
+    uint64_t            cbLost;
+};
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static void     *BrokerRxThread( void *pv );
+static void     *BrokerTxThread( void *pv );
+static bool     BrokerAlive( const char *szName );
+static size_t   HdrSize( uint32_t cMaxReaders );
+static bool     MapSegment( int fd, uint64_t cbHdr, uint64_t cbRing, uint64_t cbTx,
+                            int protRing, SHM_MAP *pmap );
+static void     Resync( SERIAL_SHM_READER *prd );
+static bool     LockTx( SHM_HDR *phdr );
+static int      FutexWait( _Atomic uint32_t *pu, uint32_t uExpected, uint64_t nsDeadline );
+static void     FutexWake( _Atomic uint32_t *pu );
+static size_t   RoundPow2( size_t cb, size_t cbMin );
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    SerialShmBrokerCreate
+**
+**  Synopsis:
+**      SERIAL_SHM_BROKER *SerialShmBrokerCreate(SERIAL_PORT *port,
+**                                               const char *szName,
+**                                               const SERIAL_SHM_CFG *pcfg)
+**
+**  Parameters:
+**      *port           port to publish, nothing else may read it
+**      szName          shm_open() name of the segment, "/something"
+**      *pcfg           ring sizes and reader slots, NULL for defaults
+**
+**  Return Values:
+**      new broker, NULL on failure with errno set
+**
+**  Errors:
+**      EINVAL for a bad name, EBUSY if the RX thread or a reactor is
+**      reading the port, EEXIST if a live broker has the name, otherwise
+**      errno from shm_open(), mmap() or pthread_create()
+**
+**  Description:
+**      Creates the segment and starts two threads: one reads the port
+**      into the ring, the other writes queued data to the port.  A
+**      segment left behind by a broker that died is replaced.
+*/
+SERIAL_SHM_BROKER *SerialShmBrokerCreate(SERIAL_PORT *port, const char *szName,
+                                         const SERIAL_SHM_CFG *pcfg) {
+
+    SERIAL_SHM_BROKER   *pbr;
+    SERIAL_SHM_CFG      cfg;
+    SHM_HDR             *phdr;
+    pthread_mutexattr_t attr;
+    size_t              cbPage = (size_t)sysconf(_SC_PAGESIZE);
+    size_t              cbHdr;
+    uint32_t            islot;
+    int                 fd;
+    int                 err;
+
+    if ( (szName == NULL) || (szName[0] != '/') || (strlen(szName) >= NAME_MAX) ) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if ( (port->prx != NULL) || (port->pvReactor != NULL) ) {
+        errno = EBUSY;
+        return NULL;
+    }
+
+    memset(&cfg, 0, sizeof(cfg));
+    if ( pcfg != NULL ) {
+        cfg = *pcfg;
+    }
+    cfg.cbRing = RoundPow2(( cfg.cbRing != 0 ) ? cfg.cbRing : SERIAL_SHM_RING_DEFAULT, cbPage);
+    cfg.cbTxQueue = RoundPow2(( cfg.cbTxQueue != 0 ) ? cfg.cbTxQueue : SERIAL_SHM_TX_DEFAULT, cbPage);
+    if ( cfg.cMaxReaders == 0 ) {
+        cfg.cMaxReaders = SERIAL_SHM_READERS_DEFAULT;
+    }
+    if ( cfg.mode == 0 ) {
+        cfg.mode = 0600;
+    }
+    cbHdr = (HdrSize(cfg.cMaxReaders) + cbPage - 1) & ~(cbPage - 1);
+
+    fd = shm_open(szName, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, cfg.mode);
+    if ( (fd < 0) && (errno == EEXIST) && !BrokerAlive(szName) ) {
+        SERIAL_LOG(SERIAL_LOG_INFO, "SERIAL shm %s: replacing a dead broker's segment", szName);
+        shm_unlink(szName);
+        fd = shm_open(szName, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, cfg.mode);
+    }
+    if ( fd < 0 ) {
+        return NULL;
+    }
+
+    pbr = calloc(1, sizeof(*pbr));
+    if ( pbr == NULL ) {
+        goto lErrUnlink;
+    }
+    pbr->port = port;
+    pbr->evtStop = -1;
+    strcpy(pbr->szName, szName);
+
+    if ( (ftruncate(fd, cbHdr + cfg.cbRing + cfg.cbTxQueue) != 0) ||
+         !MapSegment(fd, cbHdr, cfg.cbRing, cfg.cbTxQueue, PROT_READ | PROT_WRITE, &pbr->map) ) {
+        goto lErrFree;
+    }
+    close(fd);
+    fd = -1;
+
+    // a fresh segment is zero filled, only the non-zero fields are set
+    phdr = pbr->map.phdr;
+    phdr->magic = SHM_MAGIC;
+    phdr->version = SHM_VERSION;
+    phdr->pidBroker = getpid();
+    phdr->cMaxReaders = cfg.cMaxReaders;
+    phdr->cbHdr = cbHdr;
+    phdr->cbRing = cfg.cbRing;
+    phdr->cbTx = cfg.cbTxQueue;
+    for ( islot = 0; islot < cfg.cMaxReaders; islot++ ) {
+        atomic_init(&phdr->rgslot[islot].pidOwner, 0);
+    }
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    err = pthread_mutex_init(&phdr->mtxTx, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if ( err != 0 ) {
+        errno = err;
+        goto lErrUnmap;
+    }
+
+    // a quarter ring per read leaves readers room to be a little behind
+    pbr->cbChunk = cfg.cbRing / 4;
+    pbr->evtStop = eventfd(0, EFD_CLOEXEC);
+    if ( pbr->evtStop < 0 ) {
+        goto lErrMutex;
+    }
+    atomic_store_explicit(&phdr->fReady, 1, memory_order_release);
+
+    err = pthread_create(&pbr->threadRx, NULL, BrokerRxThread, pbr);
+    if ( err != 0 ) {
+        errno = err;
+        goto lErrEvt;
+    }
+    err = pthread_create(&pbr->threadTx, NULL, BrokerTxThread, pbr);
+    if ( err != 0 ) {
+        (void)write(pbr->evtStop, &(uint64_t){ 1 }, sizeof(uint64_t));
+        pthread_join(pbr->threadRx, NULL);
+        errno = err;
+        goto lErrEvt;
+    }
+
+    SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL %s: broker %s, %zu byte ring, %u readers",
+               port->szDevice, szName, cfg.cbRing, cfg.cMaxReaders);
+    return pbr;
+
+lErrEvt:
+    err = errno;
+    close(pbr->evtStop);
+    errno = err;
+lErrMutex:
+    pthread_mutex_destroy(&phdr->mtxTx);
+lErrUnmap:
+    err = errno;
+    munmap(pbr->map.pbBase, pbr->map.cbMap);
+    errno = err;
+lErrFree:
+    err = errno;
+    free(pbr);
+    errno = err;
+lErrUnlink:
+    err = errno;
+    if ( fd >= 0 ) {
+        close(fd);
+    }
+    shm_unlink(szName);
+    errno = err;
+    return NULL;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialShmBrokerDestroy
+**
+**  Synopsis:
+**      void SerialShmBrokerDestroy(SERIAL_SHM_BROKER *pbr)
+**
+**  Description:
+**      Sends what is still queued, stops both threads and removes the
+**      segment's name.  Attached readers keep their mapping; they can
+**      drain what is left and then get EPIPE.
+*/
+void SerialShmBrokerDestroy(SERIAL_SHM_BROKER *pbr) {
+
+    SHM_HDR     *phdr = pbr->map.phdr;
+    uint64_t    one = 1;
+
+    while ( (write(pbr->evtStop, &one, sizeof(one)) < 0) && (errno == EINTR) ) {
+    }
+    pthread_join(pbr->threadRx, NULL);
+
+    atomic_store(&pbr->fStop, true);
+    atomic_fetch_add(&phdr->seqTx, 1);
+    FutexWake(&phdr->seqTx);
+    pthread_join(pbr->threadTx, NULL);
+
+    atomic_store(&phdr->fClosed, 1);
+    atomic_fetch_add(&phdr->seqRx, 1);
+    FutexWake(&phdr->seqRx);
+    atomic_fetch_add(&phdr->seqTxSpace, 1);
+    FutexWake(&phdr->seqTxSpace);
+
+    shm_unlink(pbr->szName);
+    close(pbr->evtStop);
+    munmap(pbr->map.pbBase, pbr->map.cbMap);
+    free(pbr);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialShmBrokerGetStats
+**
+**  Synopsis:
+**      void SerialShmBrokerGetStats(SERIAL_SHM_BROKER *pbr,
+**                                   SERIAL_SHM_STATS *pstats)
+**
+**  Description:
+**      Lag is measured against each reader's last consumed byte, so a
+**      reader that is busy with a large span shows that span as lag.
+*/
+void SerialShmBrokerGetStats(SERIAL_SHM_BROKER *pbr, SERIAL_SHM_STATS *pstats) {
+
+    SHM_HDR     *phdr = pbr->map.phdr;
+    SHM_SLOT    *pslot;
+    uint64_t    ibHead;
+    uint64_t    cbLag;
+    uint32_t    islot;
+
+    memset(pstats, 0, sizeof(*pstats));
+    ibHead = atomic_load_explicit(&phdr->ibHead, memory_order_relaxed);
+    pstats->cbPublished = ibHead;
+    pstats->cbTxSent = atomic_load_explicit(&phdr->cbTxSent, memory_order_relaxed);
+
+    for ( islot = 0; islot < phdr->cMaxReaders; islot++ ) {
+        pslot = &phdr->rgslot[islot];
+        pstats->cLagEvents += atomic_load_explicit(&pslot->cLagEvents, memory_order_relaxed);
+        pstats->cbLost += atomic_load_explicit(&pslot->cbLost, memory_order_relaxed);
+        if ( atomic_load_explicit(&pslot->pidOwner, memory_order_relaxed) == 0 ) {
+            continue;
+        }
+        pstats->cReaders++;
+        cbLag = ibHead - atomic_load_explicit(&pslot->ibCursor, memory_order_relaxed);
+        if ( (cbLag <= ibHead) && (cbLag > pstats->cbMaxLag) ) {
+            pstats->cbMaxLag = cbLag;
+        }
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialShmOpen
+**
+**  Synopsis:
+**      SERIAL_SHM_READER *SerialShmOpen(const char *szName)
+**
+**  Parameters:
+**      szName          name the broker was created with
+**
+**  Return Values:
+**      new reader, NULL on failure with errno set
+**
+**  Errors:
+**      ENOENT if there is no broker, EPROTO for a segment this library
+**      did not make, EAGAIN if the broker is still starting, EUSERS if
+**      every reader slot is taken, otherwise errno from shm_open() or
+**      mmap()
+**
+**  Description:
+**      The reader starts at the newest byte; earlier data is not
+**      replayed.  Slots of readers whose process has exited are reused.
+**      Readers are not thread safe, open one per thread.
+*/
+SERIAL_SHM_READER *SerialShmOpen(const char *szName) {
+
+    SERIAL_SHM_READER   *prd;
+    SHM_HDR             *phdr;
+    SHM_HDR             hdr;
+    uint32_t            pidSelf = (uint32_t)getpid();
+    uint32_t            pidOwner;
+    uint32_t            islot;
+    int                 fd;
+    int                 err;
+
+    fd = shm_open(szName, O_RDWR | O_CLOEXEC, 0);
+    if ( fd < 0 ) {
+        return NULL;
+    }
+    if ( pread(fd, &hdr, offsetof(SHM_HDR, ibHead), 0) != (ssize_t)offsetof(SHM_HDR, ibHead) ) {
+        close(fd);
+        errno = EAGAIN;
+        return NULL;
+    }
+    if ( (hdr.magic != SHM_MAGIC) || (hdr.version != SHM_VERSION) ) {
+        close(fd);
+        errno = ( hdr.magic == 0 ) ? EAGAIN : EPROTO;
+        return NULL;
+    }
+
+    prd = calloc(1, sizeof(*prd));
+    if ( prd == NULL ) {
+        close(fd);
+        return NULL;
+    }
+    if ( !MapSegment(fd, hdr.cbHdr, hdr.cbRing, hdr.cbTx, PROT_READ, &prd->map) ) {
+        err = errno;
+        close(fd);
+        free(prd);
+        errno = err;
+        return NULL;
+    }
+    close(fd);
+
+    phdr = prd->map.phdr;
+    if ( !atomic_load_explicit(&phdr->fReady, memory_order_acquire) ) {
+        SerialShmClose(prd);
+        errno = EAGAIN;
+        return NULL;
+    }
+
+    for ( islot = 0; islot < phdr->cMaxReaders; islot++ ) {
+        pidOwner = 0;
+        if ( atomic_compare_exchange_strong(&phdr->rgslot[islot].pidOwner, &pidOwner, pidSelf) ) {
+            break;
+        }
+    }
+    if ( islot == phdr->cMaxReaders ) {
+        // take over the slot of a reader that exited without closing
+        for ( islot = 0; islot < phdr->cMaxReaders; islot++ ) {
+            pidOwner = atomic_load(&phdr->rgslot[islot].pidOwner);
+            if ( (pidOwner != 0) && (kill((pid_t)pidOwner, 0) != 0) && (errno == ESRCH) &&
+                 atomic_compare_exchange_strong(&phdr->rgslot[islot].pidOwner, &pidOwner, pidSelf) ) {
+                break;
+            }
+        }
+    }
+    if ( islot == phdr->cMaxReaders ) {
+        SerialShmClose(prd);
+        errno = EUSERS;
+        return NULL;
+    }
+
+    prd->pslot = &phdr->rgslot[islot];
+    prd->ibCursor = atomic_load_explicit(&phdr->ibHead, memory_order_acquire);
+    atomic_store_explicit(&prd->pslot->ibCursor, prd->ibCursor, memory_order_relaxed);
+    return prd;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialShmClose
+**
+**  Synopsis:
+**      void SerialShmClose(SERIAL_SHM_READER *prd)
+**
+**  Description:
+**      Gives the reader's slot back and unmaps the segment.  Pointers
+**      returned by SerialShmPeek() are invalid afterwards.
+*/
+void SerialShmClose(SERIAL_SHM_READER *prd) {
+
+    if ( prd->pslot != NULL ) {
+        atomic_store(&prd->pslot->pidOwner, 0);
+    }
+    munmap(prd->map.pbBase, prd->map.cbMap);
+    free(prd);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialShmPeek
+**
+**  Synopsis:
+**      int SerialShmPeek(SERIAL_SHM_READER *prd, const uint8_t **ppb,
+**                        uint32_t timeOutMs)
+**
+**  Parameters:
+**      *prd            reader returned by SerialShmOpen()
+**      **ppb           receives a pointer to the unread data, in place
+**      timeOutMs       how long to wait for data, 0 returns at once and
+**                      SERIAL_WAIT_FOREVER never expires
+**
+**  Return Values:
+**      number of contiguous bytes at *ppb, at most a whole ring
+**      -1 (SERIAL_ERROR_CODE) on error
+**      -2 (SERIAL_TIMEOUT_CODE) if nothing arrived in time
+**
+**  Errors:
+**      EOVERFLOW if the reader fell a ring behind; it has been moved to
+**      the newest byte and the next call continues from there.  EPIPE
+**      once the broker has gone and everything has been read.
+**
+**  Description:
+**      The data stays where the broker put it and nothing is copied.
+**      Pass what was used to SerialShmConsume(), which also says whether
+**      the broker overwrote any of it in the meantime.
+*/
+int SerialShmPeek(SERIAL_SHM_READER *prd, const uint8_t **ppb, uint32_t timeOutMs) {
+
+    SHM_HDR     *phdr = prd->map.phdr;
+    uint64_t    nsDeadline = 0;
+    uint64_t    ibHead;
+    uint32_t    seq;
+
+    for (;;) {
+        seq = atomic_load_explicit(&phdr->seqRx, memory_order_acquire);
+        ibHead = atomic_load_explicit(&phdr->ibHead, memory_order_acquire);
+        if ( ibHead - prd->ibCursor > phdr->cbRing ) {
+            Resync(prd);
+            errno = EOVERFLOW;
+            return SERIAL_ERROR_CODE;
+        }
+        if ( ibHead != prd->ibCursor ) {
+            *ppb = prd->map.pbRing + (prd->ibCursor & prd->map.cbRingMask);
+            return (int)(( ibHead - prd->ibCursor > INT_MAX ) ? INT_MAX : ibHead - prd->ibCursor);
+        }
+        if ( atomic_load(&phdr->fClosed) ) {
+            errno = EPIPE;
+            return SERIAL_ERROR_CODE;
+        }
+
+        if ( nsDeadline == 0 ) {
+            if ( timeOutMs == 0 ) {
+                return SERIAL_TIMEOUT_CODE;
+            }
+            nsDeadline = DeadlineFromMs(timeOutMs);
+        } else if ( MonoNowNs() >= nsDeadline ) {
+            return SERIAL_TIMEOUT_CODE;
+        }
+
+        // the broker checks cRxWaiters after publishing, see BrokerRxThread()
+        atomic_fetch_add(&phdr->cRxWaiters, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if ( atomic_load(&phdr->ibHead) == prd->ibCursor ) {
+            FutexWait(&phdr->seqRx, seq, nsDeadline);
+        }
+        atomic_fetch_sub(&phdr->cRxWaiters, 1);
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialShmConsume
+**
+**  Synopsis:
+**      bool SerialShmConsume(SERIAL_SHM_READER *prd, size_t cb)
+**
+**  Parameters:
+**      *prd            reader returned by SerialShmOpen()
+**      cb              bytes used from the last SerialShmPeek()
+**
+**  Return Values:
+**      1               the bytes were intact while they were read
+**      0               the broker overwrote them, discard what was read
+**
+**  Errors:
+**      EOVERFLOW with 0; the reader has been moved to the newest byte
+*/
+bool SerialShmConsume(SERIAL_SHM_READER *prd, size_t cb) {
+
+    SHM_HDR     *phdr = prd->map.phdr;
+
+    // order the caller's reads of the data before the reserve check
+    atomic_thread_fence(memory_order_acquire);
+    if ( atomic_load_explicit(&phdr->ibReserve, memory_order_relaxed) - prd->ibCursor > phdr->cbRing ) {
+        Resync(prd);
+        errno = EOVERFLOW;
+        return false;
+    }
+
+    prd->ibCursor += cb;
+    atomic_store_explicit(&prd->pslot->ibCursor, prd->ibCursor, memory_order_relaxed);
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialShmWrite
+**
+**  Synopsis:
+**      int SerialShmWrite(SERIAL_SHM_READER *prd, const uint8_t *pb,
+**                         size_t cb, uint32_t timeOutMs)
+**
+**  Parameters:
+**      *prd            reader returned by SerialShmOpen()
+**      *pb             data to send
+**      cb              its length, at most the queue size less 4
+**      timeOutMs       how long to wait for room in the queue
+**
+**  Return Values:
+**      cb once queued, SERIAL_ERROR_CODE or SERIAL_TIMEOUT_CODE
+**
+**  Errors:
+**      EMSGSIZE if cb can never fit, EPIPE if the broker has gone,
+**      otherwise errno from pthread_mutex_lock()
+**
+**  Description:
+**      Each write reaches the port in one piece, never interleaved with
+**      another process's.  Returns once the data is queued; the broker
+**      writes it to the port in the order it was queued.
+*/
+int SerialShmWrite(SERIAL_SHM_READER *prd, const uint8_t *pb, size_t cb, uint32_t timeOutMs) {
+
+    SHM_HDR     *phdr = prd->map.phdr;
+    uint64_t    nsDeadline = DeadlineFromMs(timeOutMs);
+    uint64_t    ibHead;
+    uint64_t    ibTail;
+    uint32_t    cbRecord = (uint32_t)cb;
+    uint32_t    seq;
+
+    if ( (cb == 0) || (cb > INT_MAX) ) {
+        return 0;
+    }
+    if ( cb + CB_TX_LEN > phdr->cbTx ) {
+        errno = EMSGSIZE;
+        return SERIAL_ERROR_CODE;
+    }
+
+    if ( !LockTx(phdr) ) {
+        return SERIAL_ERROR_CODE;
+    }
+    for (;;) {
+        if ( atomic_load(&phdr->fClosed) ) {
+            pthread_mutex_unlock(&phdr->mtxTx);
+            errno = EPIPE;
+            return SERIAL_ERROR_CODE;
+        }
+        seq = atomic_load_explicit(&phdr->seqTxSpace, memory_order_acquire);
+        ibHead = atomic_load_explicit(&phdr->ibTxHead, memory_order_relaxed);
+        ibTail = atomic_load_explicit(&phdr->ibTxTail, memory_order_acquire);
+        if ( phdr->cbTx - (ibHead - ibTail) >= cb + CB_TX_LEN ) {
+            break;
+        }
+
+        pthread_mutex_unlock(&phdr->mtxTx);
+        if ( MonoNowNs() >= nsDeadline ) {
+            return SERIAL_TIMEOUT_CODE;
+        }
+        FutexWait(&phdr->seqTxSpace, seq, nsDeadline);
+        if ( !LockTx(phdr) ) {
+            return SERIAL_ERROR_CODE;
+        }
+    }
+
+    // the queue is mapped twice, neither copy has to wrap
+    memcpy(prd->map.pbTx + (ibHead & prd->map.cbTxMask), &cbRecord, CB_TX_LEN);
+    memcpy(prd->map.pbTx + ((ibHead + CB_TX_LEN) & prd->map.cbTxMask), pb, cb);
+    atomic_store_explicit(&phdr->ibTxHead, ibHead + CB_TX_LEN + cb, memory_order_release);
+    pthread_mutex_unlock(&phdr->mtxTx);
+
+    atomic_fetch_add_explicit(&phdr->seqTx, 1, memory_order_release);
+    FutexWake(&phdr->seqTx);
+    return (int)cb;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialShmLost
+**
+**  Synopsis:
+**      uint64_t SerialShmLost(SERIAL_SHM_READER *prd)
+**
+**  Return Values:
+**      bytes this reader skipped because it fell behind
+*/
+uint64_t SerialShmLost(SERIAL_SHM_READER *prd) {
+
+    return prd->cbLost;
+}
+
+/* ------------------------------------------------------------ */
+/***    BrokerRxThread
+**
+**  Synopsis:
+**      void *BrokerRxThread(void *pv)
+**
+**  Description:
+**      Sleeps until the device or the stop eventfd is readable, then
+**      reads straight into the ring at the head.  Before the read it
+**      moves ibReserve past the bytes the read may overwrite, so a
+**      reader still looking at them can tell; after it, the head is
+**      published and sleeping readers are woken, if there are any.
+*/
+static void *BrokerRxThread(void *pv) {
+
+    SERIAL_SHM_BROKER   *pbr = pv;
+    SERIAL_PORT         *port = pbr->port;
+    SHM_HDR             *phdr = pbr->map.phdr;
+    struct pollfd       rgpfd[2];
+    uint64_t            ibHead = 0;
+    ssize_t             cbRead;
+    int                 rc;
+
+    rgpfd[0].fd = port->fd;
+    rgpfd[0].events = POLLIN;
+    rgpfd[1].fd = pbr->evtStop;
+    rgpfd[1].events = POLLIN;
+
+    for (;;) {
+        STAT_ADD_SHARED(port->stats.cPollCalls, 1);
+        rc = poll(rgpfd, 2, -1);
+        if ( rc < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            STAT_ADD_SHARED(port->stats.cErrors, 1);
+            break;
+        }
+        if ( rgpfd[1].revents ) {
+            return NULL;
+        }
+
+        atomic_store_explicit(&phdr->ibReserve, ibHead + pbr->cbChunk, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        STAT_ADD_SHARED(port->stats.cReadCalls, 1);
+        cbRead = read(port->fd, pbr->map.pbRing + (ibHead & pbr->map.cbRingMask), pbr->cbChunk);
+        if ( cbRead < 0 ) {
+            atomic_store_explicit(&phdr->ibReserve, ibHead, memory_order_relaxed);
+            if ( (errno == EINTR) || (errno == EAGAIN) ) {
+                if ( errno == EAGAIN ) {
+                    STAT_ADD_SHARED(port->stats.cEagain, 1);
+                }
+                continue;
+            }
+            STAT_ADD_SHARED(port->stats.cErrors, 1);
+            SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL broker read error %d %s", errno, strerror(errno));
+        } else if ( cbRead == 0 ) {
+            atomic_store_explicit(&phdr->ibReserve, ibHead, memory_order_relaxed);
+            if ( !(rgpfd[0].revents & (POLLHUP | POLLERR)) ) {
+                continue;
+            }
+        }
+        if ( cbRead <= 0 ) {
+            // readers keep their cursors while SerialPortSetReconnect() brings the device back
+            if ( port->photplug == NULL ) {
+                break;
+            }
+            if ( HotplugLost(port) && !HotplugWaitUp(port, pbr->evtStop) ) {
+                return NULL;
+            }
+            continue;
+        }
+
+        STAT_ADD_SHARED(port->stats.cbRead, cbRead);
+        CAPTURE_DATA(port, SERIAL_CAPTURE_RX, pbr->map.pbRing + (ibHead & pbr->map.cbRingMask), cbRead);
+        ibHead += cbRead;
+        atomic_store_explicit(&phdr->ibHead, ibHead, memory_order_release);
+        atomic_store_explicit(&phdr->ibReserve, ibHead, memory_order_relaxed);
+        atomic_fetch_add_explicit(&phdr->seqRx, 1, memory_order_release);
+        atomic_thread_fence(memory_order_seq_cst);
+        if ( atomic_load_explicit(&phdr->cRxWaiters, memory_order_relaxed) != 0 ) {
+            FutexWake(&phdr->seqRx);
+        }
+    }
+
+    // the device went away, readers drain the ring and then see EPIPE
+    SERIAL_LOG(SERIAL_LOG_WARN, "SERIAL %s: broker lost the device", port->szDevice);
+    atomic_store(&phdr->fClosed, 1);
+    atomic_fetch_add(&phdr->seqRx, 1);
+    FutexWake(&phdr->seqRx);
+    return NULL;
+}
+
+/* ------------------------------------------------------------ */
+/***    BrokerTxThread
+**
+**  Synopsis:
+**      void *BrokerTxThread(void *pv)
+**
+**  Description:
+**      Writes queued records to the port straight out of the segment,
+**      oldest first, and wakes writers waiting for room.  Exits once
+**      asked to and the queue is empty.
+*/
+static void *BrokerTxThread(void *pv) {
+
+    SERIAL_SHM_BROKER   *pbr = pv;
+    SHM_HDR             *phdr = pbr->map.phdr;
+    uint64_t            ibTail;
+    uint64_t            ibHead;
+    uint32_t            cbRecord;
+    uint32_t            seq;
+
+    for (;;) {
+        seq = atomic_load_explicit(&phdr->seqTx, memory_order_acquire);
+        ibTail = atomic_load_explicit(&phdr->ibTxTail, memory_order_relaxed);
+        ibHead = atomic_load_explicit(&phdr->ibTxHead, memory_order_acquire);
+        if ( ibTail == ibHead ) {
+            if ( atomic_load(&pbr->fStop) ) {
+                return NULL;
+            }
+            FutexWait(&phdr->seqTx, seq, UINT64_MAX);
+            continue;
+        }
+
+        memcpy(&cbRecord, pbr->map.pbTx + (ibTail & pbr->map.cbTxMask), CB_TX_LEN);
+        if ( SerialPortWrite(pbr->port, pbr->map.pbTx + ((ibTail + CB_TX_LEN) & pbr->map.cbTxMask),
+                             cbRecord, 0) != (int)cbRecord ) {
+            SERIAL_LOG(SERIAL_LOG_WARN, "SERIAL %s: broker dropped a %u byte write, %s",
+                       pbr->port->szDevice, cbRecord, strerror(errno));
+        }
+
+        atomic_store_explicit(&phdr->ibTxTail, ibTail + CB_TX_LEN + cbRecord, memory_order_release);
+        atomic_fetch_add_explicit(&phdr->cbTxSent, cbRecord, memory_order_relaxed);
+        atomic_fetch_add_explicit(&phdr->seqTxSpace, 1, memory_order_release);
+        FutexWake(&phdr->seqTxSpace);
+    }
+}
+
+/* True if the segment szName belongs to a broker that is still running. */
+static bool BrokerAlive(const char *szName) {
+
+    SHM_HDR     hdr;
+    ssize_t     cb;
+    int         fd;
+
+    fd = shm_open(szName, O_RDONLY | O_CLOEXEC, 0);
+    if ( fd < 0 ) {
+        return false;
+    }
+    cb = pread(fd, &hdr, offsetof(SHM_HDR, ibHead), 0);
+    close(fd);
+    if ( (cb != (ssize_t)offsetof(SHM_HDR, ibHead)) || (hdr.magic != SHM_MAGIC) ) {
+        // not ours, or a broker still setting it up; leave it alone
+        return cb != 0;
+    }
+    return (kill(hdr.pidBroker, 0) == 0) || (errno == EPERM);
+}
+
+/* Bytes of header and reader slots, before page rounding. */
+static size_t HdrSize(uint32_t cMaxReaders) {
+
+    return sizeof(SHM_HDR) + (size_t)cMaxReaders * sizeof(SHM_SLOT);
+}
+
+/* ------------------------------------------------------------ */
+/***    MapSegment
+**
+**  Synopsis:
+**      static bool MapSegment(int fd, uint64_t cbHdr, uint64_t cbRing,
+**                             uint64_t cbTx, int protRing, SHM_MAP *pmap)
+**
+**  Parameters:
+**      fd              the segment
+**      cbHdr           header size, page aligned
+**      cbRing, cbTx    ring sizes, powers of two and page aligned
+**      protRing        protection of the receive ring, readers only read
+**      *pmap           receives the mapping
+**
+**  Description:
+**      Reserves one range of address space and maps the header, then
+**      each ring twice in a row over it.
+*/
+static bool MapSegment(int fd, uint64_t cbHdr, uint64_t cbRing, uint64_t cbTx,
+                       int protRing, SHM_MAP *pmap) {
+
+    uint8_t     *pb;
+    int         err;
+
+    pmap->cbMap = cbHdr + 2 * cbRing + 2 * cbTx;
+    pmap->pbBase = mmap(NULL, pmap->cbMap, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ( pmap->pbBase == MAP_FAILED ) {
+        return false;
+    }
+
+    pb = pmap->pbBase;
+    if ( (mmap(pb, cbHdr, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) ||
+         (mmap(pb + cbHdr, cbRing, protRing, MAP_SHARED | MAP_FIXED, fd, cbHdr) == MAP_FAILED) ||
+         (mmap(pb + cbHdr + cbRing, cbRing, protRing, MAP_SHARED | MAP_FIXED, fd, cbHdr) == MAP_FAILED) ||
+         (mmap(pb + cbHdr + 2 * cbRing, cbTx, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+               fd, cbHdr + cbRing) == MAP_FAILED) ||
+         (mmap(pb + cbHdr + 2 * cbRing + cbTx, cbTx, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+               fd, cbHdr + cbRing) == MAP_FAILED) ) {
+        err = errno;
+        munmap(pmap->pbBase, pmap->cbMap);
+        errno = err;
+        return false;
+    }
+
+    pmap->phdr = (SHM_HDR *)pb;
+    pmap->pbRing = pb + cbHdr;
+    pmap->pbTx = pb + cbHdr + 2 * cbRing;
+    pmap->cbRingMask = cbRing - 1;
+    pmap->cbTxMask = cbTx - 1;
+    return true;
+}
+
+/* Moves a reader that fell behind to the newest byte and counts the loss. */
+static void Resync(SERIAL_SHM_READER *prd) {
+
+    uint64_t    ibHead = atomic_load_explicit(&prd->map.phdr->ibHead, memory_order_acquire);
+
+    prd->cbLost += ibHead - prd->ibCursor;
+    atomic_fetch_add_explicit(&prd->pslot->cbLost, ibHead - prd->ibCursor, memory_order_relaxed);
+    atomic_fetch_add_explicit(&prd->pslot->cLagEvents, 1, memory_order_relaxed);
+    SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL shm reader %d lost %llu bytes", (int)getpid(),
+               (unsigned long long)(ibHead - prd->ibCursor));
+    prd->ibCursor = ibHead;
+    atomic_store_explicit(&prd->pslot->ibCursor, ibHead, memory_order_relaxed);
+}
+
+/* Takes the transmit queue lock, recovering it from a writer that died. */
+static bool LockTx(SHM_HDR *phdr) {
+
+    int     err;
+
+    err = pthread_mutex_lock(&phdr->mtxTx);
+    if ( err == EOWNERDEAD ) {
+        // the head is only moved after a whole record is in, nothing to undo
+        err = pthread_mutex_consistent(&phdr->mtxTx);
+    }
+    if ( err != 0 ) {
+        errno = err;
+        return false;
+    }
+    return true;
+}
+
+/* Sleeps while *pu == uExpected, until an absolute CLOCK_MONOTONIC deadline. */
+static int FutexWait(_Atomic uint32_t *pu, uint32_t uExpected, uint64_t nsDeadline) {
+
+    struct timespec ts;
+
+    ts.tv_sec = nsDeadline / 1000000000;
+    ts.tv_nsec = nsDeadline % 1000000000;
+    return (int)syscall(SYS_futex, pu, FUTEX_WAIT_BITSET, uExpected,
+                        ( nsDeadline == UINT64_MAX ) ? NULL : &ts, NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
+/* Wakes everyone sleeping on *pu, in any process. */
+static void FutexWake(_Atomic uint32_t *pu) {
+
+    syscall(SYS_futex, pu, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/* cb rounded up to a power of two no smaller than cbMin. */
+static size_t RoundPow2(size_t cb, size_t cbMin) {
+
+    size_t  cbRound = cbMin;
+
+    while ( cbRound < cb ) {
+        cbRound <<= 1;
+    }
+    return cbRound;
+}
+
+
+/************************************ EOF ********************************/
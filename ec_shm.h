@@ -0,0 +1,111 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_shm.h --  EmbedCreativity's Serial shared memory broker header   */
+/*                                                                      */
+/************************************************************************/
+/*  Author:     agent                                                   */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*  This header file contains declarations the functions contained in   */
+/*  ec_shm.c                                                            */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026(agent): created                                          */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(_SERIALSHM_H)
+#define _SERIALSHM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "ec_serial.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------------ */
+/*                  Definitions                                 */
+/* ------------------------------------------------------------ */
+
+#define SERIAL_SHM_RING_DEFAULT     (1 << 20)   // received data kept for readers
+#define SERIAL_SHM_TX_DEFAULT       (64 << 10)  // writes waiting for the port
+#define SERIAL_SHM_READERS_DEFAULT  16
+
+/* ------------------------------------------------------------ */
+/*                  General Type Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef struct {
+    size_t      cbRing;         // 0: SERIAL_SHM_RING_DEFAULT, rounded up to a power of two
+    size_t      cbTxQueue;      // 0: SERIAL_SHM_TX_DEFAULT, rounded up to a power of two
+    uint32_t    cMaxReaders;    // 0: SERIAL_SHM_READERS_DEFAULT
+    mode_t      mode;           // permissions of the segment, 0: 0600
+} SERIAL_SHM_CFG;
+
+typedef struct {
+    uint64_t    cbPublished;    // received bytes put in the ring
+    uint64_t    cbTxSent;       // queued bytes written to the port
+    uint32_t    cReaders;       // attached now
+    uint64_t    cbMaxLag;       // furthest an attached reader is behind
+    uint64_t    cLagEvents;     // times a reader fell a whole ring behind
+    uint64_t    cbLost;         // bytes those readers skipped
+} SERIAL_SHM_STATS;
+
+/* ------------------------------------------------------------ */
+/*                  Object Class Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef struct SERIAL_SHM_BROKER SERIAL_SHM_BROKER;
+typedef struct SERIAL_SHM_READER SERIAL_SHM_READER;
+
+/* ------------------------------------------------------------ */
+/*                  Function Prototypes                         */
+/* ------------------------------------------------------------ */
+
+// owner process
+SERIAL_SHM_BROKER *SerialShmBrokerCreate(SERIAL_PORT *port, const char *szName,
+                                         const SERIAL_SHM_CFG *pcfg);
+void    SerialShmBrokerDestroy(SERIAL_SHM_BROKER *pbr);
+void    SerialShmBrokerGetStats(SERIAL_SHM_BROKER *pbr, SERIAL_SHM_STATS *pstats);
+
+// any process
+SERIAL_SHM_READER *SerialShmOpen(const char *szName);
+void    SerialShmClose(SERIAL_SHM_READER *prd);
+int     SerialShmPeek(SERIAL_SHM_READER *prd, const uint8_t **ppb, uint32_t timeOutMs);
+bool    SerialShmConsume(SERIAL_SHM_READER *prd, size_t cb);
+int     SerialShmWrite(SERIAL_SHM_READER *prd, const uint8_t *pb, size_t cb, uint32_t timeOutMs);
+uint64_t SerialShmLost(SERIAL_SHM_READER *prd);
+/* ------------------------------------------------------------ */
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+
+/**********************************  EOF  **************************************/
@@ -0,0 +1,233 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_stats.c --  EmbedCreativity's per port performance counters      */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Snapshot and reset of the counters the I/O paths keep in every      */
+/*  SERIAL_PORT, plus percentile lookup in the latency histograms.      */
+/*  The counters themselves are updated inline, see STAT_ADD_SHARED()   */
+/*  and HistRecord() in ec_serial_priv.h.                               */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*  10/16/2026 (agent): RX throttle count, reset also rebases the       */
+/*                      driver line counters                            */
+/*                                                                      */
+/************************************************************************/
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "ec_serial.h"
+#include "ec_serial_priv.h"
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static void     HistSnapshot( SERIAL_HIST *phist, SERIAL_HIST_LIVE *phistLive );
+static void     HistClear( SERIAL_HIST_LIVE *phistLive );
+static uint64_t HistBucketTop( unsigned idx );
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+#define LOAD(ctr)       atomic_load_explicit(&(ctr), memory_order_relaxed)
+#define CLEAR(ctr)      atomic_store_explicit(&(ctr), 0, memory_order_relaxed)
+
+/* ------------------------------------------------------------ */
+/***    SerialPortGetStats
+**
+**  Synopsis:
+**      void SerialPortGetStats(SERIAL_PORT *port, SERIAL_STATS *pstats)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      *pstats         receives the counters
+**
+**  Return Values:
+**      none
+**
+**  Errors:
+**      none
+**
+**  Description:
+**      Copies the counters out without stopping the port.  Safe to call
+**      from any thread while I/O is in progress; the copy is not an atomic
+**      snapshot across counters, each one is individually consistent.
+*/
+void SerialPortGetStats(SERIAL_PORT *port, SERIAL_STATS *pstats) {
+
+    SERIAL_STATS_LIVE *plive = &port->stats;
+
+    pstats->cbRead = LOAD(plive->cbRead);
+    pstats->cbWritten = LOAD(plive->cbWritten);
+    pstats->cReadCalls = LOAD(plive->cReadCalls);
+    pstats->cWriteCalls = LOAD(plive->cWriteCalls);
+    pstats->cPollCalls = LOAD(plive->cPollCalls);
+    pstats->cUringCalls = LOAD(plive->cUringCalls);
+    pstats->cPartialReads = LOAD(plive->cPartialReads);
+    pstats->cPartialWrites = LOAD(plive->cPartialWrites);
+    pstats->cTimeouts = LOAD(plive->cTimeouts);
+    pstats->cEagain = LOAD(plive->cEagain);
+    pstats->cErrors = LOAD(plive->cErrors);
+    pstats->cRxThrottles = LOAD(plive->cRxThrottles);
+    HistSnapshot(&pstats->histReadWait, &plive->histReadWait);
+    HistSnapshot(&pstats->histWrite, &plive->histWrite);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialPortResetStats
+**
+**  Synopsis:
+**      void SerialPortResetStats(SERIAL_PORT *port)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**
+**  Description:
+**      Zeroes every counter, SerialPortGetLineCounts() included.  Updates
+**      made by another thread at the same moment may survive or be lost,
+**      the counters are never torn.
+*/
+void SerialPortResetStats(SERIAL_PORT *port) {
+
+    SERIAL_STATS_LIVE *plive = &port->stats;
+
+    CLEAR(plive->cbRead);
+    CLEAR(plive->cbWritten);
+    CLEAR(plive->cReadCalls);
+    CLEAR(plive->cWriteCalls);
+    CLEAR(plive->cPollCalls);
+    CLEAR(plive->cUringCalls);
+    CLEAR(plive->cPartialReads);
+    CLEAR(plive->cPartialWrites);
+    CLEAR(plive->cTimeouts);
+    CLEAR(plive->cEagain);
+    CLEAR(plive->cErrors);
+    CLEAR(plive->cRxThrottles);
+    HistClear(&plive->histReadWait);
+    HistClear(&plive->histWrite);
+    FlowResetLineCounts(port);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialHistPercentile
+**
+**  Synopsis:
+**      uint64_t SerialHistPercentile(const SERIAL_HIST *phist, double pct)
+**
+**  Parameters:
+**      *phist          histogram from a SERIAL_STATS snapshot
+**      pct             percentile wanted, 0.0 to 100.0
+**
+**  Return Values:
+**      value in ns that pct percent of the samples do not exceed, to
+**      within the bucket resolution.  0 for an empty histogram.
+*/
+uint64_t SerialHistPercentile(const SERIAL_HIST *phist, double pct) {
+
+    uint64_t    cTarget;
+    uint64_t    cSeen;
+    unsigned    idx;
+
+    if ( phist->cSamples == 0 ) {
+        return 0;
+    }
+
+    cTarget = (uint64_t)(pct / 100.0 * phist->cSamples + 0.5);
+    if ( cTarget < 1 ) {
+        cTarget = 1;
+    }
+
+    cSeen = 0;
+    for ( idx = 0; idx < SERIAL_HIST_BUCKETS; idx++ ) {
+        cSeen += phist->rgc[idx];
+        if ( cSeen >= cTarget ) {
+            break;
+        }
+    }
+    if ( idx >= SERIAL_HIST_BUCKETS ) {
+        return phist->nsMax;
+    }
+
+    // never report more than was actually seen
+    return ( HistBucketTop(idx) < phist->nsMax ) ? HistBucketTop(idx) : phist->nsMax;
+}
+
+/* ------------------------------------------------------------ */
+/***    HistBucketTop
+**
+**  Synopsis:
+**      uint64_t HistBucketTop(unsigned idx)
+**
+**  Return Values:
+**      largest value that HistIndex() maps to bucket idx
+*/
+static uint64_t HistBucketTop(unsigned idx) {
+
+    unsigned grp = idx >> SERIAL_HIST_SUB_BITS;
+    uint64_t sub = idx & ((1u << SERIAL_HIST_SUB_BITS) - 1);
+
+    if ( grp == 0 ) {
+        return sub;
+    }
+    return ((sub + (1u << SERIAL_HIST_SUB_BITS) + 1) << (grp - 1)) - 1;
+}
+
+static void HistSnapshot(SERIAL_HIST *phist, SERIAL_HIST_LIVE *phistLive) {
+
+    unsigned idx;
+
+    phist->cSamples = LOAD(phistLive->cSamples);
+    phist->nsSum = LOAD(phistLive->nsSum);
+    phist->nsMax = LOAD(phistLive->nsMax);
+    for ( idx = 0; idx < SERIAL_HIST_BUCKETS; idx++ ) {
+        phist->rgc[idx] = LOAD(phistLive->rgc[idx]);
+    }
+}
+
+static void HistClear(SERIAL_HIST_LIVE *phistLive) {
+
+    unsigned idx;
+
+    CLEAR(phistLive->cSamples);
+    CLEAR(phistLive->nsSum);
+    CLEAR(phistLive->nsMax);
+    for ( idx = 0; idx < SERIAL_HIST_BUCKETS; idx++ ) {
+        CLEAR(phistLive->rgc[idx]);
+    }
+}
+
+
+/************************************ EOF ********************************/
@@ -0,0 +1,668 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_txn.c --  EmbedCreativity's pipelined request/response engine    */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Keeps up to cMaxInFlight requests on the wire instead of waiting    */
+/*  out one round trip per command.  Requests are framed when they are  */
+/*  submitted, sent in one writev() per batch, and responses are paired */
+/*  with their request through a user supplied key (a sequence number,  */
+/*  a register address, ...).  Without a key function responses are     */
+/*  taken to arrive in request order.  A request that sees no response  */
+/*  before its timeout is sent again, up to its retry count.            */
+/*                                                                      */
+/*  Two requests with the same key are never on the wire together, the  */
+/*  second one waits at the head of the queue until the first is done.  */
+/*                                                                      */
+/*  The engine does no locking and runs in the thread that calls        */
+/*  SerialTxnPoll(); all memory is allocated by SerialTxnCreate().      */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*                                                                      */
+/************************************************************************/
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+
+#include "ec_serial.h"
+#include "ec_serial_priv.h"
+#include "ec_frame.h"
+#include "ec_txn.h"
+
+/* ------------------------------------------------------------ */
+/*              Local Type Definitions                          */
+/* ------------------------------------------------------------ */
+
+#define TXN_NONE    UINT32_MAX  // no slot
+
+typedef struct {
+    SERIAL_TXN_DONE_FN  pfnDone;
+    void                *pvUser;
+    uint8_t             *pbWire;        // the framed request
+    size_t              cbWire;
+    uint32_t            key;
+    uint32_t            msTimeout;      // per attempt
+    uint32_t            cRetryLeft;
+    uint64_t            nsDeadline;     // while in flight
+} TXN_SLOT;
+
+struct SERIAL_TXN {
+    SERIAL_PORT         *port;
+    SERIAL_TXN_CFG      cfg;
+    SERIAL_FRAMER       *pfr;
+
+    TXN_SLOT            *rgslot;        // cMaxQueued of them
+    uint8_t             *rgbWire;       // backing store of every pbWire
+
+    uint32_t            *rgiFree;       // stack of unused slots
+    uint32_t            cFree;
+    uint32_t            *rgiQueue;      // circular FIFO of slots waiting to be sent
+    uint32_t            iQueueHead;
+    uint32_t            cQueued;
+    uint32_t            *rgiFlight;     // slots on the wire, oldest first
+    uint32_t            cFlight;
+    uint32_t            islotPartial;   // slot cut short by a failed write, or TXN_NONE
+    size_t              ibPartial;      // bytes of it already on the wire
+
+    struct iovec        *rgiov;         // one batch of requests for writev()
+    SERIAL_TXN_STATS    stats;
+};
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static int      Send( SERIAL_TXN *ptxn );
+static int      Match( SERIAL_TXN *ptxn, const uint8_t *pb, size_t cb );
+static int      Expire( SERIAL_TXN *ptxn, uint64_t nsNow );
+static void     FlightRemove( SERIAL_TXN *ptxn, uint32_t i );
+static uint32_t MsUntil( uint64_t nsDeadline );
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    SerialTxnCreate
+**
+**  Synopsis:
+**      SERIAL_TXN *SerialTxnCreate(SERIAL_PORT *port, const SERIAL_TXN_CFG *pcfg)
+**
+**  Parameters:
+**      *port           port the requests go out on
+**      *pcfg           framing, queue sizes and key function, copied
+**
+**  Return Values:
+**      new engine, NULL on failure with errno set
+**
+**  Errors:
+**      EINVAL for an empty queue or window, or a bad framing
+**
+**  Description:
+**      The engine owns a framer for the port; nothing else should read
+**      from the port while the engine is in use.
+*/
+SERIAL_TXN *SerialTxnCreate(SERIAL_PORT *port, const SERIAL_TXN_CFG *pcfg) {
+
+    SERIAL_TXN  *ptxn;
+    size_t      cbWire;
+    uint32_t    islot;
+
+    if ( (pcfg->cMaxQueued == 0) || (pcfg->cMaxInFlight == 0) || (pcfg->cbMaxRequest == 0) ) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    ptxn = calloc(1, sizeof(*ptxn));
+    if ( ptxn == NULL ) {
+        return NULL;
+    }
+    ptxn->port = port;
+    ptxn->cfg = *pcfg;
+    ptxn->islotPartial = TXN_NONE;
+    if ( ptxn->cfg.cMaxInFlight > ptxn->cfg.cMaxQueued ) {
+        ptxn->cfg.cMaxInFlight = ptxn->cfg.cMaxQueued;
+    }
+
+    ptxn->pfr = SerialFramerCreate(&pcfg->cfgFrame);
+    if ( ptxn->pfr == NULL ) {
+        free(ptxn);
+        return NULL;
+    }
+
+    cbWire = SerialFrameEncodedMax(&pcfg->cfgFrame, pcfg->cbMaxRequest);
+    ptxn->rgslot = calloc(pcfg->cMaxQueued, sizeof(TXN_SLOT));
+    ptxn->rgbWire = malloc(pcfg->cMaxQueued * cbWire);
+    ptxn->rgiFree = malloc(pcfg->cMaxQueued * sizeof(uint32_t));
+    ptxn->rgiQueue = malloc(pcfg->cMaxQueued * sizeof(uint32_t));
+    ptxn->rgiFlight = malloc(ptxn->cfg.cMaxInFlight * sizeof(uint32_t));
+    ptxn->rgiov = malloc(ptxn->cfg.cMaxInFlight * sizeof(struct iovec));
+    if ( (ptxn->rgslot == NULL) || (ptxn->rgbWire == NULL) || (ptxn->rgiFree == NULL) ||
+         (ptxn->rgiQueue == NULL) || (ptxn->rgiFlight == NULL) || (ptxn->rgiov == NULL) ) {
+        SerialTxnDestroy(ptxn);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    for ( islot = 0; islot < pcfg->cMaxQueued; islot++ ) {
+        ptxn->rgslot[islot].pbWire = ptxn->rgbWire + islot * cbWire;
+        ptxn->rgiFree[islot] = pcfg->cMaxQueued - 1 - islot;
+    }
+    ptxn->cFree = pcfg->cMaxQueued;
+
+    return ptxn;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialTxnDestroy
+**
+**  Synopsis:
+**      void SerialTxnDestroy(SERIAL_TXN *ptxn)
+**
+**  Description:
+**      Completes every request still queued or in flight with
+**      SERIAL_TXN_CANCELLED, then frees the engine.  The callbacks must
+**      not submit anything.  NULL is ignored.
+*/
+void SerialTxnDestroy(SERIAL_TXN *ptxn) {
+
+    TXN_SLOT    *pslot;
+    uint32_t    i;
+
+    if ( ptxn == NULL ) {
+        return;
+    }
+
+    if ( ptxn->rgiFlight != NULL ) {
+        for ( i = 0; i < ptxn->cFlight; i++ ) {
+            pslot = &ptxn->rgslot[ptxn->rgiFlight[i]];
+            pslot->pfnDone(pslot->pvUser, SERIAL_TXN_CANCELLED, NULL, 0);
+        }
+    }
+    if ( ptxn->islotPartial != TXN_NONE ) {
+        pslot = &ptxn->rgslot[ptxn->islotPartial];
+        pslot->pfnDone(pslot->pvUser, SERIAL_TXN_CANCELLED, NULL, 0);
+    }
+    if ( ptxn->rgiQueue != NULL ) {
+        for ( i = 0; i < ptxn->cQueued; i++ ) {
+            pslot = &ptxn->rgslot[ptxn->rgiQueue[(ptxn->iQueueHead + i) % ptxn->cfg.cMaxQueued]];
+            pslot->pfnDone(pslot->pvUser, SERIAL_TXN_CANCELLED, NULL, 0);
+        }
+    }
+
+    SerialFramerDestroy(ptxn->pfr);
+    free(ptxn->rgiov);
+    free(ptxn->rgiFlight);
+    free(ptxn->rgiQueue);
+    free(ptxn->rgiFree);
+    free(ptxn->rgbWire);
+    free(ptxn->rgslot);
+    free(ptxn);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialTxnSubmit
+**
+**  Synopsis:
+**      int SerialTxnSubmit(SERIAL_TXN *ptxn, const uint8_t *pbReq, size_t cbReq,
+**                          uint32_t timeOutMs, uint32_t cRetry,
+**                          SERIAL_TXN_DONE_FN pfnDone, void *pvUser)
+**
+**  Parameters:
+**      *pbReq          request payload, framed and copied before returning
+**      cbReq           size of the payload
+**      timeOutMs       time each attempt waits for its response,
+**                      SERIAL_WAIT_FOREVER never gives up
+**      cRetry          how many times to send again after a timeout
+**      pfnDone         called exactly once with the outcome
+**      *pvUser         passed to pfnDone
+**
+**  Return Values:
+**      0 (success)
+**      -1 (SERIAL_ERROR_CODE) on error
+**
+**  Errors:
+**      EAGAIN          cMaxQueued requests are already pending
+**      EMSGSIZE        cbReq is larger than cbMaxRequest
+**      EINVAL          the key function found no key in the request,
+**                      or pfnDone is NULL
+**
+**  Description:
+**      Queues the request.  It goes on the wire from the next
+**      SerialTxnPoll() once the in-flight window has room.
+*/
+int SerialTxnSubmit(SERIAL_TXN *ptxn, const uint8_t *pbReq, size_t cbReq,
+                    uint32_t timeOutMs, uint32_t cRetry,
+                    SERIAL_TXN_DONE_FN pfnDone, void *pvUser) {
+
+    TXN_SLOT    *pslot;
+    uint32_t    islot;
+    uint32_t    key = 0;
+
+    if ( pfnDone == NULL ) {
+        errno = EINVAL;
+        return SERIAL_ERROR_CODE;
+    }
+    if ( cbReq > ptxn->cfg.cbMaxRequest ) {
+        errno = EMSGSIZE;
+        return SERIAL_ERROR_CODE;
+    }
+    if ( ptxn->cFree == 0 ) {
+        errno = EAGAIN;
+        return SERIAL_ERROR_CODE;
+    }
+    if ( (ptxn->cfg.pfnKey != NULL) &&
+         !ptxn->cfg.pfnKey(ptxn->cfg.pvKeyCtx, pbReq, cbReq, true, &key) ) {
+        errno = EINVAL;
+        return SERIAL_ERROR_CODE;
+    }
+
+    islot = ptxn->rgiFree[ptxn->cFree - 1];
+    pslot = &ptxn->rgslot[islot];
+    pslot->cbWire = SerialFrameEncode(&ptxn->cfg.cfgFrame, pbReq, cbReq, pslot->pbWire,
+                                      SerialFrameEncodedMax(&ptxn->cfg.cfgFrame, ptxn->cfg.cbMaxRequest));
+    if ( pslot->cbWire == 0 ) {
+        errno = EINVAL;
+        return SERIAL_ERROR_CODE;
+    }
+    pslot->pfnDone = pfnDone;
+    pslot->pvUser = pvUser;
+    pslot->key = key;
+    pslot->msTimeout = timeOutMs;
+    pslot->cRetryLeft = cRetry;
+
+    ptxn->cFree--;
+    ptxn->rgiQueue[(ptxn->iQueueHead + ptxn->cQueued) % ptxn->cfg.cMaxQueued] = islot;
+    ptxn->cQueued++;
+    ptxn->stats.cSubmitted++;
+
+    return 0;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialTxnPoll
+**
+**  Synopsis:
+**      int SerialTxnPoll(SERIAL_TXN *ptxn, uint32_t timeOutMs)
+**
+**  Parameters:
+**      timeOutMs       longest time to wait for something to complete,
+**                      0 to only handle what has already arrived
+**
+**  Return Values:
+**      number of requests completed, successfully or not
+**      -1 (SERIAL_ERROR_CODE) if the port failed, see errno
+**
+**  Description:
+**      Fills the in-flight window from the queue, then reads responses
+**      and expires requests until at least one has completed or the
+**      time is up.  Callbacks run from here.  Returns 0 at once when
+**      nothing is pending.
+*/
+int SerialTxnPoll(SERIAL_TXN *ptxn, uint32_t timeOutMs) {
+
+    const uint8_t   *pbFrame;
+    uint64_t        nsEnd;
+    uint64_t        nsWait;
+    uint32_t        i;
+    int             cDone = 0;
+    int             rc;
+
+    nsEnd = DeadlineFromMs(timeOutMs);
+
+    for (;;) {
+        if ( Send(ptxn) < 0 ) {
+            return SERIAL_ERROR_CODE;
+        }
+        if ( ptxn->cFlight == 0 ) {
+            return cDone;
+        }
+
+        // once something completed only pick up what is already here
+        nsWait = 0;
+        if ( cDone == 0 ) {
+            nsWait = nsEnd;
+            for ( i = 0; i < ptxn->cFlight; i++ ) {
+                if ( ptxn->rgslot[ptxn->rgiFlight[i]].nsDeadline < nsWait ) {
+                    nsWait = ptxn->rgslot[ptxn->rgiFlight[i]].nsDeadline;
+                }
+            }
+        }
+
+        rc = SerialPortReadFrame(ptxn->port, ptxn->pfr, &pbFrame, MsUntil(nsWait));
+        if ( rc >= 0 ) {
+            cDone += Match(ptxn, pbFrame, rc);
+            continue;
+        }
+        if ( rc != SERIAL_TIMEOUT_CODE ) {
+            return SERIAL_ERROR_CODE;
+        }
+
+        cDone += Expire(ptxn, MonoNowNs());
+        if ( (cDone > 0) || (MonoNowNs() >= nsEnd) ) {
+            if ( Send(ptxn) < 0 ) {
+                return SERIAL_ERROR_CODE;
+            }
+            return cDone;
+        }
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialTxnRun
+**
+**  Synopsis:
+**      int SerialTxnRun(SERIAL_TXN *ptxn, uint32_t timeOutMs)
+**
+**  Return Values:
+**      number of requests completed, successfully or not
+**      -1 (SERIAL_ERROR_CODE) if the port failed, see errno
+**
+**  Description:
+**      Polls until nothing is pending or timeOutMs has passed; check
+**      SerialTxnPending() to tell which.
+*/
+int SerialTxnRun(SERIAL_TXN *ptxn, uint32_t timeOutMs) {
+
+    uint64_t    nsEnd;
+    int         cDone = 0;
+    int         rc;
+
+    nsEnd = DeadlineFromMs(timeOutMs);
+
+    while ( SerialTxnPending(ptxn) > 0 ) {
+        rc = SerialTxnPoll(ptxn, MsUntil(nsEnd));
+        if ( rc < 0 ) {
+            return rc;
+        }
+        cDone += rc;
+        if ( MonoNowNs() >= nsEnd ) {
+            break;
+        }
+    }
+    return cDone;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialTxnPending
+**
+**  Return Values:
+**      requests queued or in flight
+*/
+uint32_t SerialTxnPending(SERIAL_TXN *ptxn) {
+
+    return ptxn->cQueued + ptxn->cFlight + (( ptxn->islotPartial != TXN_NONE ) ? 1 : 0);
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialTxnGetStats
+**
+**  Synopsis:
+**      void SerialTxnGetStats(SERIAL_TXN *ptxn, SERIAL_TXN_STATS *pstats)
+*/
+void SerialTxnGetStats(SERIAL_TXN *ptxn, SERIAL_TXN_STATS *pstats) {
+
+    *pstats = ptxn->stats;
+}
+
+/* ------------------------------------------------------------ */
+/***    Send
+**
+**  Synopsis:
+**      int Send(SERIAL_TXN *ptxn)
+**
+**  Return Values:
+**      0 (success), -1 (SERIAL_ERROR_CODE) if the write failed
+**
+**  Description:
+**      Moves requests from the head of the queue into the window and
+**      writes them with a single writev().  Their timeouts start once
+**      the write returns.  A request whose key is already in flight
+**      holds back the ones behind it.
+**
+**      Only requests written whole stay in the window.  When the write
+**      fails part way, the request it stopped in is held aside and the
+**      rest of its frame goes out first on the next call, so the peer
+**      never sees a truncated frame.  The requests after it go back to
+**      the front of the queue.
+*/
+static int Send(SERIAL_TXN *ptxn) {
+
+    TXN_SLOT    *pslot;
+    uint64_t    nsNow;
+    uint32_t    cFlightOld = ptxn->cFlight;
+    uint32_t    islot;
+    uint32_t    i;
+    size_t      cbLeft;
+    int         ciov = 0;
+    int         rc;
+
+    if ( ptxn->islotPartial != TXN_NONE ) {
+        pslot = &ptxn->rgslot[ptxn->islotPartial];
+        ptxn->rgiFlight[ptxn->cFlight++] = ptxn->islotPartial;
+        ptxn->rgiov[ciov].iov_base = pslot->pbWire + ptxn->ibPartial;
+        ptxn->rgiov[ciov].iov_len = pslot->cbWire - ptxn->ibPartial;
+        ciov++;
+    }
+
+    while ( (ptxn->cQueued > 0) && (ptxn->cFlight < ptxn->cfg.cMaxInFlight) ) {
+        islot = ptxn->rgiQueue[ptxn->iQueueHead];
+        pslot = &ptxn->rgslot[islot];
+        if ( ptxn->cfg.pfnKey != NULL ) {
+            for ( i = 0; i < ptxn->cFlight; i++ ) {
+                if ( ptxn->rgslot[ptxn->rgiFlight[i]].key == pslot->key ) {
+                    break;
+                }
+            }
+            if ( i < ptxn->cFlight ) {
+                break;
+            }
+        }
+
+        ptxn->iQueueHead = (ptxn->iQueueHead + 1) % ptxn->cfg.cMaxQueued;
+        ptxn->cQueued--;
+        ptxn->rgiFlight[ptxn->cFlight++] = islot;
+        ptxn->rgiov[ciov].iov_base = pslot->pbWire;
+        ptxn->rgiov[ciov].iov_len = pslot->cbWire;
+        ciov++;
+    }
+
+    if ( ciov == 0 ) {
+        return 0;
+    }
+
+    rc = SerialPortWriteV(ptxn->port, ptxn->rgiov, ciov, 0);
+    cbLeft = ( rc > 0 ) ? (size_t)rc : 0;
+
+    // the requests written whole start their timeouts
+    nsNow = MonoNowNs();
+    for ( i = 0; (i < (uint32_t)ciov) && (cbLeft >= ptxn->rgiov[i].iov_len); i++ ) {
+        cbLeft -= ptxn->rgiov[i].iov_len;
+        pslot = &ptxn->rgslot[ptxn->rgiFlight[cFlightOld + i]];
+        pslot->nsDeadline = ( pslot->msTimeout == SERIAL_WAIT_FOREVER ) ?
+                            UINT64_MAX : nsNow + (uint64_t)pslot->msTimeout * 1000000;
+    }
+    if ( i > 0 ) {
+        ptxn->islotPartial = TXN_NONE;
+    }
+    if ( i == (uint32_t)ciov ) {
+        return 0;
+    }
+
+    // the write failed part way, take back what is not on the wire
+    if ( cbLeft > 0 ) {
+        ptxn->ibPartial = ( ptxn->islotPartial != TXN_NONE ) ? ptxn->ibPartial + cbLeft : cbLeft;
+        ptxn->islotPartial = ptxn->rgiFlight[cFlightOld + i];
+        i++;
+    } else if ( ptxn->islotPartial != TXN_NONE ) {
+        i++;
+    }
+    while ( (uint32_t)ciov > i ) {
+        ciov--;
+        ptxn->iQueueHead = (ptxn->iQueueHead + ptxn->cfg.cMaxQueued - 1) % ptxn->cfg.cMaxQueued;
+        ptxn->rgiQueue[ptxn->iQueueHead] = ptxn->rgiFlight[cFlightOld + ciov];
+        ptxn->cQueued++;
+    }
+    ptxn->cFlight = cFlightOld + i;
+    if ( ptxn->islotPartial != TXN_NONE ) {
+        ptxn->cFlight--;    // the partial slot is held aside, not in the window
+    }
+    return SERIAL_ERROR_CODE;
+}
+
+/* ------------------------------------------------------------ */
+/***    Match
+**
+**  Synopsis:
+**      int Match(SERIAL_TXN *ptxn, const uint8_t *pb, size_t cb)
+**
+**  Return Values:
+**      1 if the frame completed a request, 0 if nothing was waiting for it
+*/
+static int Match(SERIAL_TXN *ptxn, const uint8_t *pb, size_t cb) {
+
+    TXN_SLOT    *pslot;
+    uint32_t    islot;
+    uint32_t    key;
+    uint32_t    i = 0;
+
+    if ( ptxn->cfg.pfnKey != NULL ) {
+        if ( !ptxn->cfg.pfnKey(ptxn->cfg.pvKeyCtx, pb, cb, false, &key) ) {
+            ptxn->stats.cUnmatched++;
+            return 0;
+        }
+        for ( i = 0; i < ptxn->cFlight; i++ ) {
+            if ( ptxn->rgslot[ptxn->rgiFlight[i]].key == key ) {
+                break;
+            }
+        }
+    }
+    if ( i >= ptxn->cFlight ) {
+        ptxn->stats.cUnmatched++;
+        return 0;
+    }
+
+    islot = ptxn->rgiFlight[i];
+    pslot = &ptxn->rgslot[islot];
+    FlightRemove(ptxn, i);
+    ptxn->rgiFree[ptxn->cFree++] = islot;
+    ptxn->stats.cCompleted++;
+
+    // the slot is free already, so the callback can reuse it
+    pslot->pfnDone(pslot->pvUser, SERIAL_TXN_OK, pb, cb);
+    return 1;
+}
+
+/* ------------------------------------------------------------ */
+/***    Expire
+**
+**  Synopsis:
+**      int Expire(SERIAL_TXN *ptxn, uint64_t nsNow)
+**
+**  Return Values:
+**      number of requests given up on
+**
+**  Description:
+**      Requests past their deadline go back to the front of the queue,
+**      in their original order, or complete with SERIAL_TXN_TIMEOUT once
+**      their retries are used up.
+*/
+static int Expire(SERIAL_TXN *ptxn, uint64_t nsNow) {
+
+    TXN_SLOT    *pslot;
+    uint32_t    islot;
+    uint32_t    i;
+    int         cDone = 0;
+
+    for ( i = ptxn->cFlight; i-- > 0; ) {
+        islot = ptxn->rgiFlight[i];
+        pslot = &ptxn->rgslot[islot];
+        if ( pslot->nsDeadline > nsNow ) {
+            continue;
+        }
+        FlightRemove(ptxn, i);
+
+        if ( pslot->cRetryLeft > 0 ) {
+            pslot->cRetryLeft--;
+            ptxn->stats.cRetries++;
+            ptxn->iQueueHead = (ptxn->iQueueHead + ptxn->cfg.cMaxQueued - 1) % ptxn->cfg.cMaxQueued;
+            ptxn->rgiQueue[ptxn->iQueueHead] = islot;
+            ptxn->cQueued++;
+        } else {
+            ptxn->rgiFree[ptxn->cFree++] = islot;
+            ptxn->stats.cTimeouts++;
+            pslot->pfnDone(pslot->pvUser, SERIAL_TXN_TIMEOUT, NULL, 0);
+            cDone++;
+        }
+    }
+    return cDone;
+}
+
+/* ------------------------------------------------------------ */
+/***    FlightRemove
+**
+**  Description:
+**      Takes entry i out of the window, keeping the rest in send order.
+*/
+static void FlightRemove(SERIAL_TXN *ptxn, uint32_t i) {
+
+    ptxn->cFlight--;
+    memmove(&ptxn->rgiFlight[i], &ptxn->rgiFlight[i + 1],
+            (ptxn->cFlight - i) * sizeof(ptxn->rgiFlight[0]));
+}
+
+/* ------------------------------------------------------------ */
+/***    MsUntil
+**
+**  Description:
+**      Milliseconds from now until an absolute deadline, rounded up.
+*/
+static uint32_t MsUntil(uint64_t nsDeadline) {
+
+    uint64_t    nsNow;
+
+    if ( nsDeadline == UINT64_MAX ) {
+        return SERIAL_WAIT_FOREVER;
+    }
+    nsNow = MonoNowNs();
+    if ( nsNow >= nsDeadline ) {
+        return 0;
+    }
+    return (uint32_t)((nsDeadline - nsNow + 999999) / 1000000);
+}
+
+
+/************************************ EOF ********************************/
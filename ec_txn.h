@@ -0,0 +1,117 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_txn.h --  EmbedCreativity's Serial transaction header file       */
+/*                                                                      */
+/************************************************************************/
+/*  Author:     agent                                                   */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*  This header file contains declarations the functions contained in   */
+/*  ec_txn.c                                                            */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026(agent): created                                          */
+/*  10/16/2026(agent): extern "C" guards for the C++ layer              */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(_SERIALTXN_H)
+#define _SERIALTXN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ec_serial.h"
+#include "ec_frame.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------------ */
+/*                  General Type Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef enum {
+    SERIAL_TXN_OK,              // the matching response arrived
+    SERIAL_TXN_TIMEOUT,         // no response after the last retry
+    SERIAL_TXN_CANCELLED        // the engine was destroyed first
+} SERIAL_TXN_STATUS;
+
+// Pulls the matching key out of a request payload (fRequest) or a
+// received response frame.  Return false for frames that carry no key,
+// responses without one are counted as unmatched.
+typedef bool (*SERIAL_TXN_KEY_FN)(void *pvCtx, const uint8_t *pb, size_t cb,
+                                  bool fRequest, uint32_t *pkey);
+
+// Completion of one request.  pbRsp is only valid during the call and
+// is NULL unless status is SERIAL_TXN_OK.  May submit new requests.
+typedef void (*SERIAL_TXN_DONE_FN)(void *pvUser, SERIAL_TXN_STATUS status,
+                                   const uint8_t *pbRsp, size_t cbRsp);
+
+typedef struct {
+    SERIAL_FRAME_CFG    cfgFrame;       // framing of requests and responses
+    size_t              cbMaxRequest;   // largest request payload
+    uint32_t            cMaxQueued;     // requests waiting or in flight
+    uint32_t            cMaxInFlight;   // requests on the wire at once
+    SERIAL_TXN_KEY_FN   pfnKey;         // NULL: responses arrive in request order
+    void                *pvKeyCtx;
+} SERIAL_TXN_CFG;
+
+typedef struct {
+    uint64_t    cSubmitted;
+    uint64_t    cCompleted;         // with SERIAL_TXN_OK
+    uint64_t    cRetries;           // requests sent again after a timeout
+    uint64_t    cTimeouts;          // requests given up on
+    uint64_t    cUnmatched;         // responses no request was waiting for
+} SERIAL_TXN_STATS;
+
+/* ------------------------------------------------------------ */
+/*                  Object Class Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef struct SERIAL_TXN SERIAL_TXN;
+
+/* ------------------------------------------------------------ */
+/*                  Function Prototypes                         */
+/* ------------------------------------------------------------ */
+
+SERIAL_TXN *SerialTxnCreate(SERIAL_PORT *port, const SERIAL_TXN_CFG *pcfg);
+void    SerialTxnDestroy(SERIAL_TXN *ptxn);
+int     SerialTxnSubmit(SERIAL_TXN *ptxn, const uint8_t *pbReq, size_t cbReq,
+                        uint32_t timeOutMs, uint32_t cRetry,
+                        SERIAL_TXN_DONE_FN pfnDone, void *pvUser);
+int     SerialTxnPoll(SERIAL_TXN *ptxn, uint32_t timeOutMs);
+int     SerialTxnRun(SERIAL_TXN *ptxn, uint32_t timeOutMs);
+uint32_t SerialTxnPending(SERIAL_TXN *ptxn);
+void    SerialTxnGetStats(SERIAL_TXN *ptxn, SERIAL_TXN_STATS *pstats);
+/* ------------------------------------------------------------ */
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+
+/**********************************  EOF  **************************************/
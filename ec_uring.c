@@ -0,0 +1,596 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_uring.c --  EmbedCreativity's io_uring I/O backend               */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  A waiting read on the poll backend costs a read() that comes back   */
+/*  short, a ppoll() and another read() for every chunk the device      */
+/*  delivers.  With SERIAL_IO_URING the same wait is a single linked    */
+/*  chain handed to io_uring_enter():                                   */
+/*                                                                      */
+/*      POLL_ADD(POLLIN) -> LINK_TIMEOUT(deadline) -> READ_FIXED        */
+/*                                                                      */
+/*  The poll is needed because the port runs with VMIN=0, where a       */
+/*  plain read returns 0 at once instead of waiting.  The timeout       */
+/*  cancels the poll, and with it the read, when the deadline passes.   */
+/*  The read lands in a buffer registered with the ring, so the kernel  */
+/*  does not map and pin the destination on every call.                 */
+/*                                                                      */
+/*  The ring helpers at the top are shared with the reactor's           */
+/*  io_uring shards, see ec_reactor.c.                                  */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*  10/16/2026 (agent): reads feed SerialPortCaptureStart()             */
+/*                                                                      */
+/************************************************************************/
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#define _GNU_SOURCE  /* syscall */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "ec_serial.h"
+#include "ec_serial_priv.h"
+#include "ec_uring.h"
+
+/* ------------------------------------------------------------ */
+/*              Local Type Definitions                          */
+/* ------------------------------------------------------------ */
+
+#define URING_PORT_ENTRIES  4       // one poll/timeout/read chain at a time
+#define URING_PORT_READ     4096    // registered read buffer per port
+
+// user_data of the chain's requests
+#define URING_OP_POLL       1
+#define URING_OP_TIMEOUT    2
+#define URING_OP_READ       3
+
+struct URING_PORT {
+    URING           ring;
+    uint8_t         *pbFixed;       // registered as buffer 0
+};
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static int      ReadChain( SERIAL_PORT *port, uint8_t *pb, uint32_t cb,
+                           uint64_t nsWake, bool *pfHangup );
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    SerialPortSetIoBackend
+**
+**  Synopsis:
+**      SERIAL_IO_BACKEND SerialPortSetIoBackend(SERIAL_PORT *port,
+**                                               SERIAL_IO_BACKEND backend)
+**
+**  Parameters:
+**      *port           port returned by SerialPortOpen()
+**      backend         SERIAL_IO_URING or back to SERIAL_IO_POLL
+**
+**  Return Values:
+**      the backend now in use
+**
+**  Errors:
+**      none, if io_uring cannot be set up (old kernel, disabled by
+**      sysctl or seccomp, locked memory limit) the port stays on
+**      SERIAL_IO_POLL and the reason is logged at SERIAL_LOG_INFO
+**
+**  Description:
+**      Only waiting reads straight from the descriptor change: reads
+**      with a timeout that need at least one byte and are not busy
+**      polling.  Everything else behaves the same on both backends.
+**      Must not be called while another thread is reading the port.
+*/
+SERIAL_IO_BACKEND SerialPortSetIoBackend(SERIAL_PORT *port, SERIAL_IO_BACKEND backend) {
+
+    static const uint8_t rgop[] = {
+        IORING_OP_POLL_ADD, IORING_OP_LINK_TIMEOUT, IORING_OP_READ_FIXED
+    };
+    struct URING_PORT   *pup;
+    struct iovec        iov;
+
+    if ( backend != SERIAL_IO_URING ) {
+        UringPortFree(port);
+        return SERIAL_IO_POLL;
+    }
+    if ( port->puring != NULL ) {
+        return SERIAL_IO_URING;
+    }
+
+    pup = calloc(1, sizeof(*pup));
+    if ( pup == NULL ) {
+        return SERIAL_IO_POLL;
+    }
+    pup->pbFixed = aligned_alloc(4096, URING_PORT_READ);
+    if ( pup->pbFixed == NULL ) {
+        free(pup);
+        return SERIAL_IO_POLL;
+    }
+    iov.iov_base = pup->pbFixed;
+    iov.iov_len = URING_PORT_READ;
+    if ( !UringInit(&pup->ring, URING_PORT_ENTRIES, &iov, 1, rgop, sizeof(rgop)) ) {
+        SERIAL_LOG(SERIAL_LOG_INFO, "SERIAL %s: io_uring not available, staying on poll: %s",
+                   port->szDevice, strerror(errno));
+        free(pup->pbFixed);
+        free(pup);
+        return SERIAL_IO_POLL;
+    }
+
+    port->puring = pup;
+    return SERIAL_IO_URING;
+}
+
+/* ------------------------------------------------------------ */
+/***    UringPortFree
+**
+**  Synopsis:
+**      void UringPortFree(SERIAL_PORT *port)
+**
+**  Description:
+**      Puts the port back on the poll backend.  Called by
+**      SerialPortClose().
+*/
+void UringPortFree(SERIAL_PORT *port) {
+
+    if ( port->puring == NULL ) {
+        return;
+    }
+    UringFree(&port->puring->ring);
+    free(port->puring->pbFixed);
+    free(port->puring);
+    port->puring = NULL;
+}
+
+/* ------------------------------------------------------------ */
+/***    UringReadEx
+**
+**  Synopsis:
+**      int UringReadEx(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+**                      uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs)
+**
+**  Description:
+**      SerialPortReadEx() on the io_uring backend, 0 < minLen <= len and
+**      timeOutMs != 0.  Same results as the poll path, one
+**      io_uring_enter() per chunk received instead of two or three
+**      system calls.
+*/
+int UringReadEx(SERIAL_PORT *port, uint8_t *result, uint32_t len,
+                uint32_t minLen, uint32_t timeOutMs, uint32_t interByteUs) {
+
+    uint64_t    nsDeadline;
+    uint64_t    nsIdle;
+    uint64_t    nsWake;
+    uint32_t    totalBytesRead;
+    uint32_t    cbChunk;
+    bool        fHangup;
+    int         rc;
+
+    totalBytesRead = 0;
+    nsDeadline = DeadlineFromMs(timeOutMs);
+    nsIdle = UINT64_MAX;
+
+    for (;;) {
+        nsWake = ( nsIdle < nsDeadline ) ? nsIdle : nsDeadline;
+        if ( MonoNowNs() >= nsWake ) {
+            break;
+        }
+
+        cbChunk = len - totalBytesRead;
+        if ( cbChunk > URING_PORT_READ ) {
+            cbChunk = URING_PORT_READ;
+        }
+        fHangup = false;
+        rc = ReadChain(port, result + totalBytesRead, cbChunk, nsWake, &fHangup);
+        if ( rc < 0 ) {
+            STAT_ADD_SHARED(port->stats.cErrors, 1);
+            SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL io_uring read error %d %s", errno, strerror(errno));
+            return SERIAL_ERROR_CODE;
+        }
+        if ( fHangup ) {
+            errno = EIO;
+            return ( totalBytesRead > 0 ) ? (int)totalBytesRead : SERIAL_ERROR_CODE;
+        }
+        if ( rc == 0 ) {
+            continue;
+        }
+
+        STAT_ADD_SHARED(port->stats.cbRead, rc);
+        CAPTURE_DATA(port, SERIAL_CAPTURE_RX, result + totalBytesRead, rc);
+        totalBytesRead += rc;
+        if ( totalBytesRead >= minLen ) {
+            return totalBytesRead;
+        }
+        STAT_ADD_SHARED(port->stats.cPartialReads, 1);
+        if ( interByteUs != 0 ) {
+            nsIdle = MonoNowNs() + (uint64_t)interByteUs * 1000;
+        }
+    }
+
+    STAT_ADD_SHARED(port->stats.cTimeouts, 1);
+    return ( totalBytesRead > 0 ) ? (int)totalBytesRead : SERIAL_TIMEOUT_CODE;
+}
+
+/* ------------------------------------------------------------ */
+/***    ReadChain
+**
+**  Synopsis:
+**      int ReadChain(SERIAL_PORT *port, uint8_t *pb, uint32_t cb,
+**                    uint64_t nsWake, bool *pfHangup)
+**
+**  Parameters:
+**      *pb, cb         destination, cb <= URING_PORT_READ
+**      nsWake          CLOCK_MONOTONIC deadline, UINT64_MAX for none
+**      *pfHangup       set if the device went away
+**
+**  Return Values:
+**      bytes read, 0 if the deadline passed first, -1 with errno set
+**
+**  Description:
+**      Submits the poll/timeout/read chain and reaps all of it, so the
+**      ring is empty again on return.  If the ring itself fails the port
+**      drops back to the poll backend.
+*/
+static int ReadChain(SERIAL_PORT *port, uint8_t *pb, uint32_t cb, uint64_t nsWake, bool *pfHangup) {
+
+    URING                   *pring = &port->puring->ring;
+    struct io_uring_sqe     *psqe;
+    struct io_uring_cqe     *pcqe;
+    struct __kernel_timespec ts;
+    unsigned                cOut;
+    int                     revents = 0;
+    int                     resRead = -ECANCELED;
+    int                     rc;
+
+    psqe = UringSqe(pring);
+    psqe->opcode = IORING_OP_POLL_ADD;
+    psqe->fd = port->fd;
+    psqe->poll32_events = POLLIN;
+    psqe->flags = IOSQE_IO_LINK;
+    psqe->user_data = URING_OP_POLL;
+    cOut = 1;
+
+    if ( nsWake != UINT64_MAX ) {
+        ts.tv_sec = nsWake / 1000000000;
+        ts.tv_nsec = nsWake % 1000000000;
+        psqe = UringSqe(pring);
+        psqe->opcode = IORING_OP_LINK_TIMEOUT;
+        psqe->fd = -1;
+        psqe->addr = (uintptr_t)&ts;
+        psqe->len = 1;
+        psqe->timeout_flags = IORING_TIMEOUT_ABS;
+        psqe->flags = IOSQE_IO_LINK;
+        psqe->user_data = URING_OP_TIMEOUT;
+        cOut++;
+    }
+
+    psqe = UringSqe(pring);
+    psqe->opcode = IORING_OP_READ_FIXED;
+    psqe->fd = port->fd;
+    psqe->addr = (uintptr_t)port->puring->pbFixed;
+    psqe->len = cb;
+    psqe->buf_index = 0;
+    psqe->user_data = URING_OP_READ;
+    cOut++;
+
+    while ( cOut > 0 ) {
+        rc = UringEnter(pring, 1);
+        STAT_ADD_SHARED(port->stats.cUringCalls, 1);
+        if ( (rc < 0) && (errno != EINTR) ) {
+            // requests may still be queued against the ring, drop it
+            rc = errno;
+            UringPortFree(port);
+            errno = rc;
+            return -1;
+        }
+        while ( (pcqe = UringPeek(pring)) != NULL ) {
+            if ( pcqe->user_data == URING_OP_POLL ) {
+                revents = pcqe->res;
+            } else if ( pcqe->user_data == URING_OP_READ ) {
+                resRead = pcqe->res;
+            }
+            UringSeen(pring);
+            cOut--;
+        }
+    }
+
+    if ( resRead > 0 ) {
+        memcpy(pb, port->puring->pbFixed, resRead);
+        return resRead;
+    }
+    if ( (resRead == 0) || (resRead == -ECANCELED) ) {
+        // readable but empty, or nothing before the deadline
+        if ( (revents > 0) && (revents & (POLLHUP | POLLERR)) ) {
+            *pfHangup = true;
+        }
+        return 0;
+    }
+    errno = -resRead;
+    return -1;
+}
+
+/* ------------------------------------------------------------ */
+/***    UringInit
+**
+**  Synopsis:
+**      bool UringInit(URING *pring, unsigned cEntries,
+**                     const struct iovec *rgiovFixed, unsigned ciovFixed,
+**                     const uint8_t *rgopNeeded, unsigned copNeeded)
+**
+**  Parameters:
+**      cEntries        submission queue size, rounded up by the kernel
+**      *rgiovFixed     buffers to register for READ_FIXED/WRITE_FIXED
+**      *rgopNeeded     IORING_OP_* the caller is going to use
+**
+**  Return Values:
+**      true on success, false with errno set and nothing left allocated
+**
+**  Description:
+**      Sets up the ring, maps it, registers the buffers and checks the
+**      kernel knows every opcode needed, so callers can fall back to
+**      poll before they depend on any of it.
+*/
+bool UringInit(URING *pring, unsigned cEntries, const struct iovec *rgiovFixed,
+               unsigned ciovFixed, const uint8_t *rgopNeeded, unsigned copNeeded) {
+
+    struct io_uring_params  params;
+    struct io_uring_probe   *pprobe;
+    size_t                  cbProbe;
+    size_t                  cbSq;
+    unsigned                iop;
+    unsigned                i;
+    int                     err;
+
+    memset(pring, 0, sizeof(*pring));
+    pring->fd = -1;
+
+    memset(&params, 0, sizeof(params));
+    pring->fd = syscall(__NR_io_uring_setup, cEntries, &params);
+    if ( pring->fd < 0 ) {
+        return false;
+    }
+
+    cbSq = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    pring->cbCq = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    pring->cbRings = cbSq;
+    if ( (params.features & IORING_FEAT_SINGLE_MMAP) && (pring->cbCq > cbSq) ) {
+        pring->cbRings = pring->cbCq;
+    }
+    pring->pvRings = mmap(NULL, pring->cbRings, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, pring->fd, IORING_OFF_SQ_RING);
+    if ( pring->pvRings == MAP_FAILED ) {
+        pring->pvRings = NULL;
+        goto lError;
+    }
+    if ( params.features & IORING_FEAT_SINGLE_MMAP ) {
+        pring->pvCq = pring->pvRings;
+    } else {
+        pring->pvCq = mmap(NULL, pring->cbCq, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, pring->fd, IORING_OFF_CQ_RING);
+        if ( pring->pvCq == MAP_FAILED ) {
+            pring->pvCq = NULL;
+            goto lError;
+        }
+    }
+    pring->cbSqes = params.sq_entries * sizeof(struct io_uring_sqe);
+    pring->rgsqe = mmap(NULL, pring->cbSqes, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, pring->fd, IORING_OFF_SQES);
+    if ( pring->rgsqe == MAP_FAILED ) {
+        pring->rgsqe = NULL;
+        goto lError;
+    }
+
+    pring->psqHead = (unsigned *)((uint8_t *)pring->pvRings + params.sq_off.head);
+    pring->psqTail = (unsigned *)((uint8_t *)pring->pvRings + params.sq_off.tail);
+    pring->sqMask = *(unsigned *)((uint8_t *)pring->pvRings + params.sq_off.ring_mask);
+    pring->sqEntries = params.sq_entries;
+    pring->sqTail = *pring->psqTail;
+    pring->pcqHead = (unsigned *)((uint8_t *)pring->pvCq + params.cq_off.head);
+    pring->pcqTail = (unsigned *)((uint8_t *)pring->pvCq + params.cq_off.tail);
+    pring->cqMask = *(unsigned *)((uint8_t *)pring->pvCq + params.cq_off.ring_mask);
+    pring->rgcqe = (struct io_uring_cqe *)((uint8_t *)pring->pvCq + params.cq_off.cqes);
+
+    // slot i of the SQ array always names sqe i
+    for ( i = 0; i < params.sq_entries; i++ ) {
+        ((unsigned *)((uint8_t *)pring->pvRings + params.sq_off.array))[i] = i;
+    }
+
+    cbProbe = sizeof(*pprobe) + 256 * sizeof(struct io_uring_probe_op);
+    pprobe = calloc(1, cbProbe);
+    if ( pprobe == NULL ) {
+        goto lError;
+    }
+    if ( 0 != syscall(__NR_io_uring_register, pring->fd, IORING_REGISTER_PROBE, pprobe, 256) ) {
+        free(pprobe);
+        goto lError;
+    }
+    for ( iop = 0; iop < copNeeded; iop++ ) {
+        if ( (rgopNeeded[iop] > pprobe->last_op) ||
+             !(pprobe->ops[rgopNeeded[iop]].flags & IO_URING_OP_SUPPORTED) ) {
+            free(pprobe);
+            errno = EOPNOTSUPP;
+            goto lError;
+        }
+    }
+    free(pprobe);
+
+    if ( (ciovFixed > 0) &&
+         (0 != syscall(__NR_io_uring_register, pring->fd, IORING_REGISTER_BUFFERS,
+                       rgiovFixed, ciovFixed)) ) {
+        goto lError;
+    }
+
+    return true;
+
+lError:
+    err = errno;
+    UringFree(pring);
+    errno = err;
+    return false;
+}
+
+/* ------------------------------------------------------------ */
+/***    UringFree
+**
+**  Synopsis:
+**      void UringFree(URING *pring)
+**
+**  Description:
+**      Unmaps and closes the ring.  Requests still in flight are
+**      cancelled by the kernel; registered buffers must outlive any
+**      request that may still write to them.
+*/
+void UringFree(URING *pring) {
+
+    if ( pring->rgsqe != NULL ) {
+        munmap(pring->rgsqe, pring->cbSqes);
+    }
+    if ( (pring->pvCq != NULL) && (pring->pvCq != pring->pvRings) ) {
+        munmap(pring->pvCq, pring->cbCq);
+    }
+    if ( pring->pvRings != NULL ) {
+        munmap(pring->pvRings, pring->cbRings);
+    }
+    if ( pring->fd >= 0 ) {
+        close(pring->fd);
+    }
+    memset(pring, 0, sizeof(*pring));
+    pring->fd = -1;
+}
+
+/* ------------------------------------------------------------ */
+/***    UringSqe
+**
+**  Synopsis:
+**      struct io_uring_sqe *UringSqe(URING *pring)
+**
+**  Return Values:
+**      cleared submission entry, NULL if the queue is full
+**
+**  Description:
+**      The entry is only handed to the kernel by the next UringEnter().
+*/
+struct io_uring_sqe *UringSqe(URING *pring) {
+
+    struct io_uring_sqe *psqe;
+    unsigned            head;
+
+    head = __atomic_load_n(pring->psqHead, __ATOMIC_ACQUIRE);
+    if ( pring->sqTail - head >= pring->sqEntries ) {
+        return NULL;
+    }
+    psqe = &pring->rgsqe[pring->sqTail & pring->sqMask];
+    memset(psqe, 0, sizeof(*psqe));
+    pring->sqTail++;
+    pring->cUnsubmitted++;
+    return psqe;
+}
+
+/* ------------------------------------------------------------ */
+/***    UringEnter
+**
+**  Synopsis:
+**      int UringEnter(URING *pring, unsigned cWait)
+**
+**  Parameters:
+**      cWait           completions to wait for, 0 only submits
+**
+**  Return Values:
+**      0 on success, -1 with errno set
+**
+**  Description:
+**      Publishes the queued entries and submits them together with the
+**      wait, in one system call.  The kernel may return before cWait
+**      completions are posted (a signal, or with entries submitted),
+**      so callers reap what is there and enter again as needed.
+*/
+int UringEnter(URING *pring, unsigned cWait) {
+
+    unsigned    cSubmit = pring->cUnsubmitted;
+    long        rc;
+
+    __atomic_store_n(pring->psqTail, pring->sqTail, __ATOMIC_RELEASE);
+    rc = syscall(__NR_io_uring_enter, pring->fd, cSubmit, cWait,
+                 ( cWait > 0 ) ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if ( rc < 0 ) {
+        return -1;
+    }
+    pring->cUnsubmitted -= ( (unsigned)rc < cSubmit ) ? (unsigned)rc : cSubmit;
+    return 0;
+}
+
+/* ------------------------------------------------------------ */
+/***    UringPeek
+**
+**  Synopsis:
+**      struct io_uring_cqe *UringPeek(URING *pring)
+**
+**  Return Values:
+**      oldest unreaped completion, NULL if there is none.  Release it
+**      with UringSeen() once done with it.
+*/
+struct io_uring_cqe *UringPeek(URING *pring) {
+
+    unsigned    head = *pring->pcqHead;
+
+    if ( head == __atomic_load_n(pring->pcqTail, __ATOMIC_ACQUIRE) ) {
+        return NULL;
+    }
+    return &pring->rgcqe[head & pring->cqMask];
+}
+
+/* ------------------------------------------------------------ */
+/***    UringSeen
+**
+**  Synopsis:
+**      void UringSeen(URING *pring)
+**
+**  Description:
+**      Hands the completion returned by UringPeek() back to the kernel.
+*/
+void UringSeen(URING *pring) {
+
+    __atomic_store_n(pring->pcqHead, *pring->pcqHead + 1, __ATOMIC_RELEASE);
+}
+
+
+/************************************ EOF ********************************/
@@ -0,0 +1,89 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_uring.h --  EmbedCreativity's minimal io_uring wrapper           */
+/*                                                                      */
+/************************************************************************/
+/*  Author:     agent                                                   */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*  Just enough of io_uring for the library, on the raw system calls    */
+/*  so there is no liburing to depend on.  One thread submits and       */
+/*  reaps on a given URING.  Only the library's own source files        */
+/*  include this.                                                       */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026(agent): created                                          */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(_SERIALURING_H)
+#define _SERIALURING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+/* ------------------------------------------------------------ */
+/*                  Object Class Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef struct {
+    int                 fd;             // -1 until set up
+    unsigned            *psqHead;       // kernel consumes up to here
+    unsigned            *psqTail;
+    unsigned            sqMask;
+    unsigned            sqEntries;
+    unsigned            sqTail;         // local tail, published by UringEnter()
+    unsigned            cUnsubmitted;   // queued since the last UringEnter()
+    struct io_uring_sqe *rgsqe;
+    unsigned            *pcqHead;
+    unsigned            *pcqTail;       // kernel produces up to here
+    unsigned            cqMask;
+    struct io_uring_cqe *rgcqe;
+    void                *pvRings;       // SQ ring, and the CQ ring with it
+    size_t              cbRings;
+    void                *pvCq;          // CQ ring when mapped on its own
+    size_t              cbCq;
+    size_t              cbSqes;
+} URING;
+
+/* ------------------------------------------------------------ */
+/*                  Function Prototypes                         */
+/* ------------------------------------------------------------ */
+
+// ec_uring.c
+bool    UringInit(URING *pring, unsigned cEntries, const struct iovec *rgiovFixed,
+                  unsigned ciovFixed, const uint8_t *rgopNeeded, unsigned copNeeded);
+void    UringFree(URING *pring);
+struct io_uring_sqe *UringSqe(URING *pring);
+int     UringEnter(URING *pring, unsigned cWait);
+struct io_uring_cqe *UringPeek(URING *pring);
+void    UringSeen(URING *pring);
+
+/* ------------------------------------------------------------ */
+
+#endif
+
+/**********************************  EOF  **************************************/
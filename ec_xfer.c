@@ -0,0 +1,1054 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_xfer.c --  EmbedCreativity's windowed bulk transfer              */
+/*                                                                      */
+/************************************************************************/
+/*                                                                      */
+/*  Author:     agent                                                   */
+/*                                                                      */
+/************************************************************************/
+/*  Module Description:                                                 */
+/*                                                                      */
+/*  Sending an image a block at a time and waiting for each block to    */
+/*  be acknowledged leaves the line idle for a round trip per block.    */
+/*  Behind a USB adapter that is a millisecond or more each way, which  */
+/*  at 921600 baud is as long as the block itself.                      */
+/*                                                                      */
+/*  SerialXferSend() keeps up to cWindow blocks in flight instead.      */
+/*  Every frame is COBS encoded with a CRC-32 trailer, see ec_frame.c,  */
+/*  so a damaged block is simply dropped by the receiver's framer.      */
+/*  The receiver acknowledges with a selective ack: the first block it  */
+/*  still needs and a bitmap of the blocks after it that it holds.  A   */
+/*  serial line does not reorder, so a hole below a block that did      */
+/*  arrive was lost, and the sender sends just that block again at      */
+/*  once rather than waiting for a timeout or going back N.  Timeouts   */
+/*  only cover a lost tail and lost acks.                               */
+/*                                                                      */
+/*  The receiver acks after draining whatever input has arrived, so a   */
+/*  fast link gets one ack per burst and a slow one an ack per block,   */
+/*  either way without delaying the sender.  It hands the image to      */
+/*  pfnWrite in order, holding out of order blocks in its window.       */
+/*                                                                      */
+/*  A transfer is named by the sender's idXfer.  The receiver answers   */
+/*  the start with the first block it needs, which is past the part     */
+/*  it already has when idResume matches, so an interrupted transfer    */
+/*  restarts where it stopped on either side.                           */
+/*                                                                      */
+/*  Frames, before COBS and the CRC, integers little endian:            */
+/*                                                                      */
+/*    START     'S' version id:4 cbTotal:8 cbBlock:2 cWindow:2          */
+/*    DATA      'D' seq:4 payload                                       */
+/*    SACK      'A' flags seq:4 bitmap, bit i is block seq + i          */
+/*    END       'E' cBlocks:4                                           */
+/*    DONE      'F'                                                     */
+/*    ABORT     'X'                                                     */
+/*                                                                      */
+/*  Both ends need the line to themselves for the whole transfer.       */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026 (agent): created                                         */
+/*                                                                      */
+/************************************************************************/
+
+/* ------------------------------------------------------------ */
+/*              Include File Definitions                        */
+/* ------------------------------------------------------------ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "ec_serial.h"
+#include "ec_serial_priv.h"
+#include "ec_frame.h"
+#include "ec_crc.h"
+#include "ec_xfer.h"
+
+/* ------------------------------------------------------------ */
+/*              Local Type Definitions                          */
+/* ------------------------------------------------------------ */
+
+#define XFER_VERSION        1
+
+#define XFER_START          'S'
+#define XFER_DATA           'D'
+#define XFER_SACK           'A'
+#define XFER_END            'E'
+#define XFER_DONE           'F'
+#define XFER_ABORT          'X'
+
+#define XFER_SACK_START     0x01    // SACK flag, answers a START
+
+#define CB_START            18
+#define CB_DATA_HDR         5
+#define CB_SACK_HDR         6
+#define CB_END              5
+#define CB_FRAME_MAX        (CB_DATA_HDR + SERIAL_XFER_BLOCK_MAX)
+
+#define XFER_NONE           UINT32_MAX
+#define XFER_BITS_PER_CHAR  10      // 8N1
+#define XFER_MS_SLACK       50      // added to the computed timeout for adapter latency
+
+// One end of a transfer
+typedef struct {
+    SERIAL_PORT         *port;
+    SERIAL_XFER_CFG     cfg;
+    SERIAL_FRAME_CFG    fcfg;
+    SERIAL_FRAMER       *pfr;
+    SERIAL_XFER_STATS   stats;
+    uint64_t            nsStart;
+    uint32_t            msTimeout;
+    uint64_t            nsProgress;     // a wait without progress ends here
+    uint32_t            cStall;         // timeouts in a row
+    bool                fStarted;       // START answered
+    uint32_t            idXfer;
+    uint32_t            cBlocks;
+    uint32_t            seqBase;        // first block not acknowledged, or not yet taken by pfnWrite
+    uint8_t             *rgfHave;       // per window slot, acknowledged or held
+
+    // sender
+    const uint8_t       *pbImage;
+    uint32_t            seqNext;        // next block never sent
+    uint64_t            *rgtx;          // per window slot, order of its last send
+    uint64_t            ctx;            // sends so far
+    uint64_t            txHigh;         // latest send known to have arrived
+
+    // receiver
+    uint8_t             *pbWindow;      // cWindow blocks
+    uint32_t            seqHigh;        // one past the highest block received
+    uint32_t            cUnacked;       // blocks received since the last SACK
+    uint32_t            cAckEvery;
+
+    uint8_t             rgbFrame[CB_FRAME_MAX];
+    uint8_t             *pbWire;        // rgbFrame encoded
+    size_t              cbWireMax;
+} XFER;
+
+/* ------------------------------------------------------------ */
+/*              Forward Declarations                            */
+/* ------------------------------------------------------------ */
+
+static XFER     *XferCreate( SERIAL_PORT *port, const SERIAL_XFER_CFG *pcfg );
+static void     XferDestroy( XFER *px, SERIAL_XFER_STATS *pstats );
+static uint32_t XferTimeoutMs( XFER *px );
+static uint32_t TxNextSeq( XFER *px );
+static bool     TxSendBlock( XFER *px, uint32_t seq );
+static bool     TxSendStart( XFER *px );
+static bool     TxOnFrame( XFER *px, const uint8_t *pb, int cb, SERIAL_XFER_STATUS *pstatus );
+static bool     TxAdvance( XFER *px, uint32_t seq, SERIAL_XFER_STATUS *pstatus );
+static bool     TxTimeout( XFER *px, SERIAL_XFER_STATUS *pstatus );
+static bool     RxOnFrame( XFER *px, const uint8_t *pb, int cb, SERIAL_XFER_STATUS *pstatus );
+static bool     RxBegin( XFER *px, const uint8_t *pb, SERIAL_XFER_STATUS *pstatus );
+static bool     RxData( XFER *px, const uint8_t *pb, int cb, SERIAL_XFER_STATUS *pstatus );
+static bool     SendSack( XFER *px, uint8_t flags );
+static bool     SendByte( XFER *px, uint8_t bType );
+static bool     SendFrame( XFER *px, size_t cb );
+static int      ReadFrame( XFER *px, const uint8_t **ppb, uint32_t timeOutMs );
+static bool     Progress( XFER *px );
+static void     Stalled( XFER *px, bool fReset );
+static size_t   BlockSize( XFER *px, uint32_t seq );
+static uint32_t MsUntil( uint64_t nsDeadline );
+static void     Put16( uint8_t *pb, uint16_t w );
+static void     Put32( uint8_t *pb, uint32_t dw );
+static void     Put64( uint8_t *pb, uint64_t qw );
+static uint16_t Get16( const uint8_t *pb );
+static uint32_t Get32( const uint8_t *pb );
+static uint64_t Get64( const uint8_t *pb );
+
+/* ------------------------------------------------------------ */
+/*              Procedure Definitions                           */
+/* ------------------------------------------------------------ */
+
+/* ------------------------------------------------------------ */
+/***    SerialXferSend
+**
+**  Synopsis:
+**      SERIAL_XFER_STATUS SerialXferSend(SERIAL_PORT *port,
+**                                        const SERIAL_XFER_CFG *pcfg,
+**                                        uint32_t idXfer, const void *pv,
+**                                        size_t cb, SERIAL_XFER_STATS *pstats)
+**
+**  Parameters:
+**      *port           port the receiver is on
+**      *pcfg           window, timing and progress, NULL for the defaults
+**      idXfer          names the image, so the receiver can resume it
+**      *pv             the image
+**      cb              its size
+**      *pstats         receives the counts, may be NULL
+**
+**  Return Values:
+**      SERIAL_XFER_OK once the receiver has acknowledged every block
+**
+**  Errors:
+**      with SERIAL_XFER_ERROR, EINVAL for a block or window above the
+**      maximum, ENOMEM, otherwise errno from SerialPortWrite() or
+**      SerialPortReadEx()
+**
+**  Description:
+**      Sends the START, skips whatever the receiver reports it already
+**      has, and streams the rest.  pfnProgress is called whenever the
+**      acknowledged part grows.  A timeout is msTimeout without a new
+**      block acknowledged; the oldest block is then sent again, and from
+**      the second timeout in a row the START as well, in case the
+**      receiver was restarted.  The default msTimeout covers a quarter
+**      window on the wire at the port's baud rate.
+*/
+SERIAL_XFER_STATUS SerialXferSend(SERIAL_PORT *port, const SERIAL_XFER_CFG *pcfg, uint32_t idXfer,
+                                  const void *pv, size_t cb, SERIAL_XFER_STATS *pstats) {
+
+    XFER                *px;
+    SERIAL_XFER_STATUS  status = SERIAL_XFER_ERROR;
+    const uint8_t       *pbIn;
+    uint64_t            cBlocks;
+    uint32_t            seq;
+    int                 rc;
+
+    px = XferCreate(port, pcfg);
+    if ( px == NULL ) {
+        return SERIAL_XFER_ERROR;
+    }
+    cBlocks = ((uint64_t)cb + px->cfg.cbBlock - 1) / px->cfg.cbBlock;
+    if ( cBlocks >= XFER_NONE ) {
+        errno = EINVAL;
+        goto lDone;
+    }
+    px->rgtx = calloc(px->cfg.cWindow, sizeof(*px->rgtx));
+    px->rgfHave = calloc(px->cfg.cWindow, sizeof(*px->rgfHave));
+    if ( (px->rgtx == NULL) || (px->rgfHave == NULL) ) {
+        goto lDone;
+    }
+    px->idXfer = idXfer;
+    px->pbImage = pv;
+    px->cBlocks = (uint32_t)cBlocks;
+    px->stats.cbTotal = cb;
+    px->msTimeout = XferTimeoutMs(px);
+    if ( !TxSendStart(px) ) {
+        goto lDone;
+    }
+    Stalled(px, true);
+
+    for ( ; ; ) {
+        // take in every ack that has arrived, only wait when there is nothing to send
+        seq = TxNextSeq(px);
+        rc = ReadFrame(px, &pbIn, ( seq != XFER_NONE ) ? 0 : MsUntil(px->nsProgress));
+        if ( rc > 0 ) {
+            if ( TxOnFrame(px, pbIn, rc, &status) ) {
+                break;
+            }
+            continue;
+        }
+        if ( rc == SERIAL_ERROR_CODE ) {
+            break;
+        }
+        if ( seq != XFER_NONE ) {
+            if ( !TxSendBlock(px, seq) ) {
+                break;
+            }
+        } else if ( (MonoNowNs() >= px->nsProgress) && TxTimeout(px, &status) ) {
+            break;
+        }
+    }
+
+lDone:
+    XferDestroy(px, pstats);
+    return status;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialXferReceive
+**
+**  Synopsis:
+**      SERIAL_XFER_STATUS SerialXferReceive(SERIAL_PORT *port,
+**                                           const SERIAL_XFER_CFG *pcfg,
+**                                           SERIAL_XFER_STATS *pstats)
+**
+**  Parameters:
+**      *port           port the sender is on
+**      *pcfg           pfnWrite and, to resume, idResume and cbResume
+**      *pstats         receives the counts, may be NULL
+**
+**  Return Values:
+**      SERIAL_XFER_OK once pfnWrite has taken the whole image
+**
+**  Errors:
+**      with SERIAL_XFER_ERROR, EINVAL without pfnWrite, EPROTO for a
+**      START this end cannot take, ENOMEM, otherwise errno from
+**      SerialPortWrite() or SerialPortReadEx()
+**
+**  Description:
+**      Waits msTimeout * (cRetry + 1) for the START, then takes the
+**      image with the sender's block and window sizes.  pfnWrite gets
+**      it in order, each block once, and pfnProgress after each batch.
+**      If the START names idResume, the transfer continues after the
+**      first cbResume bytes, which pfnWrite is not given again.  Save
+**      the cbDone of the progress calls to resume after a crash.  A
+**      START for another image, or a restarted sender, starts over
+**      within the same call.
+*/
+SERIAL_XFER_STATUS SerialXferReceive(SERIAL_PORT *port, const SERIAL_XFER_CFG *pcfg,
+                                     SERIAL_XFER_STATS *pstats) {
+
+    XFER                *px;
+    SERIAL_XFER_STATUS  status = SERIAL_XFER_ERROR;
+    const uint8_t       *pbIn;
+    int                 rc;
+
+    if ( (pcfg == NULL) || (pcfg->pfnWrite == NULL) ) {
+        errno = EINVAL;
+        return SERIAL_XFER_ERROR;
+    }
+    px = XferCreate(port, pcfg);
+    if ( px == NULL ) {
+        return SERIAL_XFER_ERROR;
+    }
+    px->msTimeout = XferTimeoutMs(px);
+    px->nsProgress = MonoNowNs() + (uint64_t)px->msTimeout * (px->cfg.cRetry + 1) * 1000000;
+
+    for ( ; ; ) {
+        // ack once the input is drained, so a burst of blocks costs one SACK
+        rc = ReadFrame(px, &pbIn, ( px->cUnacked > 0 ) ? 0 : MsUntil(px->nsProgress));
+        if ( rc > 0 ) {
+            if ( RxOnFrame(px, pbIn, rc, &status) ) {
+                break;
+            }
+            continue;
+        }
+        if ( rc == SERIAL_ERROR_CODE ) {
+            break;
+        }
+        if ( px->cUnacked > 0 ) {
+            if ( !SendSack(px, 0) ) {
+                break;
+            }
+            continue;
+        }
+        if ( MonoNowNs() < px->nsProgress ) {
+            continue;
+        }
+
+        // the sender went quiet, repeat the SACK in case it was lost
+        if ( !px->fStarted ) {
+            status = SERIAL_XFER_TIMEOUT;
+            break;
+        }
+        px->stats.cTimeouts++;
+        if ( ++px->cStall > px->cfg.cRetry ) {
+            // with every block taken, only the END or its DONE went missing
+            status = ( px->seqBase >= px->cBlocks ) ? SERIAL_XFER_OK : SERIAL_XFER_TIMEOUT;
+            break;
+        }
+        if ( !SendSack(px, 0) ) {
+            break;
+        }
+        Stalled(px, false);
+    }
+
+    XferDestroy(px, pstats);
+    return status;
+}
+
+/* ------------------------------------------------------------ */
+/***    SerialXferStatusName
+**
+**  Synopsis:
+**      const char *SerialXferStatusName(SERIAL_XFER_STATUS status)
+**
+**  Return Values:
+**      short lower case name of status, for logs
+*/
+const char *SerialXferStatusName(SERIAL_XFER_STATUS status) {
+
+    switch ( status ) {
+        case SERIAL_XFER_OK:        return "ok";
+        case SERIAL_XFER_TIMEOUT:   return "timeout";
+        case SERIAL_XFER_CANCELLED: return "cancelled";
+        case SERIAL_XFER_ABORTED:   return "aborted";
+        default:                    return "error";
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    XferCreate
+**
+**  Synopsis:
+**      static XFER *XferCreate(SERIAL_PORT *port, const SERIAL_XFER_CFG *pcfg)
+**
+**  Description:
+**      Allocates one end with the defaults filled in and a COBS framer
+**      with a CRC-32 trailer.  NULL with errno set on failure.
+*/
+static XFER *XferCreate(SERIAL_PORT *port, const SERIAL_XFER_CFG *pcfg) {
+
+    XFER        *px;
+
+    px = calloc(1, sizeof(*px));
+    if ( px == NULL ) {
+        return NULL;
+    }
+    if ( pcfg != NULL ) {
+        px->cfg = *pcfg;
+    }
+    if ( px->cfg.cbBlock == 0 ) {
+        px->cfg.cbBlock = SERIAL_XFER_BLOCK_DEFAULT;
+    }
+    if ( px->cfg.cWindow == 0 ) {
+        px->cfg.cWindow = SERIAL_XFER_WINDOW_DEFAULT;
+    }
+    if ( px->cfg.cRetry == 0 ) {
+        px->cfg.cRetry = SERIAL_XFER_RETRY_DEFAULT;
+    }
+    if ( (px->cfg.cbBlock > SERIAL_XFER_BLOCK_MAX) || (px->cfg.cWindow > SERIAL_XFER_WINDOW_MAX) ) {
+        free(px);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    px->port = port;
+    px->fcfg.type = SERIAL_FRAME_COBS;
+    px->fcfg.crc = SERIAL_CRC32;
+    px->fcfg.cbMaxFrame = CB_FRAME_MAX + SerialCrcSize(SERIAL_CRC32);
+    px->cbWireMax = SerialFrameEncodedMax(&px->fcfg, CB_FRAME_MAX);
+    px->pbWire = malloc(px->cbWireMax);
+    px->pfr = SerialFramerCreate(&px->fcfg);
+    if ( (px->pbWire == NULL) || (px->pfr == NULL) ) {
+        XferDestroy(px, NULL);
+        return NULL;
+    }
+    px->nsStart = MonoNowNs();
+    return px;
+}
+
+/* Frees one end, after handing out its counts. */
+static void XferDestroy(XFER *px, SERIAL_XFER_STATS *pstats) {
+
+    int         errnoSave = errno;
+
+    if ( pstats != NULL ) {
+        px->stats.cCrcErrors = ( px->pfr != NULL ) ? SerialFramerDropped(px->pfr) : 0;
+        px->stats.nsElapsed = MonoNowNs() - px->nsStart;
+        *pstats = px->stats;
+    }
+    SerialFramerDestroy(px->pfr);
+    free(px->pbWire);
+    free(px->rgfHave);
+    free(px->rgtx);
+    free(px->pbWindow);
+    free(px);
+    errno = errnoSave;
+}
+
+/* msTimeout, or long enough for a quarter window and two blocks on the wire. */
+static uint32_t XferTimeoutMs(XFER *px) {
+
+    uint64_t    cbWire;
+    int         baudRate;
+
+    if ( px->cfg.msTimeout != 0 ) {
+        return px->cfg.msTimeout;
+    }
+    baudRate = SerialPortGetBaud(px->port);
+    if ( baudRate <= 0 ) {
+        baudRate = 9600;
+    }
+    cbWire = (uint64_t)(px->cfg.cbBlock + CB_DATA_HDR + 8) * (px->cfg.cWindow / 4 + 2);
+    return (uint32_t)(cbWire * XFER_BITS_PER_CHAR * 1000 / baudRate) + XFER_MS_SLACK;
+}
+
+/* ------------------------------------------------------------ */
+/***    TxNextSeq
+**
+**  Synopsis:
+**      static uint32_t TxNextSeq(XFER *px)
+**
+**  Return Values:
+**      block to send now, XFER_NONE to wait for acks
+**
+**  Description:
+**      A block that was sent before one the receiver has, and is not
+**      acknowledged itself, was lost; those go first, oldest first.
+**      Otherwise the next new block while the window has room.
+*/
+static uint32_t TxNextSeq(XFER *px) {
+
+    uint32_t    seq;
+    uint32_t    islot;
+
+    if ( !px->fStarted || (px->seqBase >= px->cBlocks) ) {
+        return XFER_NONE;
+    }
+    for ( seq = px->seqBase; seq < px->seqNext; seq++ ) {
+        islot = seq % px->cfg.cWindow;
+        if ( !px->rgfHave[islot] && (px->rgtx[islot] < px->txHigh) ) {
+            return seq;
+        }
+    }
+    if ( (px->seqNext < px->cBlocks) && (px->seqNext - px->seqBase < px->cfg.cWindow) ) {
+        return px->seqNext;
+    }
+    return XFER_NONE;
+}
+
+/* Sends block seq, new or again. */
+static bool TxSendBlock(XFER *px, uint32_t seq) {
+
+    uint32_t    islot = seq % px->cfg.cWindow;
+    size_t      cb = BlockSize(px, seq);
+
+    if ( seq == px->seqNext ) {
+        px->seqNext++;
+        px->rgfHave[islot] = false;
+        px->stats.cBlocks++;
+    } else {
+        px->stats.cRetransmits++;
+    }
+    px->rgtx[islot] = ++px->ctx;
+
+    px->rgbFrame[0] = XFER_DATA;
+    Put32(px->rgbFrame + 1, seq);
+    memcpy(px->rgbFrame + CB_DATA_HDR, px->pbImage + (uint64_t)seq * px->cfg.cbBlock, cb);
+    return SendFrame(px, CB_DATA_HDR + cb);
+}
+
+/* Sends the START describing the image. */
+static bool TxSendStart(XFER *px) {
+
+    px->rgbFrame[0] = XFER_START;
+    px->rgbFrame[1] = XFER_VERSION;
+    Put32(px->rgbFrame + 2, px->idXfer);
+    Put64(px->rgbFrame + 6, px->stats.cbTotal);
+    Put16(px->rgbFrame + 14, (uint16_t)px->cfg.cbBlock);
+    Put16(px->rgbFrame + 16, (uint16_t)px->cfg.cWindow);
+    return SendFrame(px, CB_START);
+}
+
+/* ------------------------------------------------------------ */
+/***    TxOnFrame
+**
+**  Synopsis:
+**      static bool TxOnFrame(XFER *px, const uint8_t *pb, int cb,
+**                            SERIAL_XFER_STATUS *pstatus)
+**
+**  Return Values:
+**      1               the transfer is over, see *pstatus
+**      0               carry on
+**
+**  Description:
+**      Applies a frame from the receiver.  A SACK answering a START sets
+**      where the blocks start, whatever was sent before.  Others move
+**      the window up and mark the blocks received beyond it.
+*/
+static bool TxOnFrame(XFER *px, const uint8_t *pb, int cb, SERIAL_XFER_STATUS *pstatus) {
+
+    const uint8_t   *pbBitmap;
+    uint32_t        seqAck;
+    uint32_t        seq;
+    uint32_t        islot;
+    size_t          cBits;
+    size_t          ibit;
+
+    switch ( pb[0] ) {
+        case XFER_ABORT:
+            *pstatus = SERIAL_XFER_ABORTED;
+            return true;
+        case XFER_DONE:
+            if ( px->fStarted && (px->seqBase >= px->cBlocks) ) {
+                *pstatus = SERIAL_XFER_OK;
+                return true;
+            }
+            return false;
+        case XFER_SACK:
+            if ( cb >= CB_SACK_HDR ) {
+                break;
+            }
+            return false;
+        default:
+            return false;
+    }
+
+    seqAck = Get32(pb + 2);
+    pbBitmap = pb + CB_SACK_HDR;
+    cBits = (size_t)(cb - CB_SACK_HDR) * 8;
+
+    if ( pb[1] & XFER_SACK_START ) {
+        // the receiver's own idea of where to start, resumed or restarted
+        if ( seqAck > px->cBlocks ) {
+            seqAck = px->cBlocks;
+        }
+        if ( !px->fStarted ) {
+            px->stats.cbResumed = (uint64_t)seqAck * px->cfg.cbBlock;
+            if ( px->stats.cbResumed > px->stats.cbTotal ) {
+                px->stats.cbResumed = px->stats.cbTotal;
+            }
+        }
+        px->fStarted = true;
+        px->seqBase = seqAck;
+        px->seqNext = seqAck;
+        px->txHigh = px->ctx;
+        return TxAdvance(px, seqAck, pstatus);
+    }
+    if ( !px->fStarted || (seqAck < px->seqBase) || (seqAck > px->seqNext) ) {
+        return false;   // stale
+    }
+
+    if ( seqAck > px->seqBase ) {
+        // everything below seqAck arrived, so did the last send of seqAck - 1
+        islot = (seqAck - 1) % px->cfg.cWindow;
+        if ( px->rgtx[islot] > px->txHigh ) {
+            px->txHigh = px->rgtx[islot];
+        }
+        px->seqBase = seqAck;
+        if ( TxAdvance(px, seqAck, pstatus) ) {
+            return true;
+        }
+    }
+    for ( ibit = 1; (ibit < cBits) && (ibit < px->cfg.cWindow); ibit++ ) {
+        seq = seqAck + (uint32_t)ibit;
+        if ( seq >= px->seqNext ) {
+            break;
+        }
+        islot = seq % px->cfg.cWindow;
+        if ( (pbBitmap[ibit / 8] & (1 << (ibit % 8))) && !px->rgfHave[islot] ) {
+            px->rgfHave[islot] = true;
+            if ( px->rgtx[islot] > px->txHigh ) {
+                px->txHigh = px->rgtx[islot];
+            }
+            Stalled(px, true);
+        }
+    }
+    return false;
+}
+
+/* The receiver has everything below seq, report it and send the END once it is all there. */
+static bool TxAdvance(XFER *px, uint32_t seq, SERIAL_XFER_STATUS *pstatus) {
+
+    px->stats.cbDone = (uint64_t)seq * px->cfg.cbBlock;
+    if ( px->stats.cbDone > px->stats.cbTotal ) {
+        px->stats.cbDone = px->stats.cbTotal;
+    }
+    Stalled(px, true);
+    if ( !Progress(px) ) {
+        SendByte(px, XFER_ABORT);
+        *pstatus = SERIAL_XFER_CANCELLED;
+        return true;
+    }
+    if ( seq >= px->cBlocks ) {
+        px->rgbFrame[0] = XFER_END;
+        Put32(px->rgbFrame + 1, px->cBlocks);
+        if ( !SendFrame(px, CB_END) ) {
+            *pstatus = SERIAL_XFER_ERROR;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------ */
+/***    TxTimeout
+**
+**  Synopsis:
+**      static bool TxTimeout(XFER *px, SERIAL_XFER_STATUS *pstatus)
+**
+**  Description:
+**      msTimeout passed without progress.  Repeats whatever would make
+**      the receiver answer: the START, the END, or the oldest block,
+**      with the START as well from the second timeout on.  Gives up
+**      after cRetry in a row; once every block is acknowledged that is
+**      still a success, only the DONE went missing.
+*/
+static bool TxTimeout(XFER *px, SERIAL_XFER_STATUS *pstatus) {
+
+    bool        fSent;
+
+    px->stats.cTimeouts++;
+    if ( ++px->cStall > px->cfg.cRetry ) {
+        *pstatus = ( px->fStarted && (px->seqBase >= px->cBlocks) ) ? SERIAL_XFER_OK : SERIAL_XFER_TIMEOUT;
+        return true;
+    }
+    Stalled(px, false);
+
+    if ( !px->fStarted ) {
+        fSent = TxSendStart(px);
+    } else if ( px->seqBase >= px->cBlocks ) {
+        px->rgbFrame[0] = XFER_END;
+        Put32(px->rgbFrame + 1, px->cBlocks);
+        fSent = SendFrame(px, CB_END);
+    } else {
+        fSent = TxSendBlock(px, px->seqBase) && ((px->cStall < 2) || TxSendStart(px));
+    }
+    if ( !fSent ) {
+        *pstatus = SERIAL_XFER_ERROR;
+        return true;
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------ */
+/***    RxOnFrame
+**
+**  Synopsis:
+**      static bool RxOnFrame(XFER *px, const uint8_t *pb, int cb,
+**                            SERIAL_XFER_STATUS *pstatus)
+**
+**  Return Values:
+**      1               the transfer is over, see *pstatus
+**      0               carry on
+**
+**  Description:
+**      Applies a frame from the sender.  Blocks before the START are
+**      left over from an earlier transfer and ignored.
+*/
+static bool RxOnFrame(XFER *px, const uint8_t *pb, int cb, SERIAL_XFER_STATUS *pstatus) {
+
+    if ( px->fStarted ) {
+        Stalled(px, true);
+    }
+
+    switch ( pb[0] ) {
+        case XFER_START:
+            if ( (cb != CB_START) || (pb[1] != XFER_VERSION) ) {
+                SendByte(px, XFER_ABORT);
+                errno = EPROTO;
+                *pstatus = SERIAL_XFER_ERROR;
+                return true;
+            }
+            if ( RxBegin(px, pb, pstatus) ) {
+                return true;
+            }
+            Stalled(px, true);
+            if ( !SendSack(px, XFER_SACK_START) ) {
+                *pstatus = SERIAL_XFER_ERROR;
+                return true;
+            }
+            return false;
+
+        case XFER_DATA:
+            if ( !px->fStarted || (cb <= CB_DATA_HDR) ) {
+                return false;
+            }
+            return RxData(px, pb, cb, pstatus);
+
+        case XFER_END:
+            if ( px->fStarted && (px->seqBase >= px->cBlocks) ) {
+                SendByte(px, XFER_DONE);
+                *pstatus = SERIAL_XFER_OK;
+                return true;
+            }
+            if ( px->fStarted && !SendSack(px, 0) ) {
+                *pstatus = SERIAL_XFER_ERROR;
+                return true;
+            }
+            return false;
+
+        case XFER_ABORT:
+            *pstatus = SERIAL_XFER_ABORTED;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/* ------------------------------------------------------------ */
+/***    RxBegin
+**
+**  Synopsis:
+**      static bool RxBegin(XFER *px, const uint8_t *pb,
+**                          SERIAL_XFER_STATUS *pstatus)
+**
+**  Description:
+**      Takes on the transfer a START describes.  A repeated START for
+**      the transfer already running keeps its state, the SACK that
+**      answers it tells the sender where to carry on.  Returns true if
+**      the START cannot be taken.
+*/
+static bool RxBegin(XFER *px, const uint8_t *pb, SERIAL_XFER_STATUS *pstatus) {
+
+    uint32_t    idXfer = Get32(pb + 2);
+    uint64_t    cbTotal = Get64(pb + 6);
+    uint32_t    cbBlock = Get16(pb + 14);
+    uint32_t    cWindow = Get16(pb + 16);
+    uint64_t    cBlocks;
+
+    if ( px->fStarted && (idXfer == px->idXfer) && (cbTotal == px->stats.cbTotal) &&
+         (cbBlock == px->cfg.cbBlock) && (cWindow == px->cfg.cWindow) ) {
+        return false;
+    }
+
+    cBlocks = ( cbBlock > 0 ) ? (cbTotal + cbBlock - 1) / cbBlock : 0;
+    if ( (cbBlock == 0) || (cbBlock > SERIAL_XFER_BLOCK_MAX) ||
+         (cWindow == 0) || (cWindow > SERIAL_XFER_WINDOW_MAX) || (cBlocks >= XFER_NONE) ) {
+        SendByte(px, XFER_ABORT);
+        errno = EPROTO;
+        *pstatus = SERIAL_XFER_ERROR;
+        return true;
+    }
+
+    free(px->pbWindow);
+    free(px->rgfHave);
+    px->pbWindow = malloc((size_t)cWindow * cbBlock);
+    px->rgfHave = calloc(cWindow, sizeof(*px->rgfHave));
+    if ( (px->pbWindow == NULL) || (px->rgfHave == NULL) ) {
+        *pstatus = SERIAL_XFER_ERROR;
+        return true;
+    }
+
+    px->fStarted = true;
+    px->idXfer = idXfer;
+    px->cfg.cbBlock = cbBlock;
+    px->cfg.cWindow = cWindow;
+    px->cBlocks = (uint32_t)cBlocks;
+    px->cAckEvery = ( cWindow >= 4 ) ? cWindow / 4 : 1;
+    px->msTimeout = XferTimeoutMs(px);
+    px->stats.cbTotal = cbTotal;
+    px->seqBase = 0;
+    if ( (idXfer == px->cfg.idResume) && (px->cfg.cbResume > 0) ) {
+        px->seqBase = ( px->cfg.cbResume / cbBlock < cBlocks ) ? (uint32_t)(px->cfg.cbResume / cbBlock) :
+                                                               px->cBlocks;
+    }
+    px->seqHigh = px->seqBase;
+    px->cUnacked = 0;
+    px->stats.cbResumed = (uint64_t)px->seqBase * cbBlock;
+    if ( px->stats.cbResumed > cbTotal ) {
+        px->stats.cbResumed = cbTotal;
+    }
+    px->stats.cbDone = px->stats.cbResumed;
+    SERIAL_LOG(SERIAL_LOG_DEBUG, "SERIAL %s: receiving %08x, %llu bytes from %llu, %u x %u",
+               px->port->szDevice, idXfer, (unsigned long long)cbTotal,
+               (unsigned long long)px->stats.cbResumed, cWindow, cbBlock);
+    return false;
+}
+
+/* ------------------------------------------------------------ */
+/***    RxData
+**
+**  Synopsis:
+**      static bool RxData(XFER *px, const uint8_t *pb, int cb,
+**                         SERIAL_XFER_STATUS *pstatus)
+**
+**  Description:
+**      Holds a block in the window and hands every block that is now in
+**      order to pfnWrite.  Acks at once for a duplicate or a block after
+**      a hole, which is what tells the sender to repeat the missing one.
+*/
+static bool RxData(XFER *px, const uint8_t *pb, int cb, SERIAL_XFER_STATUS *pstatus) {
+
+    uint32_t    seq = Get32(pb + 1);
+    uint32_t    islot;
+    size_t      cbBlock;
+    bool        fAckNow;
+    bool        fDelivered = false;
+
+    if ( (seq >= px->cBlocks) || ((size_t)cb - CB_DATA_HDR != BlockSize(px, seq)) ) {
+        return false;
+    }
+    islot = seq % px->cfg.cWindow;
+    if ( (seq < px->seqBase) || ((seq - px->seqBase < px->cfg.cWindow) && px->rgfHave[islot]) ) {
+        // our ack went missing, or the sender timed out
+        px->stats.cRetransmits++;
+        if ( !SendSack(px, 0) ) {
+            *pstatus = SERIAL_XFER_ERROR;
+            return true;
+        }
+        return false;
+    }
+    if ( seq - px->seqBase >= px->cfg.cWindow ) {
+        return false;
+    }
+
+    memcpy(px->pbWindow + (size_t)islot * px->cfg.cbBlock, pb + CB_DATA_HDR, (size_t)cb - CB_DATA_HDR);
+    px->rgfHave[islot] = true;
+    px->stats.cBlocks++;
+    px->cUnacked++;
+    fAckNow = ( seq != px->seqHigh );
+    if ( seq >= px->seqHigh ) {
+        px->seqHigh = seq + 1;
+    }
+
+    while ( (px->seqBase < px->cBlocks) && px->rgfHave[px->seqBase % px->cfg.cWindow] ) {
+        islot = px->seqBase % px->cfg.cWindow;
+        cbBlock = BlockSize(px, px->seqBase);
+        if ( !px->cfg.pfnWrite(px->cfg.pvCtx, (uint64_t)px->seqBase * px->cfg.cbBlock,
+                               px->pbWindow + (size_t)islot * px->cfg.cbBlock, cbBlock) ) {
+            SendByte(px, XFER_ABORT);
+            *pstatus = SERIAL_XFER_CANCELLED;
+            return true;
+        }
+        px->rgfHave[islot] = false;
+        px->seqBase++;
+        px->stats.cbDone += cbBlock;
+        fDelivered = true;
+    }
+    if ( fDelivered && !Progress(px) ) {
+        SendByte(px, XFER_ABORT);
+        *pstatus = SERIAL_XFER_CANCELLED;
+        return true;
+    }
+
+    if ( fAckNow || (px->cUnacked >= px->cAckEvery) || (px->seqBase >= px->cBlocks) ) {
+        if ( !SendSack(px, 0) ) {
+            *pstatus = SERIAL_XFER_ERROR;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------ */
+/***    SendSack
+**
+**  Synopsis:
+**      static bool SendSack(XFER *px, uint8_t flags)
+**
+**  Description:
+**      Tells the sender the first block still needed and which of the
+**      window after it are held.
+*/
+static bool SendSack(XFER *px, uint8_t flags) {
+
+    uint32_t    ibit;
+    size_t      cbBitmap = (px->cfg.cWindow + 7) / 8;
+
+    px->rgbFrame[0] = XFER_SACK;
+    px->rgbFrame[1] = flags;
+    Put32(px->rgbFrame + 2, px->seqBase);
+    memset(px->rgbFrame + CB_SACK_HDR, 0, cbBitmap);
+    for ( ibit = 1; ibit < px->cfg.cWindow; ibit++ ) {
+        if ( px->rgfHave[(px->seqBase + ibit) % px->cfg.cWindow] &&
+             (px->seqBase + ibit < px->seqHigh) ) {
+            px->rgbFrame[CB_SACK_HDR + ibit / 8] |= 1 << (ibit % 8);
+        }
+    }
+    px->cUnacked = 0;
+    return SendFrame(px, CB_SACK_HDR + cbBitmap);
+}
+
+/* Sends a frame that is just its type. */
+static bool SendByte(XFER *px, uint8_t bType) {
+
+    px->rgbFrame[0] = bType;
+    return SendFrame(px, 1);
+}
+
+/* Encodes the first cb bytes of rgbFrame and writes them, errno set on failure. */
+static bool SendFrame(XFER *px, size_t cb) {
+
+    size_t      cbWire;
+    int         rc;
+
+    cbWire = SerialFrameEncode(&px->fcfg, px->rgbFrame, cb, px->pbWire, px->cbWireMax);
+    rc = SerialPortWrite(px->port, px->pbWire, cbWire, 0);
+    if ( rc == (int)cbWire ) {
+        return true;
+    }
+    if ( rc >= 0 ) {
+        errno = EIO;
+    }
+    return false;
+}
+
+/* SerialPortReadFrame() that skips empty frames, line noise between two zeros. */
+static int ReadFrame(XFER *px, const uint8_t **ppb, uint32_t timeOutMs) {
+
+    int         rc;
+
+    do {
+        rc = SerialPortReadFrame(px->port, px->pfr, ppb, timeOutMs);
+    } while ( rc == 0 );
+    return rc;
+}
+
+/* Runs pfnProgress, false if it cancelled the transfer. */
+static bool Progress(XFER *px) {
+
+    if ( px->cfg.pfnProgress == NULL ) {
+        return true;
+    }
+    return px->cfg.pfnProgress(px->cfg.pvCtx, px->stats.cbDone, px->stats.cbTotal);
+}
+
+/* Restarts the no progress timer, fReset also clears the timeouts in a row. */
+static void Stalled(XFER *px, bool fReset) {
+
+    if ( fReset ) {
+        px->cStall = 0;
+    }
+    px->nsProgress = MonoNowNs() + (uint64_t)px->msTimeout * 1000000;
+}
+
+/* Payload size of block seq, only the last one is short. */
+static size_t BlockSize(XFER *px, uint32_t seq) {
+
+    uint64_t    ib = (uint64_t)seq * px->cfg.cbBlock;
+
+    return ( px->stats.cbTotal - ib < px->cfg.cbBlock ) ? (size_t)(px->stats.cbTotal - ib) : px->cfg.cbBlock;
+}
+
+/* Milliseconds left until nsDeadline, rounded up. */
+static uint32_t MsUntil(uint64_t nsDeadline) {
+
+    uint64_t    nsNow;
+
+    nsNow = MonoNowNs();
+    if ( nsNow >= nsDeadline ) {
+        return 0;
+    }
+    return (uint32_t)((nsDeadline - nsNow + 999999) / 1000000);
+}
+
+/* Little endian fields of the frames. */
+static void Put16(uint8_t *pb, uint16_t w) {
+
+    pb[0] = (uint8_t)w;
+    pb[1] = (uint8_t)(w >> 8);
+}
+
+static void Put32(uint8_t *pb, uint32_t dw) {
+
+    Put16(pb, (uint16_t)dw);
+    Put16(pb + 2, (uint16_t)(dw >> 16));
+}
+
+static void Put64(uint8_t *pb, uint64_t qw) {
+
+    Put32(pb, (uint32_t)qw);
+    Put32(pb + 4, (uint32_t)(qw >> 32));
+}
+
+static uint16_t Get16(const uint8_t *pb) {
+
+    return (uint16_t)(pb[0] | (pb[1] << 8));
+}
+
+static uint32_t Get32(const uint8_t *pb) {
+
+    return Get16(pb) | ((uint32_t)Get16(pb + 2) << 16);
+}
+
+static uint64_t Get64(const uint8_t *pb) {
+
+    return Get32(pb) | ((uint64_t)Get32(pb + 4) << 32);
+}
+
+
+/************************************ EOF ********************************/
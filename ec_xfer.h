@@ -0,0 +1,120 @@
+/*
+  Copyright (C) 2020 Embed Creativity LLC
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+/************************************************************************/
+/*                                                                      */
+/*  ec_xfer.h --  EmbedCreativity's Serial bulk transfer header file    */
+/*                                                                      */
+/************************************************************************/
+/*  Author:     agent                                                   */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*  This header file contains declarations the functions contained in   */
+/*  ec_xfer.c                                                           */
+/*                                                                      */
+/************************************************************************/
+/*  Revision History:                                                   */
+/*                                                                      */
+/*  10/16/2026(agent): created                                          */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(_SERIALXFER_H)
+#define _SERIALXFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ec_serial.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------------ */
+/*                  Definitions                                 */
+/* ------------------------------------------------------------ */
+
+#define SERIAL_XFER_BLOCK_DEFAULT   1024    // payload bytes per block
+#define SERIAL_XFER_BLOCK_MAX       4096
+#define SERIAL_XFER_WINDOW_DEFAULT  32      // blocks sent ahead of the acknowledgements
+#define SERIAL_XFER_WINDOW_MAX      256
+#define SERIAL_XFER_RETRY_DEFAULT   10      // timeouts in a row before giving up
+
+/* ------------------------------------------------------------ */
+/*                  General Type Declarations                   */
+/* ------------------------------------------------------------ */
+
+typedef enum {
+    SERIAL_XFER_OK,             // the receiver has the whole image
+    SERIAL_XFER_TIMEOUT,        // the peer stopped answering
+    SERIAL_XFER_CANCELLED,      // a callback here stopped the transfer
+    SERIAL_XFER_ABORTED,        // the peer stopped the transfer
+    SERIAL_XFER_ERROR           // bad arguments or a port error, see errno
+} SERIAL_XFER_STATUS;
+
+// Reports progress, returning false cancels the transfer
+typedef bool (*SERIAL_XFER_PROGRESS_FN)(void *pvCtx, uint64_t cbDone, uint64_t cbTotal);
+
+// Takes the image in order on the receiver, returning false cancels the transfer
+typedef bool (*SERIAL_XFER_WRITE_FN)(void *pvCtx, uint64_t ib, const uint8_t *pb, size_t cb);
+
+typedef struct {
+    uint32_t    cbBlock;        // 0: SERIAL_XFER_BLOCK_DEFAULT, the receiver takes the sender's
+    uint32_t    cWindow;        // 0: SERIAL_XFER_WINDOW_DEFAULT, the receiver takes the sender's
+    uint32_t    msTimeout;      // no progress this long is a timeout, 0: from the baud rate
+    uint32_t    cRetry;         // 0: SERIAL_XFER_RETRY_DEFAULT
+    SERIAL_XFER_PROGRESS_FN pfnProgress;   // may be NULL
+    void        *pvCtx;
+
+    // SerialXferReceive()
+    SERIAL_XFER_WRITE_FN pfnWrite;
+    uint32_t    idResume;       // transfer the receiver already holds part of
+    uint64_t    cbResume;       // bytes of it pfnWrite has taken, rounded down to a block
+} SERIAL_XFER_CFG;
+
+typedef struct {
+    uint64_t    cbTotal;
+    uint64_t    cbDone;         // acknowledged, or taken by pfnWrite, resumed part included
+    uint64_t    cbResumed;      // the receiver had this much when the transfer started
+    uint64_t    cBlocks;        // blocks sent, or accepted
+    uint64_t    cRetransmits;   // blocks sent again, or duplicates received
+    uint64_t    cTimeouts;      // waits that ended without progress
+    uint64_t    cCrcErrors;     // frames dropped by the framer
+    uint64_t    nsElapsed;
+} SERIAL_XFER_STATS;
+
+/* ------------------------------------------------------------ */
+/*                  Function Prototypes                         */
+/* ------------------------------------------------------------ */
+
+SERIAL_XFER_STATUS SerialXferSend(SERIAL_PORT *port, const SERIAL_XFER_CFG *pcfg, uint32_t idXfer,
+                                  const void *pv, size_t cb, SERIAL_XFER_STATS *pstats);
+SERIAL_XFER_STATUS SerialXferReceive(SERIAL_PORT *port, const SERIAL_XFER_CFG *pcfg,
+                                     SERIAL_XFER_STATS *pstats);
+const char *SerialXferStatusName(SERIAL_XFER_STATUS status);
+/* ------------------------------------------------------------ */
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+
+/**********************************  EOF  **************************************/